@@ -304,7 +304,8 @@ module.exports = function (grunt) {
             "all"           : [
                 "Gruntfile.js",
                 "tasks/**/*.js",
-                "appshell/node-core/*.js"
+                "appshell/node-core/*.js",
+                "test/**/*.js"
             ],
             "options": {
                 "quiet"     : true
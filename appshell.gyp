@@ -611,6 +611,67 @@
             ],
           },
         },
+        {
+          # Unit tests for the parts of the shell that don't need CEF
+          # running. "grunt test" runs them.
+          'target_name': 'appshell_unittests',
+          'type': 'executable',
+          'dependencies': [
+            'libcef_dll_wrapper',
+          ],
+          'defines': [
+            'USING_CEF_SHARED',
+          ],
+          'include_dirs': [
+            '.',
+            'deps/icu/include',
+          ],
+          'cflags': [
+            '<(march)',
+          ],
+          'link_settings': {
+            'ldflags': [
+              '-pthread',
+              '<(march)',
+            ],
+            'libraries': [
+              'deps/icu/lib/libicuuc.a',
+              'deps/icu/lib/libicudata.a',
+              '-ldl',
+            ],
+          },
+          'sources': [
+            '<@(appshell_unittests_sources)',
+          ],
+        },
+        {
+          # Times ClassifyText and IsValidUTF8 against ICU's charset
+          # detection on a tree of files. Not run by the build.
+          'target_name': 'appshell_text_benchmark',
+          'type': 'executable',
+          'include_dirs': [
+            '.',
+            'deps/icu/include',
+          ],
+          'cflags': [
+            '<(march)',
+          ],
+          'link_settings': {
+            'ldflags': [
+              '-pthread',
+              '<(march)',
+            ],
+            'libraries': [
+              'deps/icu/lib/libicui18n.a',
+              'deps/icu/lib/libicuuc.a',
+              'deps/icu/lib/libicudata.a',
+              '-ldl',
+            ],
+          },
+          'sources': [
+            '<@(appshell_text_benchmark_sources)',
+          ],
+        },
       ],
     }],  # OS=="linux" or OS=="freebsd" or OS=="openbsd"
     ['target_arch=="ia32"', {
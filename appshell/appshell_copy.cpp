@@ -0,0 +1,771 @@
+/*
+ * Copyright (c) 2016 - present Adobe Systems Incorporated. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "appshell_copy.h"
+
+#include "appshell_extensions.h"
+#include "appshell_helpers.h"
+#include "appshell_worker_pool.h"
+
+#include "include/base/cef_bind.h"
+#include "include/base/cef_lock.h"
+#include "include/cef_task.h"
+#include "include/wrapper/cef_closure_task.h"
+
+#include <map>
+
+#ifdef OS_LINUX
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <deque>
+#include <vector>
+
+// Not in the headers of older distributions.
+#ifndef FICLONE
+#define FICLONE _IOW(0x94, 9, int)
+#endif
+#endif
+
+namespace appshell_extensions {
+
+#ifdef OS_LINUX
+
+namespace {
+
+// Bytes handed to the kernel per copy_file_range() or sendfile() call, and
+// so roughly how often progress is reported for a large file.
+const size_t kChunkSize = 8 * 1024 * 1024;
+
+// Files copied concurrently by one copy.
+const int kMaxRunners = appshell::kWorkerPoolSize;
+
+// Files and directories a runner copies before it goes to the back of its
+// worker's queue, so other commands aren't held up by a big copy.
+const int kItemsPerTask = 32;
+
+const int64 kProgressIntervalMicroseconds = 100 * 1000;
+
+// Whether a copy_file_range() or sendfile() failure means the call can't be
+// used for these files at all, rather than that the copy failed.
+bool IsUnsupported(int error)
+{
+    return error == ENOSYS || error == EXDEV || error == EINVAL ||
+           error == EOPNOTSUPP || error == EBADF;
+}
+
+// Copies everything from |in| to |out|, both at offset 0.
+int32 CopyContents(int in, int out, off_t size, CopyProgressDelegate* delegate)
+{
+    if (ioctl(out, FICLONE, in) == 0) {
+        if (delegate && !delegate->OnBytesCopied(size)) {
+            return ERR_CANCELLED;
+        }
+        return NO_ERROR;
+    }
+
+    bool copied = false;
+
+#ifdef __NR_copy_file_range
+    // Called through syscall(), since older C libraries have no wrapper.
+    for (;;) {
+        ssize_t count = syscall(__NR_copy_file_range, in, NULL, out, NULL, kChunkSize, 0);
+        if (count == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (!copied && IsUnsupported(errno)) {
+                break;
+            }
+            return ConvertLinuxErrorCode(errno, false);
+        }
+        if (count == 0) {
+            return NO_ERROR;
+        }
+        copied = true;
+        if (delegate && !delegate->OnBytesCopied(count)) {
+            return ERR_CANCELLED;
+        }
+    }
+#endif
+
+    for (;;) {
+        ssize_t count = sendfile(out, in, NULL, kChunkSize);
+        if (count == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return ConvertLinuxErrorCode(errno, false);
+        }
+        if (count == 0) {
+            return NO_ERROR;
+        }
+        if (delegate && !delegate->OnBytesCopied(count)) {
+            return ERR_CANCELLED;
+        }
+    }
+}
+
+int32 CopySymlink(const std::string& src, const std::string& dest, off_t length)
+{
+    std::vector<char> target(length + 1);
+    ssize_t count = readlink(src.c_str(), &target[0], target.size());
+    if (count == -1) {
+        return ConvertLinuxErrorCode(errno, true);
+    }
+    if ((size_t)count >= target.size()) {
+        // The link changed since it was looked at.
+        return ERR_UNKNOWN;
+    }
+    target[count] = '\0';
+
+    if (unlink(dest.c_str()) == -1 && errno != ENOENT) {
+        return ConvertLinuxErrorCode(errno, false);
+    }
+    if (symlink(&target[0], dest.c_str()) == -1) {
+        return ConvertLinuxErrorCode(errno, false);
+    }
+    return NO_ERROR;
+}
+
+}  // namespace
+
+int32 CopyFileOrSymlink(const std::string& src, const std::string& dest, bool keepMode,
+                        CopyProgressDelegate* delegate)
+{
+    struct stat statbuf;
+    if (lstat(src.c_str(), &statbuf) == -1) {
+        return ConvertLinuxErrorCode(errno, true);
+    }
+    if (S_ISLNK(statbuf.st_mode)) {
+        return CopySymlink(src, dest, statbuf.st_size);
+    }
+    if (!S_ISREG(statbuf.st_mode)) {
+        return ERR_NOT_FILE;
+    }
+
+    int in = open(src.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in == -1) {
+        return ConvertLinuxErrorCode(errno, true);
+    }
+    if (fstat(in, &statbuf) == -1) {
+        int32 error = ConvertLinuxErrorCode(errno, true);
+        close(in);
+        return error;
+    }
+
+    // A symlink at |dest| is replaced, not written through.
+    struct stat destStat;
+    bool exists = lstat(dest.c_str(), &destStat) == 0;
+    if (exists && S_ISLNK(destStat.st_mode)) {
+        if (unlink(dest.c_str()) == -1) {
+            int32 error = ConvertLinuxErrorCode(errno, false);
+            close(in);
+            return error;
+        }
+        exists = false;
+    }
+    if (exists && (S_ISDIR(destStat.st_mode) ||
+                   (destStat.st_dev == statbuf.st_dev && destStat.st_ino == statbuf.st_ino))) {
+        close(in);
+        return S_ISDIR(destStat.st_mode) ? ERR_NOT_FILE : ERR_INVALID_PARAMS;
+    }
+
+    // An existing file is replaced by a copy made under a temp name next to
+    // it, so a failed copy leaves it as it was. Unless |keepMode| is set, it
+    // keeps its mode. If its directory isn't writable, it is written in place
+    // instead.
+    std::string tempPath;
+    int out = -1;
+    if (exists) {
+        size_t slash = dest.rfind('/');
+        std::string dir = (slash == std::string::npos) ? std::string() : dest.substr(0, slash + 1);
+        tempPath = dir + "." + dest.substr(dir.size()) + ".XXXXXX";
+        out = mkostemp(&tempPath[0], O_CLOEXEC);
+        if (out != -1) {
+            fchmod(out, (keepMode ? statbuf.st_mode : destStat.st_mode) & 07777);
+        } else if (errno == EACCES || errno == EPERM || errno == EROFS) {
+            tempPath.clear();
+            out = open(dest.c_str(), O_WRONLY | O_TRUNC | O_CLOEXEC);
+        }
+    } else {
+        tempPath = dest;
+        out = open(dest.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, keepMode ? (statbuf.st_mode & 07777) : 0666);
+    }
+    if (out == -1) {
+        int32 error = ConvertLinuxErrorCode(errno, false);
+        close(in);
+        return error;
+    }
+
+    int32 error = CopyContents(in, out, statbuf.st_size, delegate);
+    close(in);
+    if (close(out) == -1 && error == NO_ERROR) {
+        error = ConvertLinuxErrorCode(errno, false);
+    }
+    if (error == NO_ERROR && !tempPath.empty() && tempPath != dest && rename(tempPath.c_str(), dest.c_str()) == -1) {
+        error = ConvertLinuxErrorCode(errno, false);
+    }
+    if (error != NO_ERROR && !tempPath.empty()) {
+        // Only what this call created; an existing file is left alone.
+        unlink(tempPath.c_str());
+    }
+    return error;
+}
+
+namespace {
+
+struct CopyItem {
+    CopyItem(const std::string& relativePath, bool isDirectory)
+        : relativePath(relativePath), isDirectory(isDirectory) {}
+
+    // Empty for the source itself.
+    std::string relativePath;
+    bool isDirectory;
+};
+
+// A directory that was created writable by its owner although the source
+// isn't, to be given the source's mode once the copy is done.
+struct LockedDirectory {
+    std::string path;
+    dev_t device;
+    ino_t id;
+    mode_t mode;
+};
+
+class Copy : public CefBase, public CopyProgressDelegate {
+public:
+    Copy(CefRefPtr<CefBrowser> browser,
+         CefRefPtr<CefProcessMessage> response,
+         int32 copyId,
+         const ExtensionString& src,
+         const ExtensionString& dest)
+        : browser_(browser)
+        , response_(response)
+        , copyId_(copyId)
+        , src_(src)
+        , dest_(dest)
+        , destId_(0)
+        , destDevice_(0)
+        , runners_(0)
+        , nextRunner_(0)
+        , busy_(0)
+        , bytesCopied_(0)
+        , totalBytes_(0)
+        , filesCopied_(0)
+        , totalFiles_(0)
+        , lastProgressTime_(0)
+        , error_(NO_ERROR)
+        , cancelled_(false)
+        , finished_(false) {
+        // Without trailing slashes, so relative paths can be appended with one.
+        while (src_.length() > 1 && src_[src_.length() - 1] == '/') {
+            src_.erase(src_.length() - 1);
+        }
+        while (dest_.length() > 1 && dest_[dest_.length() - 1] == '/') {
+            dest_.erase(dest_.length() - 1);
+        }
+    }
+
+    // Looks at the source and starts the first runner.
+    void Start();
+
+    // Called on the UI thread.
+    void Cancel();
+
+    // Called on the worker threads. Copies queued items until there are none
+    // left, something failed or the copy is cancelled.
+    void Run(int runner);
+
+    // CopyProgressDelegate
+    virtual bool OnBytesCopied(int64 bytes);
+
+private:
+    void PostRunner(int runner);
+    std::string SourcePath(const std::string& relativePath) const;
+    std::string DestPath(const std::string& relativePath) const;
+    void CopyDirectory(const std::string& relativePath);
+    void CopyFileEntry(const std::string& relativePath);
+    void Fail(int32 error, const std::string& path);
+    void SendProgress(bool force);
+    void RestoreDirectoryModes();
+    void Finish();
+
+    CefRefPtr<CefBrowser> browser_;
+    CefRefPtr<CefProcessMessage> response_;
+    int32 copyId_;
+    ExtensionString src_;
+    ExtensionString dest_;
+
+    // The directory created for the source, which is skipped if it turns up
+    // in the source tree.
+    ino_t destId_;
+    dev_t destDevice_;
+
+    // Shared between the UI thread and the runners.
+    base::Lock lock_;
+    std::deque<CopyItem> queue_;
+    std::vector<LockedDirectory> lockedDirectories_;  // parents before children
+    int runners_;
+    int nextRunner_;
+    int busy_;
+    int64 bytesCopied_;
+    int64 totalBytes_;
+    int32 filesCopied_;
+    int32 totalFiles_;
+    int64 lastProgressTime_;
+    int32 error_;
+    std::string failedPath_;
+    bool cancelled_;
+    bool finished_;
+
+    IMPLEMENT_REFCOUNTING(Copy);
+};
+
+typedef std::pair<int, int32> CopyKey;
+typedef std::map<CopyKey, CefRefPtr<Copy> > CopyMap;
+
+// Copies that haven't finished yet. UI thread only.
+CopyMap g_copies;
+
+void StartTask(CefRefPtr<Copy> copy)
+{
+    copy->Start();
+}
+
+void RunTask(CefRefPtr<Copy> copy, int runner)
+{
+    copy->Run(runner);
+}
+
+void RemoveCopy(CopyKey key, CefRefPtr<Copy> copy)
+{
+    CopyMap::iterator it = g_copies.find(key);
+    if (it != g_copies.end() && it->second.get() == copy.get()) {
+        g_copies.erase(it);
+    }
+}
+
+std::string Copy::SourcePath(const std::string& relativePath) const
+{
+    return relativePath.empty() ? src_ : src_ + "/" + relativePath;
+}
+
+std::string Copy::DestPath(const std::string& relativePath) const
+{
+    return relativePath.empty() ? dest_ : dest_ + "/" + relativePath;
+}
+
+void Copy::Start()
+{
+    struct stat statbuf;
+    if (lstat(src_.c_str(), &statbuf) == -1) {
+        Fail(ConvertLinuxErrorCode(errno, true), src_);
+        Finish();
+        return;
+    }
+
+    bool isDirectory = S_ISDIR(statbuf.st_mode);
+    if (!isDirectory && !S_ISREG(statbuf.st_mode) && !S_ISLNK(statbuf.st_mode)) {
+        Fail(ERR_NOT_FILE, src_);
+        Finish();
+        return;
+    }
+
+    {
+        base::AutoLock lock(lock_);
+        lastProgressTime_ = appshell::GetMonotonicMicroseconds();
+        if (isDirectory) {
+            queue_.push_back(CopyItem("", true));
+        } else {
+            queue_.push_back(CopyItem("", false));
+            totalFiles_ = 1;
+            totalBytes_ = S_ISREG(statbuf.st_mode) ? statbuf.st_size : 0;
+        }
+        runners_ = 1;
+        nextRunner_ = 1;
+    }
+    Run(0);
+}
+
+void Copy::Cancel()
+{
+    base::AutoLock lock(lock_);
+    cancelled_ = true;
+}
+
+void Copy::Fail(int32 error, const std::string& path)
+{
+    base::AutoLock lock(lock_);
+    if (error_ == NO_ERROR && !cancelled_) {
+        error_ = error;
+        failedPath_ = path;
+    }
+}
+
+// Each runner keeps to one worker, so a copy never takes more than
+// kMaxRunners threads.
+void Copy::PostRunner(int runner)
+{
+    char key[32];
+    snprintf(key, sizeof(key), "\ncopy%d", runner);
+    appshell::PostWorkerTask(src_ + key, base::Bind(&RunTask, CefRefPtr<Copy>(this), runner));
+}
+
+void Copy::Run(int runner)
+{
+    for (int items = 0; items < kItemsPerTask; items++) {
+        CopyItem item("", false);
+        {
+            base::AutoLock lock(lock_);
+            if (cancelled_ || error_ != NO_ERROR || queue_.empty()) {
+                break;
+            }
+            item = queue_.front();
+            queue_.pop_front();
+            busy_++;
+        }
+
+        if (item.isDirectory) {
+            CopyDirectory(item.relativePath);
+        } else {
+            CopyFileEntry(item.relativePath);
+        }
+
+        base::AutoLock lock(lock_);
+        busy_--;
+    }
+
+    bool more = false;
+    bool done = false;
+    {
+        base::AutoLock lock(lock_);
+        if (!cancelled_ && error_ == NO_ERROR && !queue_.empty()) {
+            more = true;
+        } else {
+            runners_--;
+            done = !finished_ && runners_ == 0 && busy_ == 0;
+            if (done) {
+                finished_ = true;
+            }
+        }
+    }
+
+    if (more) {
+        // Let whatever else is queued on this worker run first.
+        PostRunner(runner);
+    } else if (done) {
+        Finish();
+    }
+}
+
+void Copy::CopyDirectory(const std::string& relativePath)
+{
+    std::string source = SourcePath(relativePath);
+    std::string destination = DestPath(relativePath);
+
+    int dirfd = open(source.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    DIR* dp = (dirfd == -1) ? NULL : fdopendir(dirfd);
+    if (dp == NULL) {
+        Fail(ConvertLinuxErrorCode(errno, true), source);
+        if (dirfd != -1) {
+            close(dirfd);
+        }
+        return;
+    }
+
+    // Made writable by the owner whatever the source's permissions, so its
+    // contents can be copied in. RestoreDirectoryModes() puts the source's
+    // mode back at the end.
+    struct stat statbuf;
+    bool created = false;
+    if (fstat(dirfd, &statbuf) == -1) {
+        Fail(ConvertLinuxErrorCode(errno, true), source);
+        closedir(dp);
+        return;
+    }
+    mode_t mode = statbuf.st_mode & 07777;
+    if (mkdir(destination.c_str(), mode | S_IRWXU) == 0) {
+        created = true;
+    } else if (errno != EEXIST) {
+        Fail(ConvertLinuxErrorCode(errno, false), destination);
+        closedir(dp);
+        return;
+    }
+
+    struct stat destStat;
+    if (stat(destination.c_str(), &destStat) == -1 || !S_ISDIR(destStat.st_mode)) {
+        Fail(ERR_NOT_DIRECTORY, destination);
+        closedir(dp);
+        return;
+    }
+    if (relativePath.empty()) {
+        destId_ = destStat.st_ino;
+        destDevice_ = destStat.st_dev;
+    }
+    if (created && (mode & S_IRWXU) != S_IRWXU) {
+        LockedDirectory locked;
+        locked.path = destination;
+        locked.device = destStat.st_dev;
+        locked.id = destStat.st_ino;
+        locked.mode = mode;
+        base::AutoLock lock(lock_);
+        lockedDirectories_.push_back(locked);
+    }
+
+    std::vector<CopyItem> items;
+    int32 files = 0;
+    int64 bytes = 0;
+    struct dirent* entry;
+
+    while ((entry = readdir(dp)) != NULL) {
+        const char* name = entry->d_name;
+        if (!strcmp(name, ".") || !strcmp(name, "..")) {
+            continue;
+        }
+
+        if (fstatat(dirfd, name, &statbuf, AT_SYMLINK_NOFOLLOW) == -1) {
+            continue;
+        }
+
+        std::string entryPath = relativePath.empty() ? std::string(name) : relativePath + "/" + name;
+        if (S_ISDIR(statbuf.st_mode)) {
+            // Copying a directory into itself stops at the copy.
+            if (statbuf.st_ino != destId_ || statbuf.st_dev != destDevice_) {
+                items.push_back(CopyItem(entryPath, true));
+            }
+        } else if (S_ISREG(statbuf.st_mode) || S_ISLNK(statbuf.st_mode)) {
+            items.push_back(CopyItem(entryPath, false));
+            files++;
+            if (S_ISREG(statbuf.st_mode)) {
+                bytes += statbuf.st_size;
+            }
+        }
+        // Sockets, fifos and devices are left out.
+    }
+
+    // Also closes dirfd.
+    closedir(dp);
+
+    std::vector<int> newRunners;
+    {
+        base::AutoLock lock(lock_);
+        totalFiles_ += files;
+        totalBytes_ += bytes;
+        queue_.insert(queue_.end(), items.begin(), items.end());
+        while (runners_ < kMaxRunners && queue_.size() > (size_t)runners_) {
+            runners_++;
+            newRunners.push_back(nextRunner_++);
+        }
+    }
+
+    for (size_t i = 0; i < newRunners.size(); i++) {
+        PostRunner(newRunners[i]);
+    }
+}
+
+void Copy::CopyFileEntry(const std::string& relativePath)
+{
+    std::string source = SourcePath(relativePath);
+    int32 error = CopyFileOrSymlink(source, DestPath(relativePath), true, this);
+    if (error != NO_ERROR) {
+        if (error != ERR_CANCELLED) {
+            Fail(error, source);
+        }
+        return;
+    }
+
+    {
+        base::AutoLock lock(lock_);
+        filesCopied_++;
+    }
+    SendProgress(false);
+}
+
+bool Copy::OnBytesCopied(int64 bytes)
+{
+    {
+        base::AutoLock lock(lock_);
+        bytesCopied_ += bytes;
+        if (cancelled_ || error_ != NO_ERROR) {
+            return false;
+        }
+    }
+    SendProgress(false);
+    return true;
+}
+
+void Copy::SendProgress(bool force)
+{
+    CefRefPtr<CefProcessMessage> message = CefProcessMessage::Create("invokeProgressCallback");
+    CefRefPtr<CefListValue> messageArgs = message->GetArgumentList();
+    {
+        base::AutoLock lock(lock_);
+        int64 now = appshell::GetMonotonicMicroseconds();
+        if (!force && now - lastProgressTime_ < kProgressIntervalMicroseconds) {
+            return;
+        }
+        lastProgressTime_ = now;
+
+        // Progress callbacks get null in place of the error code, which tells
+        // the JS side apart from the final callback.
+        messageArgs->SetInt(0, response_->GetArgumentList()->GetInt(0));
+        messageArgs->SetNull(1);
+        messageArgs->SetDouble(2, (double)bytesCopied_);
+        messageArgs->SetDouble(3, (double)totalBytes_);
+        messageArgs->SetInt(4, filesCopied_);
+        messageArgs->SetInt(5, totalFiles_);
+    }
+    SendResponse(browser_, message);
+}
+
+// Called once nothing else is being copied. Children go first, since a
+// parent without write or search permission would keep them from being
+// opened.
+void Copy::RestoreDirectoryModes()
+{
+    for (size_t i = lockedDirectories_.size(); i-- > 0; ) {
+        const LockedDirectory& locked = lockedDirectories_[i];
+        int fd = open(locked.path.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        if (fd == -1) {
+            continue;
+        }
+        // Only if it is still the directory this copy created.
+        struct stat statbuf;
+        if (fstat(fd, &statbuf) == 0 && statbuf.st_dev == locked.device && statbuf.st_ino == locked.id) {
+            fchmod(fd, locked.mode);
+        }
+        close(fd);
+    }
+    lockedDirectories_.clear();
+}
+
+void Copy::Finish()
+{
+    int32 error;
+    int32 filesCopied;
+    int64 bytesCopied;
+    std::string failedPath;
+    {
+        base::AutoLock lock(lock_);
+        finished_ = true;
+        queue_.clear();
+        error = cancelled_ ? ERR_CANCELLED : error_;
+        filesCopied = filesCopied_;
+        bytesCopied = bytesCopied_;
+        failedPath = failedPath_;
+    }
+
+    RestoreDirectoryModes();
+
+    if (error == NO_ERROR) {
+        // So the last progress callback shows everything copied.
+        SendProgress(true);
+    }
+
+    CefRefPtr<CefListValue> responseArgs = response_->GetArgumentList();
+    responseArgs->SetInt(1, error);
+    responseArgs->SetInt(2, filesCopied);
+    responseArgs->SetDouble(3, (double)bytesCopied);
+    responseArgs->SetString(4, failedPath);
+    SendResponse(browser_, response_);
+
+    CefPostTask(TID_UI, base::Bind(&RemoveCopy, CopyKey(browser_->GetIdentifier(), copyId_),
+                                   CefRefPtr<Copy>(this)));
+}
+
+}  // namespace
+
+void StartCopy(CefRefPtr<CefBrowser> browser,
+               CefRefPtr<CefProcessMessage> response,
+               int32 copyId,
+               const ExtensionString& src,
+               const ExtensionString& dest)
+{
+    CopyKey key(browser->GetIdentifier(), copyId);
+
+    // Ids are handed out by the renderer, which starts over after a reload.
+    CopyMap::iterator existing = g_copies.find(key);
+    if (existing != g_copies.end()) {
+        existing->second->Cancel();
+    }
+
+    CefRefPtr<Copy> copy = new Copy(browser, response, copyId, src, dest);
+    g_copies[key] = copy;
+    appshell::PostWorkerTask(src, base::Bind(&StartTask, copy));
+}
+
+void CancelCopy(CefRefPtr<CefBrowser> browser, int32 copyId)
+{
+    CopyMap::iterator it = g_copies.find(CopyKey(browser->GetIdentifier(), copyId));
+    if (it != g_copies.end()) {
+        it->second->Cancel();
+    }
+}
+
+void CancelBrowserCopies(CefRefPtr<CefBrowser> browser)
+{
+    CopyMap::iterator it = g_copies.begin();
+    while (it != g_copies.end()) {
+        if (it->first.first == browser->GetIdentifier()) {
+            it->second->Cancel();
+            g_copies.erase(it++);
+        } else {
+            ++it;
+        }
+    }
+}
+
+#else
+
+void StartCopy(CefRefPtr<CefBrowser> browser,
+               CefRefPtr<CefProcessMessage> response,
+               int32 copyId,
+               const ExtensionString& src,
+               const ExtensionString& dest)
+{
+    CefRefPtr<CefListValue> responseArgs = response->GetArgumentList();
+    responseArgs->SetInt(1, ERR_NOT_SUPPORTED);
+    responseArgs->SetInt(2, 0);
+    responseArgs->SetDouble(3, 0);
+    responseArgs->SetString(4, ExtensionString());
+    SendResponse(browser, response);
+}
+
+void CancelCopy(CefRefPtr<CefBrowser> browser, int32 copyId)
+{
+}
+
+void CancelBrowserCopies(CefRefPtr<CefBrowser> browser)
+{
+}
+
+#endif
+
+}  // namespace appshell_extensions
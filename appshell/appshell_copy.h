@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2016 - present Adobe Systems Incorporated. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "include/cef_browser.h"
+#include "include/cef_process_message.h"
+
+#include "appshell_extensions_platform.h"
+
+#include <string>
+
+namespace appshell_extensions {
+
+// Copies of files and whole directory trees for appshell.fs.copy().
+//
+// File contents never pass through the shell: a copy is first tried as a
+// reflink (FICLONE), which is instant on btrfs and XFS, then with
+// copy_file_range() and finally with sendfile(). Symlinks are copied as
+// links. Directories are read and their files copied on the worker pool,
+// several at a time.
+//
+// While the copy runs, the renderer gets "invokeProgressCallback" messages
+// with the bytes and files copied so far and the totals found so far; the
+// totals keep growing until the whole source tree has been read. The final
+// "invokeCallback" comes once everything has been copied, something failed
+// or the copy was cancelled. What was copied before a failure is left in
+// place.
+//
+// Only implemented on Linux; other platforms respond with ERR_NOT_SUPPORTED.
+//
+// All of these functions must be called on the UI thread.
+
+// Starts copying |src| to |dest|. A file replaces whatever file is at |dest|;
+// a directory is merged into the directory at |dest|, which is created if it
+// doesn't exist. |response| is the final response message and already holds
+// the callback id. The response gets the error code, the number of files and
+// bytes copied and, on failure, the path that couldn't be copied.
+void StartCopy(CefRefPtr<CefBrowser> browser,
+               CefRefPtr<CefProcessMessage> response,
+               int32 copyId,
+               const ExtensionString& src,
+               const ExtensionString& dest);
+
+// Stops copy |copyId|. Its callback gets ERR_CANCELLED.
+void CancelCopy(CefRefPtr<CefBrowser> browser, int32 copyId);
+
+// Stops every copy of |browser|. Called when the browser closes.
+void CancelBrowserCopies(CefRefPtr<CefBrowser> browser);
+
+#ifdef OS_LINUX
+class CopyProgressDelegate {
+public:
+    // Called after each chunk of a file has been copied. Returning false
+    // stops the copy with ERR_CANCELLED.
+    virtual bool OnBytesCopied(int64 bytes) = 0;
+
+protected:
+    virtual ~CopyProgressDelegate() {}
+};
+
+// Copies the file or symlink at |src| to |dest|, replacing a file or symlink
+// already there. A file is replaced by renaming a finished copy over it, so
+// it is left as it was if the copy fails. The copy gets the permissions of
+// |src| if |keepMode| is true, otherwise those of the file it replaces or the
+// default ones. |delegate| may be NULL.
+int32 CopyFileOrSymlink(const std::string& src, const std::string& dest, bool keepMode,
+                        CopyProgressDelegate* delegate);
+#endif
+
+}  // namespace appshell_extensions
@@ -0,0 +1,671 @@
+/*
+ * Copyright (c) 2016 - present Adobe Systems Incorporated. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "appshell_delete.h"
+
+#include "appshell_extensions.h"
+#include "appshell_helpers.h"
+#include "appshell_worker_pool.h"
+
+#include "include/base/cef_bind.h"
+#include "include/base/cef_lock.h"
+#include "include/cef_task.h"
+#include "include/wrapper/cef_closure_task.h"
+
+#include <map>
+
+#ifdef OS_LINUX
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <deque>
+#endif
+
+namespace appshell_extensions {
+
+#ifdef OS_LINUX
+
+namespace {
+
+// Paths or directories handled concurrently by one job.
+const int kMaxRunners = appshell::kWorkerPoolSize;
+
+// Directories or paths a runner handles before it goes to the back of its
+// worker's queue, so other commands aren't held up by a big job.
+const int kItemsPerTask = 32;
+
+// How often the cancel flag is checked while emptying a large directory.
+const size_t kCancelCheckInterval = 1024;
+
+const int64 kProgressIntervalMicroseconds = 100 * 1000;
+
+int32 DeleteTreeAt(int dirfd, const char* name)
+{
+    if (unlinkat(dirfd, name, 0) == 0) {
+        return NO_ERROR;
+    }
+    if (errno != EISDIR) {
+        return ConvertLinuxErrorCode(errno, false);
+    }
+
+    int fd = openat(dirfd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    DIR* dp = (fd == -1) ? NULL : fdopendir(fd);
+    if (dp == NULL) {
+        int32 error = ConvertLinuxErrorCode(errno, false);
+        if (fd != -1) {
+            close(fd);
+        }
+        return error;
+    }
+
+    int32 error = NO_ERROR;
+    struct dirent* entry;
+    while (error == NO_ERROR && (entry = readdir(dp)) != NULL) {
+        if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, "..")) {
+            continue;
+        }
+        error = DeleteTreeAt(fd, entry->d_name);
+        if (error == ERR_NOT_FOUND) {
+            // Deleted by someone else in the meantime.
+            error = NO_ERROR;
+        }
+    }
+
+    // Also closes fd.
+    closedir(dp);
+
+    if (error == NO_ERROR && unlinkat(dirfd, name, AT_REMOVEDIR) == -1) {
+        error = ConvertLinuxErrorCode(errno, false);
+    }
+    return error;
+}
+
+}  // namespace
+
+int32 DeleteTree(const std::string& path)
+{
+    return DeleteTreeAt(AT_FDCWD, path.c_str());
+}
+
+namespace {
+
+const size_t kNoParent = (size_t)-1;
+
+// A path given to the job, or a directory found under one when deleting.
+// Directories are opened and removed relative to their parent's descriptor,
+// so a directory swapped for a symlink partway through can't send the job
+// somewhere else.
+struct RemoveNode {
+    RemoveNode(const std::string& path, const std::string& name, size_t parent, bool isDirectory)
+        : path(path), name(name), parent(parent), isDirectory(isDirectory), fd(-1), pending(0), failed(false) {}
+
+    // The full path, for failures, and the name in the parent. For the paths
+    // given to the job, both are that path.
+    std::string path;
+    std::string name;
+    size_t parent;
+    bool isDirectory;
+
+    // The open directory, while its subdirectories are being removed.
+    int fd;
+
+    // Subdirectories not removed yet.
+    int pending;
+
+    // Whether something under the directory couldn't be removed.
+    bool failed;
+};
+
+class Remove : public CefBase {
+public:
+    Remove(CefRefPtr<CefBrowser> browser,
+           CefRefPtr<CefProcessMessage> response,
+           int32 removeId,
+           const std::vector<ExtensionString>& paths,
+           bool toTrash)
+        : browser_(browser)
+        , response_(response)
+        , removeId_(removeId)
+        , key_(paths.empty() ? ExtensionString() : paths[0])
+        , paths_(paths)
+        , toTrash_(toTrash)
+        , runners_(0)
+        , nextRunner_(0)
+        , busy_(0)
+        , removedCount_(0)
+        , failedCount_(0)
+        , error_(NO_ERROR)
+        , failures_(CefListValue::Create())
+        , lastProgressTime_(0)
+        , cancelled_(false)
+        , finished_(false) {}
+
+    // Queues the paths and starts the runners.
+    void Start();
+
+    // Called on the UI thread.
+    void Cancel();
+
+    // Called on the worker threads. Handles queued paths and directories
+    // until there are none left or the job is cancelled.
+    void Run(int runner);
+
+private:
+    void PostRunner(int runner);
+    void RemovePath(size_t index);
+    void EmptyDirectory(size_t index);
+    void RemoveDirectory(size_t index);
+    void CloseDirectories();
+    void AddFailure(const std::string& path, int32 error);
+    bool IsCancelled();
+    void SendProgress(bool force);
+    void Finish();
+
+    CefRefPtr<CefBrowser> browser_;
+    CefRefPtr<CefProcessMessage> response_;
+    int32 removeId_;
+    ExtensionString key_;
+    std::vector<ExtensionString> paths_;
+    bool toTrash_;
+
+    // Shared between the UI thread and the runners. Nodes are only ever
+    // added at the back, so references to them stay valid.
+    base::Lock lock_;
+    std::deque<RemoveNode> nodes_;
+    std::deque<size_t> queue_;
+    int runners_;
+    int nextRunner_;
+    int busy_;
+    int32 removedCount_;
+    int32 failedCount_;
+    int32 error_;
+    CefRefPtr<CefListValue> failures_;
+    int64 lastProgressTime_;
+    bool cancelled_;
+    bool finished_;
+
+    IMPLEMENT_REFCOUNTING(Remove);
+};
+
+typedef std::pair<int, int32> RemoveKey;
+typedef std::map<RemoveKey, CefRefPtr<Remove> > RemoveMap;
+
+// Jobs that haven't finished yet. UI thread only.
+RemoveMap g_removes;
+
+void StartTask(CefRefPtr<Remove> remove)
+{
+    remove->Start();
+}
+
+void RunTask(CefRefPtr<Remove> remove, int runner)
+{
+    remove->Run(runner);
+}
+
+void RemoveRemove(RemoveKey key, CefRefPtr<Remove> remove)
+{
+    RemoveMap::iterator it = g_removes.find(key);
+    if (it != g_removes.end() && it->second.get() == remove.get()) {
+        g_removes.erase(it);
+    }
+}
+
+void Remove::Start()
+{
+    std::vector<int> newRunners;
+    {
+        base::AutoLock lock(lock_);
+        lastProgressTime_ = appshell::GetMonotonicMicroseconds();
+        for (size_t i = 0; i < paths_.size(); i++) {
+            nodes_.push_back(RemoveNode(paths_[i], paths_[i], kNoParent, false));
+            queue_.push_back(i);
+        }
+        paths_.clear();
+        while (runners_ < kMaxRunners && queue_.size() > (size_t)runners_) {
+            runners_++;
+            newRunners.push_back(nextRunner_++);
+        }
+    }
+
+    if (newRunners.empty()) {
+        Finish();
+        return;
+    }
+    for (size_t i = 0; i < newRunners.size(); i++) {
+        PostRunner(newRunners[i]);
+    }
+}
+
+void Remove::Cancel()
+{
+    base::AutoLock lock(lock_);
+    cancelled_ = true;
+}
+
+bool Remove::IsCancelled()
+{
+    base::AutoLock lock(lock_);
+    return cancelled_;
+}
+
+// Each runner keeps to one worker, so a job never takes more than
+// kMaxRunners threads.
+void Remove::PostRunner(int runner)
+{
+    char key[32];
+    snprintf(key, sizeof(key), "\nremove%d", runner);
+    appshell::PostWorkerTask(key_ + key, base::Bind(&RunTask, CefRefPtr<Remove>(this), runner));
+}
+
+void Remove::Run(int runner)
+{
+    for (int items = 0; items < kItemsPerTask; items++) {
+        size_t index;
+        bool isDirectory;
+        {
+            base::AutoLock lock(lock_);
+            if (cancelled_ || queue_.empty()) {
+                break;
+            }
+            index = queue_.front();
+            queue_.pop_front();
+            isDirectory = nodes_[index].isDirectory;
+            busy_++;
+        }
+
+        if (isDirectory) {
+            EmptyDirectory(index);
+        } else {
+            RemovePath(index);
+        }
+
+        base::AutoLock lock(lock_);
+        busy_--;
+    }
+
+    SendProgress(false);
+
+    bool more = false;
+    bool done = false;
+    {
+        base::AutoLock lock(lock_);
+        if (!cancelled_ && !queue_.empty()) {
+            more = true;
+        } else {
+            runners_--;
+            done = !finished_ && runners_ == 0 && busy_ == 0;
+            if (done) {
+                finished_ = true;
+            }
+        }
+    }
+
+    if (more) {
+        // Let whatever else is queued on this worker run first.
+        PostRunner(runner);
+    } else if (done) {
+        Finish();
+    }
+}
+
+// Handles one of the paths given to the job.
+void Remove::RemovePath(size_t index)
+{
+    std::string path;
+    {
+        base::AutoLock lock(lock_);
+        path = nodes_[index].path;
+    }
+
+    if (toTrash_) {
+        int32 error = MoveFileOrDirectoryToTrash(path);
+        if (error != NO_ERROR) {
+            AddFailure(path, error);
+        } else {
+            base::AutoLock lock(lock_);
+            removedCount_++;
+        }
+        return;
+    }
+
+    if (unlinkat(AT_FDCWD, path.c_str(), 0) == 0) {
+        base::AutoLock lock(lock_);
+        removedCount_++;
+    } else if (errno == EISDIR) {
+        {
+            base::AutoLock lock(lock_);
+            nodes_[index].isDirectory = true;
+        }
+        EmptyDirectory(index);
+    } else {
+        AddFailure(path, ConvertLinuxErrorCode(errno, false));
+    }
+}
+
+// Deletes everything in a directory but its subdirectories, which are queued.
+// The directory itself goes once they are gone, and stays open until then.
+void Remove::EmptyDirectory(size_t index)
+{
+    std::string directory;
+    std::string name;
+    bool isRoot;
+    int parentfd;
+    {
+        base::AutoLock lock(lock_);
+        const RemoveNode& node = nodes_[index];
+        directory = node.path;
+        name = node.name;
+        isRoot = (node.parent == kNoParent);
+        // The parent stays open until all of its subdirectories are done.
+        parentfd = isRoot ? AT_FDCWD : nodes_[node.parent].fd;
+    }
+
+    int dirfd = openat(parentfd, name.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    // Read through a duplicate, since closedir() closes the descriptor it was
+    // given.
+    int readfd = (dirfd == -1) ? -1 : fcntl(dirfd, F_DUPFD_CLOEXEC, 0);
+    DIR* dp = (readfd == -1) ? NULL : fdopendir(readfd);
+    if (dp == NULL) {
+        int32 error = ConvertLinuxErrorCode(errno, false);
+        if (readfd != -1) {
+            close(readfd);
+        }
+        if (dirfd != -1) {
+            close(dirfd);
+        }
+        // A subdirectory that's gone already is taken as removed.
+        if (error != ERR_NOT_FOUND || isRoot) {
+            AddFailure(directory, error);
+            base::AutoLock lock(lock_);
+            nodes_[index].failed = true;
+        }
+        RemoveDirectory(index);
+        return;
+    }
+
+    std::vector<std::string> subdirectories;    // names
+    std::vector<std::pair<std::string, int32> > failures;
+    size_t entries = 0;
+    int32 removed = 0;
+    struct dirent* entry;
+
+    while ((entry = readdir(dp)) != NULL) {
+        const char* name = entry->d_name;
+        if (!strcmp(name, ".") || !strcmp(name, "..")) {
+            continue;
+        }
+
+        if (++entries % kCancelCheckInterval == 0 && IsCancelled()) {
+            break;
+        }
+
+        // d_type is DT_UNKNOWN on some file systems, in which case
+        // unlinkat() tells directories apart instead.
+        if (entry->d_type != DT_DIR && unlinkat(dirfd, name, 0) == 0) {
+            removed++;
+        } else if (entry->d_type == DT_DIR || errno == EISDIR) {
+            subdirectories.push_back(name);
+        } else if (errno != ENOENT) {
+            failures.push_back(std::make_pair(directory + "/" + name, ConvertLinuxErrorCode(errno, false)));
+        }
+    }
+
+    // Closes readfd; dirfd stays open for the subdirectories.
+    closedir(dp);
+
+    for (size_t i = 0; i < failures.size(); i++) {
+        AddFailure(failures[i].first, failures[i].second);
+    }
+
+    std::vector<int> newRunners;
+    {
+        base::AutoLock lock(lock_);
+        removedCount_ += removed;
+        if (!failures.empty()) {
+            nodes_[index].failed = true;
+        }
+        nodes_[index].fd = dirfd;
+        nodes_[index].pending = (int)subdirectories.size();
+        if (!cancelled_) {
+            // Depth first, so only the directories on the way down to the
+            // ones being emptied are held open.
+            for (size_t i = subdirectories.size(); i-- > 0; ) {
+                queue_.push_front(nodes_.size());
+                nodes_.push_back(RemoveNode(directory + "/" + subdirectories[i], subdirectories[i], index, true));
+            }
+        }
+        while (runners_ < kMaxRunners && queue_.size() > (size_t)runners_) {
+            runners_++;
+            newRunners.push_back(nextRunner_++);
+        }
+    }
+
+    for (size_t i = 0; i < newRunners.size(); i++) {
+        PostRunner(newRunners[i]);
+    }
+
+    if (subdirectories.empty()) {
+        RemoveDirectory(index);
+    }
+}
+
+// Removes a directory whose subdirectories are all gone, then any of its
+// parents that were only waiting for it.
+void Remove::RemoveDirectory(size_t index)
+{
+    for (;;) {
+        std::string path;
+        std::string name;
+        int parentfd;
+        bool failed;
+        {
+            base::AutoLock lock(lock_);
+            if (cancelled_) {
+                return;
+            }
+            RemoveNode& node = nodes_[index];
+            path = node.path;
+            name = node.name;
+            parentfd = (node.parent == kNoParent) ? AT_FDCWD : nodes_[node.parent].fd;
+            failed = node.failed;
+            if (node.fd != -1) {
+                close(node.fd);
+                node.fd = -1;
+            }
+        }
+
+        if (!failed) {
+            if (unlinkat(parentfd, name.c_str(), AT_REMOVEDIR) == 0) {
+                base::AutoLock lock(lock_);
+                removedCount_++;
+            } else if (errno != ENOENT) {
+                AddFailure(path, ConvertLinuxErrorCode(errno, false));
+                failed = true;
+            }
+        }
+
+        base::AutoLock lock(lock_);
+        size_t parent = nodes_[index].parent;
+        if (parent == kNoParent) {
+            return;
+        }
+        if (failed) {
+            nodes_[parent].failed = true;
+        }
+        if (--nodes_[parent].pending > 0) {
+            return;
+        }
+        index = parent;
+    }
+}
+
+// Closes the directories left open by a cancelled job. Called once no runner
+// is using them.
+void Remove::CloseDirectories()
+{
+    base::AutoLock lock(lock_);
+    for (size_t i = 0; i < nodes_.size(); i++) {
+        if (nodes_[i].fd != -1) {
+            close(nodes_[i].fd);
+            nodes_[i].fd = -1;
+        }
+    }
+}
+
+void Remove::AddFailure(const std::string& path, int32 error)
+{
+    base::AutoLock lock(lock_);
+    if (error_ == NO_ERROR) {
+        error_ = error;
+    }
+    failedCount_++;
+    size_t size = failures_->GetSize();
+    failures_->SetString(size, path);
+    failures_->SetInt(size + 1, error);
+}
+
+void Remove::SendProgress(bool force)
+{
+    CefRefPtr<CefProcessMessage> message = CefProcessMessage::Create("invokeProgressCallback");
+    CefRefPtr<CefListValue> messageArgs = message->GetArgumentList();
+    {
+        base::AutoLock lock(lock_);
+        int64 now = appshell::GetMonotonicMicroseconds();
+        if (!force && now - lastProgressTime_ < kProgressIntervalMicroseconds) {
+            return;
+        }
+        lastProgressTime_ = now;
+
+        // Progress callbacks get null in place of the error code, which tells
+        // the JS side apart from the final callback.
+        messageArgs->SetInt(0, response_->GetArgumentList()->GetInt(0));
+        messageArgs->SetNull(1);
+        messageArgs->SetInt(2, removedCount_);
+        messageArgs->SetList(3, failures_);
+        failures_ = CefListValue::Create();
+    }
+    SendResponse(browser_, message);
+}
+
+void Remove::Finish()
+{
+    CloseDirectories();
+
+    // Failures always reach the renderer ahead of the final response.
+    SendProgress(true);
+
+    int32 error;
+    int32 removedCount;
+    int32 failedCount;
+    {
+        base::AutoLock lock(lock_);
+        finished_ = true;
+        queue_.clear();
+        nodes_.clear();
+        error = cancelled_ ? ERR_CANCELLED : error_;
+        removedCount = removedCount_;
+        failedCount = failedCount_;
+    }
+
+    CefRefPtr<CefListValue> responseArgs = response_->GetArgumentList();
+    responseArgs->SetInt(1, error);
+    responseArgs->SetInt(2, removedCount);
+    responseArgs->SetInt(3, failedCount);
+    SendResponse(browser_, response_);
+
+    CefPostTask(TID_UI, base::Bind(&RemoveRemove, RemoveKey(browser_->GetIdentifier(), removeId_),
+                                   CefRefPtr<Remove>(this)));
+}
+
+}  // namespace
+
+void StartRemove(CefRefPtr<CefBrowser> browser,
+                 CefRefPtr<CefProcessMessage> response,
+                 int32 removeId,
+                 const std::vector<ExtensionString>& paths,
+                 bool toTrash)
+{
+    RemoveKey key(browser->GetIdentifier(), removeId);
+
+    // Ids are handed out by the renderer, which starts over after a reload.
+    RemoveMap::iterator existing = g_removes.find(key);
+    if (existing != g_removes.end()) {
+        existing->second->Cancel();
+    }
+
+    CefRefPtr<Remove> remove = new Remove(browser, response, removeId, paths, toTrash);
+    g_removes[key] = remove;
+    appshell::PostWorkerTask(paths.empty() ? ExtensionString() : paths[0], base::Bind(&StartTask, remove));
+}
+
+void CancelRemove(CefRefPtr<CefBrowser> browser, int32 removeId)
+{
+    RemoveMap::iterator it = g_removes.find(RemoveKey(browser->GetIdentifier(), removeId));
+    if (it != g_removes.end()) {
+        it->second->Cancel();
+    }
+}
+
+void CancelBrowserRemoves(CefRefPtr<CefBrowser> browser)
+{
+    RemoveMap::iterator it = g_removes.begin();
+    while (it != g_removes.end()) {
+        if (it->first.first == browser->GetIdentifier()) {
+            it->second->Cancel();
+            g_removes.erase(it++);
+        } else {
+            ++it;
+        }
+    }
+}
+
+#else
+
+void StartRemove(CefRefPtr<CefBrowser> browser,
+                 CefRefPtr<CefProcessMessage> response,
+                 int32 removeId,
+                 const std::vector<ExtensionString>& paths,
+                 bool toTrash)
+{
+    CefRefPtr<CefListValue> responseArgs = response->GetArgumentList();
+    responseArgs->SetInt(1, ERR_NOT_SUPPORTED);
+    responseArgs->SetInt(2, 0);
+    responseArgs->SetInt(3, 0);
+    SendResponse(browser, response);
+}
+
+void CancelRemove(CefRefPtr<CefBrowser> browser, int32 removeId)
+{
+}
+
+void CancelBrowserRemoves(CefRefPtr<CefBrowser> browser)
+{
+}
+
+#endif
+
+}  // namespace appshell_extensions
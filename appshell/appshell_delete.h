@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2016 - present Adobe Systems Incorporated. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "include/cef_browser.h"
+#include "include/cef_process_message.h"
+
+#include "appshell_extensions_platform.h"
+
+#include <string>
+#include <vector>
+
+namespace appshell_extensions {
+
+// Deleting or trashing several files and directory trees for
+// appshell.fs.remove().
+//
+// Deleted trees are taken apart on the worker pool, several directories at a
+// time. Entries are removed relative to their directory's descriptor, and a
+// directory is removed once everything under it is gone. Trashed paths go to
+// the trash one by one, several at a time.
+//
+// While the job runs, the renderer gets "invokeProgressCallback" messages
+// with the number of entries removed so far and the path and error code of
+// each entry that couldn't be removed since the last message. Directories
+// above an entry that couldn't be removed are left in place and aren't
+// reported. The final "invokeCallback" comes once every path has been dealt
+// with or the job was cancelled.
+//
+// Only implemented on Linux; other platforms respond with ERR_NOT_SUPPORTED.
+//
+// All of these functions must be called on the UI thread.
+
+// Starts removing |paths|, moving them to the trash if |toTrash| is true.
+// |response| is the final response message and already holds the callback
+// id. The response gets the error code of the first entry that couldn't be
+// removed, the number of entries removed and the number that couldn't be.
+void StartRemove(CefRefPtr<CefBrowser> browser,
+                 CefRefPtr<CefProcessMessage> response,
+                 int32 removeId,
+                 const std::vector<ExtensionString>& paths,
+                 bool toTrash);
+
+// Stops job |removeId|. Whatever was removed already stays removed; the
+// callback gets ERR_CANCELLED.
+void CancelRemove(CefRefPtr<CefBrowser> browser, int32 removeId);
+
+// Stops every remove job of |browser|. Called when the browser closes.
+void CancelBrowserRemoves(CefRefPtr<CefBrowser> browser);
+
+#ifdef OS_LINUX
+// Deletes the file or the directory tree at |path| on the calling thread,
+// stopping at the first entry that can't be deleted.
+int32 DeleteTree(const std::string& path);
+#endif
+
+}  // namespace appshell_extensions
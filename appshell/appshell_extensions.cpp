@@ -25,15 +25,33 @@
 
 #include "appshell_extensions_platform.h"
 #include "native_menu_model.h"
+#include "appshell_copy.h"
+#include "appshell_delete.h"
+#include "appshell_fuzzy_match.h"
+#include "appshell_node_events.h"
 #include "appshell_node_process.h"
+#include "appshell_read_stream.h"
+#include "appshell_search.h"
+#include "appshell_search_index.h"
+#include "appshell_stat_many.h"
+#include "appshell_walk.h"
+#include "appshell_watch.h"
+#include "appshell_worker_pool.h"
+#include "appshell_helpers.h"
+#include "native_call_stats.h"
 #include "config.h"
 
+#include "include/base/cef_bind.h"
+#include "include/wrapper/cef_closure_task.h"
+
 #ifdef OS_LINUX
 #include "appshell/browser/main_context.h"
 #include "appshell/browser/root_window_manager.h"
 #endif
 
 #include <algorithm>
+#include <map>
+#include <string.h>
 #include "update.h"
 
 extern std::vector<CefString> gDroppedFiles;
@@ -42,6 +60,1294 @@ extern std::string g_get_remote_debugging_port_error;
 
 namespace appshell_extensions {
 
+// A call whose response is being built on a worker thread, along with what
+// SendResponse() needs to time it once it completes.
+struct PendingCall {
+    PendingCall() : stats(NULL), startTime(0) {}
+    PendingCall(NativeCallStats* callStats, int64 callStartTime)
+        : stats(callStats), startTime(callStartTime) {}
+
+    NativeCallStats* stats;
+    int64 startTime;
+};
+
+// A call is identified by its browser id and callback id.
+typedef std::pair<int, int32> PendingCallKey;
+typedef std::map<PendingCallKey, PendingCall> PendingCallMap;
+
+// Calls waiting on a worker or a job for their final "invokeCallback".
+// UI thread only.
+static PendingCallMap g_pendingCalls;
+
+// Sends an "invokeCallback" or "invokeProgressCallback" message to the
+// renderer. Messages built on a worker thread are bounced back to the UI
+// thread first, so every process message still leaves the browser process
+// from the UI thread.
+void SendResponse(CefRefPtr<CefBrowser> browser, CefRefPtr<CefProcessMessage> response)
+{
+    if (!CefCurrentlyOn(TID_UI)) {
+        CefPostTask(TID_UI, base::Bind(&SendResponse, browser, response));
+        return;
+    }
+
+    CefRefPtr<CefListValue> responseArgs = response->GetArgumentList();
+    if (response->GetName() == "invokeCallback" && responseArgs->GetType(0) == VTYPE_INT) {
+        PendingCallMap::iterator pending =
+            g_pendingCalls.find(PendingCallKey(browser->GetIdentifier(), responseArgs->GetInt(0)));
+        if (pending != g_pendingCalls.end()) {
+            bool failed = (responseArgs->GetType(1) == VTYPE_STRING) ||
+                          (responseArgs->GetType(1) == VTYPE_INT && responseArgs->GetInt(1) != NO_ERROR);
+            pending->second.stats->Record(appshell::GetMonotonicMicroseconds() - pending->second.startTime, failed);
+            g_pendingCalls.erase(pending);
+        }
+    }
+
+    browser->SendProcessMessage(PID_RENDERER, response);
+}
+
+void CancelBrowserJobs(CefRefPtr<CefBrowser> browser)
+{
+    CancelBrowserReadStreams(browser);
+    CancelBrowserWalks(browser);
+    CancelBrowserSearches(browser);
+    CancelBrowserCopies(browser);
+    CancelBrowserRemoves(browser);
+    CloseBrowserWatches(browser);
+    ClearFuzzyMatchPaths(browser);
+    RemoveNodeStateListener(browser);
+
+    // Cancelled jobs never send their final response, so they aren't timed.
+    PendingCallMap::iterator it = g_pendingCalls.begin();
+    while (it != g_pendingCalls.end()) {
+        if (it->first.first == browser->GetIdentifier()) {
+            g_pendingCalls.erase(it++);
+        } else {
+            ++it;
+        }
+    }
+}
+
+// Blocking file system commands. The UI thread validates and copies the
+// arguments, then one of these runs on the worker pool (appshell_worker_pool.h),
+// fills in the response args and sends the response.
+
+static void IsNetworkDriveTask(CefRefPtr<CefBrowser> browser, CefRefPtr<CefProcessMessage> response,
+                               ExtensionString path)
+{
+    CefRefPtr<CefListValue> responseArgs = response->GetArgumentList();
+    bool isRemote = false;
+    responseArgs->SetInt(1, IsNetworkDrive(path, isRemote));
+    responseArgs->SetBool(2, isRemote);
+    SendResponse(browser, response);
+}
+
+static void ReadDirTask(CefRefPtr<CefBrowser> browser, CefRefPtr<CefProcessMessage> response,
+                        ExtensionString path)
+{
+    CefRefPtr<CefListValue> responseArgs = response->GetArgumentList();
+    CefRefPtr<CefListValue> directoryContents = CefListValue::Create();
+    responseArgs->SetInt(1, ReadDir(path, directoryContents));
+    responseArgs->SetList(2, directoryContents);
+    SendResponse(browser, response);
+}
+
+static void MakeDirTask(CefRefPtr<CefBrowser> browser, CefRefPtr<CefProcessMessage> response,
+                        ExtensionString pathname, int32 mode)
+{
+    response->GetArgumentList()->SetInt(1, MakeDir(pathname, mode));
+    SendResponse(browser, response);
+}
+
+static void RenameTask(CefRefPtr<CefBrowser> browser, CefRefPtr<CefProcessMessage> response,
+                       ExtensionString oldName, ExtensionString newName)
+{
+    response->GetArgumentList()->SetInt(1, Rename(oldName, newName));
+    SendResponse(browser, response);
+}
+
+static void GetFileInfoTask(CefRefPtr<CefBrowser> browser, CefRefPtr<CefProcessMessage> response,
+                            ExtensionString filename)
+{
+    CefRefPtr<CefListValue> responseArgs = response->GetArgumentList();
+    ExtensionString realPath;
+    uint32 modtime;
+    double size;
+    bool isDir;
+
+    responseArgs->SetInt(1, GetFileInfo(filename, modtime, isDir, size, realPath));
+    responseArgs->SetInt(2, modtime);
+    responseArgs->SetBool(3, isDir);
+    responseArgs->SetInt(4, size);
+    responseArgs->SetString(5, realPath);
+    SendResponse(browser, response);
+}
+
+static void ReadFileTask(CefRefPtr<CefBrowser> browser, CefRefPtr<CefProcessMessage> response,
+                         ExtensionString filename, ExtensionString encoding)
+{
+    CefRefPtr<CefListValue> responseArgs = response->GetArgumentList();
+    std::string contents = "";
+    bool preserveBOM = false;
+
+    responseArgs->SetInt(1, ReadFile(filename, encoding, contents, preserveBOM));
+    responseArgs->SetString(2, contents);
+    responseArgs->SetString(3, encoding);
+    responseArgs->SetBool(4, preserveBOM);
+    SendResponse(browser, response);
+}
+
+static void WriteFileTask(CefRefPtr<CefBrowser> browser, CefRefPtr<CefProcessMessage> response,
+                          ExtensionString filename, const std::string& contents, ExtensionString encoding,
+                          bool preserveBOM, WriteFileOptions options)
+{
+    CefRefPtr<CefListValue> responseArgs = response->GetArgumentList();
+    WriteFileTimings timings;
+
+    responseArgs->SetInt(1, WriteFile(filename, contents, encoding, preserveBOM, options, timings));
+    responseArgs->SetDouble(2, timings.writeMs);
+    responseArgs->SetDouble(3, timings.syncMs);
+    responseArgs->SetDouble(4, timings.renameMs);
+    SendResponse(browser, response);
+}
+
+static void SetPosixPermissionsTask(CefRefPtr<CefBrowser> browser, CefRefPtr<CefProcessMessage> response,
+                                    ExtensionString filename, int32 mode)
+{
+    response->GetArgumentList()->SetInt(1, SetPosixPermissions(filename, mode));
+    SendResponse(browser, response);
+}
+
+static void DeleteFileOrDirectoryTask(CefRefPtr<CefBrowser> browser, CefRefPtr<CefProcessMessage> response,
+                                      ExtensionString filename)
+{
+    response->GetArgumentList()->SetInt(1, DeleteFileOrDirectory(filename));
+    SendResponse(browser, response);
+}
+
+static void CopyFileTask(CefRefPtr<CefBrowser> browser, CefRefPtr<CefProcessMessage> response,
+                         ExtensionString src, ExtensionString dest)
+{
+    response->GetArgumentList()->SetInt(1, CopyFile(src, dest));
+    SendResponse(browser, response);
+}
+
+static void ReadDirWithStatsTask(CefRefPtr<CefBrowser> browser, CefRefPtr<CefProcessMessage> response,
+                                 ExtensionString path)
+{
+    CefRefPtr<CefListValue> entries = CefListValue::Create();
+    int32 error = ReadDirWithStats(path, entries);
+
+    CefRefPtr<CefListValue> responseArgs = response->GetArgumentList();
+    responseArgs->SetInt(1, error);
+    if (error == NO_ERROR)
+        responseArgs->SetList(2, entries);
+    SendResponse(browser, response);
+}
+
+// How the response to a native command gets back to the renderer.
+enum ResponseMode {
+    // The dispatcher sends the response as soon as the handler returns.
+    RESPOND_NOW,
+    // The handler posted a worker task, which calls SendResponse() when done.
+    RESPOND_LATER,
+    // Platform code owns the response and sends it by itself.
+    RESPOND_EXTERNALLY
+};
+
+// Everything a command handler gets to work with. Handlers read their
+// arguments from |argList| (argument 0 is the callback id), set any extra
+// response args starting at index 2 of |responseArgs|, and return an error
+// code for index 1.
+struct CommandRequest {
+    CefRefPtr<ClientHandler> handler;
+    CefRefPtr<CefBrowser> browser;
+    CefRefPtr<CefListValue> argList;
+    CefRefPtr<CefProcessMessage> response;
+    CefRefPtr<CefListValue> responseArgs;
+
+    // Set instead of returning an error code to pass a message to the callback.
+    std::string errInfo;
+
+    ResponseMode responseMode;
+};
+
+typedef int32 (*CommandHandler)(CommandRequest& request);
+
+// An entry in the command table.
+struct NativeCommand {
+    CommandHandler handler;
+
+    // Types of the arguments that follow the callback id, one character each:
+    //   's' - string, 'b' - bool, 'i' - int, 'n' - int or double, 'l' - list
+    // "" means the callback id is the only argument. NULL skips the check; it
+    // is used for commands that are called without a callback, and so without
+    // any arguments.
+    const char* argTypes;
+
+    NativeCallStats stats;
+};
+
+typedef std::map<std::string, NativeCommand> NativeCommandMap;
+
+static NativeCommandMap& GetCommands();
+
+// Checks |argList| against a NativeCommand::argTypes schema.
+static bool HasArgumentTypes(CefRefPtr<CefListValue> argList, const char* argTypes)
+{
+    if (argTypes == NULL) {
+        return true;
+    }
+
+    size_t count = strlen(argTypes);
+    if (argList->GetSize() != count + 1) {
+        return false;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        CefValueType type = argList->GetType(i + 1);
+        bool matches = false;
+        switch (argTypes[i]) {
+            case 's': matches = (type == VTYPE_STRING); break;
+            case 'b': matches = (type == VTYPE_BOOL); break;
+            case 'i': matches = (type == VTYPE_INT); break;
+            case 'n': matches = (type == VTYPE_INT || type == VTYPE_DOUBLE); break;
+            case 'l': matches = (type == VTYPE_LIST); break;
+        }
+        if (!matches) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Hands a blocking command off to the worker pool. |task| sends the response.
+static int32 RunOnWorker(CommandRequest& request, const ExtensionString& key, const base::Closure& task)
+{
+    appshell::PostWorkerTask(key, task);
+    request.responseMode = RESPOND_LATER;
+    return NO_ERROR;
+}
+
+static int32 HandleOpenLiveBrowser(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    //  1: string - argURL
+    //  2: bool - enableRemoteDebugging
+    ExtensionString argURL = request.argList->GetString(1);
+    bool enableRemoteDebugging = request.argList->GetBool(2);
+    return OpenLiveBrowser(argURL, enableRemoteDebugging);
+}
+
+static int32 HandleCloseLiveBrowser(CommandRequest& request)
+{
+    // Parameters
+    //  0: int32 - callback id
+    CloseLiveBrowser(request.browser, request.response);
+
+    // CloseLiveBrowser fires the callback asynchronously.
+    request.responseMode = RESPOND_EXTERNALLY;
+    return NO_ERROR;
+}
+
+static int32 HandleShowOpenDialog(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    //  1: bool - allowMultipleSelection
+    //  2: bool - chooseDirectory
+    //  3: string - title
+    //  4: string - initialPath
+    //  5: string - fileTypes (space-delimited string)
+    bool allowMultipleSelection = request.argList->GetBool(1);
+    bool chooseDirectory = request.argList->GetBool(2);
+    ExtensionString title = request.argList->GetString(3);
+    ExtensionString initialPath = request.argList->GetString(4);
+    ExtensionString fileTypes = request.argList->GetString(5);
+
+#ifdef OS_MACOSX
+    ShowOpenDialog(allowMultipleSelection,
+                   chooseDirectory,
+                   title,
+                   initialPath,
+                   fileTypes,
+                   request.browser,
+                   request.response);
+
+    // ShowOpenDialog fires the callback asynchronously.
+    request.responseMode = RESPOND_EXTERNALLY;
+    return NO_ERROR;
+#else
+    CefRefPtr<CefListValue> selectedFiles = CefListValue::Create();
+    int32 error = ShowOpenDialog(allowMultipleSelection,
+                                 chooseDirectory,
+                                 title,
+                                 initialPath,
+                                 fileTypes,
+                                 selectedFiles);
+    // Set response args for this function
+    request.responseArgs->SetList(2, selectedFiles);
+    return error;
+#endif
+}
+
+static int32 HandleShowSaveDialog(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    //  1: string - title
+    //  2: string - initialPath
+    //  3: string - poposedNewFilename
+    ExtensionString title = request.argList->GetString(1);
+    ExtensionString initialPath = request.argList->GetString(2);
+    ExtensionString proposedNewFilename = request.argList->GetString(3);
+
+#ifdef OS_MACOSX
+    ShowSaveDialog(title,
+                   initialPath,
+                   proposedNewFilename,
+                   request.browser,
+                   request.response);
+
+    // ShowSaveDialog fires the callback asynchronously.
+    request.responseMode = RESPOND_EXTERNALLY;
+    return NO_ERROR;
+#else
+    ExtensionString newFilePath;
+    int32 error = ShowSaveDialog(title,
+                                 initialPath,
+                                 proposedNewFilename,
+                                 newFilePath);
+
+    // Set response args for this function
+    request.responseArgs->SetString(2, newFilePath);
+    return error;
+#endif
+}
+
+static int32 HandleIsNetworkDrive(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    //  1: string - directory path
+    ExtensionString path = request.argList->GetString(1);
+    return RunOnWorker(request, path,
+        base::Bind(&IsNetworkDriveTask, request.browser, request.response, path));
+}
+
+static int32 HandleReadDir(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    //  1: string - directory path
+    ExtensionString path = request.argList->GetString(1);
+    return RunOnWorker(request, path,
+        base::Bind(&ReadDirTask, request.browser, request.response, path));
+}
+
+static int32 HandleMakeDir(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    //  1: string - directory path
+    //  2: number - mode
+    ExtensionString pathname = request.argList->GetString(1);
+    int32 mode = request.argList->GetInt(2);
+    return RunOnWorker(request, pathname,
+        base::Bind(&MakeDirTask, request.browser, request.response, pathname, mode));
+}
+
+static int32 HandleRename(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    //  1: string - old path
+    //  2: string - new path
+    ExtensionString oldName = request.argList->GetString(1);
+    ExtensionString newName = request.argList->GetString(2);
+    return RunOnWorker(request, oldName,
+        base::Bind(&RenameTask, request.browser, request.response, oldName, newName));
+}
+
+static int32 HandleGetFileInfo(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    //  1: string - filename
+    ExtensionString filename = request.argList->GetString(1);
+    return RunOnWorker(request, filename,
+        base::Bind(&GetFileInfoTask, request.browser, request.response, filename));
+}
+
+static int32 HandleStatMany(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    //  1: list - paths
+    CefRefPtr<CefListValue> pathList = request.argList->GetList(1);
+    std::vector<ExtensionString> paths(pathList->GetSize());
+    for (size_t i = 0; i < paths.size(); i++) {
+        if (pathList->GetType(i) != VTYPE_STRING) {
+            return ERR_INVALID_PARAMS;
+        }
+        paths[i] = pathList->GetString(i);
+    }
+
+    StatMany(request.browser, request.response, paths);
+    request.responseMode = RESPOND_LATER;
+    return NO_ERROR;
+}
+
+static int32 HandleReadFile(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    //  1: string - filename
+    //  2: string - encoding
+    ExtensionString filename = request.argList->GetString(1);
+    ExtensionString encoding = request.argList->GetString(2);
+    return RunOnWorker(request, filename,
+        base::Bind(&ReadFileTask, request.browser, request.response, filename, encoding));
+}
+
+static int32 HandleWriteFile(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    //  1: string - filename
+    //  2: string - data
+    //  3: string - encoding
+    //  4: bool - preserveBOM
+    //  5: bool - atomic
+    //  6: bool - sync
+    ExtensionString filename = request.argList->GetString(1);
+    std::string contents = request.argList->GetString(2);
+    ExtensionString encoding = request.argList->GetString(3);
+    bool preserveBOM = request.argList->GetBool(4);
+    WriteFileOptions options;
+    options.atomic = request.argList->GetBool(5);
+    options.sync = request.argList->GetBool(6);
+    return RunOnWorker(request, filename,
+        base::Bind(&WriteFileTask, request.browser, request.response, filename, contents, encoding, preserveBOM, options));
+}
+
+static int32 HandleSetPosixPermissions(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    //  1: string - filename
+    //  2: int - mode
+    ExtensionString filename = request.argList->GetString(1);
+    int32 mode = request.argList->GetInt(2);
+    return RunOnWorker(request, filename,
+        base::Bind(&SetPosixPermissionsTask, request.browser, request.response, filename, mode));
+}
+
+static int32 HandleDeleteFileOrDirectory(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    //  1: string - filename
+    ExtensionString filename = request.argList->GetString(1);
+    return RunOnWorker(request, filename,
+        base::Bind(&DeleteFileOrDirectoryTask, request.browser, request.response, filename));
+}
+
+static int32 HandleMoveFileOrDirectoryToTrash(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    //  1: string - path
+    ExtensionString path = request.argList->GetString(1);
+    MoveFileOrDirectoryToTrash(path, request.browser, request.response);
+
+    // MoveFileOrDirectoryToTrash fires the callback asynchronously.
+    request.responseMode = RESPOND_EXTERNALLY;
+    return NO_ERROR;
+}
+
+static int32 HandleRemove(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    //  1: list - paths
+    //  2: int32 - remove id
+    //  3: bool - move to the trash instead of deleting
+    CefRefPtr<CefListValue> pathList = request.argList->GetList(1);
+    std::vector<ExtensionString> paths;
+    for (size_t i = 0; i < pathList->GetSize(); i++) {
+        if (pathList->GetType(i) == VTYPE_STRING) {
+            paths.push_back(pathList->GetString(i));
+        }
+    }
+    StartRemove(request.browser, request.response, request.argList->GetInt(2), paths, request.argList->GetBool(3));
+
+    // The job sends its progress and then the final response from the worker pool.
+    request.responseMode = RESPOND_LATER;
+    return NO_ERROR;
+}
+
+static int32 HandleCancelRemove(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    //  1: int32 - remove id
+    CancelRemove(request.browser, request.argList->GetInt(1));
+    return NO_ERROR;
+}
+
+static int32 HandleCopyFile(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    //  1: string - filename
+    //  2: string - dest filename
+    ExtensionString src = request.argList->GetString(1);
+    ExtensionString dest = request.argList->GetString(2);
+    return RunOnWorker(request, dest,
+        base::Bind(&CopyFileTask, request.browser, request.response, src, dest));
+}
+
+static int32 HandleCopy(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    //  1: string - source path
+    //  2: string - destination path
+    //  3: int32 - copy id
+    ExtensionString src = request.argList->GetString(1);
+    ExtensionString dest = request.argList->GetString(2);
+    StartCopy(request.browser, request.response, request.argList->GetInt(3), src, dest);
+
+    // The copy sends its progress and then the final response from the worker pool.
+    request.responseMode = RESPOND_LATER;
+    return NO_ERROR;
+}
+
+static int32 HandleCancelCopy(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    //  1: int32 - copy id
+    CancelCopy(request.browser, request.argList->GetInt(1));
+    return NO_ERROR;
+}
+
+static int32 HandleReadDirWithStats(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    //  1: string - directory path
+    ExtensionString path = request.argList->GetString(1);
+    return RunOnWorker(request, path,
+        base::Bind(&ReadDirWithStatsTask, request.browser, request.response, path));
+}
+
+static int32 HandleOpenReadStream(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    //  1: string - filename
+    //  2: int32 - stream id
+    //  3: int32 - chunk size in bytes
+    //  4: int32 - number of chunks the renderer acks at a time
+    //  5: string - encoding
+    ExtensionString filename = request.argList->GetString(1);
+    int32 streamId = request.argList->GetInt(2);
+    int32 chunkSize = request.argList->GetInt(3);
+    int32 ackInterval = request.argList->GetInt(4);
+    std::string encoding = request.argList->GetString(5);
+
+    OpenReadStream(request.browser, request.response, streamId, filename, chunkSize, ackInterval, encoding);
+
+    // The stream sends its chunks and then the final response from the worker pool.
+    request.responseMode = RESPOND_LATER;
+    return NO_ERROR;
+}
+
+static int32 HandleAckReadStream(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    //  1: int32 - stream id
+    AckReadStream(request.browser, request.argList->GetInt(1));
+    return NO_ERROR;
+}
+
+static int32 HandleCancelReadStream(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    //  1: int32 - stream id
+    CancelReadStream(request.browser, request.argList->GetInt(1));
+    return NO_ERROR;
+}
+
+static int32 HandleWalk(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    //  1: string - root directory
+    //  2: int32 - walk id
+    //  3: list - exclude globs
+    //  4: int32 - max depth, negative for no limit
+    //  5: bool - follow symlinks
+    //  6: int32 - entries per batch
+    ExtensionString root = request.argList->GetString(1);
+    int32 walkId = request.argList->GetInt(2);
+    CefRefPtr<CefListValue> exclude = request.argList->GetList(3);
+
+    WalkOptions options;
+    for (size_t i = 0; i < exclude->GetSize(); i++) {
+        if (exclude->GetType(i) == VTYPE_STRING) {
+            options.exclude.push_back(exclude->GetString(i));
+        }
+    }
+    options.maxDepth = request.argList->GetInt(4);
+    options.followSymlinks = request.argList->GetBool(5);
+    options.batchSize = request.argList->GetInt(6);
+
+    StartWalk(request.browser, request.response, walkId, root, options);
+
+    // The walk sends its batches and then the final response from the worker pool.
+    request.responseMode = RESPOND_LATER;
+    return NO_ERROR;
+}
+
+static int32 HandleCancelWalk(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    //  1: int32 - walk id
+    CancelWalk(request.browser, request.argList->GetInt(1));
+    return NO_ERROR;
+}
+
+static int32 HandleWatch(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    //  1: string - root directory
+    //  2: int32 - watch id
+    //  3: list - exclude globs
+    //  4: int32 - debounce window in milliseconds
+    ExtensionString root = request.argList->GetString(1);
+    int32 watchId = request.argList->GetInt(2);
+    CefRefPtr<CefListValue> exclude = request.argList->GetList(3);
+
+    WatchOptions options;
+    for (size_t i = 0; i < exclude->GetSize(); i++) {
+        if (exclude->GetType(i) == VTYPE_STRING) {
+            options.exclude.push_back(exclude->GetString(i));
+        }
+    }
+    options.debounceMs = request.argList->GetInt(4);
+
+    StartWatch(request.browser, request.response, watchId, root, options);
+
+    // The watch pushes its change sets, and sends the final response once closed.
+    request.responseMode = RESPOND_LATER;
+    return NO_ERROR;
+}
+
+static int32 HandleCloseWatch(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    //  1: int32 - watch id
+    CloseWatch(request.browser, request.argList->GetInt(1));
+    return NO_ERROR;
+}
+
+static int32 HandleSearch(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    //  1: string - root directory
+    //  2: int32 - search id
+    //  3: string - query
+    //  4: bool - query is a regular expression
+    //  5: bool - case sensitive
+    //  6: list - exclude globs
+    //  7: list - files to search instead of the root, if not empty
+    //  8: int32 - max results, 0 for no limit
+    //  9: bool - only search the files the trigram index says could match
+    ExtensionString root = request.argList->GetString(1);
+    int32 searchId = request.argList->GetInt(2);
+    std::string query = request.argList->GetString(3);
+    CefRefPtr<CefListValue> exclude = request.argList->GetList(6);
+    CefRefPtr<CefListValue> files = request.argList->GetList(7);
+
+    SearchOptions options;
+    options.isRegexp = request.argList->GetBool(4);
+    options.isCaseSensitive = request.argList->GetBool(5);
+    for (size_t i = 0; i < exclude->GetSize(); i++) {
+        if (exclude->GetType(i) == VTYPE_STRING) {
+            options.exclude.push_back(exclude->GetString(i));
+        }
+    }
+    for (size_t i = 0; i < files->GetSize(); i++) {
+        if (files->GetType(i) == VTYPE_STRING) {
+            options.files.push_back(files->GetString(i));
+        }
+    }
+    options.maxResults = std::max(0, request.argList->GetInt(8));
+    options.useIndex = request.argList->GetBool(9);
+
+    StartSearch(request.browser, request.response, searchId, root, query, options);
+
+    // The search sends its matches and then the final response from the worker pool.
+    request.responseMode = RESPOND_LATER;
+    return NO_ERROR;
+}
+
+static int32 HandleCancelSearch(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    //  1: int32 - search id
+    CancelSearch(request.browser, request.argList->GetInt(1));
+    return NO_ERROR;
+}
+
+static int32 HandleUpdateSearchIndex(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    //  1: string - root directory
+    //  2: list - exclude globs
+    ExtensionString root = request.argList->GetString(1);
+    CefRefPtr<CefListValue> exclude = request.argList->GetList(2);
+
+    std::vector<std::string> globs;
+    for (size_t i = 0; i < exclude->GetSize(); i++) {
+        if (exclude->GetType(i) == VTYPE_STRING) {
+            globs.push_back(exclude->GetString(i));
+        }
+    }
+
+    UpdateSearchIndex(request.browser, request.response, root, globs);
+    request.responseMode = RESPOND_LATER;
+    return NO_ERROR;
+}
+
+static int32 HandleGetSearchIndexStats(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    //  1: string - root directory
+    return GetSearchIndexStats(request.argList->GetString(1), request.responseArgs);
+}
+
+static int32 HandleSetFuzzyMatchPaths(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    //  1: list - paths
+    CefRefPtr<CefListValue> paths = request.argList->GetList(1);
+    for (size_t i = 0; i < paths->GetSize(); i++) {
+        if (paths->GetType(i) != VTYPE_STRING) {
+            return ERR_INVALID_PARAMS;
+        }
+    }
+
+    SetFuzzyMatchPaths(request.browser, paths);
+    return NO_ERROR;
+}
+
+static int32 HandleFuzzyMatch(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    //  1: string - query
+    //  2: int32 - max results, 0 for the default
+    FuzzyMatch(request.browser, request.response, request.argList->GetString(1).ToString(),
+               request.argList->GetInt(2));
+
+    // The paths are scored on the worker pool, which sends the response.
+    request.responseMode = RESPOND_LATER;
+    return NO_ERROR;
+}
+
+static int32 HandleShowDeveloperTools(CommandRequest& request)
+{
+    // Parameters - none
+    CefWindowInfo wi;
+    CefBrowserSettings settings;
+    CefRefPtr<CefBrowser> browser = request.browser;
+
+    #if defined(OS_WIN)
+        wi.SetAsPopup(NULL, "DevTools");
+    #elif defined(OS_LINUX)
+        request.handler->ShowDevTools(browser, CefPoint());
+    #endif
+
+    #ifndef OS_LINUX
+        browser->GetHost()->ShowDevTools(wi, browser->GetHost()->GetClient(), settings, CefPoint());
+    #endif
+
+    return NO_ERROR;
+}
+
+static int32 HandleGetNodeState(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    int32 error = NO_ERROR;
+    int32 port = 0;
+    int32 portOrErr = getNodeState();
+    if (portOrErr < 0) { // there is an error
+        error = portOrErr;
+    } else {
+        port = portOrErr;
+    }
+    request.responseArgs->SetInt(2, port);
+    return error;
+}
+
+static int32 HandleListenNodeState(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    AddNodeStateListener(request.browser, request.response);
+
+    // The listener gets every state change, and never a final response, so
+    // only the dispatch is timed.
+    request.responseMode = RESPOND_EXTERNALLY;
+    return NO_ERROR;
+}
+
+static int32 HandleGetNodeStats(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    NodeProcessStats stats = getNodeProcessStats();
+    request.responseArgs->SetDouble(2, stats.startupMilliseconds);
+    request.responseArgs->SetInt(3, stats.restartCount);
+    request.responseArgs->SetDouble(4, stats.lastFailoverMilliseconds);
+    request.responseArgs->SetDouble(5, (double)stats.shellWakeups);
+    request.responseArgs->SetDouble(6, (double)stats.nodeWakeups);
+    return NO_ERROR;
+}
+
+static int32 HandleGetSystemDefaultApp(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    //  1: string - list of file extensions
+    ExtensionString defaultApp;
+    int32 error = getSystemDefaultApp(request.argList->GetString(1), defaultApp);
+
+    // Set response args for this function
+    request.responseArgs->SetString(2, defaultApp);
+    return error;
+}
+
+static int32 HandleQuitApplication(CommandRequest& request)
+{
+    // Parameters - none
+
+    // The DispatchCloseToNextBrowser() call initiates a quit sequence. The app will
+    // quit if all browser windows are closed.
+    #ifdef OS_LINUX
+        if(client::MainContext::Get() && 
+            client::MainContext::Get()->GetRootWindowManager()){
+            client::MainContext::Get()->GetRootWindowManager()->DispatchCloseToNextWindow();
+        }
+    #else
+        request.handler->DispatchCloseToNextBrowser();
+    #endif
+
+    return NO_ERROR;
+}
+
+static int32 HandleAbortQuit(CommandRequest& request)
+{
+    // Parameters - none
+    request.handler->AbortQuit();
+    return NO_ERROR;
+}
+
+static int32 HandleOpenURLInDefaultBrowser(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    //  1: string - url
+    ExtensionString url = request.argList->GetString(1);
+    return OpenURLInDefaultBrowser(url);
+}
+
+static int32 HandleShowOSFolder(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    //  1: string - path
+    ExtensionString path = request.argList->GetString(1);
+    return ShowFolderInOSWindow(path);
+}
+
+static int32 HandleGetPendingFilesToOpen(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    ExtensionString files;
+    int32 error = GetPendingFilesToOpen(files);
+    request.responseArgs->SetString(2, files.c_str());
+    return error;
+}
+
+static int32 HandleSetUpdateParams(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    //  1: string - update parameters json object
+    CefString updateJson = request.argList->GetString(1);
+    return SetInstallerCommandLineArgs(updateJson);
+}
+
+static int32 HandleGetDroppedFiles(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    std::wstring files;
+
+    files = L"[";
+    for (unsigned int i = 0; i < gDroppedFiles.size(); i++) {
+        std::wstring file(gDroppedFiles[i]);
+        // Convert windows paths to unix paths
+        replace(file.begin(), file.end(), '\\', '/');
+        files += L"\"";
+        files += file;
+        files += L"\"";
+        if (i < gDroppedFiles.size() - 1) {
+            files += L", ";
+        }
+    }
+    files += L"]";
+    gDroppedFiles.clear();
+
+    request.responseArgs->SetString(2, files.c_str());
+    return NO_ERROR;
+}
+
+static int32 HandleAddMenu(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    //  1: string - menuTitle to display
+    //  2: string - menu/command ID
+    //  3: string - position - first, last, before, after
+    //  4: string - relativeID - ID of other element relative to which this should be positioned (for position before and after)
+    ExtensionString menuTitle = request.argList->GetString(1);
+    ExtensionString command = CefString(request.argList->GetString(2));
+    ExtensionString position = CefString(request.argList->GetString(3));
+    ExtensionString relativeId = CefString(request.argList->GetString(4));
+
+    return AddMenu(request.browser, menuTitle, command, position, relativeId);
+}
+
+static int32 HandleAddMenuItem(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    //  1: string - parent menu this is part of
+    //  2: string - menuTitle to display
+    //  3: string - command ID
+    //  4: string - keyboard shortcut
+    //  5: string - display string
+    //  6: string - position - first, last, before, after
+    //  7: string - relativeID - ID of other element relative to which this should be positioned (for position before and after)
+    ExtensionString parentCommand = request.argList->GetString(1);
+    ExtensionString menuTitle = request.argList->GetString(2);
+    ExtensionString command = request.argList->GetString(3);
+    ExtensionString key = request.argList->GetString(4);
+    ExtensionString displayStr = request.argList->GetString(5);
+    ExtensionString position = request.argList->GetString(6);
+    ExtensionString relativeId = request.argList->GetString(7);
+
+    return AddMenuItem(request.browser, parentCommand, menuTitle, command, key, displayStr, position, relativeId);
+}
+
+static int32 HandleRemoveMenu(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    //  1: string - command ID
+    ExtensionString commandId = request.argList->GetString(1);
+    return RemoveMenu(request.browser, commandId);
+}
+
+static int32 HandleRemoveMenuItem(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    //  1: string - command ID
+    ExtensionString commandId = request.argList->GetString(1);
+    return RemoveMenuItem(request.browser, commandId);
+}
+
+static int32 HandleGetMenuItemState(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    //  1: string - menu/command ID
+    ExtensionString commandId = CefString(request.argList->GetString(1));
+    bool checked, enabled;
+    int index;
+    int32 error = GetMenuItemState(request.browser, commandId, enabled, checked, index);
+    request.responseArgs->SetBool(2, enabled);
+    request.responseArgs->SetBool(3, checked);
+    request.responseArgs->SetInt(4, index);
+    return error;
+}
+
+static int32 HandleSetMenuItemState(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    //  1: string - commandName
+    //  2: bool - enabled
+    //  3: bool - checked
+    ExtensionString command = request.argList->GetString(1);
+    bool enabled = request.argList->GetBool(2);
+    bool checked = request.argList->GetBool(3);
+    int32 error = NativeMenuModel::getInstance(getMenuParent(request.browser)).setMenuItemState(command, enabled, checked);
+    if (error == NO_ERROR) {
+        error = SetMenuItemState(request.browser, command, enabled, checked);
+    }
+    return error;
+}
+
+static int32 HandleSetMenuTitle(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    //  1: string - menu/command ID
+    //  2: string - menuTitle to display
+    ExtensionString command = CefString(request.argList->GetString(1));
+    ExtensionString menuTitle = request.argList->GetString(2);
+
+    return SetMenuTitle(request.browser, command, menuTitle);
+}
+
+static int32 HandleGetMenuTitle(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    //  1: string - menu/command ID
+    ExtensionString commandId = CefString(request.argList->GetString(1));
+    ExtensionString menuTitle;
+    int32 error = GetMenuTitle(request.browser, commandId, menuTitle);
+    request.responseArgs->SetString(2, menuTitle);
+    return error;
+}
+
+static int32 HandleSetMenuItemShortcut(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    //  1: string - command ID
+    //  2: string - shortcut
+    //  3: string - display string
+    ExtensionString commandId = request.argList->GetString(1);
+    ExtensionString shortcut = request.argList->GetString(2);
+    ExtensionString displayStr = request.argList->GetString(3);
+
+    return SetMenuItemShortcut(request.browser, commandId, shortcut, displayStr);
+}
+
+static int32 HandleGetMenuPosition(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    //  1: string - menu/command ID
+    ExtensionString commandId = request.argList->GetString(1);
+    ExtensionString parentId;
+    int index;
+    int32 error = GetMenuPosition(request.browser, commandId, parentId, index);
+    request.responseArgs->SetString(2, parentId);
+    request.responseArgs->SetInt(3, index);
+    return error;
+}
+
+static int32 HandleDragWindow(CommandRequest& request)
+{
+    // Parameters: none
+    DragWindow(request.browser);
+    return NO_ERROR;
+}
+
+static int32 HandleGetZoomLevel(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    double zoomLevel = request.browser->GetHost()->GetZoomLevel();
+
+    request.responseArgs->SetDouble(2, zoomLevel);
+    return NO_ERROR;
+}
+
+static int32 HandleSetZoomLevel(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    //  1: int32 - zoom level
+
+    // cast to double
+    double zoomLevel = 1;
+
+    if (request.argList->GetType(1) == VTYPE_DOUBLE) {
+        zoomLevel = request.argList->GetDouble(1);
+    } else {
+        zoomLevel = request.argList->GetInt(1);
+    }
+
+    request.browser->GetHost()->SetZoomLevel(zoomLevel);
+    return NO_ERROR;
+}
+
+static int32 HandleInstallCommandLineTools(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    return InstallCommandLineTools();
+}
+
+static int32 HandleGetMachineHash(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    request.responseArgs->SetString(2, GetSystemUniqueID());
+    return NO_ERROR;
+}
+
+static int32 HandleGetRemoteDebuggingPort(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    if (g_get_remote_debugging_port_error.empty() && g_remote_debugging_port > 0) {
+        request.responseArgs->SetInt(2, g_remote_debugging_port);
+    }
+    else {
+        request.responseArgs->SetNull(2);
+        request.errInfo = g_get_remote_debugging_port_error;
+    }
+    return NO_ERROR;
+}
+
+static int32 HandleGetNativeCallStats(CommandRequest& request)
+{
+    // Parameters:
+    //  0: int32 - callback id
+    //
+    // Response is a list with one entry per command that has been called:
+    //  [name, call count, error count, p50 latency (ms), p99 latency (ms)]
+    CefRefPtr<CefListValue> allStats = CefListValue::Create();
+    NativeCommandMap& commands = GetCommands();
+    size_t index = 0;
+
+    for (NativeCommandMap::iterator it = commands.begin(); it != commands.end(); ++it) {
+        const NativeCallStats& stats = it->second.stats;
+        if (stats.GetCallCount() == 0) {
+            continue;
+        }
+
+        CefRefPtr<CefListValue> entry = CefListValue::Create();
+        entry->SetString(0, it->first);
+        entry->SetInt(1, stats.GetCallCount());
+        entry->SetInt(2, stats.GetErrorCount());
+        entry->SetDouble(3, stats.GetLatencyPercentile(50));
+        entry->SetDouble(4, stats.GetLatencyPercentile(99));
+        allStats->SetList(index++, entry);
+    }
+
+    request.responseArgs->SetList(2, allStats);
+    return NO_ERROR;
+}
+
+static void AddCommand(NativeCommandMap& commands, const char* name, CommandHandler handler, const char* argTypes)
+{
+    NativeCommand& command = commands[name];
+    command.handler = handler;
+    command.argTypes = argTypes;
+}
+
+// The table of native commands, keyed by message name. Only used on the UI
+// thread, so the stats in it need no locking.
+static NativeCommandMap& GetCommands()
+{
+    static NativeCommandMap commands;
+
+    if (commands.empty()) {
+        AddCommand(commands, "OpenLiveBrowser",             &HandleOpenLiveBrowser,             "sb");
+        AddCommand(commands, "CloseLiveBrowser",            &HandleCloseLiveBrowser,            "");
+        AddCommand(commands, "ShowOpenDialog",              &HandleShowOpenDialog,              "bbsss");
+        AddCommand(commands, "ShowSaveDialog",              &HandleShowSaveDialog,              "sss");
+        AddCommand(commands, "IsNetworkDrive",              &HandleIsNetworkDrive,              "s");
+        AddCommand(commands, "ReadDir",                     &HandleReadDir,                     "s");
+        AddCommand(commands, "MakeDir",                     &HandleMakeDir,                     "si");
+        AddCommand(commands, "Rename",                      &HandleRename,                      "ss");
+        AddCommand(commands, "GetFileInfo",                 &HandleGetFileInfo,                 "s");
+        AddCommand(commands, "StatMany",                    &HandleStatMany,                    "l");
+        AddCommand(commands, "ReadFile",                    &HandleReadFile,                    "ss");
+        AddCommand(commands, "WriteFile",                   &HandleWriteFile,                   "sssbbb");
+        AddCommand(commands, "OpenReadStream",              &HandleOpenReadStream,              "siiis");
+        AddCommand(commands, "AckReadStream",               &HandleAckReadStream,               "i");
+        AddCommand(commands, "CancelReadStream",            &HandleCancelReadStream,            "i");
+        AddCommand(commands, "Walk",                        &HandleWalk,                        "silibi");
+        AddCommand(commands, "CancelWalk",                  &HandleCancelWalk,                  "i");
+        AddCommand(commands, "Watch",                       &HandleWatch,                       "sili");
+        AddCommand(commands, "CloseWatch",                  &HandleCloseWatch,                  "i");
+        AddCommand(commands, "Search",                      &HandleSearch,                      "sisbbllib");
+        AddCommand(commands, "CancelSearch",                &HandleCancelSearch,                "i");
+        AddCommand(commands, "UpdateSearchIndex",           &HandleUpdateSearchIndex,           "sl");
+        AddCommand(commands, "GetSearchIndexStats",         &HandleGetSearchIndexStats,         "s");
+        AddCommand(commands, "SetPosixPermissions",         &HandleSetPosixPermissions,         "si");
+        AddCommand(commands, "DeleteFileOrDirectory",       &HandleDeleteFileOrDirectory,       "s");
+        AddCommand(commands, "MoveFileOrDirectoryToTrash",  &HandleMoveFileOrDirectoryToTrash,  "s");
+        AddCommand(commands, "Remove",                      &HandleRemove,                      "lib");
+        AddCommand(commands, "CancelRemove",                &HandleCancelRemove,                "i");
+        AddCommand(commands, "ShowDeveloperTools",          &HandleShowDeveloperTools,          NULL);
+        AddCommand(commands, "GetNodeState",                &HandleGetNodeState,                "");
+        AddCommand(commands, "ListenNodeState",             &HandleListenNodeState,             "");
+        AddCommand(commands, "GetNodeStats",                &HandleGetNodeStats,                "");
+        AddCommand(commands, "SetFuzzyMatchPaths",          &HandleSetFuzzyMatchPaths,          "l");
+        AddCommand(commands, "FuzzyMatch",                  &HandleFuzzyMatch,                  "si");
+        AddCommand(commands, "getSystemDefaultApp",         &HandleGetSystemDefaultApp,         "s");
+        AddCommand(commands, "QuitApplication",             &HandleQuitApplication,             NULL);
+        AddCommand(commands, "AbortQuit",                   &HandleAbortQuit,                   NULL);
+        AddCommand(commands, "OpenURLInDefaultBrowser",     &HandleOpenURLInDefaultBrowser,     "s");
+        AddCommand(commands, "ShowOSFolder",                &HandleShowOSFolder,                "s");
+        AddCommand(commands, "GetPendingFilesToOpen",       &HandleGetPendingFilesToOpen,       "");
+        AddCommand(commands, "CopyFile",                    &HandleCopyFile,                    "ss");
+        AddCommand(commands, "Copy",                        &HandleCopy,                        "ssi");
+        AddCommand(commands, "CancelCopy",                  &HandleCancelCopy,                  "i");
+        AddCommand(commands, "SetUpdateParams",             &HandleSetUpdateParams,             "s");
+        AddCommand(commands, "GetDroppedFiles",             &HandleGetDroppedFiles,             "");
+        AddCommand(commands, "AddMenu",                     &HandleAddMenu,                     "ssss");
+        AddCommand(commands, "AddMenuItem",                 &HandleAddMenuItem,                 "sssssss");
+        AddCommand(commands, "RemoveMenu",                  &HandleRemoveMenu,                  "s");
+        AddCommand(commands, "RemoveMenuItem",              &HandleRemoveMenuItem,              "s");
+        AddCommand(commands, "GetMenuItemState",            &HandleGetMenuItemState,            "s");
+        AddCommand(commands, "SetMenuItemState",            &HandleSetMenuItemState,            "sbb");
+        AddCommand(commands, "SetMenuTitle",                &HandleSetMenuTitle,                "ss");
+        AddCommand(commands, "GetMenuTitle",                &HandleGetMenuTitle,                "s");
+        AddCommand(commands, "SetMenuItemShortcut",         &HandleSetMenuItemShortcut,         "sss");
+        AddCommand(commands, "GetMenuPosition",             &HandleGetMenuPosition,             "s");
+        AddCommand(commands, "DragWindow",                  &HandleDragWindow,                  NULL);
+        AddCommand(commands, "GetZoomLevel",                &HandleGetZoomLevel,                "");
+        AddCommand(commands, "SetZoomLevel",                &HandleSetZoomLevel,                "n");
+        AddCommand(commands, "InstallCommandLineTools",     &HandleInstallCommandLineTools,     "");
+        AddCommand(commands, "GetMachineHash",              &HandleGetMachineHash,              "");
+        AddCommand(commands, "ReadDirWithStats",            &HandleReadDirWithStats,            "s");
+        AddCommand(commands, "GetRemoteDebuggingPort",      &HandleGetRemoteDebuggingPort,      "");
+        AddCommand(commands, "GetNativeCallStats",          &HandleGetNativeCallStats,          "");
+    }
+
+    return commands;
+}
+
 class ProcessMessageDelegate : public ClientHandler::ProcessMessageDelegate {
 public:
     ProcessMessageDelegate()
@@ -55,13 +1361,27 @@ public:
                       CefProcessId source_process,
                       CefRefPtr<CefProcessMessage> message) OVERRIDE {
         std::string message_name = message->GetName();
+        NativeCommandMap& commands = GetCommands();
+        NativeCommandMap::iterator found = commands.find(message_name);
+
+        if (found == commands.end()) {
+            fprintf(stderr, "Native function not implemented yet: %s\n", message_name.c_str());
+            return false;
+        }
+
+        NativeCommand& command = found->second;
+        int64 startTime = appshell::GetMonotonicMicroseconds();
         CefRefPtr<CefListValue> argList = message->GetArgumentList();
         int32 callbackId = -1;
         int32 error = NO_ERROR;
-        std::string errInfo;
-        CefRefPtr<CefProcessMessage> response = 
-            CefProcessMessage::Create("invokeCallback");
-        CefRefPtr<CefListValue> responseArgs = response->GetArgumentList();
+
+        CommandRequest request;
+        request.handler = handler;
+        request.browser = browser;
+        request.argList = argList;
+        request.response = CefProcessMessage::Create("invokeCallback");
+        request.responseArgs = request.response->GetArgumentList();
+        request.responseMode = RESPOND_NOW;
         
         // V8 extension messages are handled here. These messages come from the 
         // render process thread (in client_app.cpp), and have the following format:
@@ -78,815 +1398,50 @@ public:
             callbackId = argList->GetInt(0);
             
             if (callbackId != -1)
-                responseArgs->SetInt(0, callbackId);
+                request.responseArgs->SetInt(0, callbackId);
         }
-        
-        if (message_name == "OpenLiveBrowser") {
-            // Parameters:
-            //  0: int32 - callback id
-            //  1: string - argURL
-            //  2: bool - enableRemoteDebugging
-            if (argList->GetSize() != 3 ||
-                argList->GetType(1) != VTYPE_STRING ||
-                argList->GetType(2) != VTYPE_BOOL) {
-                error = ERR_INVALID_PARAMS;
-            }
-            
-            if (error == NO_ERROR) {
-                ExtensionString argURL = argList->GetString(1);
-                bool enableRemoteDebugging = argList->GetBool(2);
-                error = OpenLiveBrowser(argURL, enableRemoteDebugging);
-            }
-            
-        } else if (message_name == "CloseLiveBrowser") {
-            // Parameters
-            //  0: int32 - callback id
-            if (argList->GetSize() != 1) {
-                error = ERR_INVALID_PARAMS;
-            }
-            
-            if (error == NO_ERROR) {
-                CloseLiveBrowser(browser, response);
-            
-                // Skip standard callback handling. CloseLiveBrowser fires the
-                // callback asynchronously.
-                return true;
-            }
-        } else if (message_name == "ShowOpenDialog") {
-            // Parameters:
-            //  0: int32 - callback id
-            //  1: bool - allowMultipleSelection
-            //  2: bool - chooseDirectory
-            //  3: string - title
-            //  4: string - initialPath
-            //  5: string - fileTypes (space-delimited string)
-            if (argList->GetSize() != 6 ||
-                argList->GetType(1) != VTYPE_BOOL ||
-                argList->GetType(2) != VTYPE_BOOL ||
-                argList->GetType(3) != VTYPE_STRING ||
-                argList->GetType(4) != VTYPE_STRING ||
-                argList->GetType(5) != VTYPE_STRING) {
-                error = ERR_INVALID_PARAMS;
-            }
-           
-            if (error == NO_ERROR) {
-                bool allowMultipleSelection = argList->GetBool(1);
-                bool chooseDirectory = argList->GetBool(2);
-                ExtensionString title = argList->GetString(3);
-                ExtensionString initialPath = argList->GetString(4);
-                ExtensionString fileTypes = argList->GetString(5);
-                
-#ifdef OS_MACOSX
-                ShowOpenDialog(allowMultipleSelection,
-                               chooseDirectory,
-                               title,
-                               initialPath,
-                               fileTypes,
-                               browser,
-                               response);
-                
-                // Skip standard callback handling. ShowOpenDialog fires the
-                // callback asynchronously.
-                
-                return true;
-#else
-                CefRefPtr<CefListValue> selectedFiles = CefListValue::Create();
-                error = ShowOpenDialog(allowMultipleSelection,
-                                       chooseDirectory,
-                                       title,
-                                       initialPath,
-                                       fileTypes,
-                                       selectedFiles);
-                // Set response args for this function
-                responseArgs->SetList(2, selectedFiles);
-#endif
-                
-            }
-            
-        } else if (message_name == "ShowSaveDialog") {
-            // Parameters:
-            //  0: int32 - callback id
-            //  1: string - title
-            //  2: string - initialPath
-            //  3: string - poposedNewFilename
-            if (argList->GetSize() != 4 ||
-                argList->GetType(1) != VTYPE_STRING ||
-                argList->GetType(2) != VTYPE_STRING ||
-                argList->GetType(3) != VTYPE_STRING) {
-                error = ERR_INVALID_PARAMS;
-            }
-
-            if (error == NO_ERROR) {
-                ExtensionString title = argList->GetString(1);
-                ExtensionString initialPath = argList->GetString(2);
-                ExtensionString proposedNewFilename = argList->GetString(3);
-                
-#ifdef OS_MACOSX
-                // Skip standard callback handling. ShowSaveDialog fires the
-                // callback asynchronously.
-                ShowSaveDialog(title,
-                               initialPath,
-                               proposedNewFilename,
-                               browser,
-                               response);
-                return true;
-#else
-                ExtensionString newFilePath;
-                error = ShowSaveDialog(title,
-                                       initialPath,
-                                       proposedNewFilename,
-                                       newFilePath);
-                
-                // Set response args for this function
-                responseArgs->SetString(2, newFilePath);
-#endif
-            }
 
-        } else if (message_name == "IsNetworkDrive") {
-            // Parameters:
-            //  0: int32 - callback id
-            //  1: string - directory path
-            if (argList->GetSize() != 2 ||
-                argList->GetType(1) != VTYPE_STRING) {
-                error = ERR_INVALID_PARAMS;
-            }
-            
-            bool isRemote = false;
-            if (error == NO_ERROR) {
-                ExtensionString path = argList->GetString(1);                
-                error = IsNetworkDrive(path, isRemote);
-            }
-            
-            // Set response args for this function
-            responseArgs->SetBool(2, isRemote);
-        } else if (message_name == "ReadDir") {
-            // Parameters:
-            //  0: int32 - callback id
-            //  1: string - directory path
-            if (argList->GetSize() != 2 ||
-                argList->GetType(1) != VTYPE_STRING) {
-                error = ERR_INVALID_PARAMS;
-            }
-            
-            CefRefPtr<CefListValue> directoryContents = CefListValue::Create();
-            
-            if (error == NO_ERROR) {
-                ExtensionString path = argList->GetString(1);
-                
-                error = ReadDir(path, directoryContents);
-            }
-            
-            // Set response args for this function
-            responseArgs->SetList(2, directoryContents);
-        } else if (message_name == "MakeDir") {
-            // Parameters:
-            //  0: int32 - callback id
-            //  1: string - directory path
-            //  2: number - mode
-            if (argList->GetSize() != 3 ||
-                argList->GetType(1) != VTYPE_STRING ||
-                argList->GetType(2) != VTYPE_INT) {
-                error = ERR_INVALID_PARAMS;
-            }
-          
-            if (error == NO_ERROR) {
-                ExtensionString pathname = argList->GetString(1);
-                int32 mode = argList->GetInt(2);
-              
-                error = MakeDir(pathname, mode);
-            }
-            // No additional response args for this function
-        } else if (message_name == "Rename") {
-            // Parameters:
-            //  0: int32 - callback id
-            //  1: string - old path
-            //  2: string - new path
-            if (argList->GetSize() != 3 ||
-                argList->GetType(1) != VTYPE_STRING ||
-                argList->GetType(2) != VTYPE_STRING) {
-                error = ERR_INVALID_PARAMS;
-            }
-          
-            if (error == NO_ERROR) {
-                ExtensionString oldName = argList->GetString(1);
-                ExtensionString newName = argList->GetString(2);
-            
-                error = Rename(oldName, newName);
-            }
-          // No additional response args for this function
-        } else if (message_name == "GetFileInfo") {
-            // Parameters:
-            //  0: int32 - callback id
-            //  1: string - filename
-            if (argList->GetSize() != 2 ||
-                argList->GetType(1) != VTYPE_STRING) {
-                error = ERR_INVALID_PARAMS;
-            }
-            
-            if (error == NO_ERROR) {
-                ExtensionString filename = argList->GetString(1);
-                ExtensionString realPath;
-                uint32 modtime;
-                double size;
-                bool isDir;
-                
-                error = GetFileInfo(filename, modtime, isDir, size, realPath);
-                
-                // Set response args for this function
-                responseArgs->SetInt(2, modtime);
-                responseArgs->SetBool(3, isDir);
-                responseArgs->SetInt(4, size);
-                responseArgs->SetString(5, realPath);
-            }
-        } else if (message_name == "ReadFile") {
-            // Parameters:
-            //  0: int32 - callback id
-            //  1: string - filename
-            //  2: string - encoding
-            if (argList->GetSize() != 3 ||
-                argList->GetType(1) != VTYPE_STRING ||
-                argList->GetType(2) != VTYPE_STRING) {
-                error = ERR_INVALID_PARAMS;
-            }
-            
-            if (error == NO_ERROR) {
-                ExtensionString filename = argList->GetString(1);
-                ExtensionString encoding = argList->GetString(2);
-                std::string contents = "";
-                bool preserveBOM = false;
-                
-                error = ReadFile(filename, encoding, contents, preserveBOM);
-                
-                // Set response args for this function
-                responseArgs->SetString(2, contents);
-                responseArgs->SetString(3, encoding);
-                responseArgs->SetBool(4, preserveBOM);
-            }
-        } else if (message_name == "WriteFile") {
-            // Parameters:
-            //  0: int32 - callback id
-            //  1: string - filename
-            //  2: string - data
-            //  3: string - encoding
-            if (argList->GetSize() != 5 ||
-                argList->GetType(1) != VTYPE_STRING ||
-                argList->GetType(2) != VTYPE_STRING ||
-                argList->GetType(3) != VTYPE_STRING ||
-                argList->GetType(4) != VTYPE_BOOL) {
-                error = ERR_INVALID_PARAMS;
-            }
-            
-            if (error == NO_ERROR) {
-                ExtensionString filename = argList->GetString(1);
-                std::string contents = argList->GetString(2);
-                ExtensionString encoding = argList->GetString(3);
-                bool preserveBOM = argList->GetBool(4);
-                
-                error = WriteFile(filename, contents, encoding, preserveBOM);
-                // No additional response args for this function
-            }
-        } else if (message_name == "SetPosixPermissions") {
-            // Parameters:
-            //  0: int32 - callback id
-            //  1: string - filename
-            //  2: int - mode
-            if (argList->GetSize() != 3 ||
-                argList->GetType(1) != VTYPE_STRING ||
-                argList->GetType(2) != VTYPE_INT) {
-                error = ERR_INVALID_PARAMS;
-            }
-            
-            if (error == NO_ERROR) {
-                ExtensionString filename = argList->GetString(1);
-                int32 mode = argList->GetInt(2);
-                
-                error = SetPosixPermissions(filename, mode);
-                
-                // No additional response args for this function
-            }
-        } else if (message_name == "DeleteFileOrDirectory") {
-            // Parameters:
-            //  0: int32 - callback id
-            //  1: string - filename
-            if (argList->GetSize() != 2 ||
-                argList->GetType(1) != VTYPE_STRING) {
-                error = ERR_INVALID_PARAMS;
-            }
-            
-            if (error == NO_ERROR) {
-                ExtensionString filename = argList->GetString(1);
-                
-                error = DeleteFileOrDirectory(filename);
-                
-                // No additional response args for this function
-            }
-        } else if (message_name == "MoveFileOrDirectoryToTrash") {
-            // Parameters:
-            //  0: int32 - callback id
-            //  1: string - path
-            if (argList->GetSize() != 2 ||
-                argList->GetType(1) != VTYPE_STRING) {
-                error = ERR_INVALID_PARAMS;
-            }
-            
-            if (error == NO_ERROR) {
-                ExtensionString path = argList->GetString(1);
-                
-                MoveFileOrDirectoryToTrash(path, browser, response);
-                
-                // Skip standard callback handling. MoveFileOrDirectoryToTrash fires the
-                // callback asynchronously.
-                return true;
-            }
-        } else if (message_name == "ShowDeveloperTools") {
-            // Parameters - none
-            CefWindowInfo wi;
-            CefBrowserSettings settings;
-
-            #if defined(OS_WIN)
-                wi.SetAsPopup(NULL, "DevTools");
-            #elif defined(OS_LINUX)
-                handler->ShowDevTools(browser, CefPoint());
-            #endif
-
-            #ifndef OS_LINUX
-                browser->GetHost()->ShowDevTools(wi, browser->GetHost()->GetClient(), settings, CefPoint());
-            #endif
-
-        } else if (message_name == "GetNodeState") {
-            // Parameters:
-            //  0: int32 - callback id
-            if (argList->GetSize() != 1) {
-                error = ERR_INVALID_PARAMS;
-            }
-            
-            if (error == NO_ERROR) {
-                int32 port = 0;
-                int32 portOrErr = getNodeState();
-                if (portOrErr < 0) { // there is an error
-                    error = portOrErr;
-                } else {
-                    port = portOrErr;
-                    error = NO_ERROR;
-                }
-                responseArgs->SetInt(2, port);
-            }
-            
-        } else if (message_name == "getSystemDefaultApp") {
-            // Parameters:
-            //  0: int32 - callback id
-            //  1: string - list of file extensions
-            if (argList->GetSize() != 2 ||
-                argList->GetType(1) != VTYPE_STRING) {
-                error = ERR_INVALID_PARAMS;
-            }
-
-            ExtensionString defaultApp;
-            if (error == NO_ERROR) {
-                error = getSystemDefaultApp(argList->GetString(1), defaultApp);
-            }
-
-            // Set response args for this function
-            responseArgs->SetString(2, defaultApp);
-
-        } else if (message_name == "QuitApplication") {
-            // Parameters - none
-
-            // The DispatchCloseToNextBrowser() call initiates a quit sequence. The app will
-            // quit if all browser windows are closed.
-            #ifdef OS_LINUX
-                if(client::MainContext::Get() && 
-                    client::MainContext::Get()->GetRootWindowManager()){
-                    client::MainContext::Get()->GetRootWindowManager()->DispatchCloseToNextWindow();
-                }
-            #else
-                handler->DispatchCloseToNextBrowser();
-            #endif
-            
-
-        } else if (message_name == "AbortQuit") {
-            // Parameters - none
-          
-            handler->AbortQuit();
-        } else if (message_name == "OpenURLInDefaultBrowser") {
-            // Parameters:
-            //  0: int32 - callback id
-            //  1: string - url
-            if (argList->GetSize() != 2 ||
-                argList->GetType(1) != VTYPE_STRING) {
-                error = ERR_INVALID_PARAMS;
-            }
-            
-            if (error == NO_ERROR) {
-                ExtensionString url = argList->GetString(1);
-                
-                error = OpenURLInDefaultBrowser(url);
-                
-                // No additional response args for this function
-            }
-        } else if (message_name == "ShowOSFolder") {
-            // Parameters:
-            //  0: int32 - callback id
-            //  1: string - path
-            
-            if (argList->GetSize() != 2 ||
-                argList->GetType(1) != VTYPE_STRING) {
-                error = ERR_INVALID_PARAMS;
-            }
-          
-            if (error == NO_ERROR) {
-                ExtensionString path = argList->GetString(1);
-                error = ShowFolderInOSWindow(path);
-            }
-        } else if (message_name == "GetPendingFilesToOpen") {
-            // Parameters:
-            //  0: int32 - callback id
-            if (argList->GetSize() != 1) {
-                error = ERR_INVALID_PARAMS;
-            }
-            
-            if (error == NO_ERROR) {
-                ExtensionString files;
-                error = GetPendingFilesToOpen(files);
-                responseArgs->SetString(2, files.c_str());
-            }
-        } else if (message_name == "CopyFile") {
-            // Parameters:
-            //  0: int32 - callback id
-            //  1: string - filename
-            //  2: string - dest filename
-            if (argList->GetSize() != 3 ||
-                argList->GetType(1) != VTYPE_STRING ||
-                argList->GetType(2) != VTYPE_STRING) {
-                error = ERR_INVALID_PARAMS;
-            }
-            
-            if (error == NO_ERROR) {
-                ExtensionString src = argList->GetString(1);
-                ExtensionString dest = argList->GetString(2);
-                
-                error = CopyFile(src, dest);
-                // No additional response args for this function
-            }
-        } else if (message_name == "SetUpdateParams") {
-			// Parameters:
-			//  0: int32 - callback id
-			//  1: string - update parameters json object
-
-			size_t numArgs = argList->GetSize();
-			if (numArgs < 2 ||
-				argList->GetType(1) != VTYPE_STRING) {
-				error = ERR_INVALID_PARAMS;
-			}
-            if(error == NO_ERROR){
-                CefString updateJson = argList->GetString(1);
-                error = SetInstallerCommandLineArgs(updateJson);
-            }
-		} else if (message_name == "GetDroppedFiles") {
-            // Parameters:
-            //  0: int32 - callback id
-            if (argList->GetSize() != 1) {
-                error = ERR_INVALID_PARAMS;
-            }
-            
-            if (error == NO_ERROR) {
-                std::wstring files;
-                
-                files = L"[";
-                for (unsigned int i = 0; i < gDroppedFiles.size(); i++) {
-                    std::wstring file(gDroppedFiles[i]);
-                    // Convert windows paths to unix paths
-                    replace(file.begin(), file.end(), '\\', '/');
-                    files += L"\"";
-                    files += file;
-                    files += L"\"";
-                    if (i < gDroppedFiles.size() - 1) {
-                        files += L", ";
-                    }
-                }
-                files += L"]";
-                gDroppedFiles.clear();
-                
-                responseArgs->SetString(2, files.c_str());
-            }
-            
-        } else if (message_name == "AddMenu") {
-            // Parameters:
-            //  0: int32 - callback id
-            //  1: string - menuTitle to display
-            //  2: string - menu/command ID
-            //  3: string - position - first, last, before, after
-            //  4: string - relativeID - ID of other element relative to which this should be positioned (for position before and after)
-            if (argList->GetSize() != 5 ||
-                argList->GetType(1) != VTYPE_STRING ||
-                argList->GetType(2) != VTYPE_STRING ||
-                argList->GetType(3) != VTYPE_STRING ||
-                argList->GetType(4) != VTYPE_STRING) {
-                error = ERR_INVALID_PARAMS;
-            }
-            
-            if (error == NO_ERROR) {
-                ExtensionString menuTitle = argList->GetString(1);
-                ExtensionString command = CefString(argList->GetString(2));
-                ExtensionString position = CefString(argList->GetString(3));
-                ExtensionString relativeId = CefString(argList->GetString(4));
-                
-                error = AddMenu(browser, menuTitle, command, position, relativeId);
-                // No additional response args for this function
-            }
-        } else if (message_name == "AddMenuItem") {
-            // Parameters:
-            //  0: int32 - callback id
-            //  1: string - parent menu this is part of
-            //  2: string - menuTitle to display
-            //  3: string - command ID
-            //  4: string - keyboard shortcut
-            //  5: string - display string
-            //  6: string - position - first, last, before, after
-            //  7: string - relativeID - ID of other element relative to which this should be positioned (for position before and after)
-            if (argList->GetSize() != 8 ||
-                argList->GetType(1) != VTYPE_STRING ||
-                argList->GetType(2) != VTYPE_STRING ||
-                argList->GetType(3) != VTYPE_STRING ||
-                argList->GetType(4) != VTYPE_STRING ||
-                argList->GetType(5) != VTYPE_STRING ||
-                argList->GetType(6) != VTYPE_STRING ||
-                argList->GetType(7) != VTYPE_STRING) {
-                error = ERR_INVALID_PARAMS;
-            }
-            
-            if (error == NO_ERROR) {
-                ExtensionString parentCommand = argList->GetString(1);
-                ExtensionString menuTitle = argList->GetString(2);
-                ExtensionString command = argList->GetString(3);
-                ExtensionString key = argList->GetString(4);
-                ExtensionString displayStr = argList->GetString(5);
-                ExtensionString position = argList->GetString(6);
-                ExtensionString relativeId = argList->GetString(7);
-
-                error = AddMenuItem(browser, parentCommand, menuTitle, command, key, displayStr, position, relativeId);
-                // No additional response args for this function
-            }
-        } else if (message_name == "RemoveMenu") {
-            // Parameters:
-            //  0: int32 - callback id
-            //  1: string - command ID
-            if (argList->GetSize() != 2 ||
-                argList->GetType(1) != VTYPE_STRING) {
-                error = ERR_INVALID_PARAMS;
-            }
-            
-            if (error == NO_ERROR) {
-                ExtensionString commandId;
-                commandId = argList->GetString(1);
-                error = RemoveMenu(browser, commandId);
-            }
-            // No response args for this function
-        } else if (message_name == "RemoveMenuItem") {
-            // Parameters:
-            //  0: int32 - callback id
-            //  1: string - command ID
-            if (argList->GetSize() != 2 ||
-                argList->GetType(1) != VTYPE_STRING) {
-                error = ERR_INVALID_PARAMS;
-            }
-            
-            if (error == NO_ERROR) {
-                ExtensionString commandId;
-                commandId = argList->GetString(1);
-                error = RemoveMenuItem(browser, commandId);
-            }
-            // No response args for this function
-        } else if (message_name == "GetMenuItemState") {
-            // Parameters:
-            //  0: int32 - callback id
-            //  1: string - menu/command ID
-            if (argList->GetSize() != 2 ||
-                argList->GetType(1) != VTYPE_STRING) {
-                error = ERR_INVALID_PARAMS;
-            }
-            
-            if (error == NO_ERROR) {
-                ExtensionString commandId = CefString(argList->GetString(1));
-                ExtensionString menuTitle;
-                bool checked, enabled;
-                int index;
-                error = GetMenuItemState(browser, commandId, enabled, checked, index);
-                responseArgs->SetBool(2, enabled);
-                responseArgs->SetBool(3, checked);
-                responseArgs->SetInt(4, index);
-            }
-        }  else if(message_name == "SetMenuItemState") {
-            // Parameters:
-            //  0: int32 - callback id
-            //  1: string - commandName
-            //  2: bool - enabled
-            //  3: bool - checked
-            if (argList->GetSize() != 4 ||
-                argList->GetType(1) != VTYPE_STRING ||
-                argList->GetType(2) != VTYPE_BOOL ||
-                argList->GetType(3) != VTYPE_BOOL) {
-                error = ERR_INVALID_PARAMS;
-            }
-
-            if (error == NO_ERROR) {
-                ExtensionString command = argList->GetString(1);
-                bool enabled = argList->GetBool(2);
-                bool checked = argList->GetBool(3);
-                error = NativeMenuModel::getInstance(getMenuParent(browser)).setMenuItemState(command, enabled, checked);
-                if (error == NO_ERROR) {
-                    error = SetMenuItemState(browser, command, enabled, checked);
-                }
-            }
-        } else if (message_name == "SetMenuTitle") {
-            // Parameters:
-            //  0: int32 - callback id
-            //  1: string - menu/command ID
-            //  2: string - menuTitle to display
-            if (argList->GetSize() != 3 ||
-                argList->GetType(1) != VTYPE_STRING ||
-                argList->GetType(2) != VTYPE_STRING) {
-                    error = ERR_INVALID_PARAMS;
-            }
-
-            if (error == NO_ERROR) {
-                ExtensionString command = CefString(argList->GetString(1));
-                ExtensionString menuTitle = argList->GetString(2);
-
-                error = SetMenuTitle(browser, command, menuTitle);
-                // No additional response args for this function
-            }
-        }  else if (message_name == "GetMenuTitle") {
-            // Parameters:
-            //  0: int32 - callback id
-            //  1: string - menu/command ID
-            if (argList->GetSize() != 2 ||
-                argList->GetType(1) != VTYPE_STRING) {
-                error = ERR_INVALID_PARAMS;
-            }
-            
-            if (error == NO_ERROR) {
-                ExtensionString commandId = CefString(argList->GetString(1));
-                ExtensionString menuTitle;
-                error = GetMenuTitle(browser, commandId, menuTitle);
-                responseArgs->SetString(2, menuTitle);
-            }
-        } else if (message_name == "SetMenuItemShortcut") {
-            // Parameters:
-            //  0: int32 - callback id
-            //  1: string - command ID
-            //  2: string - shortcut
-            //  3: string - display string
-            if (argList->GetSize() != 4 ||
-                argList->GetType(1) != VTYPE_STRING ||
-                argList->GetType(2) != VTYPE_STRING ||
-                argList->GetType(3) != VTYPE_STRING) {
-                error = ERR_INVALID_PARAMS;
-            }
-            
-            if (error == NO_ERROR) {
-                ExtensionString commandId = argList->GetString(1);
-                ExtensionString shortcut = argList->GetString(2);
-                ExtensionString displayStr = argList->GetString(3);
-                
-                error = SetMenuItemShortcut(browser, commandId, shortcut, displayStr);
-                // No additional response args for this function
-            }
-        } else if (message_name == "GetMenuPosition") {
-            // Parameters:
-            //  0: int32 - callback id
-            //  1: string - menu/command ID
-            if (argList->GetSize() != 2 ||
-                argList->GetType(1) != VTYPE_STRING) {
-                error = ERR_INVALID_PARAMS;
-            }
-            
-            if (error == NO_ERROR) {
-                ExtensionString commandId;
-                ExtensionString parentId;
-                int index;
-                commandId = argList->GetString(1);
-                error = GetMenuPosition(browser, commandId, parentId, index);
-                responseArgs->SetString(2, parentId);
-                responseArgs->SetInt(3, index);
-            }
-        } else if (message_name == "DragWindow") {     
-            // Parameters: none       
-            DragWindow(browser);
-        } else if (message_name == "GetZoomLevel") {
-            // Parameters:
-            //  0: int32 - callback id
-            double zoomLevel = browser->GetHost()->GetZoomLevel();
-
-            responseArgs->SetDouble(2, zoomLevel);
-        } else if (message_name == "SetZoomLevel") {
-            // Parameters:
-            //  0: int32 - callback id
-            //  1: int32 - zoom level
-
-            if (argList->GetSize() != 2 ||
-                !(argList->GetType(1) == VTYPE_INT || argList->GetType(1) == VTYPE_DOUBLE)) {
-                error = ERR_INVALID_PARAMS;
-            }
-
-            if (error == NO_ERROR) {
-                // cast to double
-                double zoomLevel = 1;
-                
-                if (argList->GetType(1) == VTYPE_DOUBLE) {
-                    zoomLevel = argList->GetDouble(1);
-                } else {
-                    zoomLevel = argList->GetInt(1);
-                }
-
-                browser->GetHost()->SetZoomLevel(zoomLevel);
-            }
+        // Registered before the handler runs, because some handlers that
+        // respond later fail early and call SendResponse() before returning.
+        // SendResponse() records the stats and drops the entry.
+        PendingCallKey pendingKey(browser->GetIdentifier(), callbackId);
+        if (callbackId != -1) {
+            g_pendingCalls[pendingKey] = PendingCall(&command.stats, startTime);
         }
-        else if (message_name == "InstallCommandLineTools") {
-            // Parameters:
-            //  0: int32 - callback id
-            if (argList->GetSize() != 1) {
-                error = ERR_INVALID_PARAMS;
-            }
-            
-            if (error == NO_ERROR) {
-                error = InstallCommandLineTools();
-            }
 
-		} else if (message_name == "GetMachineHash") {
-			// Parameters:
-			//  0: int32 - callback id
+        if (!HasArgumentTypes(argList, command.argTypes)) {
+            error = ERR_INVALID_PARAMS;
+        } else {
+            error = command.handler(request);
+        }
 
-			responseArgs->SetString(2, GetSystemUniqueID());
-		} 
-        else if (message_name == "ReadDirWithStats") {
-            // Parameters:
-            //  0: int32 - callback id
-            
-            CefRefPtr<CefListValue> uberDict    = CefListValue::Create();
-            CefRefPtr<CefListValue> dirContents = CefListValue::Create();
-            CefRefPtr<CefListValue> allStats = CefListValue::Create();
-            
-            ExtensionString path = argList->GetString(1);
-            ReadDir(path, dirContents);
-            
-            // Now we iterator through the contents of directoryContents.
-            size_t theSize = dirContents->GetSize();
-            for ( size_t iFileEntry = 0; iFileEntry < theSize ; ++iFileEntry) {
-                CefRefPtr<CefListValue> fileStats = CefListValue::Create();
-
-                #ifdef OS_WIN
-                    ExtensionString theFile  = path + L"/";
-                #else
-                    ExtensionString theFile  = path + "/";
-                #endif
-
-                ExtensionString fileName = dirContents->GetString(iFileEntry);
-                theFile = theFile + fileName;
-                
-                ExtensionString realPath;
-                uint32 modtime;
-                double size;
-                bool isDir;
-                GetFileInfo(theFile, modtime, isDir, size, realPath);
-                
-                fileStats->SetInt(0, modtime);
-                fileStats->SetBool(1, isDir);
-                fileStats->SetInt(2, size);
-                fileStats->SetString(3, realPath);
-                
-                allStats->SetList(iFileEntry, fileStats);
-                
-            }
-            
-            uberDict->SetList(0, dirContents);
-            uberDict->SetList(1, allStats);
-            responseArgs->SetList(2, uberDict);
-        } else if (message_name == "GetRemoteDebuggingPort") {
-            if (g_get_remote_debugging_port_error.empty() && g_remote_debugging_port > 0) {
-                responseArgs->SetInt(2, g_remote_debugging_port);
-            }
-            else {
-                responseArgs->SetNull(2);
-                errInfo = g_get_remote_debugging_port_error;
+        if (callbackId != -1) {
+            if (request.responseMode == RESPOND_LATER) {
+                return true;
             }
+            g_pendingCalls.erase(pendingKey);
         }
 
-        else {
-            fprintf(stderr, "Native function not implemented yet: %s\n", message_name.c_str());
-            return false;
+        if (request.responseMode != RESPOND_NOW) {
+            // We can't see when platform code responds, or there is no
+            // callback to respond to, so this only times the dispatch.
+            command.stats.Record(appshell::GetMonotonicMicroseconds() - startTime, false);
+            return true;
         }
+
+        command.stats.Record(appshell::GetMonotonicMicroseconds() - startTime,
+                             error != NO_ERROR || !request.errInfo.empty());
       
         if (callbackId != -1) {
-            if (errInfo.empty()) {
-                responseArgs->SetInt(1, error);
+            if (request.errInfo.empty()) {
+                request.responseArgs->SetInt(1, error);
             }
             else {
-                responseArgs->SetString(1, errInfo);
+                request.responseArgs->SetString(1, request.errInfo);
             }
 
             // Send response
-            browser->SendProcessMessage(PID_RENDERER, response);
+            browser->SendProcessMessage(PID_RENDERER, request.response);
         }
       
         return true;
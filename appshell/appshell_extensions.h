@@ -31,4 +31,14 @@ namespace appshell_extensions {
 // Create message delegates that run in the browser process
 void CreateProcessMessageDelegates(ClientHandler::ProcessMessageDelegateSet& delegates);
 
+// Sends a response or progress message for a native command to the renderer.
+// Can be called from any thread.
+void SendResponse(CefRefPtr<CefBrowser> browser, CefRefPtr<CefProcessMessage> response);
+
+// Stops every stream, walk, search, copy, remove and watch that |browser|
+// started and forgets its other per-browser state. Jobs still on a worker
+// finish in the background, and their responses go nowhere. Called on the UI
+// thread when the browser closes.
+void CancelBrowserJobs(CefRefPtr<CefBrowser> browser);
+
 }  // namespace appshell_extensions
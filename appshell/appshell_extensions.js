@@ -24,8 +24,8 @@
 // This is the JavaScript code for bridging to native functionality
 // See appshell_extentions_[platform] for implementation of native methods.
 //
-// Note: All file native file i/o functions are synchronous, but are exposed
-// here as asynchronous calls. 
+// Note: Native file i/o functions run on a pool of worker threads in the
+// browser process and are exposed here as asynchronous calls.
 
 var appshell, brackets;
 if (!appshell) {
@@ -90,6 +90,16 @@ if (!brackets) {
      * @constant File was encoded with utf-16
      */
     appshell.fs.ERR_UNSUPPORTED_UTF16_ENCODING      = 20;
+
+    /**
+     * @constant The operation was cancelled before it completed.
+     */
+    appshell.fs.ERR_CANCELLED               = 22;
+
+    /**
+     * @constant The operation is not available on this platform.
+     */
+    appshell.fs.ERR_NOT_SUPPORTED           = 23;
     
     /**
      * @constant File could not be written.
@@ -330,7 +340,93 @@ if (!brackets) {
             });
         }, path);
     };
+
+    /**
+     * @constant File types reported by statMany. These MUST be in sync with FileType in
+     * appshell_extensions_platform.h
+     */
+    appshell.fs.TYPE_NONE       = 0;
+    appshell.fs.TYPE_FILE       = 1;
+    appshell.fs.TYPE_DIRECTORY  = 2;
+    appshell.fs.TYPE_OTHER      = 3;
+
+    /**
+     * Get information for many files or directories at once. The paths are stat'ed natively, in
+     * parallel, with a single round trip for all of them.
+     *
+     * @param {Array.<string>} paths The paths of the files or directories.
+     * @param {function(err, stats)} callback Asynchronous callback function. The callback gets two
+     *        arguments (err, stats) where stats holds one array per field, each in the order of paths:
+     *          mtime     - modification time in ms since 1970, with the sub-ms part as a fraction
+     *          mtimeSec  - whole seconds of the modification time
+     *          mtimeNsec - nanoseconds of the modification time (0 where the platform has none)
+     *          size      - size in bytes
+     *          type      - one of the TYPE_* constants; TYPE_NONE if the stat failed
+     *          error     - NO_ERROR or the error for that path, e.g. ERR_NOT_FOUND
+     *        err is only set when the call as a whole failed.
+     *        Possible error values:
+     *          NO_ERROR
+     *          ERR_UNKNOWN
+     *          ERR_INVALID_PARAMS
+     *
+     * @return None. This is an asynchronous call that sends all return information to the callback.
+     */
+    native function StatMany();
+    appshell.fs.statMany = function (paths, callback) {
+        StatMany(function (err, mtimeSec, mtimeNsec, size, type, error) {
+            if (err) {
+                callback(err);
+                return;
+            }
+
+            var mtime = new Array(mtimeSec.length),
+                i;
+            for (i = 0; i < mtimeSec.length; i++) {
+                mtime[i] = mtimeSec[i] * 1000 + mtimeNsec[i] / 1000000;
+            }
+            callback(err, {
+                mtime: mtime,
+                mtimeSec: mtimeSec,
+                mtimeNsec: mtimeNsec,
+                size: size,
+                type: type,
+                error: error
+            });
+        }, paths);
+    };
  
+    /**
+     * @private
+     * Unpacks the flat [name, mtime, isDir, size, realPath, name, ...] lists sent by
+     * ReadDirWithStats and Walk into names and stats objects.
+     */
+    function _unpackStatsList(entries) {
+        var STRIDE = 5,
+            names  = [],
+            stats  = [],
+            i;
+
+        var makeStats = function (isDir, modtime, size, realPath) {
+            return {
+                isFile: function () {
+                    return !isDir;
+                },
+                isDirectory: function () {
+                    return isDir;
+                },
+                mtime: new Date(modtime * 1000), // modtime is seconds since 1970, convert to ms
+                size: new Number(size),
+                realPath: realPath ? realPath : null
+            };
+        };
+
+        for (i = 0; i + STRIDE <= entries.length; i += STRIDE) {
+            names.push(entries[i]);
+            stats.push(makeStats(entries[i + 2], entries[i + 1], entries[i + 3], entries[i + 4]));
+        }
+        return { names: names, stats: stats };
+    }
+
     /**
      * Reads the contents of a directory and reports contents along with stats. 
      *
@@ -347,30 +443,13 @@ if (!brackets) {
      *                 
      * @return None. This is an asynchronous call that sends all return information to the callback.
      */ 
-    // Test dictionary
     native function ReadDirWithStats();
     appshell.fs.readDirWithStats = function (path, callback){
 
-        ReadDirWithStats(function (err, allPaths){
+        ReadDirWithStats(function (err, entries){
             if (callback) {
-                var finalArray  = [];
-                var allContents = allPaths[0];
-                var allStats    = allPaths[1];
-
-                allStats.forEach(function (val, idx) {
-                    finalArray[idx] = {
-                        isFile: function () {
-                            return !val[1];
-                        },
-                        isDirectory: function () {
-                            return val[1];
-                        },
-                        mtime: new Date(val[0] * 1000), // modtime is seconds since 1970, convert to ms
-                        size: new Number(val[2]),
-                        realPath: val[3] ? val[3] : null
-                    }
-                });
-                callback(err, allContents, finalArray);
+                var unpacked = _unpackStatsList(entries || []);
+                callback(err, unpacked.names, unpacked.stats);
             }
         }, path);
     };
@@ -436,6 +515,186 @@ if (!brackets) {
         GetNodeState(callback);
     };
 
+    /**
+     * @private
+     * Callbacks registered with onNodeStateChanged, or null until the first one.
+     */
+    var _nodeStateListeners = null;
+
+    /**
+     * @private
+     * The last state pushed by the shell, or null if none has arrived yet.
+     */
+    var _nodeState = null;
+
+    /**
+     * Calls back whenever the state of the Node server changes, and once right away with the
+     * current state. The shell pushes the changes, so there is no need to poll getNodeState()
+     * for the port.
+     *
+     * @param {function(err, port)} callback Called with the same arguments as getNodeState's
+     *        callback: NO_ERROR and the TCP port once the server is listening, otherwise one of
+     *        the ERR_NODE_* values and 0, e.g. while Node is being restarted.
+     *
+     * @return {{remove: function()}} An object whose remove() method stops the callbacks.
+     */
+    native function ListenNodeState();
+    appshell.app.onNodeStateChanged = function (callback) {
+        if (!_nodeStateListeners) {
+            _nodeStateListeners = [];
+            ListenNodeState(function (err, state) {
+                _nodeState = state;
+                _nodeStateListeners.slice().forEach(function (listener) {
+                    listener(state);
+                });
+            });
+        }
+
+        function listener(state) {
+            if (state < 0) {
+                callback(state, 0);
+            } else {
+                callback(appshell.app.NO_ERROR, state);
+            }
+        }
+        _nodeStateListeners.push(listener);
+
+        // Later listeners catch up with the state the first one was given
+        if (_nodeState !== null) {
+            var state = _nodeState;
+            setTimeout(function () {
+                if (_nodeStateListeners.indexOf(listener) !== -1) {
+                    listener(state);
+                }
+            }, 0);
+        }
+
+        return {
+            remove: function () {
+                var index = _nodeStateListeners.indexOf(listener);
+                if (index !== -1) {
+                    _nodeStateListeners.splice(index, 1);
+                }
+            }
+        };
+    };
+
+    /**
+     * Returns diagnostics for the Node process.
+     *
+     * @param {function(err, stats)} callback Asynchronous callback function. stats has:
+     *        startupTime - milliseconds from starting the current Node process until its server
+     *          reported its port, or -1 if it hasn't yet.
+     *        restartCount - how many times the Node process has been restarted.
+     *        lastFailoverTime - milliseconds from the last restart until the new process reported
+     *          its port, or -1 if there hasn't been one.
+     *        shellWakeups, nodeWakeups - how many times the shell and the Node process have
+     *          woken up so far, or -1 where that isn't known (Windows, or no Node process).
+     *
+     * @return None. This is an asynchronous call that sends all return information to the callback.
+     */
+    native function GetNodeStats();
+    appshell.app.getNodeStats = function (callback) {
+        GetNodeStats(function (err, startupTime, restartCount, lastFailoverTime,
+                               shellWakeups, nodeWakeups) {
+            callback(err, {
+                startupTime: startupTime,
+                restartCount: restartCount,
+                lastFailoverTime: lastFailoverTime,
+                shellWakeups: shellWakeups,
+                nodeWakeups: nodeWakeups
+            });
+        });
+    };
+    
+    /**
+     * Measures how often the shell and the Node process wake up, by sampling their wakeup
+     * counts at the start and end of the given time. Meant to be run while the editor sits
+     * idle, to catch timers and polling that keep waking the machine up.
+     *
+     * @param {number} seconds How long to measure for.
+     * @param {function(err, result)} callback Asynchronous callback function. result has
+     *        shellWakeupsPerMinute and nodeWakeupsPerMinute. err is appshell.fs.ERR_UNKNOWN if the
+     *        counts aren't available on this platform, or Node restarted meanwhile.
+     *
+     * @return None. This is an asynchronous call that sends all return information to the callback.
+     */
+    appshell.app.measureIdleWakeups = function (seconds, callback) {
+        appshell.app.getNodeStats(function (err, start) {
+            if (err || start.shellWakeups < 0) {
+                callback(err || appshell.fs.ERR_UNKNOWN);
+                return;
+            }
+            setTimeout(function () {
+                appshell.app.getNodeStats(function (err, end) {
+                    if (err || end.shellWakeups < 0 || end.restartCount !== start.restartCount) {
+                        callback(err || appshell.fs.ERR_UNKNOWN);
+                        return;
+                    }
+                    var minutes = seconds / 60;
+                    callback(appshell.app.NO_ERROR, {
+                        shellWakeupsPerMinute: (end.shellWakeups - start.shellWakeups) / minutes,
+                        nodeWakeupsPerMinute: (end.nodeWakeups - start.nodeWakeups) / minutes
+                    });
+                });
+            }, seconds * 1000);
+        });
+    };
+
+    /**
+     * Sets the paths that fuzzyMatch() picks from, usually every file in the project. The list
+     * is copied into the shell once, so later queries don't send it again.
+     *
+     * @param {Array.<string>} paths The paths to match against.
+     * @param {function(err)=} callback Asynchronous callback function.
+     *        Possible error values:
+     *          NO_ERROR
+     *          ERR_INVALID_PARAMS
+     *
+     * @return None. This is an asynchronous call that sends all return information to the callback.
+     */
+    native function SetFuzzyMatchPaths();
+    appshell.app.setFuzzyMatchPaths = function (paths, callback) {
+        SetFuzzyMatchPaths(callback || _dummyCallback, paths);
+    };
+
+    /**
+     * Finds the paths given to setFuzzyMatchPaths() that best match a Quick Open query. The
+     * query's characters must occur in a path in order, ignoring case and spaces. Matches in the
+     * file name, at the start of words and in runs score higher. A query that extends the
+     * previous one only looks at the paths that matched that one, so typing stays fast.
+     *
+     * @param {string} query The text typed so far.
+     * @param {number} limit The maximum number of matches to return (default 100, at most 1000).
+     * @param {function(err, Array.<{path: string, score: number, ranges: Array.<{start: number, end: number}>}>)} callback
+     *        Asynchronous callback function, called with the matches, best first. ranges are
+     *        the matched parts of path, as offsets into the string.
+     *        Possible error values:
+     *          NO_ERROR
+     *          ERR_INVALID_PARAMS
+     *
+     * @return None. This is an asynchronous call that sends all return information to the callback.
+     */
+    native function FuzzyMatch();
+    appshell.app.fuzzyMatch = function (query, limit, callback) {
+        FuzzyMatch(function (err, flatResults) {
+            var results = [],
+                i,
+                j;
+            if (!err) {
+                // A flat list of [path, score, [start, end, ...], ...]
+                for (i = 0; i + 3 <= flatResults.length; i += 3) {
+                    var ranges = [];
+                    for (j = 0; j + 2 <= flatResults[i + 2].length; j += 2) {
+                        ranges.push({ start: flatResults[i + 2][j], end: flatResults[i + 2][j + 1] });
+                    }
+                    results.push({ path: flatResults[i], score: flatResults[i + 1], ranges: ranges });
+                }
+            }
+            callback(err, results);
+        }, query, limit || 0);
+    };
+
     /**
      * Reads the entire contents of a file. 
      *
@@ -457,14 +716,363 @@ if (!brackets) {
     appshell.fs.readFile = function (path, encoding, callback) {
         ReadFile(callback, path, encoding);
     };
+
+    /**
+     * @private
+     * Number of chunks a read stream sends before it waits for the renderer to ack them.
+     */
+    var READ_STREAM_ACK_INTERVAL = 4;
+
+    /**
+     * @private
+     * Id of the next read stream opened by this window.
+     */
+    var _nextReadStreamId = 0;
+
+    /**
+     * Reads a file in chunks, so the first part of a large file can be shown before
+     * the rest has been read. Chunks are delivered in order and a multi-byte character
+     * is never split between two chunks.
+     *
+     * @param {string} path The path of the file to read.
+     * @param {{chunkSize: number, encoding: string}=} options Optional. chunkSize is the number
+     *        of bytes read at a time (default 1 MB). encoding defaults to 'utf8'; any other
+     *        encoding known to ICU can be given. For 'utf8' the actual encoding of the file is
+     *        detected from its start, as in readFile; if the file was taken for UTF-8 and
+     *        isn't valid UTF-8 further on, the stream stops with ERR_DECODE_FILE_FAILED.
+     * @param {function(string)} onChunk Called with the text of each chunk.
+     * @param {function(err, encoding, preserveBOM)} callback Asynchronous callback function, called
+     *        once after the last chunk. The callback gets the error, the encoding of the file and
+     *        whether the file starts with a UTF-8 BOM.
+     *        Possible error values:
+     *          NO_ERROR
+     *          ERR_UNKNOWN
+     *          ERR_INVALID_PARAMS
+     *          ERR_CANT_READ
+     *          ERR_UNSUPPORTED_ENCODING
+     *          ERR_UNSUPPORTED_UTF16_ENCODING
+     *          ERR_DECODE_FILE_FAILED
+     *          ERR_CANCELLED
+     *
+     * @return {{cancel: function()}} An object whose cancel() method stops the stream. No more
+     *        chunks are delivered after the callback gets ERR_CANCELLED.
+     */
+    native function OpenReadStream();
+    native function AckReadStream();
+    native function CancelReadStream();
+    appshell.fs.openReadStream = function (path, options, onChunk, callback) {
+        options = options || {};
+
+        var streamId = _nextReadStreamId++,
+            chunksReceived = 0;
+
+        OpenReadStream(function (err, data, preserveBOM) {
+            if (err === null) {
+                // Progress call with one more chunk of text
+                onChunk(data);
+                chunksReceived++;
+                if (chunksReceived % READ_STREAM_ACK_INTERVAL === 0) {
+                    AckReadStream(_dummyCallback, streamId);
+                }
+            } else {
+                callback(err, data, preserveBOM);
+            }
+        }, path, streamId, options.chunkSize || 1024 * 1024, READ_STREAM_ACK_INTERVAL, options.encoding || "utf8");
+
+        return {
+            cancel: function () {
+                CancelReadStream(_dummyCallback, streamId);
+            }
+        };
+    };
     
+    /**
+     * @private
+     * Id of the next walk started by this window.
+     */
+    var _nextWalkId = 0;
+
+    /**
+     * Lists every file and directory under a directory. The tree is read natively, several
+     * directories at a time, and the entries are delivered in batches.
+     *
+     * @param {string} root The path of the directory to walk.
+     * @param {{exclude: Array.<string>, maxDepth: number, followSymlinks: boolean, batchSize: number}=} options
+     *        Optional. exclude is a list of glob patterns of entries to skip along with everything
+     *        under them; patterns without a slash are matched against the entry name, the others
+     *        against the path relative to root. maxDepth is how many levels of subdirectories to
+     *        enter (0 only lists root; the default is no limit). followSymlinks enters symlinks to
+     *        directories; every directory is entered at most once, so symlink loops are safe.
+     *        batchSize is the number of entries per batch (default 2000).
+     * @param {function(Array.<string>, Array.<Object>)} onBatch Called with each batch of entries: the
+     *        paths relative to root, and their stats in the same form as readDirWithStats.
+     * @param {function(err, {entries: number, skipped: number})} callback Asynchronous callback function,
+     *        called once after the last batch with the number of entries listed and the number of
+     *        directories that couldn't be read.
+     *        Possible error values:
+     *          NO_ERROR
+     *          ERR_UNKNOWN
+     *          ERR_INVALID_PARAMS
+     *          ERR_NOT_FOUND
+     *          ERR_CANT_READ
+     *          ERR_NOT_DIRECTORY
+     *          ERR_CANCELLED
+     *          ERR_NOT_SUPPORTED (Linux only for now)
+     *
+     * @return {{cancel: function()}} An object whose cancel() method stops the walk. No more
+     *        batches are delivered after the callback gets ERR_CANCELLED.
+     */
+    native function Walk();
+    native function CancelWalk();
+    appshell.fs.walk = function (root, options, onBatch, callback) {
+        options = options || {};
+
+        var walkId = _nextWalkId++,
+            maxDepth = (typeof options.maxDepth === "number") ? options.maxDepth : -1;
+
+        Walk(function (err, entries, skipped) {
+            if (err === null) {
+                // Progress call with one more batch of entries
+                var unpacked = _unpackStatsList(entries);
+                onBatch(unpacked.names, unpacked.stats);
+            } else if (callback) {
+                callback(err, { entries: entries, skipped: skipped });
+            }
+        }, root, walkId, options.exclude || [], maxDepth, !!options.followSymlinks, options.batchSize || 2000);
+
+        return {
+            cancel: function () {
+                CancelWalk(_dummyCallback, walkId);
+            }
+        };
+    };
+
+    /**
+     * @private
+     * Id of the next watch started by this window.
+     */
+    var _nextWatchId = 0;
+
+    /**
+     * Watches a directory tree for changes. Changes are pushed from the shell as they happen, so
+     * nothing has to be polled or re-stat'ed. Bursts of changes, like a branch switch, arrive as one
+     * change set once the tree has been quiet for the debounce window (but at least once a second).
+     * Within a change set, a file that was created and then written to is only reported as created,
+     * one that was created and deleted again is not reported at all, and a file moved within the
+     * tree is reported as renamed.
+     *
+     * @param {string} root The path of the directory to watch.
+     * @param {{exclude: Array.<string>, debounce: number}=} options Optional. exclude is a list of
+     *        glob patterns of entries to ignore, matched as in walk(). debounce is the quiet time
+     *        in milliseconds before a change set is sent (default 100).
+     * @param {function(Array.<{type: string, path: string, oldPath: string}>, boolean)} onChange Called
+     *        with each change set and whether changes were lost, in which case the tree should be
+     *        read again. type is "created", "modified", "deleted" or "renamed"; paths are relative
+     *        to root, and oldPath is only set for renames.
+     * @param {function(err)=} callback Asynchronous callback function, called once the watch has
+     *        been closed, or has stopped because root went away (ERR_NOT_FOUND).
+     *        Possible error values:
+     *          NO_ERROR
+     *          ERR_UNKNOWN
+     *          ERR_INVALID_PARAMS
+     *          ERR_NOT_FOUND
+     *          ERR_CANT_READ
+     *          ERR_NOT_DIRECTORY
+     *          ERR_NOT_SUPPORTED (Linux only for now)
+     *
+     * @return {{close: function()}} An object whose close() method stops the watch.
+     */
+    native function Watch();
+    native function CloseWatch();
+    appshell.fs.watch = function (root, options, onChange, callback) {
+        options = options || {};
+
+        var watchId = _nextWatchId++;
+
+        Watch(function (err, changes, overflow) {
+            if (err === null) {
+                // Progress call with a flat list of [type, path, oldPath, ...]
+                var changeSet = [],
+                    i;
+                for (i = 0; i + 3 <= changes.length; i += 3) {
+                    changeSet.push({ type: changes[i], path: changes[i + 1], oldPath: changes[i + 2] || null });
+                }
+                onChange(changeSet, overflow);
+            } else if (callback) {
+                callback(err);
+            }
+        }, root, watchId, options.exclude || [], options.debounce || 100);
+
+        return {
+            close: function () {
+                CloseWatch(_dummyCallback, watchId);
+            }
+        };
+    };
+
+    /**
+     * @private
+     * Id of the next search started by this window.
+     */
+    var _nextSearchId = 0;
+
+    /**
+     * Finds text in every file under a directory. The files are read and searched natively,
+     * several at a time, and the matches are delivered in batches as they are found. Lines that
+     * can't match are skipped with a plain string search before the regular expression runs, and
+     * binary files and files over 16MB aren't searched.
+     *
+     * Regular expressions use JavaScript syntax without backreferences or lookaround, which are
+     * rejected, and are matched one line at a time.
+     *
+     * @param {string} root The path of the directory to search.
+     * @param {string} query The text or regular expression to look for.
+     * @param {{isRegexp: boolean, isCaseSensitive: boolean, exclude: Array.<string>, files: Array.<string>, maxResults: number, useIndex: boolean}=} options
+     *        Optional. exclude is a list of glob patterns of files and directories to skip, matched
+     *        as in walk(). files is a list of full paths to search instead of walking root.
+     *        maxResults stops the search once that many matches have been found. useIndex only
+     *        searches the files that root's search index (see updateSearchIndex) says could
+     *        match, if one is loaded.
+     * @param {function(Array.<{fullPath: string, start: {line: number, ch: number}, end: {line: number, ch: number}, line: string, lineOffset: number}>)} onMatches
+     *        Called with each batch of matches. line is the text of the matching line; for very
+     *        long lines it is only the part around the match, starting at column lineOffset.
+     * @param {function(err, {matches: number, files: number, truncated: boolean, message: string})} callback
+     *        Asynchronous callback function, called once after the last batch with the number of
+     *        matches and of files searched, and whether the search stopped at maxResults. message
+     *        explains an invalid regular expression.
+     *        Possible error values:
+     *          NO_ERROR
+     *          ERR_UNKNOWN
+     *          ERR_INVALID_PARAMS
+     *          ERR_NOT_FOUND
+     *          ERR_CANT_READ
+     *          ERR_NOT_DIRECTORY
+     *          ERR_CANCELLED
+     *          ERR_NOT_SUPPORTED (Linux only for now)
+     *
+     * @return {{cancel: function()}} An object whose cancel() method stops the search. No more
+     *        batches are delivered after the callback gets ERR_CANCELLED.
+     */
+    native function Search();
+    native function CancelSearch();
+    appshell.fs.search = function (root, query, options, onMatches, callback) {
+        options = options || {};
+
+        var searchId = _nextSearchId++;
+
+        Search(function (err, matches, files, truncated, message) {
+            if (err === null) {
+                // Progress call with a flat list of [fullPath, line, startCh, endCh, text, textOffset, ...]
+                var batch = [],
+                    i;
+                for (i = 0; i + 6 <= matches.length; i += 6) {
+                    batch.push({
+                        fullPath: matches[i],
+                        start: { line: matches[i + 1], ch: matches[i + 2] },
+                        end: { line: matches[i + 1], ch: matches[i + 3] },
+                        line: matches[i + 4],
+                        lineOffset: matches[i + 5]
+                    });
+                }
+                onMatches(batch);
+            } else if (callback) {
+                callback(err, { matches: matches, files: files, truncated: truncated, message: message || "" });
+            }
+        }, root, searchId, query, !!options.isRegexp, !!options.isCaseSensitive,
+            options.exclude || [], options.files || [], options.maxResults || 0, !!options.useIndex);
+
+        return {
+            cancel: function () {
+                CancelSearch(_dummyCallback, searchId);
+            }
+        };
+    };
+
+    /**
+     * @private
+     * Turns the figures native code sends about a search index into an object.
+     */
+    function _searchIndexStats(files, trigrams, size, buildTime, filesRead, queries, lastQueryTime, totalQueryTime) {
+        return {
+            files: files,
+            trigrams: trigrams,
+            size: size,
+            buildTime: buildTime,
+            filesRead: filesRead,
+            queries: queries,
+            lastQueryTime: lastQueryTime,
+            averageQueryTime: queries ? totalQueryTime / queries : 0
+        };
+    }
+
+    /**
+     * Loads the trigram index of a project and brings it up to date, so search() can use it
+     * to skip files that can't match. Indexes are kept under the app support directory; only
+     * files whose modification time or size changed since the last update are read again.
+     * Searches find what the files held at the last update, so call this again after files
+     * change.
+     *
+     * @param {string} root The path of the project's root directory.
+     * @param {{exclude: Array.<string>}=} options Optional. exclude is a list of glob patterns of
+     *        files and directories to leave out of the index, matched as in walk().
+     * @param {function(err, Object)} callback Asynchronous callback function, called with the
+     *        index's figures in the same form as getSearchIndexStats().
+     *        Possible error values:
+     *          NO_ERROR
+     *          ERR_UNKNOWN
+     *          ERR_INVALID_PARAMS
+     *          ERR_NOT_FOUND
+     *          ERR_CANT_READ
+     *          ERR_NOT_DIRECTORY
+     *          ERR_CANT_WRITE
+     *          ERR_OUT_OF_SPACE
+     *          ERR_NOT_SUPPORTED (Linux only for now)
+     *
+     * @return None. This is an asynchronous call that sends all return information to the callback.
+     */
+    native function UpdateSearchIndex();
+    appshell.fs.updateSearchIndex = function (root, options, callback) {
+        options = options || {};
+        UpdateSearchIndex(function (err) {
+            var stats = _searchIndexStats.apply(null, Array.prototype.slice.call(arguments, 1));
+            if (callback) {
+                callback(err, stats);
+            }
+        }, root, options.exclude || []);
+    };
+
+    /**
+     * Returns figures about the loaded search index of a project.
+     *
+     * @param {string} root The path of the project's root directory.
+     * @param {function(err, {files: number, trigrams: number, size: number, buildTime: number, filesRead: number, queries: number, lastQueryTime: number, averageQueryTime: number})} callback
+     *        Asynchronous callback function. size is in bytes; buildTime is how long the last
+     *        update took and filesRead how many files it read; queries is the number of searches
+     *        that used the index. Times are in milliseconds.
+     *        Possible error values:
+     *          NO_ERROR
+     *          ERR_NOT_FOUND (no index is loaded for root)
+     *          ERR_NOT_SUPPORTED (Linux only for now)
+     *
+     * @return None. This is an asynchronous call that sends all return information to the callback.
+     */
+    native function GetSearchIndexStats();
+    appshell.fs.getSearchIndexStats = function (root, callback) {
+        GetSearchIndexStats(function (err) {
+            callback(err, _searchIndexStats.apply(null, Array.prototype.slice.call(arguments, 1)));
+        }, root);
+    };
+
     /**
      * Write data to a file, replacing the file if it already exists. 
      *
      * @param {string} path The path of the file to write.
      * @param {string} data The data to write to the file.
      * @param {string} encoding The encoding for the file. The only supported encoding is 'utf8'.
-     * @param {function(err)=} callback Asynchronous callback function. The callback gets one argument (err).
+     * @param {boolean} preserveBOM If true, a UTF-8 file is written with a BOM.
+     * @param {function(err, timings)=} callback Asynchronous callback function. The callback gets two
+     *        arguments (err, timings) where timings has the form {write: number, sync: number, rename: number},
+     *        the time in milliseconds spent on each phase of the save.
      *        Possible error values:
      *          NO_ERROR
      *          ERR_UNKNOWN
@@ -472,12 +1080,20 @@ if (!brackets) {
      *          ERR_UNSUPPORTED_ENCODING
      *          ERR_CANT_WRITE
      *          ERR_OUT_OF_SPACE
+     * @param {{atomic: boolean, sync: boolean}=} options Optional. With atomic set, the data is written
+     *        to a temp file that then replaces the file, so the file is never left half-written (Linux
+     *        only for now). With sync set, the data is flushed to disk before the callback is called.
      *                 
      * @return None. This is an asynchronous call that sends all return information to the callback.
      */
     native function WriteFile();
-    appshell.fs.writeFile = function (path, data, encoding, preserveBOM, callback) {
-        WriteFile(callback || _dummyCallback, path, data, encoding, preserveBOM);
+    appshell.fs.writeFile = function (path, data, encoding, preserveBOM, callback, options) {
+        options = options || {};
+        WriteFile(function (err, writeTime, syncTime, renameTime) {
+            if (callback) {
+                callback(err, { write: writeTime, sync: syncTime, rename: renameTime });
+            }
+        }, path, data, encoding, !!preserveBOM, !!options.atomic, !!options.sync);
     };
     
     /**
@@ -537,6 +1153,68 @@ if (!brackets) {
         MoveFileOrDirectoryToTrash(callback || _dummyCallback, path);
     };    
 
+    /**
+     * @private
+     * Id of the next remove started by this window.
+     */
+    var _nextRemoveId = 0;
+
+    /**
+     * Deletes several files and directory trees, or moves them to the trash. Trees are taken
+     * apart natively, several directories at a time, so this is the fast way to get rid of a
+     * folder like node_modules. Entries that can't be removed are skipped and reported, along
+     * with the directories above them, which are left in place.
+     *
+     * @param {Array.<string>} paths The paths of the files and directories to remove.
+     * @param {{trash: boolean}=} options Optional. trash moves each path to the trash instead of
+     *        deleting it.
+     * @param {?function(number, Array.<{path: string, err: number}>)} onProgress Optional. Called at
+     *        most every 100ms with the number of entries removed so far and the entries that
+     *        couldn't be removed since the last call.
+     * @param {function(err, {removed: number, failed: number})} callback Asynchronous callback
+     *        function, called once everything has been dealt with. err is the error of the first
+     *        entry that couldn't be removed.
+     *        Possible error values:
+     *          NO_ERROR
+     *          ERR_UNKNOWN
+     *          ERR_INVALID_PARAMS
+     *          ERR_NOT_FOUND
+     *          ERR_CANT_WRITE
+     *          ERR_CANCELLED
+     *          ERR_NOT_SUPPORTED (Linux only for now)
+     *
+     * @return {{cancel: function()}} An object whose cancel() method stops removing entries.
+     *        Whatever was removed already stays removed.
+     */
+    native function Remove();
+    native function CancelRemove();
+    appshell.fs.remove = function (paths, options, onProgress, callback) {
+        options = options || {};
+
+        var removeId = _nextRemoveId++;
+
+        Remove(function (err, removed, failed) {
+            if (err === null) {
+                // Progress call; failed is a flat list of paths and error codes
+                if (onProgress) {
+                    var failures = [], i;
+                    for (i = 0; i < failed.length; i += 2) {
+                        failures.push({ path: failed[i], err: failed[i + 1] });
+                    }
+                    onProgress(removed, failures);
+                }
+            } else if (callback) {
+                callback(err, { removed: removed, failed: failed });
+            }
+        }, paths, removeId, !!options.trash);
+
+        return {
+            cancel: function () {
+                CancelRemove(_dummyCallback, removeId);
+            }
+        };
+    };
+
     /**
      * Copy src to dest, replacing the file at dest if it already exists.
      *
@@ -556,6 +1234,65 @@ if (!brackets) {
     appshell.fs.copyFile = function (src, dest, callback) {
         CopyFile(callback || _dummyCallback, src, dest);
     };
+
+    /**
+     * @private
+     * Id of the next copy started by this window.
+     */
+    var _nextCopyId = 0;
+
+    /**
+     * Copies a file or a whole directory tree. File contents are cloned where the file system
+     * supports it and otherwise copied by the kernel, several files at a time, so this is the
+     * fast way to duplicate a folder. Symlinks are copied as links.
+     *
+     * @param {string} src The path of the file or directory to copy.
+     * @param {string} dest The path to copy to. A file replaces the file at dest; a directory is
+     *        merged into the directory at dest, which is created if needed.
+     * @param {?function({bytesCopied: number, totalBytes: number, filesCopied: number, totalFiles: number})} onProgress
+     *        Optional. Called at most every 100ms while the copy runs, including during large
+     *        files, and once more when it is done. The totals grow until the whole source tree has
+     *        been read.
+     * @param {function(err, {files: number, bytes: number, failedPath: string})} callback Asynchronous
+     *        callback function, called with what was copied and, on failure, the path that couldn't
+     *        be copied. Whatever was copied before a failure is left in place.
+     *        Possible error values:
+     *          NO_ERROR
+     *          ERR_UNKNOWN
+     *          ERR_INVALID_PARAMS
+     *          ERR_NOT_FOUND
+     *          ERR_CANT_READ
+     *          ERR_CANT_WRITE
+     *          ERR_OUT_OF_SPACE
+     *          ERR_NOT_FILE
+     *          ERR_NOT_DIRECTORY
+     *          ERR_CANCELLED
+     *          ERR_NOT_SUPPORTED (Linux only for now)
+     *
+     * @return {{cancel: function()}} An object whose cancel() method stops the copy.
+     */
+    native function Copy();
+    native function CancelCopy();
+    appshell.fs.copy = function (src, dest, onProgress, callback) {
+        var copyId = _nextCopyId++;
+
+        Copy(function (err, a, b, c, d) {
+            if (err === null) {
+                // Progress call
+                if (onProgress) {
+                    onProgress({ bytesCopied: a, totalBytes: b, filesCopied: c, totalFiles: d });
+                }
+            } else if (callback) {
+                callback(err, { files: a, bytes: b, failedPath: c });
+            }
+        }, src, dest, copyId);
+
+        return {
+            cancel: function () {
+                CancelCopy(_dummyCallback, copyId);
+            }
+        };
+    };
  
     /**
      * Return the number of milliseconds that have elapsed since the application
@@ -663,6 +1400,34 @@ if (!brackets) {
     appshell.app.getRemoteDebuggingPort = function (callback) {
         GetRemoteDebuggingPort(callback || _dummyCallback);
     };
+
+    /**
+     * Get usage statistics for the native functions called since startup.
+     *
+     * @param {function(err, stats)} callback Asynchronous callback function. The callback gets
+     *        an error code and an object keyed by native function name. Each value has the form
+     *        {calls: number, errors: number, p50: number, p99: number}, where p50 and p99 are
+     *        latencies in milliseconds. Only functions that have been called are included.
+     *
+     * @return None. This is an asynchronous call that sends all return information to the callback.
+     */
+    native function GetNativeCallStats();
+    appshell.app.getNativeCallStats = function (callback) {
+        GetNativeCallStats(function (err, entries) {
+            var stats = {};
+            if (!err && entries) {
+                entries.forEach(function (entry) {
+                    stats[entry[0]] = {
+                        calls: entry[1],
+                        errors: entry[2],
+                        p50: entry[3],
+                        p99: entry[4]
+                    };
+                });
+            }
+            callback(err, stats);
+        });
+    };
     
     
     /**
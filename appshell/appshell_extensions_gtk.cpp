@@ -27,14 +27,21 @@
 #include <gio/gio.h>
 #include <gtk/gtk.h>
 #include "appshell_extensions.h"
+#include "appshell_copy.h"
+#include "appshell_delete.h"
+#include "appshell_worker_pool.h"
 #include "native_menu_model.h"
 #include "client_handler.h"
+#include "include/base/cef_bind.h"
 
 #include <errno.h>
 #include <dirent.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <fcntl.h>
+#include <string.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #include <X11/Xlib.h>
 #include <gdk/gdkkeysyms.h>
@@ -105,7 +112,6 @@ extern CefRefPtr<ClientHandler> g_handler;
 //   - chromium - other chromium executable name (in arch linux)
 std::string browsers[3] = {"google-chrome", "chromium-browser", "chromium"};
 
-int ConvertLinuxErrorCode(int errorCode, bool isReading = true);
 int ConvertGnomeErrorCode(GError* gerror, bool isReading = true);
 
 extern bool isReallyClosing;
@@ -387,6 +393,17 @@ int Rename(ExtensionString oldName, ExtensionString newName)
     }
 }
 
+ExtensionString ResolveRealPath(const ExtensionString& path)
+{
+    ExtensionString result;
+    char* resolved = realpath(path.c_str(), NULL);
+    if (resolved) {
+        result = resolved;
+        free(resolved);
+    }
+    return result;
+}
+
 int GetFileInfo(ExtensionString filename, uint32& modtime, bool& isDir, double& size, ExtensionString& realPath)
 {
     struct stat buf;
@@ -396,11 +413,115 @@ int GetFileInfo(ExtensionString filename, uint32& modtime, bool& isDir, double&
     modtime = buf.st_mtime;
     isDir = S_ISDIR(buf.st_mode);
     size = (double)buf.st_size;
-    
-    // TODO: Implement realPath. If "filename" is a symlink, realPath should be the actual path
-    // to the linked object.
+
+    // If "filename" is a symlink, realPath is the actual path to the linked object.
     realPath = "";
-    
+    struct stat linkbuf;
+    if (lstat(filename.c_str(), &linkbuf) == 0 && S_ISLNK(linkbuf.st_mode))
+        realPath = ResolveRealPath(filename);
+
+    return NO_ERROR;
+}
+
+int32 GetFileStats(const ExtensionString& path, FileStats& stats)
+{
+    struct stat buf;
+    if (stat(path.c_str(), &buf) == -1)
+        return ConvertLinuxErrorCode(errno);
+
+    stats.mtimeSec = buf.st_mtim.tv_sec;
+    stats.mtimeNsec = buf.st_mtim.tv_nsec;
+    stats.size = (double)buf.st_size;
+    stats.type = S_ISDIR(buf.st_mode) ? FILE_TYPE_DIRECTORY :
+                 S_ISREG(buf.st_mode) ? FILE_TYPE_FILE : FILE_TYPE_OTHER;
+    return NO_ERROR;
+}
+
+struct DirEntryStats {
+    ExtensionString name;
+    time_t modtime;
+    double size;
+    ExtensionString realPath;
+};
+
+static void AppendDirEntryStats(CefRefPtr<CefListValue>& entries, size_t& index,
+                                const std::vector<DirEntryStats>& list, bool isDir)
+{
+    for (size_t i = 0; i < list.size(); i++) {
+        entries->SetString(index++, list[i].name);
+        entries->SetInt(index++, (int)list[i].modtime);
+        entries->SetBool(index++, isDir);
+        entries->SetDouble(index++, list[i].size);
+        entries->SetString(index++, list[i].realPath);
+    }
+}
+
+int32 ReadDirWithStats(ExtensionString path, CefRefPtr<CefListValue>& entries)
+{
+    if (path.length() && path[path.length() - 1] != '/')
+        path += '/';
+
+    // Stat everything relative to the directory fd, so there is no per-entry
+    // path building or lookup of the directory itself.
+    int dirfd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirfd == -1)
+        return ConvertLinuxErrorCode(errno, true);
+
+    DIR* dp = fdopendir(dirfd);
+    if (dp == NULL) {
+        int error = errno;
+        close(dirfd);
+        return ConvertLinuxErrorCode(error, true);
+    }
+
+    std::vector<DirEntryStats> dirs;
+    std::vector<DirEntryStats> files;
+    struct dirent* entry;
+
+    while ((entry = readdir(dp)) != NULL) {
+        const char* name = entry->d_name;
+        if (!strcmp(name, ".") || !strcmp(name, ".."))
+            continue;
+
+        // d_type can't give us mtime and size, but it does let us drop
+        // sockets, fifos and devices without a stat.
+        unsigned char type = entry->d_type;
+        if (type != DT_UNKNOWN && type != DT_DIR && type != DT_REG && type != DT_LNK)
+            continue;
+
+        struct stat statbuf;
+        if (fstatat(dirfd, name, &statbuf, AT_SYMLINK_NOFOLLOW) == -1)
+            continue;
+
+        DirEntryStats stats;
+        stats.name = name;
+
+        // Only symlinks need their target stat'ed and resolved. Dangling
+        // links are skipped, as ReadDir does.
+        if (S_ISLNK(statbuf.st_mode)) {
+            if (fstatat(dirfd, name, &statbuf, 0) == -1)
+                continue;
+            stats.realPath = ResolveRealPath(path + name);
+        }
+
+        stats.modtime = statbuf.st_mtime;
+        stats.size = (double)statbuf.st_size;
+
+        if (S_ISDIR(statbuf.st_mode))
+            dirs.push_back(stats);
+        else if (S_ISREG(statbuf.st_mode))
+            files.push_back(stats);
+    }
+
+    // Also closes dirfd.
+    closedir(dp);
+
+    //# List dirs first, files next
+    size_t index = 0;
+    entries->SetSize((dirs.size() + files.size()) * READDIR_STATS_STRIDE);
+    AppendDirEntryStats(entries, index, dirs, true);
+    AppendDirEntryStats(entries, index, files, false);
+
     return NO_ERROR;
 }
 
@@ -408,30 +529,30 @@ const int utf8_BOM_Len = 3;
 const int utf16_BOM_Len = 2;
 const int utf32_BOM_Len = 4;
 
-bool has_utf8_BOM(gchar* data, gsize length)
+bool has_utf8_BOM(const gchar* data, gsize length)
 {
     return ((length >= utf8_BOM_Len) &&
                 (data[0] == (gchar)0xEF) && (data[1] == (gchar)0xBB) && (data[2] == (gchar)0xBF));
 }
 
-bool has_utf16be_BOM(gchar* data, gsize length)
+bool has_utf16be_BOM(const gchar* data, gsize length)
 {
     return ((length >= utf16_BOM_Len) && (data[0] == (gchar)0xFE) && (data[1] == (gchar)0xFF));
 }
 
-bool has_utf16le_BOM(gchar* data, gsize length)
+bool has_utf16le_BOM(const gchar* data, gsize length)
 {
     return ((length >= utf16_BOM_Len) && (data[0] == (gchar)0xFF) && (data[1] == (gchar)0xFE));
 }
 
-bool has_utf32be_BOM(gchar* data, gsize length)
+bool has_utf32be_BOM(const gchar* data, gsize length)
 {
     return ((length >=  utf32_BOM_Len) &&
              (data[0] == (gchar)0x00) && (data[1] == (gchar)0x00) &&
              (data[2] == (gchar)0xFE) && (data[3] == (gchar)0xFF));
 }
 
-bool has_utf32le_BOM(gchar* data, gsize length)
+bool has_utf32le_BOM(const gchar* data, gsize length)
 {
    return ((length >=  utf32_BOM_Len) &&
              (data[0] == (gchar)0xFE) && (data[1] == (gchar)0xFF) &&
@@ -439,12 +560,83 @@ bool has_utf32le_BOM(gchar* data, gsize length)
 }
 
 
-bool has_utf_32_BOM(gchar* data, gsize length) 
+bool has_utf_32_BOM(const gchar* data, gsize length) 
 {
     return (has_utf32be_BOM(data ,length) ||
             has_utf32le_BOM(data ,length));
 }
 
+// Checks that the text up to the first NUL byte is valid UTF-8, in place.
+// Text after a NUL is not checked, matching how g_locale_to_utf8() used to
+// treat these buffers.
+bool IsValidUTF8Text(const gchar* data, gsize length)
+{
+    const void* nul = memchr(data, '\0', length);
+    if (nul != NULL) {
+        length = (const gchar*)nul - data;
+    }
+    return IsValidUTF8(data, length);
+}
+
+
+// Reads up to |length| bytes from |fd| into |data|, stopping early only at
+// EOF. Returns how many bytes were read, or -1 with errno set.
+static ssize_t ReadUpTo(int fd, char* data, size_t length)
+{
+    size_t total = 0;
+    while (total < length) {
+        ssize_t bytesRead = read(fd, data + total, length - total);
+        if (bytesRead < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        if (bytesRead == 0) {
+            break;
+        }
+        total += bytesRead;
+    }
+    return total;
+}
+
+// Reads the rest of |fd| into |buffer|, after the |prefixLength| bytes of
+// |prefix|, which is what the caller read already minus any BOM. |consumed|
+// is how much the caller read. For regular files the buffer is sized up
+// front from |st|, so the contents arrive in a single read(2) and are not
+// copied again. Returns an errno value, or 0 on success.
+static int ReadFileDescriptor(int fd, const struct stat& st, size_t consumed,
+                              const char* prefix, size_t prefixLength, std::string& buffer)
+{
+    // Files in /proc and pipes report a size of 0, so keep reading until EOF.
+    size_t capacity = (S_ISREG(st.st_mode) && (size_t)st.st_size > consumed)
+        ? (size_t)st.st_size - consumed + prefixLength + 1
+        : 64 * 1024;
+    size_t length = prefixLength;
+
+    buffer.resize(capacity);
+    memcpy(&buffer[0], prefix, prefixLength);
+    for (;;) {
+        ssize_t bytesRead = read(fd, &buffer[length], capacity - length);
+        if (bytesRead < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno;
+        }
+        if (bytesRead == 0) {
+            break;
+        }
+        length += bytesRead;
+        if (length == capacity) {
+            // The file grew since fstat() or had no size to begin with.
+            capacity *= 2;
+            buffer.resize(capacity);
+        }
+    }
+    buffer.resize(length);
+    return 0;
+}
 
 int32 ReadFile(ExtensionString filename, ExtensionString& encoding, std::string& contents, bool& preserveBOM)
 {
@@ -453,100 +645,310 @@ int32 ReadFile(ExtensionString filename, ExtensionString& encoding, std::string&
     }
 
     int error = NO_ERROR;
-    GError *gerror = NULL;
-    gchar *file_get_contents = NULL;
-    gsize len = 0;
-    
-    if (!g_file_get_contents(filename.c_str(), &file_get_contents, &len, &gerror)) {
-        error = GErrorToErrorCode(gerror);
+    int readErrno = 0;
+    struct stat st;
+    int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+
+    // The first bytes are read on their own so that a UTF-8 BOM can be left
+    // out of |contents| without moving the rest of the file afterwards.
+    gchar head[utf32_BOM_Len];
+    ssize_t headLength = 0;
+    bool utf8BOM = false;
+    bool utf32BOM = false;
+
+    if (fd < 0) {
+        readErrno = errno;
+    } else {
+        if (fstat(fd, &st) != 0) {
+            readErrno = errno;
+        } else if (S_ISDIR(st.st_mode)) {
+            readErrno = EISDIR;
+        } else if ((headLength = ReadUpTo(fd, head, sizeof(head))) < 0) {
+            readErrno = errno;
+        } else {
+            utf32BOM = has_utf_32_BOM(head, headLength);
+            utf8BOM = has_utf8_BOM(head, headLength);
+            if (!utf32BOM) {
+                size_t skip = utf8BOM ? utf8_BOM_Len : 0;
+                readErrno = ReadFileDescriptor(fd, st, headLength, head + skip, headLength - skip, contents);
+            }
+        }
+        close(fd);
+    }
+
+    if (readErrno != 0) {
+        // Map errno the same way the g_file_get_contents() errors used to be.
+        error = GErrorToErrorCode(g_error_new_literal(G_FILE_ERROR, g_file_error_from_errno(readErrno), ""));
         if (error == ERR_NOT_FILE) {
             error = ERR_CANT_READ;
         }
-    } else {
-        if (has_utf_32_BOM(file_get_contents, len)) {
-            error = ERR_UNSUPPORTED_ENCODING;
-        } else  if (has_utf8_BOM(file_get_contents, len)) {
-            // if file contains BOM chars,
-            // then we set preserveBOM to true,
-            // so that while writing we can 
-            // prepend the BOM chars
-            std::ifstream file(filename.c_str());
-            std::stringstream ss;
-            ss << file.rdbuf();
-            contents = ss.str();
-            contents.erase(0, 3);
-            preserveBOM = true;
-        } else if (!g_locale_to_utf8(file_get_contents, -1, NULL, NULL, &gerror) || encoding != "UTF-8") {
-            contents.assign(file_get_contents, len);
-            std::string detectedCharSet;
-            try {
-                if (encoding == "UTF-8") {
-                    CharSetDetect ICUDetector;
-                    ICUDetector(contents.c_str(), contents.size(), detectedCharSet);
-                }
-                else {
-                    detectedCharSet = encoding;
-                }
-                if (detectedCharSet == "UTF-16LE" || detectedCharSet == "UTF-16BE") {
-                    error = ERR_UNSUPPORTED_UTF16_ENCODING;
-                }
-                if (!detectedCharSet.empty() && error == NO_ERROR) {
-                    std::transform(detectedCharSet.begin(), detectedCharSet.end(), detectedCharSet.begin(), ::toupper);
-                    DecodeContents(contents, detectedCharSet);
-                    encoding = detectedCharSet;
-                }
-                else if (detectedCharSet.empty()) {
-                    error = ERR_UNSUPPORTED_ENCODING;
-                }
-            } catch (...) {
+        contents.clear();
+        return error;
+    }
+
+    const gchar* data = contents.data();
+    gsize len = contents.size();
+
+    if (utf32BOM) {
+        contents.clear();
+        error = ERR_UNSUPPORTED_ENCODING;
+    } else if (utf8BOM) {
+        // if file contains BOM chars,
+        // then we set preserveBOM to true,
+        // so that while writing we can 
+        // prepend the BOM chars
+        preserveBOM = true;
+    } else if (!IsValidUTF8Text(data, len) || encoding != "UTF-8") {
+        std::string detectedCharSet;
+        try {
+            if (encoding == "UTF-8") {
+                DetectCharSet(contents.c_str(), contents.size(), detectedCharSet);
+            }
+            else {
+                detectedCharSet = encoding;
+            }
+            if (detectedCharSet == "UTF-16LE" || detectedCharSet == "UTF-16BE") {
+                error = ERR_UNSUPPORTED_UTF16_ENCODING;
+            }
+            if (!detectedCharSet.empty() && error == NO_ERROR) {
+                std::transform(detectedCharSet.begin(), detectedCharSet.end(), detectedCharSet.begin(), ::toupper);
+                DecodeContents(contents, detectedCharSet);
+                encoding = detectedCharSet;
+            }
+            else if (detectedCharSet.empty()) {
                 error = ERR_UNSUPPORTED_ENCODING;
             }
-        } else {
-            contents.assign(file_get_contents, len);
+        } catch (...) {
+            error = ERR_UNSUPPORTED_ENCODING;
         }
-        g_free(file_get_contents);
     }
     return error;
 }
 
 
 
-int32 WriteFile(ExtensionString filename, std::string contents, ExtensionString encoding, bool preserveBOM)
+static double MillisecondsSince(int64 startTime)
 {
-    const char *filenameStr = filename.c_str();    
-    int error = NO_ERROR;
-    GError *gerror = NULL;
-    if (g_file_test(filenameStr, G_FILE_TEST_EXISTS) && g_access(filenameStr, W_OK) == -1) {
-        return ERR_CANT_WRITE;
+    return (appshell::GetMonotonicMicroseconds() - startTime) / 1000.0;
+}
+
+static int ConvertWriteErrorCode(int errorCode)
+{
+    return (errorCode == ENOSPC || errorCode == EDQUOT) ? ERR_OUT_OF_SPACE : ERR_CANT_WRITE;
+}
+
+// Writes all of |iov| to |fd|, picking up after short writes.
+static bool WriteAll(int fd, struct iovec* iov, int iovcnt)
+{
+    while (iovcnt > 0) {
+        ssize_t written = writev(fd, iov, iovcnt);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        while (iovcnt > 0 && (size_t)written >= iov->iov_len) {
+            written -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (char*)iov->iov_base + written;
+            iov->iov_len -= written;
+        }
+    }
+    return true;
+}
+
+// Whether creating a temp file failed because the directory can't take one,
+// even though the file in it may still be writable in place.
+static bool IsTempFileDenied(int errorCode)
+{
+    return errorCode == EACCES || errorCode == EPERM || errorCode == EROFS;
+}
+
+// Writes |iov| to a temp file in the directory of |target| and renames it over
+// |target|, which must be an existing file given as an absolute path. Returns
+// false without touching |target| if no temp file can be created next to it
+// (say the file is writable but its directory isn't) or the temp file can't be
+// given the owner of |target|; the caller then falls back to writing in place.
+static bool WriteFileAtomically(const std::string& target, const struct stat& targetStat,
+                                struct iovec* iov, int iovcnt, bool sync,
+                                WriteFileTimings& timings, int& error)
+{
+    int64 startTime = appshell::GetMonotonicMicroseconds();
+    std::string dir = target.substr(0, target.rfind('/') + 1);
+    std::string tempPath = dir + "." + target.substr(dir.size()) + ".XXXXXX";
+    bool linked = false;
+
+    // An O_TMPFILE file has no name until it is linked in, so a crash while
+    // writing leaves nothing behind. Older kernels and some file systems don't
+    // support it.
+    int fd = -1;
+#ifdef O_TMPFILE
+    fd = open(dir.c_str(), O_TMPFILE | O_WRONLY | O_CLOEXEC, 0600);
+#endif
+    if (fd < 0) {
+        fd = mkostemp(&tempPath[0], O_CLOEXEC);
+        if (fd < 0) {
+            if (IsTempFileDenied(errno)) {
+                return false;
+            }
+            error = ConvertWriteErrorCode(errno);
+            return true;
+        }
+        linked = true;
+    }
+
+    if (fchown(fd, targetStat.st_uid, targetStat.st_gid) != 0 &&
+        (targetStat.st_uid != geteuid() || targetStat.st_gid != getegid())) {
+        // Replacing the file would change its owner.
+        close(fd);
+        if (linked) {
+            unlink(tempPath.c_str());
+        }
+        return false;
+    }
+    fchmod(fd, targetStat.st_mode & 07777);
+
+    error = NO_ERROR;
+    if (!WriteAll(fd, iov, iovcnt)) {
+        error = ConvertWriteErrorCode(errno);
+    }
+    timings.writeMs = MillisecondsSince(startTime);
+
+    if (error == NO_ERROR && sync) {
+        int64 syncStart = appshell::GetMonotonicMicroseconds();
+        if (fdatasync(fd) != 0) {
+            error = ConvertWriteErrorCode(errno);
+        }
+        timings.syncMs = MillisecondsSince(syncStart);
+    }
+
+    int64 renameStart = appshell::GetMonotonicMicroseconds();
+    if (error == NO_ERROR && !linked) {
+        // linkat() can't replace an existing file, so give the file a temp
+        // name first and rename that.
+        char procPath[64];
+        snprintf(procPath, sizeof(procPath), "/proc/self/fd/%d", fd);
+        int tempFd = mkostemp(&tempPath[0], O_CLOEXEC);
+        if (tempFd < 0) {
+            error = ConvertWriteErrorCode(errno);
+        } else {
+            close(tempFd);
+            unlink(tempPath.c_str());
+            if (linkat(AT_FDCWD, procPath, AT_FDCWD, tempPath.c_str(), AT_SYMLINK_FOLLOW) != 0) {
+                error = ConvertWriteErrorCode(errno);
+            } else {
+                linked = true;
+            }
+        }
+    }
+    close(fd);
+
+    if (error == NO_ERROR && rename(tempPath.c_str(), target.c_str()) != 0) {
+        error = ConvertWriteErrorCode(errno);
+    }
+    if (error != NO_ERROR && linked) {
+        unlink(tempPath.c_str());
     }
 
+    if (error == NO_ERROR && sync) {
+        // Make the rename itself durable.
+        int dirFd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (dirFd >= 0) {
+            fsync(dirFd);
+            close(dirFd);
+        }
+    }
+    timings.renameMs = MillisecondsSince(renameStart);
+
+    return true;
+}
+
+int32 WriteFile(ExtensionString filename, const std::string& contents, ExtensionString encoding, bool preserveBOM,
+                const WriteFileOptions& options, WriteFileTimings& timings)
+{
+    int error = NO_ERROR;
+
     if (encoding == "utf8") {
         encoding = "UTF-8";
     }
-    
+
+    // UTF-8 is written straight from |contents|, with the BOM in its own
+    // iovec. Only other encodings need a converted copy.
+    std::string encoded;
+    struct iovec iov[2];
+    int iovcnt = 0;
+
     if (encoding != "UTF-8") {
         try {
+            std::string converted(contents);
             CharSetEncode ICUEncoder(encoding);
-            ICUEncoder(contents);
+            ICUEncoder(converted);
+            encoded.swap(converted);
         } catch (...) {
             error = ERR_ENCODE_FILE_FAILED;
         }
-    } else if (encoding == "UTF-8" && preserveBOM) {
+    } else if (preserveBOM) {
         // File originally contained BOM chars
         // so we prepend BOM chars
-        contents = UTF8_BOM + contents;
+        iov[iovcnt].iov_base = (void*)UTF8_BOM;
+        iov[iovcnt].iov_len = utf8_BOM_Len;
+        iovcnt++;
     }
-    
-    try {
-        std::ofstream file;
-        file.open (filenameStr);
-        file << contents;
-        if (file.fail()) {
-            error = ERR_CANT_WRITE;
+
+    const std::string& body = (encoding != "UTF-8" && error == NO_ERROR) ? encoded : contents;
+    iov[iovcnt].iov_base = (void*)body.data();
+    iov[iovcnt].iov_len = body.size();
+    iovcnt++;
+
+    if (options.atomic) {
+        // Follow a symlink so the link itself stays in place. A file that
+        // doesn't exist yet has nothing to lose and is written directly.
+        char* resolved = realpath(filename.c_str(), NULL);
+        struct stat targetStat;
+        if (resolved != NULL && stat(resolved, &targetStat) == 0 && S_ISREG(targetStat.st_mode)) {
+            std::string target(resolved);
+            free(resolved);
+
+            // rename() would happily replace a read-only file.
+            if (access(target.c_str(), W_OK) != 0) {
+                return ERR_CANT_WRITE;
+            }
+
+            int atomicError = NO_ERROR;
+            if (WriteFileAtomically(target, targetStat, iov, iovcnt, options.sync, timings, atomicError)) {
+                return (atomicError != NO_ERROR) ? atomicError : error;
+            }
+        } else {
+            free(resolved);
         }
-        file.close();
-    } catch (...) {
-        return ERR_CANT_WRITE;
+    }
+
+    int64 startTime = appshell::GetMonotonicMicroseconds();
+    int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (fd < 0) {
+        return ConvertWriteErrorCode(errno);
+    }
+
+    bool written = WriteAll(fd, iov, iovcnt);
+    if (!written) {
+        error = ConvertWriteErrorCode(errno);
+    }
+    timings.writeMs = MillisecondsSince(startTime);
+
+    if (options.sync && written) {
+        int64 syncStart = appshell::GetMonotonicMicroseconds();
+        if (fdatasync(fd) != 0) {
+            error = ConvertWriteErrorCode(errno);
+        }
+        timings.syncMs = MillisecondsSince(syncStart);
+    }
+
+    if (close(fd) != 0 && error == NO_ERROR) {
+        error = ConvertWriteErrorCode(errno);
     }
     
     return error;
@@ -561,80 +963,36 @@ int SetPosixPermissions(ExtensionString filename, int32 mode)
     return NO_ERROR;
 }
 
-int _deleteFile(GFile *file)
+int DeleteFileOrDirectory(ExtensionString filename)
 {
-    int error = NO_ERROR;
-    GError *gerror = NULL;
-
-    if (!g_file_delete(file, NULL, &gerror)) {
-        error = GErrorToErrorCode(gerror);
-    }
-
-    return error;
+    return appshell_extensions::DeleteTree(filename);
 }
 
-int _doDeleteFileOrDirectory(GFile *file)
+int32 MoveFileOrDirectoryToTrash(ExtensionString filename)
 {
-    GFileEnumerator *enumerator;
-    GFileInfo *fileinfo;
     int error = NO_ERROR;
-    GFile *child;
-    
-    // deletes a file or an empty directory
-    error = _deleteFile(file);
-    if (error == ERR_NOT_FOUND || error == NO_ERROR) {
-        return error;
-    }
-    
-    enumerator = g_file_enumerate_children(file, "standard::*", G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS, NULL, NULL);
-
-    if (enumerator == NULL) {
-        error = ERR_UNKNOWN;
-    } else {
-        // recursively delete directory contents
-        while ((fileinfo = g_file_enumerator_next_file(enumerator, NULL, NULL)) != NULL) {
-            child = g_file_get_child(file, g_file_info_get_name(fileinfo));
-            error = _doDeleteFileOrDirectory(child);
-            g_object_unref(child);
-
-            if (error != NO_ERROR) {
-                break;
-            }
-        }
-
-        // directory is now empty, delete it
-        if (error == NO_ERROR) {
-            error = _deleteFile(file);
-        }
-
-        g_object_unref(enumerator);
+    GFile *file = g_file_new_for_path(filename.c_str());
+    GError *gerror = NULL;
+    if (!g_file_trash(file, NULL, &gerror)) {
+        error = ConvertGnomeErrorCode(gerror);
+        g_error_free(gerror);
     }
+    g_object_unref(file);
 
     return error;
 }
 
-int DeleteFileOrDirectory(ExtensionString filename)
+static void MoveFileOrDirectoryToTrashTask(ExtensionString filename, CefRefPtr<CefBrowser> browser, CefRefPtr<CefProcessMessage> response)
 {
-    GFile *file = g_file_new_for_path(filename.c_str());
-    int error = _doDeleteFileOrDirectory(file);
-    g_object_unref(file);
-
-    return error;
+    response->GetArgumentList()->SetInt(1, MoveFileOrDirectoryToTrash(filename));
+    appshell_extensions::SendResponse(browser, response);
 }
 
 void MoveFileOrDirectoryToTrash(ExtensionString filename, CefRefPtr<CefBrowser> browser, CefRefPtr<CefProcessMessage> response)
 {
-    int error = NO_ERROR;
-    GFile *file = g_file_new_for_path(filename.c_str());
-    GError *gerror = NULL;
-    if (!g_file_trash(file, NULL, &gerror)) {
-        error = ConvertGnomeErrorCode(gerror);
-        g_error_free(gerror);
-    }
-    g_object_unref(file);
-    
-    response->GetArgumentList()->SetInt(1, error);
-    browser->SendProcessMessage(PID_RENDERER, response);
+    // g_file_trash copies the whole tree when the trash is on another file
+    // system, so it must not run on the UI thread.
+    appshell::PostWorkerTask(filename, base::Bind(&MoveFileOrDirectoryToTrashTask, filename, browser, response));
 }
 
 void CloseWindow(CefRefPtr<CefBrowser> browser)
@@ -815,15 +1173,19 @@ int ConvertLinuxErrorCode(int errorCode, bool isReading)
     case ENOENT:
         return ERR_NOT_FOUND;
     case EACCES:
+    case EPERM:
         return isReading ? ERR_CANT_READ : ERR_CANT_WRITE;
     case ENOTDIR:
         return ERR_NOT_DIRECTORY;
-//    case ERROR_WRITE_PROTECT:
-//        return ERR_CANT_WRITE;
-//    case ERROR_HANDLE_DISK_FULL:
-//        return ERR_OUT_OF_SPACE;
-//    case ERROR_ALREADY_EXISTS:
-//        return ERR_FILE_EXISTS;
+    case EISDIR:
+        return ERR_NOT_FILE;
+    case EROFS:
+        return ERR_CANT_WRITE;
+    case ENOSPC:
+    case EDQUOT:
+        return ERR_OUT_OF_SPACE;
+    case EEXIST:
+        return ERR_FILE_EXISTS;
     default:
         return ERR_UNKNOWN;
     }
@@ -831,19 +1193,7 @@ int ConvertLinuxErrorCode(int errorCode, bool isReading)
 
 int32 CopyFile(ExtensionString src, ExtensionString dest)
 {
-    int error = NO_ERROR;
-    GFile *source = g_file_new_for_path(src.c_str());
-    GFile *destination = g_file_new_for_path(dest.c_str());
-    GError *gerror = NULL;
-
-    if (!g_file_copy(source, destination, (GFileCopyFlags)(G_FILE_COPY_OVERWRITE|G_FILE_COPY_NOFOLLOW_SYMLINKS|G_FILE_COPY_TARGET_DEFAULT_PERMS), NULL, NULL, NULL, &gerror)) {
-        error = ConvertGnomeErrorCode(gerror);
-        g_error_free(gerror);
-    }
-    g_object_unref(source);
-    g_object_unref(destination);
-
-    return error;    
+    return appshell_extensions::CopyFileOrSymlink(src, dest, false, NULL);
 }
 
 int32 GetPendingFilesToOpen(ExtensionString& files)
@@ -38,6 +38,7 @@
 
 #include <unistd.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netdb.h>
@@ -740,8 +741,7 @@ int32 ReadFile(ExtensionString filename, ExtensionString& encoding, std::string&
             std::string detectedCharSet;
             try {
                 if (encoding == "UTF-8") {
-                    CharSetDetect ICUDetector;
-                    ICUDetector(contents.c_str(), contents.size(), detectedCharSet);
+                    DetectCharSet(contents.c_str(), contents.size(), detectedCharSet);
                 }
                 else {
                     detectedCharSet = encoding;
@@ -767,10 +767,13 @@ int32 ReadFile(ExtensionString filename, ExtensionString& encoding, std::string&
     
     return error;}
 
-int32 WriteFile(ExtensionString filename, std::string contents, ExtensionString encoding, bool preserveBOM)
+int32 WriteFile(ExtensionString filename, const std::string& data, ExtensionString encoding, bool preserveBOM,
+                const WriteFileOptions& options, WriteFileTimings& timings)
 {
     const char *filenameStr = filename.c_str();
     int32 error = NO_ERROR;
+    std::string contents = data;
+    int64 startTime = appshell::GetMonotonicMicroseconds();
     if (encoding == "utf8") {
         encoding = "UTF-8";
     }
@@ -799,6 +802,21 @@ int32 WriteFile(ExtensionString filename, std::string contents, ExtensionString
     } catch (...) {
         return ERR_CANT_WRITE;
     }
+    timings.writeMs = (appshell::GetMonotonicMicroseconds() - startTime) / 1000.0;
+
+    if (options.sync && error == NO_ERROR) {
+        // fsync() only reaches the drive's cache on Mac; F_FULLFSYNC asks the
+        // drive to flush it too. Some file systems don't support it.
+        int64 syncStart = appshell::GetMonotonicMicroseconds();
+        int fd = open(filenameStr, O_WRONLY);
+        if (fd == -1 || (fcntl(fd, F_FULLFSYNC) == -1 && fsync(fd) == -1)) {
+            error = ERR_CANT_WRITE;
+        }
+        if (fd != -1) {
+            close(fd);
+        }
+        timings.syncMs = (appshell::GetMonotonicMicroseconds() - syncStart) / 1000.0;
+    }
     
     return error;
 }
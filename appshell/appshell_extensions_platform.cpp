@@ -2,6 +2,7 @@
 #include <unicode/ucsdet.h>
 #include <unicode/ucnv.h>
 #include <fstream>
+#include <string.h>
 
 #ifdef OS_LINUX
 #include "appshell/browser/main_context.h"
@@ -10,6 +11,12 @@
 #include <unicode/unistr.h>
 #endif
 
+#if defined(OS_WIN)
+#define APPSHELL_THREAD_LOCAL __declspec(thread)
+#else
+#define APPSHELL_THREAD_LOCAL __thread
+#endif
+
 #define UTF8_BOM "\xEF\xBB\xBF"
 
 CharSetDetect::CharSetDetect() {
@@ -50,6 +57,27 @@ void CharSetDetect::operator()(const char* bufferData, size_t bufferLength, std:
 	//int32_t detectionConfidence = ucsdet_getConfidence(charsetMatch_, &error);
 }
 
+void DetectCharSet(const char* bufferData, size_t bufferLength, std::string &detectedCharSet)
+{
+    TextClass textClass = ClassifyText(bufferData, bufferLength);
+    if (textClass == TEXT_ASCII || textClass == TEXT_UTF8) {
+        detectedCharSet = "UTF-8";
+        return;
+    }
+
+    // Binary buffers still go to ICU, since that is how UTF-16 without a BOM
+    // gets recognized (and reported as unsupported).
+
+    // Opening a detector loads ICU's recognizer tables, so each thread keeps
+    // one around. File i/o runs on a fixed set of threads that live as long as
+    // the app, so these are never freed.
+    static APPSHELL_THREAD_LOCAL CharSetDetect* threadDetector = NULL;
+    if (threadDetector == NULL) {
+        threadDetector = new CharSetDetect();
+    }
+    (*threadDetector)(bufferData, bufferLength, detectedCharSet);
+}
+
 CharSetEncode::CharSetEncode(std::string encoding) {
     m_status = U_ZERO_ERROR;
     m_conv = ucnv_open(encoding.c_str(), &m_status);
@@ -126,6 +154,64 @@ void CheckForUTF8BOM(const std::string& filename, bool& preserveBOM) {
 	}
 }
 
+#ifndef OS_LINUX
+// Generic ReadDirWithStats for platforms without a native one: ReadDir plus a
+// GetFileInfo per entry. Entries that vanish in between are left out.
+int32 ReadDirWithStats(ExtensionString path, CefRefPtr<CefListValue>& entries)
+{
+    CefRefPtr<CefListValue> names = CefListValue::Create();
+    int32 error = ReadDir(path, names);
+    if (error != NO_ERROR)
+        return error;
+
+#ifdef OS_WIN
+    ExtensionString prefix = path + L"/";
+#else
+    ExtensionString prefix = path + "/";
+#endif
+
+    size_t count = names->GetSize();
+    size_t index = 0;
+    entries->SetSize(count * READDIR_STATS_STRIDE);
+    for (size_t i = 0; i < count; i++) {
+        ExtensionString name = names->GetString(i);
+        ExtensionString realPath;
+        uint32 modtime;
+        double size;
+        bool isDir;
+        if (GetFileInfo(prefix + name, modtime, isDir, size, realPath) != NO_ERROR)
+            continue;
+
+        entries->SetString(index++, name);
+        entries->SetInt(index++, modtime);
+        entries->SetBool(index++, isDir);
+        entries->SetDouble(index++, size);
+        entries->SetString(index++, realPath);
+    }
+    entries->SetSize(index);
+
+    return NO_ERROR;
+}
+
+// Generic GetFileStats on top of GetFileInfo, with whole seconds only.
+int32 GetFileStats(const ExtensionString& path, FileStats& stats)
+{
+    ExtensionString realPath;
+    uint32 modtime;
+    double size;
+    bool isDir;
+    int32 error = GetFileInfo(path, modtime, isDir, size, realPath);
+    if (error != NO_ERROR)
+        return error;
+
+    stats.mtimeSec = modtime;
+    stats.mtimeNsec = 0;
+    stats.size = size;
+    stats.type = isDir ? FILE_TYPE_DIRECTORY : FILE_TYPE_FILE;
+    return NO_ERROR;
+}
+#endif
+
 #ifdef OS_LINUX
 // The following routine will get the containing GTK root window, for a browser.
 scoped_refptr<client::RootWindowGtk> getRootGtkWindow(CefRefPtr<CefBrowser> browser)
@@ -29,6 +29,7 @@
 #include <string>
 
 #include "config.h"
+#include "appshell_text.h"
 #include <unicode/ucsdet.h>
 
 #ifdef OS_LINUX
@@ -64,6 +65,8 @@ static const int ERR_ENCODE_FILE_FAILED = 18;
 static const int ERR_DECODE_FILE_FAILED = 19;
 static const int ERR_UNSUPPORTED_UTF16_ENCODING = 20;
 static const int ERR_UPDATE_ARGS_INIT_FAILED = 21;
+static const int ERR_CANCELLED = 22;
+static const int ERR_NOT_SUPPORTED = 23;
 
 static const int ERR_PID_NOT_FOUND = -9999; // negative int to avoid confusion with real PIDs
 
@@ -102,6 +105,11 @@ public:
 	void operator()(const char* bufferData, size_t bufferLength, std::string &detectedCharSet);
 };
 
+// Same contract as CharSetDetect, but answers "UTF-8" for ASCII and UTF-8
+// buffers without involving ICU, and reuses one detector per thread for the
+// rest. Throws on failure like CharSetDetect.
+void DetectCharSet(const char* bufferData, size_t bufferLength, std::string &detectedCharSet);
+
 class CharSetEncode
 {
     UErrorCode m_status;
@@ -126,6 +134,14 @@ private:
 };
 #endif
 
+#if defined(OS_LINUX)
+// Maps an errno value to one of the error codes above.
+int ConvertLinuxErrorCode(int errorCode, bool isReading = true);
+
+// Returns |path| with every symlink resolved, or "" if it can't be resolved.
+ExtensionString ResolveRealPath(const ExtensionString& path);
+#endif
+
 #if defined(OS_MACOSX) || defined(OS_LINUX)
 void DecodeContents(std::string &contents, const std::string& encoding);
 #endif
@@ -180,9 +196,65 @@ int32 Rename(ExtensionString oldName, ExtensionString newName);
 
 int32 GetFileInfo(ExtensionString filename, uint32& modtime, bool& isDir, double& size, ExtensionString& realPath);
 
+// Lists a directory and stats its entries in one go. Directories come first,
+// then files; anything else is skipped, like ReadDir. Entries are packed into
+// one flat list, READDIR_STATS_STRIDE values per entry:
+//   name (string), mtime (int, seconds), isDir (bool), size (double), realPath (string)
+// realPath is only set for symlinks and is empty otherwise.
+const int READDIR_STATS_STRIDE = 5;
+
+int32 ReadDirWithStats(ExtensionString path, CefRefPtr<CefListValue>& entries);
+
+// File types reported by GetFileStats. Must be in sync with appshell_extensions.js.
+enum FileType {
+    FILE_TYPE_NONE = 0,         // the stat failed
+    FILE_TYPE_FILE = 1,
+    FILE_TYPE_DIRECTORY = 2,
+    FILE_TYPE_OTHER = 3
+};
+
+struct FileStats {
+    FileStats() : mtimeSec(0), mtimeNsec(0), size(0), type(FILE_TYPE_NONE) {}
+
+    // Modification time; the nanoseconds are 0 where the platform doesn't
+    // have them.
+    int64 mtimeSec;
+    int32 mtimeNsec;
+    double size;
+    FileType type;
+};
+
+// Stats one path, following symlinks like GetFileInfo. Safe to call from
+// any thread.
+int32 GetFileStats(const ExtensionString& path, FileStats& stats);
+
 int32 ReadFile(ExtensionString filename, ExtensionString& encoding, std::string& contents, bool& hasBOM);
 
-int32 WriteFile(ExtensionString filename, std::string contents, ExtensionString encoding, bool preserveBOM);
+// How a file is saved by WriteFile. Platforms ignore the options they don't
+// support; only Linux does atomic saves so far.
+struct WriteFileOptions {
+    WriteFileOptions() : atomic(false), sync(false) {}
+
+    // Write to a temp file next to the target and rename it into place, so
+    // the target is never left half-written.
+    bool atomic;
+
+    // Flush the data to disk before returning.
+    bool sync;
+};
+
+// How long each phase of a WriteFile call took, in milliseconds. A phase the
+// platform doesn't perform separately stays 0.
+struct WriteFileTimings {
+    WriteFileTimings() : writeMs(0), syncMs(0), renameMs(0) {}
+
+    double writeMs;     // opening the file and writing the data
+    double syncMs;      // flushing the data to disk
+    double renameMs;    // moving the temp file into place (atomic saves)
+};
+
+int32 WriteFile(ExtensionString filename, const std::string& contents, ExtensionString encoding, bool preserveBOM,
+                const WriteFileOptions& options, WriteFileTimings& timings);
 
 int32 SetPosixPermissions(ExtensionString filename, int32 mode);
 
@@ -190,6 +262,11 @@ int32 DeleteFileOrDirectory(ExtensionString filename);
 
 void MoveFileOrDirectoryToTrash(ExtensionString filename, CefRefPtr<CefBrowser> browser, CefRefPtr<CefProcessMessage> response);
 
+#ifdef OS_LINUX
+// Moves |filename| to the trash before returning. Called on the worker pool.
+int32 MoveFileOrDirectoryToTrash(ExtensionString filename);
+#endif
+
 int32 CopyFile(ExtensionString src, ExtensionString dest);
 
 int32 getSystemDefaultApp(const ExtensionString& fileTypes, ExtensionString& fileTypesWithdefaultApp);
@@ -930,18 +930,15 @@ bool GetBufferAsUTF8(UTFValidationState& validationState)
         return false;
     }
 
-    // See if we can convert the data to UNICODE from UTF-8
-    //  if the data isn't UTF-8, this will fail and the result will be 0
-    int outBuffSize = (validationState.dataLen + 1) * 2;
-    wchar_t* outBuffer = new wchar_t[outBuffSize];
-    int result = MultiByteToWideChar(CP_UTF8, MB_ERR_INVALID_CHARS, validationState.data, validationState.dataLen, outBuffer, outBuffSize);
-    delete []outBuffer;
-
-    if ((result > 0) && hasBOM(validationState)) {
+    // Validate in place rather than converting to UNICODE just to see
+    //  whether MultiByteToWideChar() fails
+    bool result = IsValidUTF8(validationState.data, validationState.dataLen);
+
+    if (result && hasBOM(validationState)) {
         RemoveBOM(validationState);
     }
 
-    return (result > 0);
+    return result;
 }
 
 bool IsUTFLeadByte(char data)
@@ -1130,8 +1127,7 @@ int32 ReadFile(ExtensionString filename, ExtensionString& encoding, std::string&
                         std::string detectedCharSet;
                         try {
                             if (encoding == L"UTF-8") {
-                                CharSetDetect ICUDetector;
-                                ICUDetector(contents.c_str(), contents.size(), detectedCharSet);
+                                DetectCharSet(contents.c_str(), contents.size(), detectedCharSet);
                             }
                             else {
                                 std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> conv;
@@ -1220,8 +1216,11 @@ static void WideToCharSet(const std::wstring &aUTF16string, long codePage, std::
 
 
 
-int32 WriteFile(ExtensionString filename, std::string contents, ExtensionString encoding, bool preserveBOM)
+int32 WriteFile(ExtensionString filename, const std::string& data, ExtensionString encoding, bool preserveBOM,
+                const WriteFileOptions& options, WriteFileTimings& timings)
 {
+    std::string contents = data;
+    int64 startTime = appshell::GetMonotonicMicroseconds();
     if (encoding == L"utf8") {
         encoding = L"UTF-8";
     }
@@ -1256,6 +1255,15 @@ int32 WriteFile(ExtensionString filename, std::string contents, ExtensionString
     if (!WriteFile(hFile, contents.c_str(), contents.length(), &dwBytesWritten, NULL)) {
         error = ConvertWinErrorCode(GetLastError(), false);
     }
+    timings.writeMs = (appshell::GetMonotonicMicroseconds() - startTime) / 1000.0;
+
+    if (options.sync && error == NO_ERROR) {
+        int64 syncStart = appshell::GetMonotonicMicroseconds();
+        if (!FlushFileBuffers(hFile)) {
+            error = ConvertWinErrorCode(GetLastError(), false);
+        }
+        timings.syncMs = (appshell::GetMonotonicMicroseconds() - syncStart) / 1000.0;
+    }
 
     CloseHandle(hFile);
     return error;
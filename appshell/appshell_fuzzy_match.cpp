@@ -0,0 +1,504 @@
+/*
+ * Copyright (c) 2016 - present Adobe Systems Incorporated. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "appshell_fuzzy_match.h"
+
+#include "appshell_extensions.h"
+#include "appshell_worker_pool.h"
+
+#include "include/base/cef_bind.h"
+#include "include/base/cef_lock.h"
+#include "include/cef_task.h"
+#include "include/wrapper/cef_closure_task.h"
+
+#include <string.h>
+#include <algorithm>
+#include <map>
+#include <vector>
+
+namespace appshell_extensions {
+
+namespace {
+
+const int32 kDefaultLimit = 100;
+const int32 kMaxLimit = 1000;
+
+// Longer queries are rejected; nobody types that much into Quick Open.
+const size_t kMaxQueryLength = 256;
+
+// Fewer paths than this aren't worth another worker.
+const size_t kMinPathsPerTask = 8192;
+
+// Score for each matched character, and the bonuses and penalties on top.
+const int32 kMatchScore = 16;
+const int32 kSegmentStartBonus = 40;    // right after a slash
+const int32 kWordStartBonus = 30;       // after "_", "-", "." or a space
+const int32 kCamelCaseBonus = 24;
+const int32 kConsecutiveBonus = 20;
+const int32 kFileNameBonus = 12;        // in the last path segment
+const int32 kMaxGapPenalty = 15;
+
+inline char FoldChar(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+// Paths back to back in one buffer, plus a copy with ASCII folded to lower
+// case for matching. Immutable once built, so queries can share it.
+class PathArena : public CefBase {
+public:
+    explicit PathArena(CefRefPtr<CefListValue> paths)
+    {
+        size_t count = paths->GetSize();
+        offsets_.reserve(count + 1);
+        for (size_t i = 0; i < count; i++) {
+            offsets_.push_back((uint32)text_.length());
+            text_ += paths->GetString(i).ToString();
+        }
+        offsets_.push_back((uint32)text_.length());
+
+        folded_ = text_;
+        for (size_t i = 0; i < folded_.length(); i++) {
+            folded_[i] = FoldChar(folded_[i]);
+        }
+    }
+
+    size_t Count() const { return offsets_.size() - 1; }
+    const char* Path(size_t i) const { return text_.data() + offsets_[i]; }
+    const char* Folded(size_t i) const { return folded_.data() + offsets_[i]; }
+    size_t Length(size_t i) const { return offsets_[i + 1] - offsets_[i]; }
+
+private:
+    std::string text_;
+    std::string folded_;
+    std::vector<uint32> offsets_;
+
+    IMPLEMENT_REFCOUNTING(PathArena);
+};
+
+// The paths that matched a query, for narrowing down the next one.
+class CandidateSet : public CefBase {
+public:
+    CandidateSet(const std::string& query, std::vector<uint32>& indices)
+        : query_(query) {
+        indices_.swap(indices);
+    }
+
+    const std::string& Query() const { return query_; }
+    const std::vector<uint32>& Indices() const { return indices_; }
+
+private:
+    std::string query_;
+    std::vector<uint32> indices_;
+
+    IMPLEMENT_REFCOUNTING(CandidateSet);
+};
+
+struct FuzzyState {
+    CefRefPtr<PathArena> arena;
+    CefRefPtr<CandidateSet> candidates;
+};
+
+// By browser id. UI thread only.
+std::map<int, FuzzyState> g_fuzzyStates;
+
+struct ScoredPath {
+    ScoredPath(int32 score, uint32 length, uint32 index)
+        : score(score), length(length), index(index) {}
+
+    int32 score;
+    uint32 length;
+    uint32 index;
+};
+
+// Orders better matches first: higher scores, then shorter paths, then the
+// order the paths were given in.
+bool IsBetter(const ScoredPath& a, const ScoredPath& b)
+{
+    if (a.score != b.score) {
+        return a.score > b.score;
+    }
+    if (a.length != b.length) {
+        return a.length < b.length;
+    }
+    return a.index < b.index;
+}
+
+// Whether |query| is a subsequence of |folded| from |from| on. If so,
+// |positions| gets the tightest match that ends where the leftmost one does.
+// memchr does the scanning, so this mostly runs at vectorized speed.
+bool AlignQuery(const char* folded, size_t length, size_t from, const std::string& query, size_t* positions)
+{
+    size_t pos = from;
+    for (size_t i = 0; i < query.length(); i++) {
+        const void* hit = (pos < length) ? memchr(folded + pos, query[i], length - pos) : NULL;
+        if (hit == NULL) {
+            return false;
+        }
+        positions[i] = (const char*)hit - folded;
+        pos = positions[i] + 1;
+    }
+
+    // Walk back from the end, taking each character as late as possible.
+    if (!query.empty()) {
+        size_t p = positions[query.length() - 1];
+        for (size_t i = query.length(); i-- > 0;) {
+            while (folded[p] != query[i]) {
+                p--;
+            }
+            positions[i] = p--;
+        }
+    }
+    return true;
+}
+
+// Finds |query| as one run in |folded| from |from| on, or returns npos.
+size_t FindRun(const char* folded, size_t length, size_t from, const std::string& query)
+{
+    size_t count = query.length();
+    while (count && from + count <= length) {
+        const void* hit = memchr(folded + from, query[0], length - from - count + 1);
+        if (hit == NULL) {
+            break;
+        }
+        size_t start = (const char*)hit - folded;
+        if (!memcmp(folded + start + 1, query.data() + 1, count - 1)) {
+            return start;
+        }
+        from = start + 1;
+    }
+    return std::string::npos;
+}
+
+int32 ScorePositions(const char* path, size_t length, size_t fileNameStart, const size_t* positions,
+                     size_t count)
+{
+    int32 score = 0;
+    for (size_t i = 0; i < count; i++) {
+        size_t p = positions[i];
+        score += kMatchScore;
+
+        char previous = (p > 0) ? path[p - 1] : '/';
+        if (previous == '/' || previous == '\\') {
+            score += kSegmentStartBonus;
+        } else if (previous == '_' || previous == '-' || previous == '.' || previous == ' ') {
+            score += kWordStartBonus;
+        } else if (previous >= 'a' && previous <= 'z' && path[p] >= 'A' && path[p] <= 'Z') {
+            score += kCamelCaseBonus;
+        }
+
+        if (i > 0) {
+            size_t gap = p - positions[i - 1] - 1;
+            score += (gap == 0) ? kConsecutiveBonus : -(int32)std::min(gap, (size_t)kMaxGapPenalty);
+        }
+        if (p >= fileNameStart) {
+            score += kFileNameBonus;
+        }
+    }
+
+    // Shorter paths are more likely what was meant.
+    return score - (int32)(length / 16);
+}
+
+// Scores a path that is known to contain |query|. The query is tried
+// within the file name and across the whole path, both as a run and spread
+// out, and the best of those counts. |positions| gets its matched bytes.
+int32 ScorePath(const char* path, const char* folded, size_t length, const std::string& query,
+                std::vector<size_t>* positions)
+{
+    size_t fileNameStart = 0;
+    for (size_t i = length; i > 0; i--) {
+        if (path[i - 1] == '/' || path[i - 1] == '\\') {
+            fileNameStart = i;
+            break;
+        }
+    }
+
+    size_t count = query.length();
+    size_t candidate[kMaxQueryLength];
+    size_t best[kMaxQueryLength];
+    int32 bestScore = 0;
+    bool found = false;
+
+    const size_t starts[2] = { fileNameStart, 0 };
+    for (int start = 0; start < 2; start++) {
+        if (start == 1 && fileNameStart == 0) {
+            break;
+        }
+        size_t from = starts[start];
+
+        size_t runStart = FindRun(folded, length, from, query);
+        if (runStart != std::string::npos) {
+            for (size_t i = 0; i < count; i++) {
+                candidate[i] = runStart + i;
+            }
+            int32 score = ScorePositions(path, length, fileNameStart, candidate, count);
+            if (!found || score > bestScore) {
+                found = true;
+                bestScore = score;
+                std::copy(candidate, candidate + count, best);
+            }
+        }
+
+        if (AlignQuery(folded, length, from, query, candidate)) {
+            int32 score = ScorePositions(path, length, fileNameStart, candidate, count);
+            if (!found || score > bestScore) {
+                found = true;
+                bestScore = score;
+                std::copy(candidate, candidate + count, best);
+            }
+        }
+    }
+
+    if (positions) {
+        positions->assign(best, best + count);
+    }
+    return bestScore;
+}
+
+// Length in UTF-16 code units of the first |length| bytes of UTF-8 text.
+int32 UTF16Length(const char* text, size_t length)
+{
+    int32 units = 0;
+    for (size_t i = 0; i < length; i++) {
+        unsigned char c = text[i];
+        if ((c & 0xC0) != 0x80) {
+            units += (c >= 0xF0) ? 2 : 1;
+        }
+    }
+    return units;
+}
+
+class FuzzyMatchJob : public CefBase {
+public:
+    FuzzyMatchJob(CefRefPtr<CefBrowser> browser,
+                  CefRefPtr<CefProcessMessage> response,
+                  CefRefPtr<PathArena> arena,
+                  CefRefPtr<CandidateSet> previous,
+                  const std::string& query,
+                  size_t limit,
+                  int tasks)
+        : browser_(browser)
+        , response_(response)
+        , arena_(arena)
+        , previous_(previous)
+        , query_(query)
+        , limit_(limit)
+        , best_(tasks)
+        , matched_(tasks)
+        , remainingTasks_(tasks) {
+    }
+
+    // Called on a worker thread for each slice of the paths.
+    void Run(int task, size_t begin, size_t end);
+
+private:
+    void Respond();
+
+    CefRefPtr<CefBrowser> browser_;
+    CefRefPtr<CefProcessMessage> response_;
+    CefRefPtr<PathArena> arena_;
+    CefRefPtr<CandidateSet> previous_;
+    std::string query_;
+    size_t limit_;
+
+    // Each task fills its own slot, so only the counter needs the lock.
+    std::vector<std::vector<ScoredPath> > best_;
+    std::vector<std::vector<uint32> > matched_;
+
+    base::Lock lock_;
+    int remainingTasks_;
+
+    IMPLEMENT_REFCOUNTING(FuzzyMatchJob);
+};
+
+void MatchTask(CefRefPtr<FuzzyMatchJob> job, int task, size_t begin, size_t end)
+{
+    job->Run(task, begin, end);
+}
+
+void StoreCandidates(int browserId, CefRefPtr<PathArena> arena, CefRefPtr<CandidateSet> candidates)
+{
+    std::map<int, FuzzyState>::iterator it = g_fuzzyStates.find(browserId);
+    if (it != g_fuzzyStates.end() && it->second.arena.get() == arena.get()) {
+        it->second.candidates = candidates;
+    }
+}
+
+void FuzzyMatchJob::Run(int task, size_t begin, size_t end)
+{
+    const PathArena& arena = *arena_.get();
+    const std::vector<uint32>* indices = previous_.get() ? &previous_->Indices() : NULL;
+    std::vector<ScoredPath>& best = best_[task];
+    std::vector<uint32>& matched = matched_[task];
+    size_t positions[kMaxQueryLength];
+
+    for (size_t i = begin; i < end; i++) {
+        uint32 index = indices ? (*indices)[i] : (uint32)i;
+        const char* folded = arena.Folded(index);
+        size_t length = arena.Length(index);
+        if (!AlignQuery(folded, length, 0, query_, positions)) {
+            continue;
+        }
+        matched.push_back(index);
+
+        // A heap with the worst of the best on top.
+        ScoredPath scored(ScorePath(arena.Path(index), folded, length, query_, NULL), (uint32)length, index);
+        if (best.size() < limit_) {
+            best.push_back(scored);
+            std::push_heap(best.begin(), best.end(), IsBetter);
+        } else if (IsBetter(scored, best.front())) {
+            std::pop_heap(best.begin(), best.end(), IsBetter);
+            best.back() = scored;
+            std::push_heap(best.begin(), best.end(), IsBetter);
+        }
+    }
+
+    bool last;
+    {
+        base::AutoLock lock(lock_);
+        last = (--remainingTasks_ == 0);
+    }
+    if (last) {
+        Respond();
+    }
+}
+
+void FuzzyMatchJob::Respond()
+{
+    std::vector<ScoredPath> best;
+    std::vector<uint32> matched;
+    for (size_t i = 0; i < best_.size(); i++) {
+        best.insert(best.end(), best_[i].begin(), best_[i].end());
+        matched.insert(matched.end(), matched_[i].begin(), matched_[i].end());
+    }
+    std::sort(best.begin(), best.end(), IsBetter);
+    if (best.size() > limit_) {
+        best.erase(best.begin() + limit_, best.end());
+    }
+
+    CefRefPtr<CefListValue> results = CefListValue::Create();
+    std::vector<size_t> positions;
+    size_t resultIndex = 0;
+    for (size_t i = 0; i < best.size(); i++) {
+        uint32 index = best[i].index;
+        const char* path = arena_->Path(index);
+        size_t length = arena_->Length(index);
+        ScorePath(path, arena_->Folded(index), length, query_, &positions);
+
+        // Adjacent characters make one range.
+        CefRefPtr<CefListValue> ranges = CefListValue::Create();
+        size_t rangeIndex = 0;
+        for (size_t j = 0; j < positions.size();) {
+            size_t k = j + 1;
+            while (k < positions.size() && positions[k] == positions[k - 1] + 1) {
+                k++;
+            }
+            ranges->SetInt(rangeIndex++, UTF16Length(path, positions[j]));
+            ranges->SetInt(rangeIndex++, UTF16Length(path, positions[k - 1] + 1));
+            j = k;
+        }
+
+        results->SetString(resultIndex++, std::string(path, length));
+        results->SetInt(resultIndex++, best[i].score);
+        results->SetList(resultIndex++, ranges);
+    }
+
+    CefRefPtr<CefListValue> responseArgs = response_->GetArgumentList();
+    responseArgs->SetInt(1, NO_ERROR);
+    responseArgs->SetList(2, results);
+    SendResponse(browser_, response_);
+
+    CefRefPtr<CandidateSet> candidates = new CandidateSet(query_, matched);
+    CefPostTask(TID_UI, base::Bind(&StoreCandidates, browser_->GetIdentifier(), arena_, candidates));
+}
+
+}  // namespace
+
+void SetFuzzyMatchPaths(CefRefPtr<CefBrowser> browser, CefRefPtr<CefListValue> paths)
+{
+    FuzzyState& state = g_fuzzyStates[browser->GetIdentifier()];
+    state.arena = new PathArena(paths);
+    state.candidates = NULL;
+}
+
+void FuzzyMatch(CefRefPtr<CefBrowser> browser,
+                CefRefPtr<CefProcessMessage> response,
+                const std::string& query,
+                int32 limit)
+{
+    CefRefPtr<CefListValue> responseArgs = response->GetArgumentList();
+
+    // Spaces are for the reader; paths are matched without them.
+    std::string folded;
+    for (size_t i = 0; i < query.length(); i++) {
+        if (query[i] != ' ') {
+            folded += FoldChar(query[i]);
+        }
+    }
+    if (folded.length() > kMaxQueryLength) {
+        responseArgs->SetInt(1, ERR_INVALID_PARAMS);
+        SendResponse(browser, response);
+        return;
+    }
+
+    std::map<int, FuzzyState>::iterator it = g_fuzzyStates.find(browser->GetIdentifier());
+    if (it == g_fuzzyStates.end() || !it->second.arena.get()) {
+        // No paths yet, so nothing matches.
+        responseArgs->SetInt(1, NO_ERROR);
+        responseArgs->SetList(2, CefListValue::Create());
+        SendResponse(browser, response);
+        return;
+    }
+
+    // Whatever matches the new query also matched one it extends.
+    CefRefPtr<CandidateSet> previous = it->second.candidates;
+    if (previous.get() && folded.compare(0, previous->Query().length(), previous->Query()) != 0) {
+        previous = NULL;
+    }
+
+    size_t count = previous.get() ? previous->Indices().size() : it->second.arena->Count();
+    size_t tasks = (count + kMinPathsPerTask - 1) / kMinPathsPerTask;
+    tasks = std::max((size_t)1, std::min(tasks, (size_t)appshell::kWorkerPoolSize));
+    size_t perTask = (count + tasks - 1) / tasks;
+
+    limit = (limit <= 0) ? kDefaultLimit : std::min(limit, kMaxLimit);
+    CefRefPtr<FuzzyMatchJob> job = new FuzzyMatchJob(browser, response, it->second.arena, previous, folded,
+                                                     (size_t)limit, (int)tasks);
+    for (size_t i = 0; i < tasks; i++) {
+        size_t begin = std::min(i * perTask, count);
+        size_t end = std::min(begin + perTask, count);
+
+        // One key per slice, which spreads them over the workers.
+        std::string key = "\nfuzzy";
+        key += (char)('0' + i);
+        appshell::PostWorkerTask(ExtensionString(key.begin(), key.end()),
+                                 base::Bind(&MatchTask, job, (int)i, begin, end));
+    }
+}
+
+void ClearFuzzyMatchPaths(CefRefPtr<CefBrowser> browser)
+{
+    g_fuzzyStates.erase(browser->GetIdentifier());
+}
+
+}  // namespace appshell_extensions
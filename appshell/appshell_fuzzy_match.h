@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2016 - present Adobe Systems Incorporated. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "include/cef_browser.h"
+#include "include/cef_process_message.h"
+
+#include "appshell_extensions_platform.h"
+
+#include <string>
+
+namespace appshell_extensions {
+
+// Fuzzy file name matching for Quick Open.
+//
+// Each window hands over its project's paths once, with SetFuzzyMatchPaths().
+// They are kept in one buffer, so a query is a scan over contiguous memory
+// rather than a walk over 100k strings. A query's characters must all occur
+// in a path, in order and ignoring ASCII case; matching paths are scored,
+// favoring matches in the file name, at the start of words and in runs, and
+// only the best are sent back.
+//
+// A query that extends the previous one only rescans the paths that matched
+// that one.
+//
+// All functions must be called on the UI thread.
+
+static const int FUZZY_MATCH_STRIDE = 3;
+
+// Replaces the paths matched for |browser|. |paths| must only hold strings.
+void SetFuzzyMatchPaths(CefRefPtr<CefBrowser> browser, CefRefPtr<CefListValue> paths);
+
+// Scores the paths of |browser| against |query| on the worker pool. |response|
+// already holds the callback id, and gets the error code and a flat list of
+// FUZZY_MATCH_STRIDE values per match, best first: the path, its score and a
+// list of the matched ranges, as start and end offsets in UTF-16 code units.
+// At most |limit| matches are sent.
+void FuzzyMatch(CefRefPtr<CefBrowser> browser,
+                CefRefPtr<CefProcessMessage> response,
+                const std::string& query,
+                int32 limit);
+
+// Drops the paths of a browser that is going away.
+void ClearFuzzyMatchPaths(CefRefPtr<CefBrowser> browser);
+
+}  // namespace appshell_extensions
@@ -32,6 +32,10 @@
 namespace appshell {
 
 double GetElapsedMilliseconds();
+
+// Returns a monotonic timestamp in microseconds. Only differences between
+// two values are meaningful; use it to time native operations.
+int64 GetMonotonicMicroseconds();
 CefString GetCurrentLanguage();
 std::string GetExtensionJSSource();
 CefString AppGetSupportDirectory();
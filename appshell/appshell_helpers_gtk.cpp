@@ -36,6 +36,7 @@
 //#include <ShlObj.h>
 #include <glib.h>
 #include <sys/stat.h>
+#include <time.h>
 
 extern time_t g_appStartupTime;
 extern char _binary_appshell_appshell_extensions_js_start;
@@ -89,6 +90,13 @@ double GetElapsedMilliseconds()
     return (time(NULL) - g_appStartupTime);
 }
 
+int64 GetMonotonicMicroseconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
 CefString AppGetSupportDirectory()
 {
     gchar *supportDir = g_strdup_printf("%s/%s", g_get_user_config_dir(), APP_NAME);
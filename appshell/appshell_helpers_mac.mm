@@ -27,6 +27,7 @@
 #include "include/cef_version.h"
 #include "config.h"
 #include <Cocoa/Cocoa.h>
+#include <mach/mach_time.h>
 
 extern CFTimeInterval g_appStartupTime;
 
@@ -39,6 +40,16 @@ double GetElapsedMilliseconds()
     return round(elapsed * 1000);
 }
 
+int64 GetMonotonicMicroseconds()
+{
+    static mach_timebase_info_data_t timebase = { 0, 0 };
+    if (timebase.denom == 0) {
+        mach_timebase_info(&timebase);
+    }
+
+    return (int64)(mach_absolute_time() * timebase.numer / timebase.denom / 1000);
+}
+
 CefString GetCurrentLanguage()
 {
     // Do not confuse preferredLanguages with currentLocale.
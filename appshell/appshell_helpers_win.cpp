@@ -93,6 +93,19 @@ double GetElapsedMilliseconds()
     return (timeGetTime() - g_appStartupTime);
 }
 
+int64 GetMonotonicMicroseconds()
+{
+    static LARGE_INTEGER frequency = { 0 };
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return (int64)(now.QuadPart / frequency.QuadPart) * 1000000 +
+           (int64)(now.QuadPart % frequency.QuadPart) * 1000000 / frequency.QuadPart;
+}
+
 CefString AppGetSupportDirectory()
 {
     wchar_t dataPath[MAX_UNC_PATH];
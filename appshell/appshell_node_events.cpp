@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2016 - present Adobe Systems Incorporated. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "appshell_node_events.h"
+
+#include "appshell_extensions.h"
+#include "appshell_node_process.h"
+
+#include "include/base/cef_bind.h"
+#include "include/cef_task.h"
+#include "include/wrapper/cef_closure_task.h"
+
+#include <map>
+
+namespace appshell_extensions {
+
+namespace {
+
+struct NodeStateListener {
+    CefRefPtr<CefBrowser> browser;
+    int32 callbackId;
+};
+
+std::map<int, NodeStateListener> g_nodeStateListeners;
+
+bool g_listeningToNode = false;
+
+void SendNodeState(const NodeStateListener& listener, int state)
+{
+    // Progress callbacks get null in place of the error code, like the
+    // streaming calls.
+    CefRefPtr<CefProcessMessage> message = CefProcessMessage::Create("invokeProgressCallback");
+    CefRefPtr<CefListValue> messageArgs = message->GetArgumentList();
+    messageArgs->SetInt(0, listener.callbackId);
+    messageArgs->SetNull(1);
+    messageArgs->SetInt(2, state);
+    SendResponse(listener.browser, message);
+}
+
+void BroadcastNodeState(int state)
+{
+    std::map<int, NodeStateListener>::const_iterator it;
+    for (it = g_nodeStateListeners.begin(); it != g_nodeStateListeners.end(); ++it) {
+        SendNodeState(it->second, state);
+    }
+}
+
+// Called by the node process code, on whichever thread saw the change.
+void OnNodeStateChanged(int state)
+{
+    CefPostTask(TID_UI, base::Bind(&BroadcastNodeState, state));
+}
+
+}  // namespace
+
+void AddNodeStateListener(CefRefPtr<CefBrowser> browser,
+                          CefRefPtr<CefProcessMessage> response)
+{
+    if (!g_listeningToNode) {
+        setNodeStateListener(&OnNodeStateChanged);
+        g_listeningToNode = true;
+    }
+
+    NodeStateListener listener;
+    listener.browser = browser;
+    listener.callbackId = response->GetArgumentList()->GetInt(0);
+    g_nodeStateListeners[browser->GetIdentifier()] = listener;
+
+    SendNodeState(listener, getNodeState());
+}
+
+void RemoveNodeStateListener(CefRefPtr<CefBrowser> browser)
+{
+    g_nodeStateListeners.erase(browser->GetIdentifier());
+}
+
+}  // namespace appshell_extensions
@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2016 - present Adobe Systems Incorporated. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "include/cef_browser.h"
+#include "include/cef_process_message.h"
+
+namespace appshell_extensions {
+
+// Pushes the state of the Node process to the renderer, for
+// appshell.app.onNodeStateChanged(), so nothing has to poll GetNodeState.
+//
+// Each browser registers one listener, whose callback gets an
+// "invokeProgressCallback" message with the state (the port, or a
+// BRACKETS_NODE_* error code) every time it changes, and once right away.
+// The final "invokeCallback" is never sent, so the callback stays registered
+// for the life of the page.
+//
+// All functions must be called on the UI thread.
+
+// Registers the callback in |response| to hear about |browser|'s state
+// changes, replacing any earlier one.
+void AddNodeStateListener(CefRefPtr<CefBrowser> browser,
+                          CefRefPtr<CefProcessMessage> response);
+
+// Drops the listener of a browser that is going away.
+void RemoveNodeStateListener(CefRefPtr<CefBrowser> browser);
+
+}  // namespace appshell_extensions
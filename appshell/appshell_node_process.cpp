@@ -23,49 +23,134 @@
 
 #include "appshell_node_process.h"
 #include "appshell_node_process_internal.h"
+#include "appshell_helpers.h"
+
+#include "include/base/cef_lock.h"
 
 #include <sstream>
 #include <vector>
 #include <cstdio>
+#include <algorithm>
+#include <cstring>
+
+// Data from the node process is read straight into this buffer and parsed
+// where it lies. Only the read thread touches it. Complete commands are
+// consumed from the front; when the end is reached, the one partial command
+// left over is moved back to the start. A command that doesn't fit in the
+// buffer at all is dropped.
+static const size_t COMMAND_BUFFER_SIZE = 64 * 1024;
+static char commandBuffer[COMMAND_BUFFER_SIZE];
+
+// Start of the first command not parsed yet, and end of the data read.
+static size_t commandStart = 0;
+static size_t commandEnd = 0;
+
+// In the text protocol, where to continue looking for a separator.
+static size_t separatorSearchStart = 0;
+
+// In the framed protocol, bytes of an oversized frame still to be skipped.
+static size_t bytesToSkip = 0;
+
+// Whether Node has switched to the framed protocol.
+static bool framed = false;
+
+static const size_t FRAME_HEADER_SIZE = 4;
 
-static std::string buffer("");
 static int commandCount = 0;
 
+// Counters for the "benchmarkStart"/"benchmarkEnd" commands.
+static int benchmarkCommands = 0;
+static size_t benchmarkBytes = 0;
+
+// Startup timing of the current Node process. Written from the platform's node
+// thread and the read thread, read from the UI thread.
+static base::Lock statsLock;
+static int64 nodeStartingTime = 0;
+static double startupMilliseconds = -1;
+static int restartCount = 0;
+static int64 restartTime = 0;
+static double lastFailoverMilliseconds = -1;
+
+// Listener for state changes, and the last state it was told about.
+static base::Lock listenerLock;
+static NodeStateListener nodeStateListener = NULL;
+static int notifiedNodeState = BRACKETS_NODE_NOT_YET_STARTED;
+
+// Whether field |index| of a parsed command is |value|.
+static bool fieldEquals(const std::vector<std::pair<const char*, size_t> >& fields, size_t index, const char* value) {
+    size_t length = strlen(value);
+    return index < fields.size() && fields[index].second == length &&
+        memcmp(fields[index].first, value, length) == 0;
+}
+
 // Processes a single command from the node process. May call
 // platform-specific functions in order to do this. Any platform-specific
 // functions must be declared in a file used on all platforms and then
 // implemented on all platforms. Because this is not the main communication
-// channel with the client, the protocol is left very simple. Individual
-// messages are separated by two newlines. Arguments in a message are
-// separated by "|" characters. The first argument is the command name, and
-// the remaining arguments are dependent on the command.
+// channel with the client, the protocol is left very simple. Arguments in a
+// message are separated by "|" characters. The first argument is a message
+// id, the second the command name, and the remaining arguments are dependent
+// on the command.
+//
+// Messages start out separated by two newlines. If the node process was
+// offered the framed protocol (BRACKETS_NODE_FRAMING_ENV) and takes it up, it
+// sends a "framing" command and from then on prefixes every message with its
+// length as a 4-byte big-endian number instead.
 //
 // The number of total commands is expected to be very small. Right now,
-// the only commands are "ping" (a keep-alive command) and "port", which
-// records the port number that the node websocket server is currently using.
-void processCommand (const std::string &command) {
-    std::vector<std::string> args;
-    std::size_t start, end;
+// the commands are "ping" (a rare keep-alive command), "port", which records the
+// port number that the node websocket server is currently using, "framing"
+// and the "benchmarkStart"/"benchmarkEnd" pair around a burst of commands
+// that measures the throughput of this channel.
+static void processCommand(const char* command, size_t length) {
+    std::vector<std::pair<const char*, size_t> > fields;
     std::ostringstream responseStream("");
     std::string response("");
     
+    benchmarkCommands++;
+    benchmarkBytes += length;
+
     // parse arguments
-    start = 0;
-    end = command.find("|", start);
-    while (end != std::string::npos) {
-        args.push_back(command.substr(start, end-start));
-        start = end + 1;
-        end = command.find("|", start);
+    const char* end = command + length;
+    const char* start = command;
+    for (;;) {
+        const char* separator = (const char*)memchr(start, '|', end - start);
+        if (separator == NULL) {
+            fields.push_back(std::make_pair(start, (size_t)(end - start)));
+            break;
+        }
+        fields.push_back(std::make_pair(start, (size_t)(separator - start)));
+        start = separator + 1;
     }
-    args.push_back(command.substr(start));
     
-    if (args.size() > 1) {
-        if (args[1] == "ping") {
-            responseStream << "\n\n" << (commandCount++) << "|pong|" << args[0] << "\n\n";
-        } else if (args[1] == "port" && args.size() > 2) {
+    if (fields.size() > 1) {
+        std::string id(fields[0].first, fields[0].second);
+        if (fieldEquals(fields, 1, "ping")) {
+            responseStream << "\n\n" << (commandCount++) << "|pong|" << id << "\n\n";
+        } else if (fieldEquals(fields, 1, "port") && fields.size() > 2) {
             int port = 0;
-            std::istringstream(args[2]) >> port;
+            std::istringstream(std::string(fields[2].first, fields[2].second)) >> port;
             setNodeState(port);
+            
+            base::AutoLock lock(statsLock);
+            int64 now = appshell::GetMonotonicMicroseconds();
+            if (startupMilliseconds < 0 && nodeStartingTime != 0) {
+                startupMilliseconds = (now - nodeStartingTime) / 1000.0;
+            }
+            if (restartTime != 0) {
+                lastFailoverMilliseconds = (now - restartTime) / 1000.0;
+                restartTime = 0;
+            }
+        } else if (fieldEquals(fields, 1, "framing") && fieldEquals(fields, 2, "1")) {
+            framed = true;
+        } else if (fieldEquals(fields, 1, "benchmarkStart")) {
+            benchmarkCommands = 0;
+            benchmarkBytes = 0;
+        } else if (fieldEquals(fields, 1, "benchmarkEnd") && fields.size() > 2) {
+            // Tells Node how much arrived, not counting the end command.
+            std::string benchmarkId(fields[2].first, fields[2].second);
+            responseStream << "\n\n" << (commandCount++) << "|benchmarkEnd|" << benchmarkId << "|"
+                << (benchmarkCommands - 1) << "|" << (benchmarkBytes - length) << "\n\n";
         }
     }
     
@@ -76,40 +161,163 @@ void processCommand (const std::string &command) {
     
 }
 
-// Called any time the command buffer is modified. Parses the entire buffer,
-// removing any full commands. Calls processCommand on each full command.
-void parseCommandBuffer() {
-    std::size_t i;
-    std::string command("");
-    
-    i = buffer.find("\n\n");
-    while (i != std::string::npos) {
-        if (i > 0) {
-            // every command is prefixed *and* suffixed with "\n\n", so half the time
-            // we'll get an empty "command"
-            command = buffer.substr(0, i);
-            processCommand(command);
+// Called any time data has been added to the command buffer. Calls
+// processCommand on each full command and moves past it.
+static void parseCommandBuffer() {
+    for (;;) {
+        if (bytesToSkip > 0) {
+            size_t skipped = std::min(bytesToSkip, commandEnd - commandStart);
+            commandStart += skipped;
+            bytesToSkip -= skipped;
+            if (bytesToSkip > 0) {
+                break;
+            }
         }
-        
-        // Always erase up to and including the newlines we found, even if it was an
-        // empty command.
-        buffer.erase(0, i+2);
-        
-        // Find again
-        i = buffer.find("\n\n");
+
+        const char* data = commandBuffer + commandStart;
+        size_t length = commandEnd - commandStart;
+
+        if (framed) {
+            if (length < FRAME_HEADER_SIZE) {
+                break;
+            }
+            const unsigned char* header = (const unsigned char*)data;
+            size_t frameLength = ((size_t)header[0] << 24) | ((size_t)header[1] << 16) |
+                                 ((size_t)header[2] << 8) | (size_t)header[3];
+            if (frameLength > COMMAND_BUFFER_SIZE - FRAME_HEADER_SIZE) {
+                fprintf(stderr, "Dropping a %lu byte command from node, which doesn't fit the buffer.\n",
+                        (unsigned long)frameLength);
+                commandStart += FRAME_HEADER_SIZE;
+                bytesToSkip = frameLength;
+                continue;
+            }
+            if (length < FRAME_HEADER_SIZE + frameLength) {
+                break;
+            }
+            commandStart += FRAME_HEADER_SIZE + frameLength;
+            processCommand(data + FRAME_HEADER_SIZE, frameLength);
+        } else {
+            // Every command is prefixed *and* suffixed with "\n\n", so half the
+            // time there's an empty "command" between two separators.
+            size_t i = std::max(separatorSearchStart, commandStart);
+            const char* separator = NULL;
+            while (i + 1 < commandEnd) {
+                const char* newline = (const char*)memchr(commandBuffer + i, '\n', commandEnd - i - 1);
+                if (newline == NULL) {
+                    break;
+                }
+                if (newline[1] == '\n') {
+                    separator = newline;
+                    break;
+                }
+                i = newline - commandBuffer + 1;
+            }
+            if (separator == NULL) {
+                // The last byte might be the first half of a separator.
+                separatorSearchStart = (commandEnd > commandStart) ? commandEnd - 1 : commandStart;
+                break;
+            }
+            commandStart = separator - commandBuffer + 2;
+            separatorSearchStart = commandStart;
+            if (separator > data) {
+                processCommand(data, separator - data);
+            }
+        }
+    }
+
+    if (commandStart == commandEnd) {
+        commandStart = commandEnd = separatorSearchStart = 0;
     }
 }
 
-// Adds incoming data to the command buffer and then initiates parsing.
-void processIncomingData(const std::string &data) {
-    if (buffer.max_size() < buffer.size() + data.size()) {
-        // If we don't have room to store this data, that means that we have a
-        // buffer that has 4 GB of data without any command separators.
-        // This indicates that we don't have a command in the buffer, so we can just
-        // throw it all out and start over. (This shouldn't ever happen.)
-        fprintf(stderr, "Buffer for node stdout exceeded max size (4GB), clearing buffer.");
-        buffer = "";
+char* getIncomingDataBuffer(size_t& available) {
+    if (commandEnd == COMMAND_BUFFER_SIZE) {
+        if (commandStart > 0) {
+            // Make room after the partial command.
+            size_t length = commandEnd - commandStart;
+            memmove(commandBuffer, commandBuffer + commandStart, length);
+            separatorSearchStart -= std::min(separatorSearchStart, commandStart);
+            commandStart = 0;
+            commandEnd = length;
+        } else {
+            // The buffer holds a single unfinished text command, so it can't
+            // be a command. Throw it all out and start over. (This shouldn't
+            // ever happen.)
+            fprintf(stderr, "Buffer for node stdout is full without a command separator, clearing buffer.\n");
+            commandStart = commandEnd = separatorSearchStart = 0;
+        }
     }
-    buffer += data;
+    available = COMMAND_BUFFER_SIZE - commandEnd;
+    return commandBuffer + commandEnd;
+}
+
+void processIncomingBytes(size_t length) {
+    commandEnd += length;
     parseCommandBuffer();
 }
+
+// Copies the data into the command buffer, a piece at a time if needed.
+void processIncomingData(const std::string &data) {
+    size_t offset = 0;
+    while (offset < data.size()) {
+        size_t available;
+        char* buffer = getIncomingDataBuffer(available);
+        size_t length = std::min(available, data.size() - offset);
+        memcpy(buffer, data.data() + offset, length);
+        offset += length;
+        processIncomingBytes(length);
+    }
+}
+
+void resetIncomingData() {
+    commandStart = commandEnd = separatorSearchStart = 0;
+    bytesToSkip = 0;
+    framed = false;
+}
+
+void recordNodeStarting() {
+    base::AutoLock lock(statsLock);
+    nodeStartingTime = appshell::GetMonotonicMicroseconds();
+    startupMilliseconds = -1;
+}
+
+void setNodeStateListener(NodeStateListener listener) {
+    base::AutoLock lock(listenerLock);
+    nodeStateListener = listener;
+}
+
+void notifyNodeStateChanged(int state) {
+    NodeStateListener listener;
+    {
+        base::AutoLock lock(listenerLock);
+        if (state == notifiedNodeState) {
+            return;
+        }
+        notifiedNodeState = state;
+        listener = nodeStateListener;
+    }
+    if (listener) {
+        listener(state);
+    }
+}
+
+void recordNodeRestarting() {
+    base::AutoLock lock(statsLock);
+    restartCount++;
+    restartTime = appshell::GetMonotonicMicroseconds();
+}
+
+NodeProcessStats getNodeProcessStats() {
+    NodeProcessStats stats;
+    {
+        base::AutoLock lock(statsLock);
+        stats.startupMilliseconds = startupMilliseconds;
+        stats.restartCount = restartCount;
+        stats.lastFailoverMilliseconds = lastFailoverMilliseconds;
+    }
+    if (!getProcessWakeups(stats.shellWakeups, stats.nodeWakeups)) {
+        stats.shellWakeups = -1;
+        stats.nodeWakeups = -1;
+    }
+    return stats;
+}
@@ -32,6 +32,14 @@ static const int BRACKETS_NODE_FAILED           = -3;
 // For auto restart, if node ran for less than 5 seconds, do NOT do a restart
 static const int BRACKETS_NODE_AUTO_RESTART_TIMEOUT = 5; // seconds
 
+// Where the restart is done with backoff (Linux), how many quicker exits in a
+// row are retried before giving up. The waits double from 1 second.
+static const int BRACKETS_NODE_MAX_QUICK_RESTARTS = 5;
+
+// Whether to keep a second Node process loaded and waiting (Linux), so that a
+// restart doesn't pay for Node's startup. Costs the memory of an idle Node.
+static const bool BRACKETS_NODE_KEEP_STANDBY = true;
+
 // Public interface for interacting with node process. All of these functions below
 // must be implemented in a thread-safe manner if calls to the *public* API happen
 // from a different thread than that which processes data coming in from the Node
@@ -45,3 +53,33 @@ void startNodeProcess();
 // that the Node server is listening on.
 int getNodeState();
 
+// Called with the new state whenever the state from getNodeState changes, on
+// whichever thread changed it.
+typedef void (*NodeStateListener)(int state);
+
+// Sets the function to call when the state changes, or NULL for none.
+void setNodeStateListener(NodeStateListener listener);
+
+
+// Diagnostics for the Node process.
+struct NodeProcessStats {
+    // Milliseconds from starting the current Node process until it reported the
+    // port it listens on, or -1 if it hasn't yet.
+    double startupMilliseconds;
+    
+    // How many times the Node process has been restarted.
+    int restartCount;
+    
+    // Milliseconds from the last restart until the new process reported its
+    // port, or -1 if there hasn't been one.
+    double lastFailoverMilliseconds;
+    
+    // How many times the shell and the Node process have woken up so far, or
+    // -1 where that isn't known. Sampled twice while the app is idle, these
+    // give the idle wakeup rate.
+    long long shellWakeups;
+    long long nodeWakeups;
+};
+
+// Gets the diagnostics for the Node process.
+NodeProcessStats getNodeProcessStats();
@@ -23,6 +23,7 @@
 
 #pragma once
 
+#include <stddef.h>
 #include <string>
 
 // This file declares "internal" functions that exist on both plantforms for
@@ -36,6 +37,41 @@
 // platform-specific functions below).
 void processIncomingData(const std::string &data);
 
+// Returns where the next data read from Node should go and how many bytes fit
+// there. Incoming data is parsed where it lies, so readers that can read
+// straight into this buffer should, and then call processIncomingBytes.
+char* getIncomingDataBuffer(size_t& available);
+
+// Parses |length| bytes just read into the buffer from getIncomingDataBuffer.
+void processIncomingBytes(size_t length);
+
+// Drops any partial command and goes back to the text protocol. Called before
+// reading from a new Node process.
+void resetIncomingData();
+
+// Records that a new Node process is about to be started, for the startup
+// time in getNodeProcessStats. Called by the platform code right before it
+// creates the process.
+void recordNodeStarting();
+
+// Tells the listener from setNodeStateListener about the state, unless it
+// already knows. Called by the platform code whenever it changes the state,
+// after releasing any locks.
+void notifyNodeStateChanged(int state);
+
+// Records that the Node process exited and is being replaced, for the
+// restart count and failover time in getNodeProcessStats.
+void recordNodeRestarting();
+
+// Environment variable that offers the node process the framed protocol for
+// its stdout. See processCommand in appshell_node_process.cpp.
+#define BRACKETS_NODE_FRAMING_ENV "BRACKETS_NODE_FRAMING"
+
+// Environment variable that asks the node process to load node-core and then
+// wait for a blank command on stdin before starting its server. See
+// Launcher.js.
+#define BRACKETS_NODE_STANDBY_ENV "BRACKETS_NODE_STANDBY"
+
 // Platform-specific functions that must be be present on all platforms.
 // All of these functions below must be implemented in
 // a thread-safe manner if calls to the *public* API (defined in
@@ -48,3 +84,8 @@ void sendData(const std::string &data);
 
 // Sets the state of the current Node process.
 void setNodeState(int state);
+
+// Gets how many times the shell process and the current Node process have
+// woken up since they started, for getNodeProcessStats. Returns false where
+// the platform doesn't count wakeups, or if there is no Node process.
+bool getProcessWakeups(long long& shellWakeups, long long& nodeWakeups);
@@ -23,6 +23,7 @@
 
 #include "appshell_node_process.h"
 #include "appshell_node_process_internal.h"
+#include "appshell_helpers.h"
 
 #include <pthread.h>
 #include <stdio.h>
@@ -31,160 +32,425 @@
 #include <string.h>
 #include <stdlib.h>
 #include <sys/wait.h>
+#include <sys/syscall.h>
+#include <sys/prctl.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
 
+#include <vector>
 
 #include "config.h"
 
-#define BRACKETS_NODE_BUFFER_SIZE 4096
-#define MAX_PATH 128
+extern char** environ;
 
 // init mutex
 pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
 
-// write & read references to subprocess
-FILE* streamTo;
-FILE* streamFrom;
+// write end of the pipe to the active subprocess, and its pid
+int fdTo = -1;
+static pid_t nodePid = -1;
 
 // Threads should hold mutex before using these
 static int nodeState = BRACKETS_NODE_NOT_YET_STARTED;
-static int nodeStartTime = 0;
+static bool nodeThreadStarted = false;
+
+// A Node process and our ends of its stdin/stdout pipes.
+struct NodeChild {
+    pid_t pid;
+    int fdTo;
+    int fdFrom;
+};
+
+// The standby process, if there is one, and whether starting it failed for
+// the current active process. Only the node thread uses these.
+static NodeChild standby = { -1, -1, -1 };
+static bool standbyFailed = false;
+
+// Written to a Node process to make it start its server. See Launcher.js.
+static const char NODE_ACTIVATE_COMMAND[] = "\n\n";
 
 // Forward declarations
 void* nodeThread(void*);
-void* nodeReadThread(void*);
 void restartNode(bool);
 
-// Creates the thread that starts Node and then monitors the state
-// of the node process.
-void startNodeProcess() {
+// Returns the directory holding the Brackets executable, with a trailing
+// slash, or an empty string if it can't be found.
+static std::string getExecutableDirectory() {
     
-    pthread_t thread_id;
-    if (pthread_create(&thread_id, NULL, &nodeThread, NULL) != 0)
-        nodeState = BRACKETS_NODE_FAILED;
+    // readlink doesn't tell us how long the target is, so retry with a larger
+    // buffer until it fits
+    std::vector<char> buffer(256);
+    for (;;) {
+        ssize_t length = readlink("/proc/self/exe", &buffer[0], buffer.size());
+        if (length == -1) {
+            return std::string();
+        }
+        if ((size_t)length < buffer.size()) {
+            std::string executablePath(&buffer[0], length);
+            
+            // strip off trailing executable name
+            return executablePath.substr(0, executablePath.rfind('/') + 1);
+        }
+        buffer.resize(buffer.size() * 2);
+    }
 }
 
+// Writes all of |data| to |fd|. Returns false if the write fails.
+static bool writeAll(int fd, const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fd, data, length);
+        if (written == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        length -= written;
+    }
+    return true;
+}
 
-// Thread function for the thread that starts the node process
-// and monitors that process's state
-void* nodeThread(void* unused) {
+// Makes |fd| the child's |target| descriptor. dup2 clears close-on-exec on
+// the copy, but does nothing when the two are the same.
+static bool moveDescriptor(int fd, int target) {
+    if (fd == target) {
+        return fcntl(target, F_SETFD, 0) != -1;
+    }
+    return dup2(fd, target) != -1;
+}
+
+// Runs in the child between vfork and exec. It shares our memory, so it only
+// makes system calls, and reports a failure by setting |execError|. Never
+// returns.
+static void execNode(char* const argv[], char* const envp[], int stdinFd, int stdoutFd,
+                     pid_t parentPid, volatile int* execError) {
     
-    // get mutex
-    if (pthread_mutex_lock(&mutex)) {
-        fprintf(stderr, 
-                "failed to acquire mutex for Node subprocess start: %s\n",
-                strerror(errno));
-        return NULL;
-    }        
+    // Have the kernel send SIGTERM when the thread that started the child, the
+    // node thread, goes away. It never exits on its own, so this means the
+    // browser process died, and Node goes with it even if its event loop is
+    // too busy to see stdin close. If we already died, don't start at all.
+    if (prctl(PR_SET_PDEATHSIG, SIGTERM) == -1) {
+        *execError = errno;
+        _exit(127);
+    }
+    if (getppid() != parentPid) {
+        *execError = ESRCH;
+        _exit(127);
+    }
     
-    // TODO nodeStartTime = get time();
+    if (!moveDescriptor(stdinFd, STDIN_FILENO) || !moveDescriptor(stdoutFd, STDOUT_FILENO)) {
+        *execError = errno;
+        _exit(127);
+    }
     
-    char executablePath[MAX_PATH];
-    char bracketsDirPath[MAX_PATH];
-    char nodeExecutablePath[MAX_PATH];
-    char nodecorePath[MAX_PATH];
+    // don't pass on our signal handlers, SIGPIPE being ignored, or our
+    // signal mask
+    for (int signalNumber = 1; signalNumber < NSIG; signalNumber++) {
+        struct sigaction action;
+        if (sigaction(signalNumber, NULL, &action) == 0 &&
+            (action.sa_handler != SIG_IGN || signalNumber == SIGPIPE) &&
+            action.sa_handler != SIG_DFL) {
+            memset(&action, 0, sizeof(action));
+            action.sa_handler = SIG_DFL;
+            sigaction(signalNumber, &action, NULL);
+        }
+    }
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigprocmask(SIG_SETMASK, &signals, NULL);
+    
+    execve(argv[0], argv, envp);
+    *execError = errno;
+    _exit(127);
+}
 
+// Starts a Node process. It loads node-core and then waits until it is
+// activated by writing NODE_ACTIVATE_COMMAND to it, so the same process
+// works as the active one and as a standby. Returns false if it can't be
+// started.
+static bool spawnNode(NodeChild& child) {
+    
     // get path to Brackets
-    if (readlink("/proc/self/exe", executablePath, MAX_PATH) == -1) {
+    std::string bracketsDirPath = getExecutableDirectory();
+    if (bracketsDirPath.empty()) {
         fprintf(stderr, "cannot find Brackets path: %s\n", strerror(errno));
-        pthread_mutex_unlock(&mutex);
-        return NULL;
+        return false;
     }
-
-    // strip off trailing executable name
-    char* lastIndexOf = strrchr(executablePath, '/');
-    memcpy(bracketsDirPath, executablePath, lastIndexOf - executablePath + 1);
-
-    // null terminate the string
-    bracketsDirPath[lastIndexOf - executablePath + 1] = '\0';
     
     // create node exec and node-core paths
-    strcpy(nodeExecutablePath, bracketsDirPath);
-    strcat(nodeExecutablePath, NODE_EXECUTABLE_PATH);
-    strcpy(nodecorePath, bracketsDirPath);
-    strcat(nodecorePath, NODE_CORE_PATH);
+    std::string nodeExecutablePath = bracketsDirPath + NODE_EXECUTABLE_PATH;
+    std::string nodecorePath = bracketsDirPath + NODE_CORE_PATH;
     
-    // create pipes for node process stdin/stdout
+    // create pipes for node process stdin/stdout. They are close-on-exec so
+    // only the ends dup'ed onto node's stdin and stdout survive into node,
+    // and other processes we start don't hold them open.
     int toNode[2];
     int fromNode[2];
     
-    pipe(toNode);
-    pipe(fromNode);
+    if (pipe2(toNode, O_CLOEXEC) == -1) {
+        fprintf(stderr, "failed to create pipe for Node subprocess: %s\n", strerror(errno));
+        return false;
+    }
+    if (pipe2(fromNode, O_CLOEXEC) == -1) {
+        fprintf(stderr, "failed to create pipe for Node subprocess: %s\n", strerror(errno));
+        close(toNode[0]);
+        close(toNode[1]);
+        return false;
+    }
+    
+    // node gets our environment, plus the offer of the framed protocol
+    // and the request to wait for activation
+    std::vector<char*> envp;
+    for (char** variable = environ; *variable != NULL; variable++) {
+        envp.push_back(*variable);
+    }
+    std::string framingVariable = BRACKETS_NODE_FRAMING_ENV "=1";
+    std::string standbyVariable = BRACKETS_NODE_STANDBY_ENV "=1";
+    envp.push_back(&framingVariable[0]);
+    envp.push_back(&standbyVariable[0]);
+    envp.push_back(NULL);
+    
+    char* argv[] = { &nodeExecutablePath[0], &nodecorePath[0], NULL };
+    
+    // create the Node process. vfork doesn't copy this (large,
+    // multithreaded) process the way fork does, so startup doesn't get
+    // slower as the browser process grows. Unlike posix_spawn, it lets the
+    // child set its parent-death signal. Signals are blocked until the child
+    // has exec'ed, so none of our handlers run on its borrowed stack.
+    volatile int execError = 0;
+    pid_t parentPid = getpid();
+    sigset_t allSignals;
+    sigset_t oldSignals;
+    sigfillset(&allSignals);
+    pthread_sigmask(SIG_SETMASK, &allSignals, &oldSignals);
     
-    // create the Node process
-    pid_t child_pid = fork();
-    if (child_pid == 0) { // child (node) process
-        // close our copy of write end and
-        // connect read end to stdin
+    child.pid = vfork();
+    if (child.pid == 0) {
+        execNode(argv, &envp[0], toNode[0], fromNode[1], parentPid, &execError);
+    }
+    int spawnResult = child.pid == -1 ? errno : execError;
+    
+    pthread_sigmask(SIG_SETMASK, &oldSignals, NULL);
+    if (child.pid != -1 && spawnResult != 0) {
+        while (waitpid(child.pid, NULL, 0) == -1 && errno == EINTR) {
+        }
+    }
+    
+    // close our reference of toNode's read end
+    // and fromNode's write end
+    close(toNode[0]);
+    close(fromNode[1]);
+    
+    if (spawnResult != 0) {
+        fprintf(stderr, "the Node process failed to start: %s\n", strerror(spawnResult));
         close(toNode[1]);
-        dup2(toNode[0], STDIN_FILENO);
-        
-        // close our copy of read end and
-        // connect write end to stdout
         close(fromNode[0]);
-        dup2(fromNode[1], STDOUT_FILENO);
-        
-        // run node executable
-        char* arg_list[] = { nodeExecutablePath, nodecorePath, NULL};
-        execvp(arg_list[0], arg_list);
-        
-        fprintf(stderr, "the Node process failed to start: %s\n", strerror(errno));
-        abort();
+        return false;
     }
-    else { // parent
-        
-        // close our reference of toNode's read end
-        // and fromNode's write end
-        close(toNode[0]);
-        close(fromNode[1]);
-        
-        // convert subprocess write & read to FILE objects
-        streamTo = fdopen(toNode[1], "w");
-        streamFrom = fdopen(fromNode[0], "r");
+    
+    child.fdTo = toNode[1];
+    child.fdFrom = fromNode[0];
+    return true;
+}
 
-        nodeState = BRACKETS_NODE_PORT_NOT_YET_SET;
+// Kills |child| if it is still running, waits for it and closes its pipes.
+// Returns how it exited, as from waitpid.
+static int reapNode(NodeChild& child) {
     
-        // done launching process so release mutex
-        if (pthread_mutex_unlock(&mutex)) {
-            fprintf(stderr, 
-                "failed to release mutex for Node subprocess startup: %s\n",
-                strerror(errno));
+    int status = 0;
+    if (waitpid(child.pid, &status, WNOHANG) == 0) {
+        kill(child.pid, SIGKILL);
+        while (waitpid(child.pid, &status, 0) == -1 && errno == EINTR) {
         }
-        
-        // start pipe read thread
-        pthread_t readthread_id;
-        if (pthread_create(&readthread_id, NULL, &nodeReadThread, NULL) != 0)
-            nodeState = BRACKETS_NODE_FAILED;
-            // ugly - need to think more about what to do if read thread fails
+    }
+    close(child.fdTo);
+    close(child.fdFrom);
+    child.pid = child.fdTo = child.fdFrom = -1;
+    return status;
+}
 
+// Gets a process to activate: the standby if it is still alive, otherwise
+// a new one.
+static bool takeNode(NodeChild& child) {
+    
+    if (standby.pid != -1) {
+        int status;
+        if (waitpid(standby.pid, &status, WNOHANG) == 0) {
+            child = standby;
+            standby.pid = standby.fdTo = standby.fdFrom = -1;
+            return true;
+        }
+        fprintf(stderr, "the standby Node process exited\n");
+        reapNode(standby);
     }
+    return spawnNode(child);
+}
+
+// Returns a pidfd for |pid|, or -1 if the kernel doesn't have them.
+static int openPidFd(pid_t pid) {
+#ifdef SYS_pidfd_open
+    return syscall(SYS_pidfd_open, pid, 0);
+#else
+    return -1;
+#endif
+}
+
+// Reads from |child| into the command buffer until it exits or closes its
+// stdout. Node's exit is seen through a pidfd where the kernel has them,
+// so a grandchild holding on to Node's stdout doesn't hide it. Without a
+// pidfd, the end of stdout is taken as the exit.
+static void readFromNode(NodeChild& child) {
     
-    return NULL;
+    int pidFd = openPidFd(child.pid);
+    for (;;) {
+        if (pidFd != -1) {
+            struct pollfd fds[2];
+            fds[0].fd = child.fdFrom;
+            fds[0].events = POLLIN;
+            fds[1].fd = pidFd;
+            fds[1].events = POLLIN;
+            if (poll(fds, 2, -1) == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                break;
+            }
+            if (fds[1].revents != 0) {
+                // read whatever Node wrote before it exited, without
+                // waiting for anyone else who has the pipe
+                fcntl(child.fdFrom, F_SETFL, fcntl(child.fdFrom, F_GETFL) | O_NONBLOCK);
+            } else if (fds[0].revents == 0) {
+                continue;
+            }
+        }
+        
+        size_t available;
+        char* buffer = getIncomingDataBuffer(available);
+        ssize_t bytesRead = read(child.fdFrom, buffer, available);
+        if (bytesRead == -1 && errno == EINTR) {
+            continue;
+        }
+        if (bytesRead <= 0) {
+            break;
+        }
+        processIncomingBytes(bytesRead);
+        
+        // once this process is serving, start the next one in the background
+        if (BRACKETS_NODE_KEEP_STANDBY && standby.pid == -1 && !standbyFailed && getNodeState() >= 0) {
+            standbyFailed = !spawnNode(standby);
+        }
+    }
+    if (pidFd != -1) {
+        close(pidFd);
+    }
 }
 
+// Creates the thread that starts Node and then monitors the state
+// of the node process. If a process is already running, this is a no-op.
+void startNodeProcess() {
+    
+    pthread_mutex_lock(&mutex);
+    bool started = nodeThreadStarted;
+    nodeThreadStarted = true;
+    pthread_mutex_unlock(&mutex);
+    if (started) {
+        return;
+    }
+    
+    pthread_t thread_id;
+    if (pthread_create(&thread_id, NULL, &nodeThread, NULL) != 0)
+        setNodeState(BRACKETS_NODE_FAILED);
+}
 
-// Thread function for the thread that reads from the Node pipe
-// Reads on anonymous pipes are always blocking (OVERLAPPED reads
-// are not possible) So, we need to do this in a separate thread
 
-// TODO: This code first reads to a character buffer, and then
-// copies it to a std::string. The code could be optimized to avoid
-// this double-copy
-void* nodeReadThread(void* unused) {
+// Thread function for the thread that starts the node process, reads from
+// it and restarts it when it exits. A process that ran for at least
+// BRACKETS_NODE_AUTO_RESTART_TIMEOUT is replaced right away, by the standby
+// when there is one. Quicker exits are retried with exponential backoff, up
+// to BRACKETS_NODE_MAX_QUICK_RESTARTS times in a row.
+void* nodeThread(void* unused) {
     
-    char charBuf[BRACKETS_NODE_BUFFER_SIZE];
-    std::string strBuf("");
-    while (fgets(charBuf, BRACKETS_NODE_BUFFER_SIZE, streamFrom) != NULL) {
-        strBuf.assign(charBuf);
-        processIncomingData(strBuf);
+    int quickExits = 0;
+    for (;;) {
+        NodeChild child;
+        if (!takeNode(child)) {
+            setNodeState(BRACKETS_NODE_FAILED);
+            return NULL;
+        }
+        
+        recordNodeStarting();
+        if (!writeAll(child.fdTo, NODE_ACTIVATE_COMMAND, sizeof(NODE_ACTIVATE_COMMAND) - 1)) {
+            fprintf(stderr, "failed to activate Node subprocess: %s\n", strerror(errno));
+        }
+        
+        resetIncomingData();
+        pthread_mutex_lock(&mutex);
+        fdTo = child.fdTo;
+        nodePid = child.pid;
+        nodeState = BRACKETS_NODE_PORT_NOT_YET_SET;
+        pthread_mutex_unlock(&mutex);
+        notifyNodeStateChanged(BRACKETS_NODE_PORT_NOT_YET_SET);
+        int64 startTime = appshell::GetMonotonicMicroseconds();
+        
+        readFromNode(child);
+        
+        // the process is gone, so stop sending to it
+        pthread_mutex_lock(&mutex);
+        fdTo = -1;
+        nodePid = -1;
+        nodeState = BRACKETS_NODE_NOT_YET_STARTED;
+        pthread_mutex_unlock(&mutex);
+        notifyNodeStateChanged(BRACKETS_NODE_NOT_YET_STARTED);
+        int status = reapNode(child);
+        if (WIFSIGNALED(status)) {
+            fprintf(stderr, "the Node process was killed by signal %d\n", WTERMSIG(status));
+        } else {
+            fprintf(stderr, "the Node process exited with status %d\n", WEXITSTATUS(status));
+        }
+        
+        int64 ranFor = appshell::GetMonotonicMicroseconds() - startTime;
+        if (ranFor >= BRACKETS_NODE_AUTO_RESTART_TIMEOUT * 1000000LL) {
+            quickExits = 0;
+        } else if (++quickExits > BRACKETS_NODE_MAX_QUICK_RESTARTS) {
+            fprintf(stderr, "the Node process keeps exiting, not restarting it\n");
+            if (standby.pid != -1) {
+                reapNode(standby);
+            }
+            setNodeState(BRACKETS_NODE_FAILED);
+            return NULL;
+        }
+        recordNodeRestarting();
+        
+        // a standby that failed to start gets another chance
+        standbyFailed = false;
+        
+        if (quickExits > 0) {
+            struct timespec delay = { 1 << (quickExits - 1), 0 };
+            while (nanosleep(&delay, &delay) == -1 && errno == EINTR) {
+            }
+        }
     }
+    
+    return NULL;
 }
 
 
-// Determines whether the current node process has run long
-// enough that a restart is warranted, and initiates the startup
-// if so. Can also optionally terminate the running process.
+// Ends the current node process if |terminateCurrentProcess| is set. The
+// node thread sees it exit and decides whether to start another one.
 void restartNode(bool terminateCurrentProcess) {
     
+    if (!terminateCurrentProcess) {
+        return;
+    }
+    pthread_mutex_lock(&mutex);
+    if (nodePid != -1) {
+        kill(nodePid, SIGKILL);
+    }
+    pthread_mutex_unlock(&mutex);
 }
 
 // Sends data to the node process. If the write fails completely,
@@ -198,14 +464,23 @@ void sendData(const std::string &data) {
         return;
     }
 
-    // write to pipe
-    fprintf(streamTo, "%s", data.c_str());
+    // write to pipe, unbuffered so replies aren't held back
+    bool failed = false;
+    if (fdTo != -1 && !writeAll(fdTo, data.data(), data.size())) {
+        fprintf(stderr, "failed to write to Node subprocess: %s\n", strerror(errno));
+        failed = true;
+    }
     
     if (pthread_mutex_unlock(&mutex)) {
             fprintf(stderr, 
             "failed to release mutex for write to Node subprocess: %s\n",
             strerror(errno));
     }
+    
+    if (failed) {
+        // there's something wrong with this process, restart it
+        restartNode(true);
+    }
 }
 
 // Returns nodeState variable 
@@ -229,4 +504,56 @@ void setNodeState(int newState) {
             "failed to release mutex for Node set state: %s\n",
             strerror(errno));
     }
+    notifyNodeStateChanged(newState);
+}
+
+// Adds up the voluntary context switches of all the threads of |pid|. A
+// thread switches out voluntarily when it goes to sleep, so each one is
+// followed by a wakeup. Returns -1 if the process can't be read.
+static long long countWakeups(pid_t pid) {
+    
+    char tasksPath[64];
+    snprintf(tasksPath, sizeof(tasksPath), "/proc/%d/task", (int)pid);
+    DIR* tasks = opendir(tasksPath);
+    if (tasks == NULL) {
+        return -1;
+    }
+    
+    long long total = 0;
+    struct dirent* task;
+    while ((task = readdir(tasks)) != NULL) {
+        if (task->d_name[0] == '.') {
+            continue;
+        }
+        std::string statusPath = std::string(tasksPath) + "/" + task->d_name + "/status";
+        FILE* status = fopen(statusPath.c_str(), "r");
+        if (status == NULL) {
+            continue; // the thread just exited
+        }
+        char line[256];
+        while (fgets(line, sizeof(line), status) != NULL) {
+            long long switches;
+            if (sscanf(line, "voluntary_ctxt_switches: %lld", &switches) == 1) {
+                total += switches;
+                break;
+            }
+        }
+        fclose(status);
+    }
+    closedir(tasks);
+    return total;
+}
+
+// Counts wakeups of the browser process and the active Node process
+bool getProcessWakeups(long long& shellWakeups, long long& nodeWakeups) {
+    
+    pthread_mutex_lock(&mutex);
+    pid_t pid = nodePid;
+    pthread_mutex_unlock(&mutex);
+    if (pid == -1) {
+        return false;
+    }
+    shellWakeups = countWakeups(getpid());
+    nodeWakeups = countWakeups(pid);
+    return shellWakeups != -1 && nodeWakeups != -1;
 }
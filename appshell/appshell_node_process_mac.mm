@@ -27,6 +27,10 @@
 #import <Foundation/Foundation.h>
 #import <Cocoa/Cocoa.h>
 
+#include <libproc.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
 #include "config.h"
 
 // NOTE ON THREAD SAFETY: This code is not thread-safe. All of the methods
@@ -44,6 +48,7 @@
 -(void) stop;
 -(int) getState;
 -(void) setState: (int)newState;
+-(pid_t) getPid;
 -(void) receiveDataFromTask: (NSNotification *)aNotification;
 -(void) sendDataToTask: (NSString *)dataString;
 
@@ -80,6 +85,7 @@
     state = BRACKETS_NODE_PORT_NOT_YET_SET;
     
     lastStartTime = CFAbsoluteTimeGetCurrent();
+    resetIncomingData();
     
     NSString *appPath = [[NSBundle mainBundle] bundlePath];
     NSString *nodePath = [appPath stringByAppendingString:NODE_EXECUTABLE_PATH];
@@ -121,6 +127,7 @@
     // send a NSFileHandleReadCompletionNotification when it has data that is available.
     [[[task standardOutput] fileHandleForReading] readInBackgroundAndNotify];
     
+    recordNodeStarting();
     [task launch];
     
     return true;
@@ -164,12 +171,21 @@
     
     CFAbsoluteTime elapsed = CFAbsoluteTimeGetCurrent() - lastStartTime;
     if (elapsed > BRACKETS_NODE_AUTO_RESTART_TIMEOUT) {
+        recordNodeRestarting();
         [self start];
     } else {
         NSLog(@"Node process did not stay running long enough. Failing.");
     }
 }
 
+// Returns the pid of the running node process, or -1 if there isn't one
+-(pid_t) getPid {
+    if (task != NULL && [task isRunning]) {
+        return [task processIdentifier];
+    }
+    return -1;
+}
+
 // Handler for new data from node process
 -(void) receiveDataFromTask: (NSNotification *)aNotification {
     NSData *data = [[aNotification userInfo] objectForKey:NSFileHandleNotificationDataItem];
@@ -233,4 +249,25 @@ int getNodeState() {
 
 void setNodeState(int state) {
     [gNodeWrapper setState:state];
+    notifyNodeStateChanged(state);
+}
+
+// Returns the idle and interrupt wakeups of |pid|, the counts Activity
+// Monitor shows, or -1 if they can't be read.
+static long long countWakeups(pid_t pid) {
+    struct rusage_info_v1 info;
+    if (proc_pid_rusage(pid, RUSAGE_INFO_V1, (rusage_info_t*)&info) != 0) {
+        return -1;
+    }
+    return (long long)(info.ri_pkg_idle_wkups + info.ri_interrupt_wkups);
+}
+
+bool getProcessWakeups(long long& shellWakeups, long long& nodeWakeups) {
+    pid_t pid = [gNodeWrapper getPid];
+    if (pid == -1) {
+        return false;
+    }
+    shellWakeups = countWakeups(getpid());
+    nodeWakeups = countWakeups(pid);
+    return shellWakeups != -1 && nodeWakeups != -1;
 }
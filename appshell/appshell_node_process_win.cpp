@@ -80,23 +80,19 @@ void startNodeProcess() {
 
 // Thread function for the thread that reads from the Node pipe
 // Reads on anonymous pipes are always blocking (OVERLAPPED reads
-// are not possible) So, we need to do this in a separate thread
-//
-// TODO: This code first reads to a character buffer, and then
-// copies it to a std::string. The code could be optimized to avoid
-// this double-copy
+// are not possible) So, we need to do this in a separate thread.
+// Data is read straight into the command buffer and parsed there.
 DWORD WINAPI NodeReadThread(LPVOID lpParam) {
 	DWORD dwRead;
-	CHAR chBuf[BRACKETS_NODE_BUFFER_SIZE];
-	std::string strBuf("");
 	BOOL bSuccess = FALSE;
 	for (;;) {	
-		bSuccess = ReadFile(g_hChildStd_OUT_Rd, chBuf, BRACKETS_NODE_BUFFER_SIZE, &dwRead, NULL);
+		size_t available;
+		char* buffer = getIncomingDataBuffer(available);
+		bSuccess = ReadFile(g_hChildStd_OUT_Rd, buffer, (DWORD)available, &dwRead, NULL);
 		if( ! bSuccess || dwRead == 0 ) {
 			break;
 		} else {
-			strBuf.assign(chBuf, dwRead);
-			processIncomingData(strBuf);
+			processIncomingBytes(dwRead);
 		}
 	} 
 	return 0;
@@ -196,6 +192,7 @@ DWORD WINAPI NodeThread(LPVOID lpParam) {
 
 			// Create the child process. 
 
+			recordNodeStarting();
 			bSuccess = CreateProcess(NULL, 
 				commandLine,       // command line 
 				NULL,              // process security attributes 
@@ -218,6 +215,7 @@ DWORD WINAPI NodeThread(LPVOID lpParam) {
 			}
 			else {
 				// Start reading from the pipe
+				resetIncomingData();
 				hNodeReadThread = CreateThread(NULL, 0, NodeReadThread, NULL, 0, NULL);
 
 				// Loop to check if process is still running
@@ -282,6 +280,7 @@ void restartNode(bool terminateCurrentProcess) {
 
 			if (shouldRestart) {
 				// Ran at least 5 seconds last time, so restart
+				recordNodeRestarting();
 				startNodeProcess();
 			} else {
 				// Didn't run long enough
@@ -350,6 +349,7 @@ void setNodeState(int newState) {
 		if (dwWaitResult == WAIT_OBJECT_0) { // got the mutex
 			nodeState = newState;
 			ReleaseMutex(hNodeMutex);
+			notifyNodeStateChanged(newState);
 		}
 		// If we didn't get the mutex, we don't have any way to signal the state
 		// here. But something is very wrong, so something internally should eventually
@@ -360,3 +360,8 @@ void setNodeState(int newState) {
 	// So, it's not appropriate for something to be setting the state. So, we do nothing
 	// (This should not happen, as this function is only called by way of a running node process)
 }
+
+// Windows only counts wakeups in ETW traces, so they aren't available here.
+bool getProcessWakeups(long long& shellWakeups, long long& nodeWakeups) {
+	return false;
+}
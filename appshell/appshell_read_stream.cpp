@@ -0,0 +1,480 @@
+/*
+ * Copyright (c) 2016 - present Adobe Systems Incorporated. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "appshell_read_stream.h"
+
+#include "appshell_extensions.h"
+#include "appshell_worker_pool.h"
+
+#include "include/base/cef_bind.h"
+#include "include/base/cef_lock.h"
+#include "include/cef_task.h"
+#include "include/wrapper/cef_closure_task.h"
+
+#include <unicode/ucnv.h>
+#include <unicode/ustring.h>
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <vector>
+
+namespace appshell_extensions {
+
+namespace {
+
+const int32 kMinChunkSize = 4 * 1024;
+const int32 kMaxChunkSize = 16 * 1024 * 1024;
+
+// How much of the start of the file is looked at to work out its encoding.
+const size_t kSniffSize = 64 * 1024;
+
+// Returns the length of |text| without a multibyte UTF-8 sequence that is cut
+// off at the end, so the rest of it can be prepended to the next chunk.
+size_t GetCompleteUTF8Length(const std::string& text)
+{
+    size_t length = text.size();
+    size_t lead = length;
+
+    // A sequence is at most 4 bytes, so only the last 3 can be an unfinished one.
+    while (lead > 0 && length - lead < 3 && (text[lead - 1] & 0xC0) == 0x80) {
+        lead--;
+    }
+    if (lead == 0) {
+        return length;
+    }
+
+    unsigned char leadByte = text[lead - 1];
+    size_t needed = (leadByte >= 0xF0) ? 4 : (leadByte >= 0xE0) ? 3 : (leadByte >= 0xC0) ? 2 : 1;
+    size_t available = length - (lead - 1);
+
+    return (available < needed) ? lead - 1 : length;
+}
+
+class ReadStream : public CefBase {
+public:
+    ReadStream(CefRefPtr<CefBrowser> browser,
+               CefRefPtr<CefProcessMessage> response,
+               int32 streamId,
+               const ExtensionString& path,
+               int32 chunkSize,
+               int32 ackInterval,
+               const std::string& encoding)
+        : browser_(browser)
+        , response_(response)
+        , streamId_(streamId)
+        , path_(path)
+        , chunkSize_(chunkSize)
+        , ackInterval_(ackInterval)
+        , credits_(2 * ackInterval)
+        , waiting_(false)
+        , cancelled_(false)
+        , encoding_(encoding)
+        , started_(false)
+        , finished_(false)
+        , preserveBOM_(false)
+        , converter_(NULL) {
+    }
+
+    ~ReadStream() {
+        if (converter_) {
+            ucnv_close(converter_);
+        }
+    }
+
+    // Queues the next batch of chunks on the worker pool.
+    void Post();
+
+    // Called on the UI thread.
+    void Ack();
+    void Cancel();
+
+    // Called on the worker thread. Sends chunks until the file ends or the
+    // unacknowledged chunks run out of credit.
+    void ReadChunks();
+
+private:
+    int32 Start();
+    int32 Decode(const char* data, size_t length, bool atEnd, std::string& text);
+    int32 DecodeWithConverter(const char* data, size_t length, bool atEnd, std::string& text);
+    void SendChunk(const std::string& text);
+    void Finish(int32 error);
+
+    CefRefPtr<CefBrowser> browser_;
+    CefRefPtr<CefProcessMessage> response_;
+    int32 streamId_;
+    ExtensionString path_;
+    size_t chunkSize_;
+    int32 ackInterval_;
+
+    // Shared between the UI thread and the worker.
+    base::Lock lock_;
+    int32 credits_;
+    bool waiting_;
+    bool cancelled_;
+
+    // Only used on the worker thread.
+    std::string encoding_;
+    bool started_;
+    bool finished_;
+    bool preserveBOM_;
+    std::ifstream file_;
+    std::vector<char> buffer_;
+    std::string carry_;
+    UConverter* converter_;
+
+    IMPLEMENT_REFCOUNTING(ReadStream);
+};
+
+typedef std::pair<int, int32> StreamKey;
+typedef std::map<StreamKey, CefRefPtr<ReadStream> > StreamMap;
+
+// Streams that haven't finished yet. UI thread only.
+StreamMap g_streams;
+
+void ReadChunksTask(CefRefPtr<ReadStream> stream)
+{
+    stream->ReadChunks();
+}
+
+void RemoveStream(StreamKey key, CefRefPtr<ReadStream> stream)
+{
+    StreamMap::iterator it = g_streams.find(key);
+    if (it != g_streams.end() && it->second.get() == stream.get()) {
+        g_streams.erase(it);
+    }
+}
+
+void ReadStream::Post()
+{
+    appshell::PostWorkerTask(path_, base::Bind(&ReadChunksTask, CefRefPtr<ReadStream>(this)));
+}
+
+void ReadStream::Ack()
+{
+    bool resume = false;
+    {
+        base::AutoLock lock(lock_);
+        credits_ += ackInterval_;
+        resume = waiting_;
+        waiting_ = false;
+    }
+    if (resume) {
+        Post();
+    }
+}
+
+void ReadStream::Cancel()
+{
+    bool resume = false;
+    {
+        base::AutoLock lock(lock_);
+        cancelled_ = true;
+        resume = waiting_;
+        waiting_ = false;
+    }
+    if (resume) {
+        Post();
+    }
+}
+
+void ReadStream::ReadChunks()
+{
+    if (finished_) {
+        return;
+    }
+
+    if (!started_) {
+        started_ = true;
+        int32 error = Start();
+        if (error != NO_ERROR) {
+            Finish(error);
+            return;
+        }
+    }
+
+    for (;;) {
+        {
+            base::AutoLock lock(lock_);
+            if (cancelled_) {
+                break;
+            }
+            if (credits_ <= 0) {
+                // Ack() or Cancel() posts the next batch.
+                waiting_ = true;
+                return;
+            }
+        }
+
+        file_.read(&buffer_[0], chunkSize_);
+        size_t length = file_.gcount();
+        bool atEnd = !file_;
+        if (file_.bad()) {
+            Finish(ERR_CANT_READ);
+            return;
+        }
+
+        std::string text;
+        int32 error = Decode(&buffer_[0], length, atEnd, text);
+        if (error != NO_ERROR) {
+            Finish(error);
+            return;
+        }
+
+        if (!text.empty()) {
+            SendChunk(text);
+            base::AutoLock lock(lock_);
+            credits_--;
+        }
+
+        if (atEnd) {
+            Finish(NO_ERROR);
+            return;
+        }
+    }
+
+    Finish(ERR_CANCELLED);
+}
+
+// Opens the file and works out its encoding from the first chunk, the same
+// way ReadFile() does for the whole file.
+int32 ReadStream::Start()
+{
+    if (encoding_ == "utf8") {
+        encoding_ = "UTF-8";
+    }
+    std::transform(encoding_.begin(), encoding_.end(), encoding_.begin(), ::toupper);
+
+    file_.open(path_.c_str(), std::ios::in | std::ios::binary);
+    if (!file_.is_open()) {
+        return ERR_CANT_READ;
+    }
+
+    buffer_.resize(chunkSize_);
+
+    if (encoding_ != "UTF-8") {
+        UErrorCode status = U_ZERO_ERROR;
+        converter_ = ucnv_open(encoding_.c_str(), &status);
+        return U_SUCCESS(status) ? NO_ERROR : ERR_UNSUPPORTED_ENCODING;
+    }
+
+    // Look at the start of the file without consuming it.
+    std::string sample(std::max(chunkSize_, kSniffSize), '\0');
+    file_.read(&sample[0], sample.size());
+    size_t length = file_.gcount();
+    bool wholeFile = (length < sample.size());
+    sample.resize(length);
+    file_.clear();
+    file_.seekg(0);
+
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(sample.data());
+    if (length >= 4 && ((data[0] == 0x00 && data[1] == 0x00 && data[2] == 0xFE && data[3] == 0xFF) ||
+                        (data[0] == 0xFE && data[1] == 0xFF && data[2] == 0x00 && data[3] == 0x00))) {
+        return ERR_UNSUPPORTED_ENCODING;
+    }
+    if (length >= 3 && data[0] == 0xEF && data[1] == 0xBB && data[2] == 0xBF) {
+        // Skip the BOM; WriteFile puts it back when preserveBOM is set.
+        preserveBOM_ = true;
+        file_.seekg(3);
+        return NO_ERROR;
+    }
+
+    if (IsValidUTF8(sample.data(), wholeFile ? length : GetCompleteUTF8Length(sample))) {
+        return NO_ERROR;
+    }
+
+    std::string detectedCharSet;
+    try {
+        DetectCharSet(sample.data(), sample.size(), detectedCharSet);
+    } catch (...) {
+        return ERR_UNSUPPORTED_ENCODING;
+    }
+    if (detectedCharSet == "UTF-16LE" || detectedCharSet == "UTF-16BE") {
+        return ERR_UNSUPPORTED_UTF16_ENCODING;
+    }
+    if (detectedCharSet.empty()) {
+        return ERR_UNSUPPORTED_ENCODING;
+    }
+
+    std::transform(detectedCharSet.begin(), detectedCharSet.end(), detectedCharSet.begin(), ::toupper);
+    encoding_ = detectedCharSet;
+
+    UErrorCode status = U_ZERO_ERROR;
+    converter_ = ucnv_open(encoding_.c_str(), &status);
+    return U_SUCCESS(status) ? NO_ERROR : ERR_UNSUPPORTED_ENCODING;
+}
+
+// Turns raw bytes into UTF-8 text. Bytes of a character that continues in the
+// next chunk are held back until then.
+//
+// Start() only looks at the first kSniffSize bytes, so UTF-8 is checked again
+// in every chunk. A file that turns out not to be UTF-8 further on fails with
+// ERR_DECODE_FILE_FAILED, as its first chunks have already been sent.
+int32 ReadStream::Decode(const char* data, size_t length, bool atEnd, std::string& text)
+{
+    if (converter_) {
+        return DecodeWithConverter(data, length, atEnd, text);
+    }
+
+    text.swap(carry_);
+    text.append(data, length);
+    carry_.clear();
+
+    if (!atEnd) {
+        size_t complete = GetCompleteUTF8Length(text);
+        carry_.assign(text, complete, std::string::npos);
+        text.resize(complete);
+    }
+    if (!IsValidUTF8(text.data(), text.size())) {
+        return ERR_DECODE_FILE_FAILED;
+    }
+    return NO_ERROR;
+}
+
+int32 ReadStream::DecodeWithConverter(const char* data, size_t length, bool atEnd, std::string& text)
+{
+    // The converter keeps partial characters in its own state between calls.
+    std::vector<UChar> utf16(length + 1);
+    size_t converted = 0;
+    const char* source = data;
+    const char* sourceLimit = data + length;
+    UErrorCode status = U_ZERO_ERROR;
+
+    for (;;) {
+        UChar* target = &utf16[converted];
+        UChar* targetStart = target;
+        status = U_ZERO_ERROR;
+        ucnv_toUnicode(converter_, &target, &utf16[0] + utf16.size(), &source, sourceLimit, NULL, atEnd, &status);
+        converted += target - targetStart;
+
+        if (status != U_BUFFER_OVERFLOW_ERROR) {
+            break;
+        }
+        utf16.resize(utf16.size() * 2);
+    }
+    if (U_FAILURE(status)) {
+        return ERR_DECODE_FILE_FAILED;
+    }
+
+    int32_t utf8Length = 0;
+    status = U_ZERO_ERROR;
+    u_strToUTF8(NULL, 0, &utf8Length, &utf16[0], converted, &status);
+    if (status != U_BUFFER_OVERFLOW_ERROR && U_FAILURE(status)) {
+        return ERR_DECODE_FILE_FAILED;
+    }
+
+    text.resize(utf8Length);
+    if (utf8Length > 0) {
+        status = U_ZERO_ERROR;
+        u_strToUTF8(&text[0], utf8Length, NULL, &utf16[0], converted, &status);
+        if (U_FAILURE(status)) {
+            return ERR_DECODE_FILE_FAILED;
+        }
+    }
+    return NO_ERROR;
+}
+
+void ReadStream::SendChunk(const std::string& text)
+{
+    // Progress callbacks get null in place of the error code, which tells the
+    // JS side apart from the final callback.
+    CefRefPtr<CefProcessMessage> message = CefProcessMessage::Create("invokeProgressCallback");
+    CefRefPtr<CefListValue> messageArgs = message->GetArgumentList();
+    messageArgs->SetInt(0, response_->GetArgumentList()->GetInt(0));
+    messageArgs->SetNull(1);
+    messageArgs->SetString(2, text);
+    SendResponse(browser_, message);
+}
+
+void ReadStream::Finish(int32 error)
+{
+    finished_ = true;
+    file_.close();
+    carry_.clear();
+
+    CefRefPtr<CefListValue> responseArgs = response_->GetArgumentList();
+    responseArgs->SetInt(1, error);
+    responseArgs->SetString(2, encoding_);
+    responseArgs->SetBool(3, preserveBOM_);
+    SendResponse(browser_, response_);
+
+    CefPostTask(TID_UI, base::Bind(&RemoveStream, StreamKey(browser_->GetIdentifier(), streamId_),
+                                   CefRefPtr<ReadStream>(this)));
+}
+
+}  // namespace
+
+void OpenReadStream(CefRefPtr<CefBrowser> browser,
+                    CefRefPtr<CefProcessMessage> response,
+                    int32 streamId,
+                    const ExtensionString& path,
+                    int32 chunkSize,
+                    int32 ackInterval,
+                    const std::string& encoding)
+{
+    StreamKey key(browser->GetIdentifier(), streamId);
+
+    // Ids are handed out by the renderer, which starts over after a reload.
+    StreamMap::iterator existing = g_streams.find(key);
+    if (existing != g_streams.end()) {
+        existing->second->Cancel();
+    }
+
+    chunkSize = std::max(kMinChunkSize, std::min(chunkSize, kMaxChunkSize));
+    ackInterval = std::max(ackInterval, 1);
+
+    CefRefPtr<ReadStream> stream =
+        new ReadStream(browser, response, streamId, path, chunkSize, ackInterval, encoding);
+    g_streams[key] = stream;
+    stream->Post();
+}
+
+void AckReadStream(CefRefPtr<CefBrowser> browser, int32 streamId)
+{
+    StreamMap::iterator it = g_streams.find(StreamKey(browser->GetIdentifier(), streamId));
+    if (it != g_streams.end()) {
+        it->second->Ack();
+    }
+}
+
+void CancelReadStream(CefRefPtr<CefBrowser> browser, int32 streamId)
+{
+    StreamMap::iterator it = g_streams.find(StreamKey(browser->GetIdentifier(), streamId));
+    if (it != g_streams.end()) {
+        it->second->Cancel();
+    }
+}
+
+void CancelBrowserReadStreams(CefRefPtr<CefBrowser> browser)
+{
+    StreamMap::iterator it = g_streams.begin();
+    while (it != g_streams.end()) {
+        if (it->first.first == browser->GetIdentifier()) {
+            it->second->Cancel();
+            g_streams.erase(it++);
+        } else {
+            ++it;
+        }
+    }
+}
+
+}  // namespace appshell_extensions
@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2016 - present Adobe Systems Incorporated. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "include/cef_browser.h"
+#include "include/cef_process_message.h"
+
+#include "appshell_extensions_platform.h"
+
+namespace appshell_extensions {
+
+// Streaming file reads for appshell.fs.openReadStream().
+//
+// The file is read and decoded on the worker pool one chunk at a time. Each
+// chunk goes to the renderer as an "invokeProgressCallback" message, and the
+// stream's callback gets the final "invokeCallback" once the file has been
+// read, an error occurred or the stream was cancelled.
+//
+// The renderer acks every |ackInterval| chunks it receives. At most two
+// intervals' worth of chunks are unacknowledged at any time, so a busy
+// renderer is never flooded with data it can't process yet.
+//
+// All of these functions must be called on the UI thread.
+
+// Starts streaming |path|. |response| is the final response message and
+// already holds the callback id. The response gets the error code, the
+// encoding of the file and whether it had a UTF-8 BOM.
+void OpenReadStream(CefRefPtr<CefBrowser> browser,
+                    CefRefPtr<CefProcessMessage> response,
+                    int32 streamId,
+                    const ExtensionString& path,
+                    int32 chunkSize,
+                    int32 ackInterval,
+                    const std::string& encoding);
+
+// Allows stream |streamId| to send another |ackInterval| chunks.
+void AckReadStream(CefRefPtr<CefBrowser> browser, int32 streamId);
+
+// Stops stream |streamId|. Its callback gets ERR_CANCELLED.
+void CancelReadStream(CefRefPtr<CefBrowser> browser, int32 streamId);
+
+// Stops every stream of |browser|. Called when the browser closes.
+void CancelBrowserReadStreams(CefRefPtr<CefBrowser> browser);
+
+}  // namespace appshell_extensions
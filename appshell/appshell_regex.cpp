@@ -0,0 +1,914 @@
+/*
+ * Copyright (c) 2016 - present Adobe Systems Incorporated. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "appshell_regex.h"
+
+#include <unicode/uchar.h>
+
+#include <algorithm>
+
+namespace appshell {
+
+namespace {
+
+// Limits that keep a compiled pattern small; "a{1000}{1000}" would otherwise
+// turn into a million instructions.
+const int kMaxRepeat = 1000;
+const size_t kMaxProgramSize = 20000;
+const int kMaxNesting = 200;
+
+const unsigned int kReplacementChar = 0xFFFD;
+
+// Decodes the code point at |pos|. Invalid bytes decode to U+FFFD, one at a time.
+unsigned int DecodeUTF8(const char* text, size_t length, size_t pos, size_t& next)
+{
+    unsigned char lead = text[pos];
+    if (lead < 0x80) {
+        next = pos + 1;
+        return lead;
+    }
+
+    size_t trail = (lead >= 0xF0) ? 3 : (lead >= 0xE0) ? 2 : (lead >= 0xC0) ? 1 : 0;
+    if (trail == 0 || lead > 0xF4 || pos + trail >= length) {
+        next = pos + 1;
+        return kReplacementChar;
+    }
+
+    unsigned int c = lead & (0x3F >> trail);
+    for (size_t i = 1; i <= trail; i++) {
+        unsigned char byte = text[pos + i];
+        if ((byte & 0xC0) != 0x80) {
+            next = pos + 1;
+            return kReplacementChar;
+        }
+        c = (c << 6) | (byte & 0x3F);
+    }
+    next = pos + trail + 1;
+    return c;
+}
+
+void AppendUTF8(std::string& text, unsigned int c)
+{
+    if (c < 0x80) {
+        text += (char)c;
+    } else if (c < 0x800) {
+        text += (char)(0xC0 | (c >> 6));
+        text += (char)(0x80 | (c & 0x3F));
+    } else if (c < 0x10000) {
+        text += (char)(0xE0 | (c >> 12));
+        text += (char)(0x80 | ((c >> 6) & 0x3F));
+        text += (char)(0x80 | (c & 0x3F));
+    } else {
+        text += (char)(0xF0 | (c >> 18));
+        text += (char)(0x80 | ((c >> 12) & 0x3F));
+        text += (char)(0x80 | ((c >> 6) & 0x3F));
+        text += (char)(0x80 | (c & 0x3F));
+    }
+}
+
+bool IsWordByte(unsigned char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+bool IsLineTerminator(unsigned int c)
+{
+    return c == '\n' || c == '\r' || c == 0x2028 || c == 0x2029;
+}
+
+int HexValue(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+}  // namespace
+
+// Turns a pattern into a syntax tree, and the tree into a Regex program.
+class RegexParser {
+public:
+    RegexParser(Regex& regex, const std::string& pattern)
+        : regex_(regex)
+        , pattern_(pattern)
+        , pos_(0)
+        , depth_(0) {
+    }
+
+    bool Parse(std::string& error);
+
+private:
+    struct Node {
+        enum Type { EMPTY, CHAR, ANY, CLASS, BOL, EOL, WORD_BOUNDARY, NOT_WORD_BOUNDARY, CONCAT, ALTERNATE, REPEAT };
+
+        explicit Node(Type type) : type(type), c(0), min(0), max(0), greedy(true) {}
+
+        Type type;
+        unsigned int c;             // CHAR: the code point; CLASS: index into Regex::classes_
+        std::vector<int> children;  // CONCAT, ALTERNATE; REPEAT has one
+        int min;                    // REPEAT
+        int max;                    // REPEAT; -1 for no limit
+        bool greedy;                // REPEAT
+    };
+
+    int NewNode(Node::Type type);
+    bool AtEnd() const { return pos_ >= pattern_.length(); }
+    unsigned int Next();
+    unsigned int Peek() const;
+
+    int ParseAlternation();
+    int ParseConcatenation();
+    int ParseRepeat();
+    int ParseAtom();
+    int ParseClass();
+    int ParseEscape();
+    bool ParseClassEscape(Regex::CharClass& charClass, unsigned int& c);
+    bool ParseQuantifier(int& min, int& max);
+    bool ParseNumber(int& value);
+    int AddBuiltinClass(char name);
+    void AddBuiltinRanges(Regex::CharClass& charClass, char name);
+
+    void FindLiteral(int root);
+    void Emit(int node);
+    int Push(Regex::Inst::Op op, unsigned int arg, int x, int y);
+
+    Regex& regex_;
+    const std::string& pattern_;
+    size_t pos_;
+    int depth_;
+    std::vector<Node> nodes_;
+    std::string error_;
+};
+
+int RegexParser::NewNode(Node::Type type)
+{
+    nodes_.push_back(Node(type));
+    return (int)nodes_.size() - 1;
+}
+
+unsigned int RegexParser::Next()
+{
+    size_t next;
+    unsigned int c = DecodeUTF8(pattern_.data(), pattern_.length(), pos_, next);
+    pos_ = next;
+    return c;
+}
+
+unsigned int RegexParser::Peek() const
+{
+    size_t next;
+    return DecodeUTF8(pattern_.data(), pattern_.length(), pos_, next);
+}
+
+bool RegexParser::Parse(std::string& error)
+{
+    int root = ParseAlternation();
+    if (error_.empty() && !AtEnd()) {
+        error_ = "Unmatched ')'";
+    }
+
+    if (error_.empty()) {
+        FindLiteral(root);
+        Emit(root);
+        Push(Regex::Inst::MATCH, 0, 0, 0);
+        if (regex_.program_.size() > kMaxProgramSize) {
+            error_ = "Regular expression is too large";
+        }
+    }
+
+    error = error_;
+    return error_.empty();
+}
+
+int RegexParser::ParseAlternation()
+{
+    int first = ParseConcatenation();
+    if (AtEnd() || pattern_[pos_] != '|') {
+        return first;
+    }
+
+    int node = NewNode(Node::ALTERNATE);
+    nodes_[node].children.push_back(first);
+    while (error_.empty() && !AtEnd() && pattern_[pos_] == '|') {
+        pos_++;
+        int next = ParseConcatenation();
+        nodes_[node].children.push_back(next);
+    }
+    return node;
+}
+
+int RegexParser::ParseConcatenation()
+{
+    int node = NewNode(Node::CONCAT);
+    while (error_.empty() && !AtEnd() && pattern_[pos_] != '|' && pattern_[pos_] != ')') {
+        int child = ParseRepeat();
+        if (child < 0) {
+            break;
+        }
+        // Flatten groups like "(?:ab)c" so literals can be found across them.
+        if (nodes_[child].type == Node::CONCAT) {
+            std::vector<int> grandchildren = nodes_[child].children;
+            nodes_[node].children.insert(nodes_[node].children.end(), grandchildren.begin(), grandchildren.end());
+        } else {
+            nodes_[node].children.push_back(child);
+        }
+    }
+    return node;
+}
+
+int RegexParser::ParseRepeat()
+{
+    int atom = ParseAtom();
+    if (atom < 0 || AtEnd()) {
+        return atom;
+    }
+
+    while (error_.empty() && !AtEnd()) {
+        int min, max;
+        size_t start = pos_;
+        if (!ParseQuantifier(min, max)) {
+            pos_ = start;
+            break;
+        }
+
+        Node::Type type = nodes_[atom].type;
+        if (type == Node::BOL || type == Node::EOL || type == Node::WORD_BOUNDARY ||
+            type == Node::NOT_WORD_BOUNDARY || type == Node::EMPTY) {
+            error_ = "Nothing to repeat";
+            return -1;
+        }
+        if (max != -1 && max < min) {
+            error_ = "Numbers out of order in {} quantifier";
+            return -1;
+        }
+        if (min > kMaxRepeat || max > kMaxRepeat) {
+            error_ = "Regular expression is too large";
+            return -1;
+        }
+
+        bool greedy = true;
+        if (!AtEnd() && pattern_[pos_] == '?') {
+            greedy = false;
+            pos_++;
+        }
+
+        int repeat = NewNode(Node::REPEAT);
+        nodes_[repeat].children.push_back(atom);
+        nodes_[repeat].min = min;
+        nodes_[repeat].max = max;
+        nodes_[repeat].greedy = greedy;
+        atom = repeat;
+    }
+    return atom;
+}
+
+bool RegexParser::ParseQuantifier(int& min, int& max)
+{
+    char c = pattern_[pos_];
+    if (c == '*' || c == '+' || c == '?') {
+        pos_++;
+        min = (c == '+') ? 1 : 0;
+        max = (c == '?') ? 1 : -1;
+        return true;
+    }
+    if (c != '{') {
+        return false;
+    }
+
+    // Anything that isn't a well-formed {n}, {n,} or {n,m} is a literal '{'.
+    pos_++;
+    if (!ParseNumber(min)) {
+        return false;
+    }
+    max = min;
+    if (!AtEnd() && pattern_[pos_] == ',') {
+        pos_++;
+        max = -1;
+        if (!AtEnd() && pattern_[pos_] != '}' && !ParseNumber(max)) {
+            return false;
+        }
+    }
+    if (AtEnd() || pattern_[pos_] != '}') {
+        return false;
+    }
+    pos_++;
+    return true;
+}
+
+bool RegexParser::ParseNumber(int& value)
+{
+    size_t start = pos_;
+    value = 0;
+    while (!AtEnd() && pattern_[pos_] >= '0' && pattern_[pos_] <= '9') {
+        value = std::min(value * 10 + (pattern_[pos_] - '0'), kMaxRepeat + 1);
+        pos_++;
+    }
+    return pos_ > start;
+}
+
+int RegexParser::ParseAtom()
+{
+    unsigned int c = Peek();
+    switch (c) {
+        case '(': {
+            pos_++;
+            if (++depth_ > kMaxNesting) {
+                error_ = "Too many nested groups";
+                return -1;
+            }
+            if (!AtEnd() && pattern_[pos_] == '?') {
+                if (pos_ + 1 < pattern_.length() && pattern_[pos_ + 1] == ':') {
+                    pos_ += 2;
+                } else {
+                    error_ = "Lookaround and named groups are not supported";
+                    return -1;
+                }
+            }
+            int inner = ParseAlternation();
+            if (!error_.empty()) {
+                return -1;
+            }
+            if (AtEnd() || pattern_[pos_] != ')') {
+                error_ = "Unterminated group";
+                return -1;
+            }
+            pos_++;
+            depth_--;
+            return inner;
+        }
+        case '[':
+            pos_++;
+            return ParseClass();
+        case '.':
+            pos_++;
+            return NewNode(Node::ANY);
+        case '^':
+            pos_++;
+            return NewNode(Node::BOL);
+        case '$':
+            pos_++;
+            return NewNode(Node::EOL);
+        case '\\':
+            pos_++;
+            return ParseEscape();
+        case '*':
+        case '+':
+        case '?':
+            error_ = "Nothing to repeat";
+            return -1;
+        case '{': {
+            // "{" only counts as a quantifier after an atom.
+            int min, max;
+            size_t start = pos_;
+            bool isQuantifier = ParseQuantifier(min, max);
+            pos_ = start;
+            if (isQuantifier) {
+                error_ = "Nothing to repeat";
+                return -1;
+            }
+            break;
+        }
+    }
+
+    int node = NewNode(Node::CHAR);
+    nodes_[node].c = Next();
+    return node;
+}
+
+int RegexParser::ParseEscape()
+{
+    if (AtEnd()) {
+        error_ = "\\ at end of pattern";
+        return -1;
+    }
+
+    char c = pattern_[pos_];
+    switch (c) {
+        case 'b':
+            pos_++;
+            return NewNode(Node::WORD_BOUNDARY);
+        case 'B':
+            pos_++;
+            return NewNode(Node::NOT_WORD_BOUNDARY);
+        case 'd': case 'D': case 'w': case 'W': case 's': case 'S':
+            pos_++;
+            return AddBuiltinClass(c);
+    }
+    if (c >= '1' && c <= '9') {
+        error_ = "Backreferences are not supported";
+        return -1;
+    }
+
+    Regex::CharClass unused;
+    unsigned int value;
+    if (!ParseClassEscape(unused, value)) {
+        return -1;
+    }
+    int node = NewNode(Node::CHAR);
+    nodes_[node].c = value;
+    return node;
+}
+
+// Parses an escape that stands for a single character, after the '\'.
+// Builtin classes are added to |charClass| instead, and |c| is set to 0x110000.
+bool RegexParser::ParseClassEscape(Regex::CharClass& charClass, unsigned int& c)
+{
+    char escape = pattern_[pos_++];
+    switch (escape) {
+        case 'n': c = '\n'; return true;
+        case 'r': c = '\r'; return true;
+        case 't': c = '\t'; return true;
+        case 'f': c = '\f'; return true;
+        case 'v': c = '\v'; return true;
+        case '0': c = 0; return true;
+        case 'd': case 'w': case 's':
+            AddBuiltinRanges(charClass, escape);
+            c = 0x110000;
+            return true;
+        case 'x':
+        case 'u': {
+            size_t digits = (escape == 'x') ? 2 : 4;
+            unsigned int value = 0;
+            size_t i;
+            for (i = 0; i < digits && pos_ + i < pattern_.length(); i++) {
+                int digit = HexValue(pattern_[pos_ + i]);
+                if (digit < 0) {
+                    break;
+                }
+                value = value * 16 + digit;
+            }
+            if (i == digits) {
+                pos_ += digits;
+                c = value;
+            } else {
+                // Like JavaScript, a malformed escape is the letter itself.
+                c = escape;
+            }
+            return true;
+        }
+        case 'D': case 'W': case 'S':
+            error_ = "Negated classes inside [] are not supported";
+            return false;
+    }
+
+    pos_--;
+    c = Next();
+    return true;
+}
+
+int RegexParser::ParseClass()
+{
+    Regex::CharClass charClass;
+    if (!AtEnd() && pattern_[pos_] == '^') {
+        charClass.negated = true;
+        pos_++;
+    }
+
+    while (!AtEnd() && pattern_[pos_] != ']') {
+        unsigned int low;
+        if (pattern_[pos_] == '\\') {
+            pos_++;
+            if (AtEnd()) {
+                break;
+            }
+            if (pattern_[pos_] == 'b') {
+                pos_++;
+                low = '\b';
+            } else if (!ParseClassEscape(charClass, low)) {
+                return -1;
+            }
+        } else {
+            low = Next();
+        }
+        if (low == 0x110000) {
+            continue;
+        }
+
+        unsigned int high = low;
+        if (pos_ + 1 < pattern_.length() && pattern_[pos_] == '-' && pattern_[pos_ + 1] != ']') {
+            pos_++;
+            if (pattern_[pos_] == '\\') {
+                pos_++;
+                if (!ParseClassEscape(charClass, high)) {
+                    return -1;
+                }
+                if (high == 0x110000) {
+                    error_ = "Invalid character class range";
+                    return -1;
+                }
+            } else {
+                high = Next();
+            }
+            if (high < low) {
+                error_ = "Range out of order in character class";
+                return -1;
+            }
+        }
+        charClass.ranges.push_back(Regex::Range(low, high));
+    }
+
+    if (AtEnd()) {
+        error_ = "Unterminated character class";
+        return -1;
+    }
+    pos_++;
+
+    regex_.classes_.push_back(charClass);
+    int node = NewNode(Node::CLASS);
+    nodes_[node].c = (unsigned int)regex_.classes_.size() - 1;
+    return node;
+}
+
+void RegexParser::AddBuiltinRanges(Regex::CharClass& charClass, char name)
+{
+    std::vector<Regex::Range>& ranges = charClass.ranges;
+    switch (name) {
+        case 'd': case 'D':
+            ranges.push_back(Regex::Range('0', '9'));
+            break;
+        case 'w': case 'W':
+            ranges.push_back(Regex::Range('a', 'z'));
+            ranges.push_back(Regex::Range('A', 'Z'));
+            ranges.push_back(Regex::Range('0', '9'));
+            ranges.push_back(Regex::Range('_', '_'));
+            break;
+        case 's': case 'S':
+            ranges.push_back(Regex::Range('\t', '\r'));
+            ranges.push_back(Regex::Range(' ', ' '));
+            ranges.push_back(Regex::Range(0xA0, 0xA0));
+            ranges.push_back(Regex::Range(0x1680, 0x1680));
+            ranges.push_back(Regex::Range(0x2000, 0x200A));
+            ranges.push_back(Regex::Range(0x2028, 0x2029));
+            ranges.push_back(Regex::Range(0x202F, 0x202F));
+            ranges.push_back(Regex::Range(0x205F, 0x205F));
+            ranges.push_back(Regex::Range(0x3000, 0x3000));
+            ranges.push_back(Regex::Range(0xFEFF, 0xFEFF));
+            break;
+    }
+}
+
+int RegexParser::AddBuiltinClass(char name)
+{
+    Regex::CharClass charClass;
+    AddBuiltinRanges(charClass, name);
+    charClass.negated = (name == 'D' || name == 'W' || name == 'S');
+
+    regex_.classes_.push_back(charClass);
+    int node = NewNode(Node::CLASS);
+    nodes_[node].c = (unsigned int)regex_.classes_.size() - 1;
+    return node;
+}
+
+// Picks the longest run of plain characters in the top-level sequence as the
+// literal every match must contain.
+void RegexParser::FindLiteral(int root)
+{
+    std::vector<int> items;
+    if (nodes_[root].type == Node::CONCAT) {
+        items = nodes_[root].children;
+    } else {
+        items.push_back(root);
+    }
+
+    std::string best;
+    std::string run;
+    bool allChars = !items.empty();
+    for (size_t i = 0; i <= items.size(); i++) {
+        const Node* node = (i < items.size()) ? &nodes_[items[i]] : NULL;
+        // Case-insensitive literals are matched with ASCII case folding only.
+        if (node && node->type == Node::CHAR && (!regex_.ignoreCase_ || node->c < 0x80)) {
+            unsigned int c = node->c;
+            if (regex_.ignoreCase_ && c >= 'A' && c <= 'Z') {
+                c += 'a' - 'A';
+            }
+            AppendUTF8(run, c);
+            continue;
+        }
+
+        if (node) {
+            allChars = false;
+        }
+        if (run.length() > best.length()) {
+            best = run;
+        }
+        run.clear();
+    }
+
+    regex_.literal_ = best;
+    regex_.isLiteral_ = allChars;
+}
+
+int RegexParser::Push(Regex::Inst::Op op, unsigned int arg, int x, int y)
+{
+    std::vector<Regex::Inst>& program = regex_.program_;
+    program.push_back(Regex::Inst(op, arg, x, y));
+    return (int)program.size() - 1;
+}
+
+void RegexParser::Emit(int index)
+{
+    std::vector<Regex::Inst>& program = regex_.program_;
+    if (program.size() > kMaxProgramSize) {
+        return;
+    }
+
+    const Node& node = nodes_[index];
+    switch (node.type) {
+        case Node::EMPTY:
+            break;
+        case Node::CHAR:
+            Push(Regex::Inst::CHAR, regex_.Canonicalize(node.c), 0, 0);
+            break;
+        case Node::ANY:
+            Push(Regex::Inst::ANY, 0, 0, 0);
+            break;
+        case Node::CLASS:
+            Push(Regex::Inst::CLASS, node.c, 0, 0);
+            break;
+        case Node::BOL:
+            Push(Regex::Inst::BOL, 0, 0, 0);
+            break;
+        case Node::EOL:
+            Push(Regex::Inst::EOL, 0, 0, 0);
+            break;
+        case Node::WORD_BOUNDARY:
+            Push(Regex::Inst::WORD_BOUNDARY, 0, 0, 0);
+            break;
+        case Node::NOT_WORD_BOUNDARY:
+            Push(Regex::Inst::NOT_WORD_BOUNDARY, 0, 0, 0);
+            break;
+        case Node::CONCAT:
+            for (size_t i = 0; i < node.children.size(); i++) {
+                Emit(node.children[i]);
+            }
+            break;
+        case Node::ALTERNATE: {
+            // split L1, next; L1: a; jmp end; next: split L2, ...; last; end:
+            std::vector<int> jumps;
+            for (size_t i = 0; i + 1 < node.children.size(); i++) {
+                int split = Push(Regex::Inst::SPLIT, 0, 0, 0);
+                program[split].x = split + 1;
+                Emit(node.children[i]);
+                jumps.push_back(Push(Regex::Inst::JMP, 0, 0, 0));
+                program[split].y = (int)program.size();
+            }
+            Emit(node.children.back());
+            for (size_t i = 0; i < jumps.size(); i++) {
+                program[jumps[i]].x = (int)program.size();
+            }
+            break;
+        }
+        case Node::REPEAT: {
+            int child = node.children[0];
+            int lastCopy = -1;
+            for (int i = 0; i < node.min; i++) {
+                lastCopy = (int)program.size();
+                Emit(child);
+            }
+
+            if (node.max == -1) {
+                if (lastCopy >= 0) {
+                    // x+: loop back over the last copy
+                    int split = Push(Regex::Inst::SPLIT, 0, 0, 0);
+                    program[split].x = node.greedy ? lastCopy : split + 1;
+                    program[split].y = node.greedy ? split + 1 : lastCopy;
+                } else {
+                    // x*: L: split body, end; body; jmp L; end:
+                    int split = Push(Regex::Inst::SPLIT, 0, 0, 0);
+                    Emit(child);
+                    Push(Regex::Inst::JMP, 0, split, 0);
+                    int end = (int)program.size();
+                    program[split].x = node.greedy ? split + 1 : end;
+                    program[split].y = node.greedy ? end : split + 1;
+                }
+            } else {
+                // x{0,n} is n optional copies, all skipping to the end.
+                std::vector<int> splits;
+                for (int i = node.min; i < node.max; i++) {
+                    splits.push_back(Push(Regex::Inst::SPLIT, 0, 0, 0));
+                    Emit(child);
+                }
+                int end = (int)program.size();
+                for (size_t i = 0; i < splits.size(); i++) {
+                    program[splits[i]].x = node.greedy ? splits[i] + 1 : end;
+                    program[splits[i]].y = node.greedy ? end : splits[i] + 1;
+                }
+            }
+            break;
+        }
+    }
+}
+
+Regex::Regex()
+    : isLiteral_(false)
+    , ignoreCase_(false) {
+}
+
+bool Regex::Compile(const std::string& pattern, bool ignoreCase, std::string& error)
+{
+    program_.clear();
+    classes_.clear();
+    literal_.clear();
+    isLiteral_ = false;
+    ignoreCase_ = ignoreCase;
+
+    RegexParser parser(*this, pattern);
+    return parser.Parse(error);
+}
+
+// Case folding the way JavaScript does it without the u flag: characters are
+// compared upper-cased, except that nothing outside ASCII folds into it.
+unsigned int Regex::Canonicalize(unsigned int c) const
+{
+    if (!ignoreCase_) {
+        return c;
+    }
+    if (c < 0x80) {
+        return (c >= 'a' && c <= 'z') ? c - ('a' - 'A') : c;
+    }
+    unsigned int upper = u_toupper(c);
+    return (upper < 0x80) ? c : upper;
+}
+
+bool Regex::ClassMatches(const CharClass& charClass, unsigned int c) const
+{
+    unsigned int lower = c;
+    unsigned int upper = c;
+    if (ignoreCase_) {
+        lower = u_tolower(c);
+        upper = u_toupper(c);
+    }
+
+    bool found = false;
+    for (size_t i = 0; i < charClass.ranges.size() && !found; i++) {
+        const Range& range = charClass.ranges[i];
+        found = (c >= range.first && c <= range.last) ||
+                (lower >= range.first && lower <= range.last) ||
+                (upper >= range.first && upper <= range.last);
+    }
+    return found != charClass.negated;
+}
+
+// Adds |pc| to a thread list, following jumps, splits and assertions right
+// away. Threads are added in priority order, and a pc already on the list
+// was reached by a thread that takes precedence, so it isn't added again.
+void Regex::AddThread(Threads& threads, int list, int pc, int start,
+                      const char* line, size_t length, size_t pos) const
+{
+    std::vector<unsigned int>& marks = threads.marks_[list];
+    unsigned int mark = threads.listMarks_[list];
+
+    std::vector<int> stack(1, pc);
+    while (!stack.empty()) {
+        pc = stack.back();
+        stack.pop_back();
+        if (marks[pc] == mark) {
+            continue;
+        }
+        marks[pc] = mark;
+
+        const Inst& inst = program_[pc];
+        switch (inst.op) {
+            case Inst::JMP:
+                stack.push_back(inst.x);
+                break;
+            case Inst::SPLIT:
+                // Pushed in reverse, so x is followed first.
+                stack.push_back(inst.y);
+                stack.push_back(inst.x);
+                break;
+            case Inst::BOL:
+                if (pos == 0) {
+                    stack.push_back(pc + 1);
+                }
+                break;
+            case Inst::EOL:
+                if (pos == length) {
+                    stack.push_back(pc + 1);
+                }
+                break;
+            case Inst::WORD_BOUNDARY:
+            case Inst::NOT_WORD_BOUNDARY: {
+                bool before = (pos > 0 && IsWordByte(line[pos - 1]));
+                bool after = (pos < length && IsWordByte(line[pos]));
+                if ((before != after) == (inst.op == Inst::WORD_BOUNDARY)) {
+                    stack.push_back(pc + 1);
+                }
+                break;
+            }
+            default:
+                threads.pcs_[list].push_back(pc);
+                threads.starts_[list].push_back(start);
+                break;
+        }
+    }
+}
+
+bool Regex::Search(const char* line, size_t length, size_t from, size_t& matchStart, size_t& matchEnd,
+                   Threads& threads) const
+{
+    if (program_.empty()) {
+        return false;
+    }
+    if (threads.nextMark_ > 0xFFFF0000u) {
+        threads.nextMark_ = 0;
+        threads.marks_[0].clear();
+        threads.marks_[1].clear();
+    }
+    for (int list = 0; list < 2; list++) {
+        threads.marks_[list].resize(program_.size());
+        threads.pcs_[list].clear();
+        threads.starts_[list].clear();
+        threads.listMarks_[list] = ++threads.nextMark_;
+    }
+
+    int current = 0;
+    bool matched = false;
+    size_t pos = from;
+
+    for (;;) {
+        if (!matched) {
+            // A new thread starting here, behind every thread that started earlier.
+            AddThread(threads, current, 0, (int)pos, line, length, pos);
+        }
+        if (matched && threads.pcs_[current].empty()) {
+            break;
+        }
+
+        bool atEnd = (pos >= length);
+        size_t next = pos;
+        unsigned int c = 0;
+        unsigned int canonical = 0;
+        if (!atEnd) {
+            c = DecodeUTF8(line, length, pos, next);
+            canonical = Canonicalize(c);
+        }
+
+        int other = 1 - current;
+        threads.pcs_[other].clear();
+        threads.starts_[other].clear();
+        threads.listMarks_[other] = ++threads.nextMark_;
+
+        std::vector<int>& pcs = threads.pcs_[current];
+        std::vector<int>& starts = threads.starts_[current];
+        for (size_t i = 0; i < pcs.size(); i++) {
+            const Inst& inst = program_[pcs[i]];
+            bool step = false;
+            switch (inst.op) {
+                case Inst::MATCH:
+                    matched = true;
+                    matchStart = starts[i];
+                    matchEnd = pos;
+                    break;
+                case Inst::CHAR:
+                    step = !atEnd && canonical == inst.arg;
+                    break;
+                case Inst::ANY:
+                    step = !atEnd && !IsLineTerminator(c);
+                    break;
+                case Inst::CLASS:
+                    step = !atEnd && ClassMatches(classes_[inst.arg], c);
+                    break;
+                default:
+                    break;
+            }
+            if (inst.op == Inst::MATCH) {
+                // Threads after this one have lower priority.
+                break;
+            }
+            if (step) {
+                AddThread(threads, other, pcs[i] + 1, starts[i], line, length, next);
+            }
+        }
+
+        if (atEnd) {
+            break;
+        }
+        current = other;
+        pos = next;
+    }
+
+    return matched;
+}
+
+}  // namespace appshell
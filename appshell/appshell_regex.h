@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2016 - present Adobe Systems Incorporated. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace appshell {
+
+// A regular expression matcher for native find in files.
+//
+// Patterns are compiled to a small program that is run as a Pike VM: all
+// the ways the pattern could match are followed at once, so a search takes
+// time linear in the length of the text however the pattern is written.
+// There is no backtracking to blow up on.
+//
+// The syntax is the part of JavaScript's that can be matched that way:
+// literals, ".", classes ("[a-z]", "\d", "\w", "\s" and their negations),
+// "^", "$", "\b", "\B", groups, alternation, and greedy or lazy "*", "+", "?"
+// and "{m,n}". Backreferences and lookaround are rejected. Text is matched
+// a line at a time, as UTF-8; "^" and "$" match at the ends of the line.
+class Regex {
+public:
+    Regex();
+
+    // Returns false, with a message in |error|, if |pattern| is invalid or
+    // uses syntax the matcher doesn't support.
+    bool Compile(const std::string& pattern, bool ignoreCase, std::string& error);
+
+    // Working memory for Search(). Keep one per thread and reuse it.
+    class Threads {
+    public:
+        Threads() : nextMark_(0) {
+            listMarks_[0] = listMarks_[1] = 0;
+        }
+
+    private:
+        friend class Regex;
+        std::vector<int> pcs_[2];
+        std::vector<int> starts_[2];
+        // marks_[list][pc] == listMarks_[list] when pc is already on the list.
+        std::vector<unsigned int> marks_[2];
+        unsigned int listMarks_[2];
+        unsigned int nextMark_;
+    };
+
+    // Finds the leftmost match in |line| that starts at or after |from|, a
+    // byte offset. Matches may be empty. Safe to call from several threads
+    // at once, each with its own |threads|.
+    bool Search(const char* line, size_t length, size_t from, size_t& matchStart, size_t& matchEnd,
+                Threads& threads) const;
+
+    // A string that is part of every match, in UTF-8, or "" if there is
+    // none. Lines without it can be skipped. With ignoreCase, it is lower
+    // case and only ever plain ASCII.
+    const std::string& RequiredLiteral() const { return literal_; }
+
+    // Whether the pattern matches RequiredLiteral() and nothing else, so a
+    // plain string search does the job.
+    bool IsLiteral() const { return isLiteral_; }
+
+    bool IgnoreCase() const { return ignoreCase_; }
+
+private:
+    struct Range {
+        Range(unsigned int first, unsigned int last) : first(first), last(last) {}
+        unsigned int first;
+        unsigned int last;
+    };
+
+    struct CharClass {
+        CharClass() : negated(false) {}
+        std::vector<Range> ranges;
+        bool negated;
+    };
+
+    struct Inst {
+        enum Op { CHAR, ANY, CLASS, SPLIT, JMP, MATCH, BOL, EOL, WORD_BOUNDARY, NOT_WORD_BOUNDARY };
+
+        Inst(Op op, unsigned int arg, int x, int y) : op(op), arg(arg), x(x), y(y) {}
+
+        Op op;
+        unsigned int arg;   // CHAR: the code point; CLASS: index into classes_
+        int x;              // SPLIT, JMP: target (preferred one for SPLIT)
+        int y;              // SPLIT: other target
+    };
+
+    friend class RegexParser;
+
+    unsigned int Canonicalize(unsigned int c) const;
+    bool ClassMatches(const CharClass& charClass, unsigned int c) const;
+    void AddThread(Threads& threads, int list, int pc, int start,
+                   const char* line, size_t length, size_t pos) const;
+
+    std::vector<Inst> program_;
+    std::vector<CharClass> classes_;
+    std::string literal_;
+    bool isLiteral_;
+    bool ignoreCase_;
+};
+
+}  // namespace appshell
@@ -0,0 +1,892 @@
+/*
+ * Copyright (c) 2016 - present Adobe Systems Incorporated. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "appshell_search.h"
+
+#include "appshell_extensions.h"
+#include "appshell_helpers.h"
+#include "appshell_regex.h"
+#include "appshell_search_index.h"
+#include "appshell_worker_pool.h"
+
+#include "include/base/cef_bind.h"
+#include "include/base/cef_lock.h"
+#include "include/cef_task.h"
+#include "include/wrapper/cef_closure_task.h"
+
+#include <map>
+
+#ifdef OS_LINUX
+#include "appshell_walk.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <deque>
+#endif
+
+namespace appshell_extensions {
+
+#ifdef OS_LINUX
+
+namespace {
+
+const off_t kMaxFileSize = 16 * 1024 * 1024;
+
+// Files searched concurrently by one search.
+const int kMaxRunners = appshell::kWorkerPoolSize;
+
+// Files or directories a runner handles before it goes to the back of its
+// worker's queue, so other commands aren't held up by a big search.
+const int kItemsPerTask = 64;
+
+// Matches are sent once this many have piled up, or once this long has
+// passed since the last batch, whichever comes first.
+const size_t kBatchSize = 500;
+const int64 kBatchIntervalMicroseconds = 100 * 1000;
+
+// Lines longer than this are cut down to the part around the match, starting
+// up to kPreviewContext bytes before it.
+const size_t kMaxPreviewLength = 512;
+const size_t kPreviewContext = 128;
+
+bool IsContinuationByte(char c)
+{
+    return (c & 0xC0) == 0x80;
+}
+
+// Length in UTF-16 code units of UTF-8 text, which is what CodeMirror counts
+// columns in.
+int32 UTF16Length(const char* text, size_t length)
+{
+    int32 units = 0;
+    for (size_t i = 0; i < length; i++) {
+        unsigned char c = text[i];
+        if (!IsContinuationByte(c)) {
+            units += (c >= 0xF0) ? 2 : 1;
+        }
+    }
+    return units;
+}
+
+// Finds a string in a block of text, optionally ignoring ASCII case. The
+// last result is remembered, so lines can be searched one at a time without
+// scanning the rest of the text over and over.
+class LiteralFinder {
+public:
+    LiteralFinder(const std::string& literal, bool ignoreCase)
+        : literal_(literal)
+        , ignoreCase_(ignoreCase)
+        , text_(NULL)
+        , length_(0) {
+        lower_ = literal.empty() ? 0 : literal[0];
+        upper_ = (lower_ >= 'a' && lower_ <= 'z' && ignoreCase) ? lower_ - ('a' - 'A') : lower_;
+    }
+
+    void Reset(const char* text, size_t length)
+    {
+        text_ = text;
+        length_ = length;
+        scannedFrom_ = nextHit_ = 0;
+        scanned_ = false;
+        nextLower_ = nextUpper_ = 0;
+        lowerFrom_ = upperFrom_ = 0;
+        lowerScanned_ = upperScanned_ = false;
+    }
+
+    // The first occurrence that starts at or after |from| and ends by |end|,
+    // or std::string::npos.
+    size_t Find(size_t from, size_t end)
+    {
+        if (!scanned_ || from < scannedFrom_ || from > nextHit_) {
+            nextHit_ = Scan(from);
+            scannedFrom_ = from;
+            scanned_ = true;
+        }
+        if (nextHit_ == std::string::npos || nextHit_ + literal_.length() > end) {
+            return std::string::npos;
+        }
+        return nextHit_;
+    }
+
+private:
+    size_t Scan(size_t from)
+    {
+        size_t length = literal_.length();
+        if (from + length > length_) {
+            return std::string::npos;
+        }
+
+        if (!ignoreCase_) {
+            // glibc's memmem and memchr are vectorized, so this is where
+            // most of the bytes of a search go by.
+            const void* hit = memmem(text_ + from, length_ - from, literal_.data(), length);
+            return hit ? (const char*)hit - text_ : std::string::npos;
+        }
+
+        for (;;) {
+            size_t candidate = std::min(NextByte(lower_, from, nextLower_, lowerFrom_, lowerScanned_),
+                                        NextByte(upper_, from, nextUpper_, upperFrom_, upperScanned_));
+            if (candidate == std::string::npos || candidate + length > length_) {
+                return std::string::npos;
+            }
+            if (strncasecmp(text_ + candidate + 1, literal_.data() + 1, length - 1) == 0) {
+                return candidate;
+            }
+            from = candidate + 1;
+        }
+    }
+
+    size_t NextByte(char c, size_t from, size_t& next, size_t& scannedFrom, bool& scanned)
+    {
+        if (!scanned || from < scannedFrom || (next != std::string::npos && from > next)) {
+            const void* hit = memchr(text_ + from, c, length_ - from);
+            next = hit ? (const char*)hit - text_ : std::string::npos;
+            scannedFrom = from;
+            scanned = true;
+        }
+        return next;
+    }
+
+    std::string literal_;
+    bool ignoreCase_;
+    char lower_;
+    char upper_;
+
+    const char* text_;
+    size_t length_;
+    size_t scannedFrom_;
+    size_t nextHit_;
+    bool scanned_;
+    size_t nextLower_;
+    size_t nextUpper_;
+    size_t lowerFrom_;
+    size_t upperFrom_;
+    bool lowerScanned_;
+    bool upperScanned_;
+};
+
+struct LineMatch {
+    int32 line;
+    int32 startCh;
+    int32 endCh;
+    std::string preview;
+    int32 previewOffset;
+};
+
+// Per-runner scratch space, reused from file to file.
+struct SearchBuffers {
+    SearchBuffers(const std::string& literal, bool ignoreCase) : finder(literal, ignoreCase) {}
+
+    std::string contents;
+    LiteralFinder finder;
+    appshell::Regex::Threads threads;
+    std::vector<LineMatch> matches;
+};
+
+class Search : public CefBase {
+public:
+    Search(CefRefPtr<CefBrowser> browser,
+           CefRefPtr<CefProcessMessage> response,
+           int32 searchId,
+           const ExtensionString& root,
+           const appshell::Regex& regex,
+           const SearchOptions& options)
+        : browser_(browser)
+        , response_(response)
+        , searchId_(searchId)
+        , root_(root)
+        , regex_(regex)
+        , options_(options)
+        , runners_(0)
+        , nextRunner_(0)
+        , busy_(0)
+        , matchCount_(0)
+        , fileCount_(0)
+        , lastBatchTime_(0)
+        , startTime_(0)
+        , usedIndex_(false)
+        , cancelled_(false)
+        , truncated_(false)
+        , finished_(false) {
+        if (root_.empty() || root_[root_.length() - 1] != '/') {
+            root_ += '/';
+        }
+    }
+
+    // Queues the root or the given files and starts the first runner.
+    void Start();
+
+    // Called on the UI thread.
+    void Cancel();
+
+    // Called on the worker threads. Searches queued files and reads queued
+    // directories until there are none left or the search is stopped.
+    void Run(int runner);
+
+private:
+    void PostRunner(int runner);
+    void StartRunners();
+    void ReadDirectory(const std::string& relativePath);
+    void SearchFile(const std::string& path, SearchBuffers& buffers,
+                    CefRefPtr<CefListValue>& batch, size_t& batchIndex);
+    void SearchText(const char* text, size_t length, size_t limit, SearchBuffers& buffers);
+    bool SearchLine(const char* line, size_t length, int32 lineNumber, size_t limit, SearchBuffers& buffers,
+                    size_t lineOffset);
+    void SendBatch(CefRefPtr<CefListValue>& batch, size_t& batchIndex);
+    void SendBatchIfDue(CefRefPtr<CefListValue>& batch, size_t& batchIndex);
+    void Finish(int32 error);
+
+    CefRefPtr<CefBrowser> browser_;
+    CefRefPtr<CefProcessMessage> response_;
+    int32 searchId_;
+    ExtensionString root_;
+    const appshell::Regex regex_;
+    SearchOptions options_;
+
+    // Shared between the UI thread and the runners.
+    base::Lock lock_;
+    std::deque<std::string> files_;         // full paths
+    std::deque<std::string> directories_;   // relative to the root, ending with a slash
+    int runners_;
+    int nextRunner_;
+    int busy_;
+    int32 matchCount_;
+    int32 fileCount_;
+    int64 lastBatchTime_;
+    int64 startTime_;
+    bool usedIndex_;
+    bool cancelled_;
+    bool truncated_;
+    bool finished_;
+
+    IMPLEMENT_REFCOUNTING(Search);
+};
+
+typedef std::pair<int, int32> SearchKey;
+typedef std::map<SearchKey, CefRefPtr<Search> > SearchMap;
+
+// Searches that haven't finished yet. UI thread only.
+SearchMap g_searches;
+
+void StartTask(CefRefPtr<Search> search)
+{
+    search->Start();
+}
+
+void RunTask(CefRefPtr<Search> search, int runner)
+{
+    search->Run(runner);
+}
+
+void RemoveSearch(SearchKey key, CefRefPtr<Search> search)
+{
+    SearchMap::iterator it = g_searches.find(key);
+    if (it != g_searches.end() && it->second.get() == search.get()) {
+        g_searches.erase(it);
+    }
+}
+
+void Search::Start()
+{
+    startTime_ = appshell::GetMonotonicMicroseconds();
+    if (options_.useIndex && options_.files.empty()) {
+        usedIndex_ = FindSearchIndexCandidates(root_, regex_.RequiredLiteral(), options_.exclude, options_.files);
+    }
+
+    if (options_.files.empty() && !usedIndex_) {
+        std::string root = (root_.length() > 1) ? root_.substr(0, root_.length() - 1) : root_;
+
+        struct stat statbuf;
+        if (stat(root.c_str(), &statbuf) == -1) {
+            Finish((errno == ENOENT || errno == ENOTDIR) ? ERR_NOT_FOUND : ERR_CANT_READ);
+            return;
+        }
+        if (!S_ISDIR(statbuf.st_mode)) {
+            Finish(ERR_NOT_DIRECTORY);
+            return;
+        }
+    }
+
+    {
+        base::AutoLock lock(lock_);
+        lastBatchTime_ = appshell::GetMonotonicMicroseconds();
+        if (options_.files.empty() && !usedIndex_) {
+            directories_.push_back("");
+        } else {
+            files_.assign(options_.files.begin(), options_.files.end());
+            options_.files.clear();
+        }
+        runners_ = 1;
+        nextRunner_ = 1;
+    }
+    StartRunners();
+    Run(0);
+}
+
+void Search::Cancel()
+{
+    base::AutoLock lock(lock_);
+    cancelled_ = true;
+}
+
+// Each runner keeps to one worker, so a search never takes more than
+// kMaxRunners threads.
+void Search::PostRunner(int runner)
+{
+    char key[32];
+    snprintf(key, sizeof(key), "\n%d", runner);
+    appshell::PostWorkerTask(root_ + key, base::Bind(&RunTask, CefRefPtr<Search>(this), runner));
+}
+
+// Adds runners while there is more queued than the current ones can share.
+void Search::StartRunners()
+{
+    std::vector<int> newRunners;
+    {
+        base::AutoLock lock(lock_);
+        while (runners_ < kMaxRunners && files_.size() + directories_.size() > (size_t)runners_) {
+            runners_++;
+            newRunners.push_back(nextRunner_++);
+        }
+    }
+
+    for (size_t i = 0; i < newRunners.size(); i++) {
+        PostRunner(newRunners[i]);
+    }
+}
+
+void Search::Run(int runner)
+{
+    CefRefPtr<CefListValue> batch = CefListValue::Create();
+    size_t batchIndex = 0;
+    SearchBuffers buffers(regex_.RequiredLiteral(), regex_.IgnoreCase());
+
+    for (int items = 0; items < kItemsPerTask; items++) {
+        std::string path;
+        bool isFile;
+        {
+            base::AutoLock lock(lock_);
+            if (cancelled_ || truncated_ || (files_.empty() && directories_.empty())) {
+                break;
+            }
+            // Files first, so matches start coming in before the whole tree
+            // has been read.
+            isFile = !files_.empty();
+            std::deque<std::string>& queue = isFile ? files_ : directories_;
+            path = queue.front();
+            queue.pop_front();
+            busy_++;
+        }
+
+        if (isFile) {
+            SearchFile(path, buffers, batch, batchIndex);
+        } else {
+            ReadDirectory(path);
+        }
+
+        {
+            base::AutoLock lock(lock_);
+            busy_--;
+        }
+
+        // Checked after every item, since a run of files without matches or
+        // a big directory can take well past the interval.
+        SendBatchIfDue(batch, batchIndex);
+    }
+
+    // Matches go out before the runner can be counted as done, so they always
+    // reach the renderer ahead of the final response. They also go out before
+    // the runner is reposted, since it may wait behind other work on its
+    // worker for a while.
+    SendBatch(batch, batchIndex);
+
+    bool more = false;
+    bool done = false;
+    int32 error = NO_ERROR;
+    {
+        base::AutoLock lock(lock_);
+        if (!cancelled_ && !truncated_ && !(files_.empty() && directories_.empty())) {
+            more = true;
+        } else {
+            runners_--;
+            done = !finished_ && runners_ == 0 && busy_ == 0;
+            if (done) {
+                finished_ = true;
+                error = cancelled_ ? ERR_CANCELLED : NO_ERROR;
+            }
+        }
+    }
+
+    if (more) {
+        // Let whatever else is queued on this worker run first.
+        PostRunner(runner);
+    } else if (done) {
+        Finish(error);
+    }
+}
+
+void Search::ReadDirectory(const std::string& relativePath)
+{
+    std::string directory = root_ + relativePath;
+
+    int dirfd = open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    DIR* dp = (dirfd == -1) ? NULL : fdopendir(dirfd);
+    if (dp == NULL) {
+        if (dirfd != -1) {
+            close(dirfd);
+        }
+        return;
+    }
+
+    std::vector<std::string> files;
+    std::vector<std::string> subdirectories;
+    struct dirent* entry;
+
+    while ((entry = readdir(dp)) != NULL) {
+        const char* name = entry->d_name;
+        if (!strcmp(name, ".") || !strcmp(name, "..")) {
+            continue;
+        }
+
+        unsigned char type = entry->d_type;
+        if (type != DT_UNKNOWN && type != DT_DIR && type != DT_REG && type != DT_LNK) {
+            continue;
+        }
+
+        std::string entryPath = relativePath + name;
+        if (IsExcludedPath(options_.exclude, name, entryPath)) {
+            continue;
+        }
+
+        // Symlinked files are searched, but symlinked directories aren't
+        // entered, so nothing is searched twice.
+        if (type == DT_UNKNOWN || type == DT_LNK) {
+            struct stat statbuf;
+            if (fstatat(dirfd, name, &statbuf, AT_SYMLINK_NOFOLLOW) == -1) {
+                continue;
+            }
+            if (S_ISLNK(statbuf.st_mode)) {
+                type = (fstatat(dirfd, name, &statbuf, 0) == 0 && S_ISREG(statbuf.st_mode)) ? DT_REG : DT_UNKNOWN;
+            } else {
+                type = S_ISDIR(statbuf.st_mode) ? DT_DIR : S_ISREG(statbuf.st_mode) ? DT_REG : DT_UNKNOWN;
+            }
+        }
+
+        if (type == DT_REG) {
+            files.push_back(directory + name);
+        } else if (type == DT_DIR) {
+            subdirectories.push_back(entryPath + "/");
+        }
+    }
+
+    // Also closes dirfd.
+    closedir(dp);
+
+    {
+        base::AutoLock lock(lock_);
+        files_.insert(files_.end(), files.begin(), files.end());
+        directories_.insert(directories_.end(), subdirectories.begin(), subdirectories.end());
+    }
+    StartRunners();
+}
+
+void Search::SearchFile(const std::string& path, SearchBuffers& buffers,
+                        CefRefPtr<CefListValue>& batch, size_t& batchIndex)
+{
+    size_t limit;
+    {
+        base::AutoLock lock(lock_);
+        limit = (options_.maxResults > 0) ? (size_t)(options_.maxResults - matchCount_) : std::string::npos;
+        fileCount_++;
+    }
+
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return;
+    }
+
+    struct stat statbuf;
+    if (fstat(fd, &statbuf) == -1 || !S_ISREG(statbuf.st_mode) || statbuf.st_size > kMaxFileSize) {
+        close(fd);
+        return;
+    }
+
+    // The size is only a hint; the file may change while it's read.
+    std::string& contents = buffers.contents;
+    contents.resize((size_t)statbuf.st_size + 1);
+    size_t length = 0;
+    for (;;) {
+        if (length == contents.size()) {
+            if (length > (size_t)kMaxFileSize) {
+                break;
+            }
+            contents.resize(length * 2);
+        }
+        ssize_t count = read(fd, &contents[length], contents.size() - length);
+        if (count == -1 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            break;
+        }
+        length += count;
+    }
+    close(fd);
+
+    const char* text = contents.data();
+    if (length > (size_t)kMaxFileSize || memchr(text, '\0', length) != NULL) {
+        // Too big, or binary
+        return;
+    }
+    if (length >= 3 && !memcmp(text, "\xEF\xBB\xBF", 3)) {
+        text += 3;
+        length -= 3;
+    }
+
+    buffers.matches.clear();
+    SearchText(text, length, limit, buffers);
+    if (buffers.matches.empty()) {
+        return;
+    }
+
+    size_t count = buffers.matches.size();
+    {
+        base::AutoLock lock(lock_);
+        if (options_.maxResults > 0) {
+            // Another runner may have taken some of what was left meanwhile.
+            count = std::min(count, (size_t)(options_.maxResults - matchCount_));
+            if (matchCount_ + (int32)count >= options_.maxResults) {
+                truncated_ = true;
+            }
+        }
+        matchCount_ += (int32)count;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        const LineMatch& match = buffers.matches[i];
+        batch->SetString(batchIndex++, path);
+        batch->SetInt(batchIndex++, match.line);
+        batch->SetInt(batchIndex++, match.startCh);
+        batch->SetInt(batchIndex++, match.endCh);
+        batch->SetString(batchIndex++, match.preview);
+        batch->SetInt(batchIndex++, match.previewOffset);
+    }
+
+    if (batchIndex >= kBatchSize * SEARCH_MATCH_STRIDE) {
+        SendBatch(batch, batchIndex);
+    }
+}
+
+// Collects up to |limit| matches in |text| into buffers.matches.
+void Search::SearchText(const char* text, size_t length, size_t limit, SearchBuffers& buffers)
+{
+    LiteralFinder& finder = buffers.finder;
+    bool prefilter = !regex_.RequiredLiteral().empty();
+    finder.Reset(text, length);
+
+    size_t pos = 0;             // where the next line to look at starts
+    size_t counted = 0;         // newlines before here have been counted
+    int32 lineNumber = 0;
+
+    while (pos < length || (pos == 0 && length == 0)) {
+        size_t lineStart = pos;
+        if (prefilter) {
+            // Skip straight to the next line that could match.
+            size_t hit = finder.Find(pos, length);
+            if (hit == std::string::npos) {
+                break;
+            }
+            const void* newline = memrchr(text + pos, '\n', hit - pos);
+            if (newline) {
+                lineStart = (const char*)newline - text + 1;
+            }
+        }
+
+        const void* newline = memchr(text + lineStart, '\n', length - lineStart);
+        size_t lineEnd = newline ? (const char*)newline - text : length;
+
+        while (counted < lineStart) {
+            const void* next = memchr(text + counted, '\n', lineStart - counted);
+            if (!next) {
+                break;
+            }
+            lineNumber++;
+            counted = (const char*)next - text + 1;
+        }
+        counted = lineStart;
+
+        size_t contentEnd = lineEnd;
+        if (contentEnd > lineStart && text[contentEnd - 1] == '\r') {
+            contentEnd--;
+        }
+
+        if (!SearchLine(text + lineStart, contentEnd - lineStart, lineNumber, limit, buffers, lineStart)) {
+            break;
+        }
+        if (lineEnd == length) {
+            break;
+        }
+        pos = lineEnd + 1;
+    }
+}
+
+// Adds the matches in one line. Returns false once |limit| has been reached.
+bool Search::SearchLine(const char* line, size_t length, int32 lineNumber, size_t limit, SearchBuffers& buffers,
+                        size_t lineOffset)
+{
+    std::vector<LineMatch>& matches = buffers.matches;
+    size_t from = 0;
+    size_t columnBytes = 0;     // UTF-16 length of the line up to here has been counted
+    int32 column = 0;
+
+    while (from <= length) {
+        size_t matchStart, matchEnd;
+        if (regex_.IsLiteral()) {
+            size_t hit = buffers.finder.Find(lineOffset + from, lineOffset + length);
+            if (hit == std::string::npos) {
+                break;
+            }
+            matchStart = hit - lineOffset;
+            matchEnd = matchStart + regex_.RequiredLiteral().length();
+        } else if (!regex_.Search(line, length, from, matchStart, matchEnd, buffers.threads)) {
+            break;
+        }
+
+        if (matchEnd == matchStart) {
+            // Empty matches, like "x*" between other characters, aren't useful
+            // search results.
+            from = matchStart + 1;
+            while (from < length && IsContinuationByte(line[from])) {
+                from++;
+            }
+            continue;
+        }
+
+        LineMatch match;
+        match.line = lineNumber;
+        column += UTF16Length(line + columnBytes, matchStart - columnBytes);
+        columnBytes = matchStart;
+        match.startCh = column;
+        match.endCh = column + UTF16Length(line + matchStart, matchEnd - matchStart);
+
+        if (length <= kMaxPreviewLength) {
+            match.preview.assign(line, length);
+            match.previewOffset = 0;
+        } else {
+            size_t start = (matchStart > kPreviewContext) ? matchStart - kPreviewContext : 0;
+            while (start > 0 && IsContinuationByte(line[start])) {
+                start--;
+            }
+            size_t end = std::min(length, std::max(matchEnd, start + kMaxPreviewLength));
+            while (end < length && IsContinuationByte(line[end])) {
+                end++;
+            }
+            match.preview.assign(line + start, end - start);
+            match.previewOffset = column - UTF16Length(line + start, matchStart - start);
+        }
+
+        matches.push_back(match);
+        if (matches.size() >= limit) {
+            return false;
+        }
+        from = matchEnd;
+    }
+    return true;
+}
+
+void Search::SendBatch(CefRefPtr<CefListValue>& batch, size_t& batchIndex)
+{
+    if (batchIndex == 0) {
+        return;
+    }
+
+    {
+        base::AutoLock lock(lock_);
+        lastBatchTime_ = appshell::GetMonotonicMicroseconds();
+    }
+
+    // Progress callbacks get null in place of the error code, which tells the
+    // JS side apart from the final callback.
+    CefRefPtr<CefProcessMessage> message = CefProcessMessage::Create("invokeProgressCallback");
+    CefRefPtr<CefListValue> messageArgs = message->GetArgumentList();
+    messageArgs->SetInt(0, response_->GetArgumentList()->GetInt(0));
+    messageArgs->SetNull(1);
+    messageArgs->SetList(2, batch);
+    SendResponse(browser_, message);
+
+    batch = CefListValue::Create();
+    batchIndex = 0;
+}
+
+// Sends |batch| if it has anything in it and the interval has passed since
+// the last one.
+void Search::SendBatchIfDue(CefRefPtr<CefListValue>& batch, size_t& batchIndex)
+{
+    if (batchIndex == 0) {
+        return;
+    }
+
+    bool due;
+    {
+        base::AutoLock lock(lock_);
+        due = appshell::GetMonotonicMicroseconds() - lastBatchTime_ >= kBatchIntervalMicroseconds;
+    }
+    if (due) {
+        SendBatch(batch, batchIndex);
+    }
+}
+
+void Search::Finish(int32 error)
+{
+    int32 matchCount;
+    int32 fileCount;
+    bool truncated;
+    {
+        base::AutoLock lock(lock_);
+        finished_ = true;
+        files_.clear();
+        directories_.clear();
+        matchCount = matchCount_;
+        fileCount = fileCount_;
+        truncated = truncated_;
+    }
+
+    CefRefPtr<CefListValue> responseArgs = response_->GetArgumentList();
+    responseArgs->SetInt(1, error);
+    responseArgs->SetInt(2, matchCount);
+    responseArgs->SetInt(3, fileCount);
+    responseArgs->SetBool(4, truncated);
+    // Recorded first, so the figures include this search by the time its
+    // callback runs.
+    if (usedIndex_) {
+        RecordSearchIndexQuery(root_, (appshell::GetMonotonicMicroseconds() - startTime_) / 1000.0);
+    }
+    SendResponse(browser_, response_);
+
+    CefPostTask(TID_UI, base::Bind(&RemoveSearch, SearchKey(browser_->GetIdentifier(), searchId_),
+                                   CefRefPtr<Search>(this)));
+}
+
+// Turns a plain search string into a pattern that matches it literally.
+std::string EscapePattern(const std::string& query)
+{
+    std::string pattern;
+    for (size_t i = 0; i < query.length(); i++) {
+        if (query[i] != '\0' && strchr("\\^$.|?*+()[]{}", query[i])) {
+            pattern += '\\';
+        }
+        pattern += query[i];
+    }
+    return pattern;
+}
+
+}  // namespace
+
+void StartSearch(CefRefPtr<CefBrowser> browser,
+                 CefRefPtr<CefProcessMessage> response,
+                 int32 searchId,
+                 const ExtensionString& root,
+                 const std::string& query,
+                 const SearchOptions& options)
+{
+    SearchKey key(browser->GetIdentifier(), searchId);
+
+    // Ids are handed out by the renderer, which starts over after a reload.
+    SearchMap::iterator existing = g_searches.find(key);
+    if (existing != g_searches.end()) {
+        existing->second->Cancel();
+    }
+
+    appshell::Regex regex;
+    std::string error;
+    if (!regex.Compile(options.isRegexp ? query : EscapePattern(query), !options.isCaseSensitive, error)) {
+        CefRefPtr<CefListValue> responseArgs = response->GetArgumentList();
+        responseArgs->SetInt(1, ERR_INVALID_PARAMS);
+        responseArgs->SetInt(2, 0);
+        responseArgs->SetInt(3, 0);
+        responseArgs->SetBool(4, false);
+        responseArgs->SetString(5, error);
+        SendResponse(browser, response);
+        return;
+    }
+
+    CefRefPtr<Search> search = new Search(browser, response, searchId, root, regex, options);
+    g_searches[key] = search;
+    appshell::PostWorkerTask(root, base::Bind(&StartTask, search));
+}
+
+void CancelSearch(CefRefPtr<CefBrowser> browser, int32 searchId)
+{
+    SearchMap::iterator it = g_searches.find(SearchKey(browser->GetIdentifier(), searchId));
+    if (it != g_searches.end()) {
+        it->second->Cancel();
+    }
+}
+
+void CancelBrowserSearches(CefRefPtr<CefBrowser> browser)
+{
+    SearchMap::iterator it = g_searches.begin();
+    while (it != g_searches.end()) {
+        if (it->first.first == browser->GetIdentifier()) {
+            it->second->Cancel();
+            g_searches.erase(it++);
+        } else {
+            ++it;
+        }
+    }
+}
+
+#else
+
+void StartSearch(CefRefPtr<CefBrowser> browser,
+                 CefRefPtr<CefProcessMessage> response,
+                 int32 searchId,
+                 const ExtensionString& root,
+                 const std::string& query,
+                 const SearchOptions& options)
+{
+    CefRefPtr<CefListValue> responseArgs = response->GetArgumentList();
+    responseArgs->SetInt(1, ERR_NOT_SUPPORTED);
+    responseArgs->SetInt(2, 0);
+    responseArgs->SetInt(3, 0);
+    responseArgs->SetBool(4, false);
+    SendResponse(browser, response);
+}
+
+void CancelSearch(CefRefPtr<CefBrowser> browser, int32 searchId)
+{
+}
+
+void CancelBrowserSearches(CefRefPtr<CefBrowser> browser)
+{
+}
+
+#endif
+
+}  // namespace appshell_extensions
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2016 - present Adobe Systems Incorporated. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "include/cef_browser.h"
+#include "include/cef_process_message.h"
+
+#include "appshell_extensions_platform.h"
+
+#include <string>
+#include <vector>
+
+namespace appshell_extensions {
+
+// Find in files for appshell.fs.search().
+//
+// The tree is walked and the files are searched on the worker pool, several at
+// a time. Files that can't contain a match are ruled out with a plain string
+// search for the part of the query every match must contain, and only the
+// lines around its hits are run through the regular expression (see
+// appshell::Regex). Binary files (any NUL byte) and files over 16MB are
+// skipped.
+//
+// Matches go to the renderer in batches as "invokeProgressCallback" messages,
+// as a flat list of SEARCH_MATCH_STRIDE values per match: the full path, the
+// 0-based line, the start and end columns in UTF-16 code units, the line
+// text and the column the text starts at. Long lines are cut down to the part
+// around the match, in which case the last value isn't 0. The final
+// "invokeCallback" follows once every file has been searched, the result
+// limit has been reached or the search was cancelled.
+//
+// Only implemented on Linux; other platforms respond with ERR_NOT_SUPPORTED.
+//
+// All of these functions must be called on the UI thread.
+
+static const int SEARCH_MATCH_STRIDE = 6;
+
+struct SearchOptions {
+    SearchOptions() : isRegexp(false), isCaseSensitive(false), maxResults(0), useIndex(false) {}
+
+    bool isRegexp;
+    bool isCaseSensitive;
+
+    // Glob patterns of files and directories to leave out, as for
+    // WalkOptions::exclude.
+    std::vector<std::string> exclude;
+
+    // If not empty, these files are searched instead of walking the root.
+    std::vector<ExtensionString> files;
+
+    // Stop once this many matches have been found; 0 for no limit.
+    int32 maxResults;
+
+    // Only search the files the root's trigram index says could match, if
+    // an index is loaded (see appshell_search_index.h).
+    bool useIndex;
+};
+
+// Starts searching |root| for |query|. |response| is the final response
+// message and already holds the callback id. The response gets the error code,
+// the number of matches, the number of files searched and whether the search
+// stopped at maxResults. An invalid regular expression fails right away with
+// ERR_INVALID_PARAMS and the parser's message.
+void StartSearch(CefRefPtr<CefBrowser> browser,
+                 CefRefPtr<CefProcessMessage> response,
+                 int32 searchId,
+                 const ExtensionString& root,
+                 const std::string& query,
+                 const SearchOptions& options);
+
+// Stops search |searchId|. Its callback gets ERR_CANCELLED.
+void CancelSearch(CefRefPtr<CefBrowser> browser, int32 searchId);
+
+// Stops every search of |browser|. Called when the browser closes.
+void CancelBrowserSearches(CefRefPtr<CefBrowser> browser);
+
+}  // namespace appshell_extensions
@@ -0,0 +1,1160 @@
+/*
+ * Copyright (c) 2016 - present Adobe Systems Incorporated. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "appshell_search_index.h"
+
+#include "appshell_extensions.h"
+#include "appshell_helpers.h"
+#include "appshell_worker_pool.h"
+
+#include "include/base/cef_bind.h"
+#include "include/base/cef_lock.h"
+#include "include/cef_task.h"
+#include "include/wrapper/cef_closure_task.h"
+
+#ifdef OS_LINUX
+#include "appshell_walk.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <map>
+#endif
+
+namespace appshell_extensions {
+
+#ifdef OS_LINUX
+
+namespace {
+
+// The index file starts with an IndexHeader, followed by the IndexFile
+// entries sorted by path, the IndexTrigram entries sorted by trigram, the
+// posting lists (ascending file numbers, as uint32_t) and finally the
+// strings: the root, then the paths relative to it. Everything is in the
+// machine's byte order; the file is only ever read where it was written.
+const char kIndexMagic[4] = { 'B', 'T', 'R', 'I' };
+const uint32_t kIndexVersion = 1;
+
+struct IndexHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t fileCount;
+    uint32_t trigramCount;
+    uint64_t filesOffset;
+    uint64_t trigramsOffset;
+    uint64_t postingsOffset;
+    uint64_t postingCount;
+    uint64_t stringsOffset;
+    uint64_t stringsLength;
+    uint32_t rootLength;
+    uint32_t reserved;
+};
+
+struct IndexFile {
+    uint64_t pathOffset;    // into the strings
+    uint32_t pathLength;
+    int32_t mtimeNsec;
+    int64_t mtimeSec;
+    uint64_t size;
+};
+
+struct IndexTrigram {
+    uint32_t trigram;
+    uint32_t count;
+    uint64_t offset;        // into the postings, in entries
+};
+
+// Same limit as appshell.fs.search(); bigger files are never searched.
+const off_t kMaxIndexedFileSize = 16 * 1024 * 1024;
+
+// Fewer changed files than this aren't worth another worker.
+const size_t kMinFilesPerTask = 64;
+
+// Three bytes make a trigram.
+const uint32_t kTrigramCount = 1 << 24;
+
+uint32_t FoldByte(unsigned char c)
+{
+    return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+// Fibonacci hashing: the top |32 - shift| bits of the product pick the slot.
+size_t HashTrigram(uint32_t trigram, int shift)
+{
+    return (uint32_t)(trigram * 2654435769u) >> shift;
+}
+
+// Marks a free slot in TrigramCounts. Trigrams are below 2^24, so this is
+// never one.
+const uint32_t kNoTrigram = 0xffffffff;
+
+// A count for each trigram that occurs, in an open-addressing hash table.
+// A project only has a small part of the 2^24 possible trigrams, so this is
+// much smaller than a table with a slot for each of them.
+class TrigramCounts {
+public:
+    TrigramCounts() : slots_(1 << 10, Slot()), shift_(32 - 10), size_(0) {}
+
+    // The count for |trigram|, which starts out 0.
+    uint32_t& operator[](uint32_t trigram)
+    {
+        size_t slot = Find(trigram);
+        if (slots_[slot].trigram == kNoTrigram) {
+            if ((size_ + 1) * 2 > slots_.size()) {
+                Grow();
+                slot = Find(trigram);
+            }
+            slots_[slot].trigram = trigram;
+            size_++;
+        }
+        return slots_[slot].count;
+    }
+
+private:
+    // Kept side by side, so a lookup touches one cache line.
+    struct Slot {
+        Slot() : trigram(kNoTrigram), count(0) {}
+        uint32_t trigram;
+        uint32_t count;
+    };
+
+    size_t Find(uint32_t trigram) const
+    {
+        size_t mask = slots_.size() - 1;
+        size_t slot = HashTrigram(trigram, shift_);
+        while (slots_[slot].trigram != kNoTrigram && slots_[slot].trigram != trigram) {
+            slot = (slot + 1) & mask;
+        }
+        return slot;
+    }
+
+    void Grow()
+    {
+        std::vector<Slot> slots(slots_.size() * 2, Slot());
+        slots.swap(slots_);
+        shift_--;
+        for (size_t i = 0; i < slots.size(); i++) {
+            if (slots[i].trigram != kNoTrigram) {
+                slots_[Find(slots[i].trigram)] = slots[i];
+            }
+        }
+    }
+
+    std::vector<Slot> slots_;
+    int shift_;
+    size_t size_;
+};
+
+// The trigrams seen in one file, checked for every byte read. Each slot keeps
+// a trigram in its low 24 bits and the generation it was added in above
+// them, so Clear() only has to move to the next generation, and slots stay
+// small enough for a typical file's table to sit in the cache.
+class TrigramSet {
+public:
+    TrigramSet() : slots_(1 << 10, 0), shift_(32 - 10), size_(0), generation_(1) {}
+
+    // Adds |trigram|, and returns false if it was already there.
+    bool Insert(uint32_t trigram)
+    {
+        uint32_t key = (generation_ << 24) | trigram;
+        size_t slot = Find(key);
+        if (slots_[slot] == key) {
+            return false;
+        }
+        if ((size_ + 1) * 2 > slots_.size()) {
+            Grow();
+            slot = Find(key);
+        }
+        slots_[slot] = key;
+        size_++;
+        return true;
+    }
+
+    void Clear()
+    {
+        size_ = 0;
+        if (++generation_ == 256) {
+            std::fill(slots_.begin(), slots_.end(), 0);
+            generation_ = 1;
+        }
+    }
+
+private:
+    size_t Find(uint32_t key) const
+    {
+        size_t mask = slots_.size() - 1;
+        size_t slot = HashTrigram(key & (kTrigramCount - 1), shift_);
+        while ((slots_[slot] >> 24) == generation_ && slots_[slot] != key) {
+            slot = (slot + 1) & mask;
+        }
+        return slot;
+    }
+
+    void Grow()
+    {
+        std::vector<uint32_t> slots(slots_.size() * 2, 0);
+        slots.swap(slots_);
+        shift_--;
+        for (size_t i = 0; i < slots.size(); i++) {
+            if ((slots[i] >> 24) == generation_) {
+                slots_[Find(slots[i])] = slots[i];
+            }
+        }
+    }
+
+    std::vector<uint32_t> slots_;
+    int shift_;
+    size_t size_;
+    uint32_t generation_;
+};
+
+// An index file mapped into memory. Immutable, so it can be shared between
+// threads; an update maps a new file and this one goes away once the last
+// search using it is done.
+//
+// Only the header and the bounds of the tables are checked when the file is
+// opened, since going over every entry of a big index would take longer than
+// the search it is for. Paths and posting lists are checked as they are read,
+// so a damaged entry is skipped instead of reading outside the mapping.
+class MappedIndex : public CefBase {
+public:
+    // Returns NULL if there is no index at |path|, or its header is damaged
+    // or it was written for another root or version.
+    static CefRefPtr<MappedIndex> Open(const std::string& path, const std::string& root);
+
+    ~MappedIndex()
+    {
+        munmap(data_, length_);
+    }
+
+    uint32_t FileCount() const { return header_->fileCount; }
+    uint32_t TrigramCount() const { return header_->trigramCount; }
+    size_t Size() const { return length_; }
+
+    const IndexFile& File(uint32_t i) const { return files_[i]; }
+
+    // The path of file |i|, or an empty string if there is no such file or
+    // its entry is damaged.
+    std::string FilePath(uint32_t i) const
+    {
+        if (i >= header_->fileCount) {
+            return std::string();
+        }
+        const IndexFile& file = files_[i];
+        if (file.pathOffset > header_->stringsLength || header_->stringsLength - file.pathOffset < file.pathLength) {
+            return std::string();
+        }
+        return std::string(strings_ + file.pathOffset, file.pathLength);
+    }
+
+    const IndexTrigram& Trigram(uint32_t i) const { return trigrams_[i]; }
+
+    // The |trigram.count| file numbers for |trigram|, or NULL if the list
+    // runs past the end of the postings. The numbers themselves aren't
+    // checked; callers compare them with FileCount().
+    const uint32_t* Postings(const IndexTrigram& trigram) const
+    {
+        if (trigram.offset > header_->postingCount || header_->postingCount - trigram.offset < trigram.count) {
+            return NULL;
+        }
+        return postings_ + trigram.offset;
+    }
+
+    // The entry for |trigram|, or NULL if no file contains it.
+    const IndexTrigram* FindTrigram(uint32_t trigram) const
+    {
+        uint32_t low = 0;
+        uint32_t high = header_->trigramCount;
+        while (low < high) {
+            uint32_t middle = low + (high - low) / 2;
+            if (trigrams_[middle].trigram < trigram) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        return (low < header_->trigramCount && trigrams_[low].trigram == trigram) ? &trigrams_[low] : NULL;
+    }
+
+    // Whether every path and posting list is in bounds and every posting is
+    // a file number. An update goes over all of them anyway, so it checks
+    // this first instead of carrying damage over.
+    bool HasValidEntries() const;
+
+private:
+    MappedIndex(void* data, size_t length)
+        : data_(data)
+        , length_(length) {
+        const char* bytes = (const char*)data;
+        header_ = (const IndexHeader*)bytes;
+        files_ = (const IndexFile*)(bytes + header_->filesOffset);
+        trigrams_ = (const IndexTrigram*)(bytes + header_->trigramsOffset);
+        postings_ = (const uint32_t*)(bytes + header_->postingsOffset);
+        strings_ = bytes + header_->stringsOffset;
+    }
+
+    bool IsValid(const std::string& root) const;
+
+    void* data_;
+    size_t length_;
+    const IndexHeader* header_;
+    const IndexFile* files_;
+    const IndexTrigram* trigrams_;
+    const uint32_t* postings_;
+    const char* strings_;
+
+    IMPLEMENT_REFCOUNTING(MappedIndex);
+};
+
+CefRefPtr<MappedIndex> MappedIndex::Open(const std::string& path, const std::string& root)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return NULL;
+    }
+
+    struct stat statbuf;
+    void* data = MAP_FAILED;
+    if (fstat(fd, &statbuf) == 0 && (size_t)statbuf.st_size >= sizeof(IndexHeader)) {
+        data = mmap(NULL, statbuf.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    // The mapping stays valid without the descriptor.
+    close(fd);
+    if (data == MAP_FAILED) {
+        return NULL;
+    }
+
+    CefRefPtr<MappedIndex> index = new MappedIndex(data, statbuf.st_size);
+    return index->IsValid(root) ? index : CefRefPtr<MappedIndex>();
+}
+
+// Checks the header, and that each table fits in the file, so a truncated
+// index is rejected before anything else is read.
+bool MappedIndex::IsValid(const std::string& root) const
+{
+    const IndexHeader& header = *header_;
+    if (memcmp(header.magic, kIndexMagic, sizeof(kIndexMagic)) || header.version != kIndexVersion) {
+        return false;
+    }
+
+    uint64_t length = length_;
+    if (header.filesOffset % 8 || header.filesOffset > length ||
+        (length - header.filesOffset) / sizeof(IndexFile) < header.fileCount ||
+        header.trigramsOffset % 8 || header.trigramsOffset > length ||
+        (length - header.trigramsOffset) / sizeof(IndexTrigram) < header.trigramCount ||
+        header.postingsOffset % 4 || header.postingsOffset > length ||
+        (length - header.postingsOffset) / sizeof(uint32_t) < header.postingCount ||
+        header.stringsOffset > length || length - header.stringsOffset < header.stringsLength ||
+        header.rootLength > header.stringsLength) {
+        return false;
+    }
+
+    return root.compare(0, std::string::npos, strings_, header.rootLength) == 0;
+}
+
+bool MappedIndex::HasValidEntries() const
+{
+    for (uint32_t i = 0; i < header_->fileCount; i++) {
+        const IndexFile& file = files_[i];
+        if (file.pathOffset > header_->stringsLength || header_->stringsLength - file.pathOffset < file.pathLength) {
+            return false;
+        }
+    }
+
+    for (uint32_t i = 0; i < header_->trigramCount; i++) {
+        const IndexTrigram& trigram = trigrams_[i];
+        const uint32_t* postings = Postings(trigram);
+        if (postings == NULL) {
+            return false;
+        }
+        for (uint32_t j = 0; j < trigram.count; j++) {
+            if (postings[j] >= header_->fileCount) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+struct IndexState {
+    IndexState()
+        : buildTimeMs(0)
+        , filesRead(0)
+        , queryCount(0)
+        , lastQueryMs(0)
+        , totalQueryMs(0) {
+    }
+
+    CefRefPtr<MappedIndex> index;
+    double buildTimeMs;
+    int32 filesRead;
+    int32 queryCount;
+    double lastQueryMs;
+    double totalQueryMs;
+};
+
+// Loaded indexes by root, with a trailing slash. Searches read this from the
+// worker threads, hence the lock.
+base::Lock g_indexesLock;
+std::map<std::string, IndexState> g_indexes;
+
+std::string NormalizeRoot(const ExtensionString& root)
+{
+    std::string result = root;
+    if (result.empty() || result[result.length() - 1] != '/') {
+        result += '/';
+    }
+    return result;
+}
+
+// One file per root, named after a hash of the root.
+std::string IndexPathForRoot(const std::string& directory, const std::string& root)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < root.length(); i++) {
+        hash = (hash ^ (unsigned char)root[i]) * 1099511628211ULL;
+    }
+
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.idx", (unsigned long long)hash);
+    return directory + name;
+}
+
+// Whether |relativePath| or one of the directories it is in is excluded.
+bool IsExcludedFile(const std::vector<std::string>& exclude, const std::string& relativePath)
+{
+    if (exclude.empty()) {
+        return false;
+    }
+
+    size_t start = 0;
+    for (;;) {
+        size_t slash = relativePath.find('/', start);
+        std::string name = relativePath.substr(start, slash - start);
+        if (IsExcludedPath(exclude, name.c_str(), relativePath.substr(0, slash))) {
+            return true;
+        }
+        if (slash == std::string::npos) {
+            return false;
+        }
+        start = slash + 1;
+    }
+}
+
+void SetStatsArgs(CefRefPtr<CefListValue> responseArgs, const IndexState& state)
+{
+    CefRefPtr<MappedIndex> index = state.index;
+    responseArgs->SetInt(2, index.get() ? (int32)index->FileCount() : 0);
+    responseArgs->SetInt(3, index.get() ? (int32)index->TrigramCount() : 0);
+    responseArgs->SetDouble(4, index.get() ? (double)index->Size() : 0);
+    responseArgs->SetDouble(5, state.buildTimeMs);
+    responseArgs->SetInt(6, state.filesRead);
+    responseArgs->SetInt(7, state.queryCount);
+    responseArgs->SetDouble(8, state.lastQueryMs);
+    responseArgs->SetDouble(9, state.totalQueryMs);
+}
+
+struct ScannedFile {
+    std::string path;       // relative to the root
+    int64_t mtimeSec;
+    int32_t mtimeNsec;
+    uint64_t size;
+    int64_t oldNumber;      // in the old index, or -1 if the file has to be read
+
+    bool operator<(const ScannedFile& other) const { return path < other.path; }
+};
+
+class IndexUpdate : public CefBase {
+public:
+    IndexUpdate(CefRefPtr<CefBrowser> browser,
+                CefRefPtr<CefProcessMessage> response,
+                const std::string& root,
+                const std::string& indexDirectory,
+                const std::vector<std::string>& exclude)
+        : root_(root)
+        , indexDirectory_(indexDirectory)
+        , indexPath_(IndexPathForRoot(indexDirectory, root))
+        , startTime_(0)
+        , remainingTasks_(0) {
+        AddRequest(browser, response, exclude);
+    }
+
+    const std::string& Root() const { return root_; }
+
+    // Makes this update answer another call too, with |exclude| replacing
+    // the one it had. Only called on the UI thread, before the update starts.
+    void AddRequest(CefRefPtr<CefBrowser> browser,
+                    CefRefPtr<CefProcessMessage> response,
+                    const std::vector<std::string>& exclude)
+    {
+        requests_.push_back(std::make_pair(browser, response));
+        exclude_ = exclude;
+    }
+
+    // Lists the tree and compares it with the old index. Called on a worker.
+    void Start();
+
+    // Reads changed files begin to end. Called on the workers.
+    void ReadFiles(size_t begin, size_t end);
+
+private:
+    void Scan();
+    void Build();
+    int32 Write(const std::vector<uint32_t>& offsets, const std::vector<uint32_t>& trigrams,
+                const std::vector<uint32_t>& postings);
+    void Finish(int32 error);
+
+    std::vector<std::pair<CefRefPtr<CefBrowser>, CefRefPtr<CefProcessMessage> > > requests_;
+    std::string root_;
+    std::string indexDirectory_;
+    std::string indexPath_;
+    std::vector<std::string> exclude_;
+    int64 startTime_;
+
+    CefRefPtr<MappedIndex> old_;
+    std::vector<ScannedFile> files_;
+
+    // Positions in files_ of the files to read, and what was found in them.
+    // Each task fills its own slice.
+    std::vector<size_t> changed_;
+    std::vector<std::vector<uint32_t> > changedTrigrams_;
+    std::vector<char> changedRead_;
+
+    base::Lock lock_;
+    int remainingTasks_;
+
+    IMPLEMENT_REFCOUNTING(IndexUpdate);
+};
+
+typedef std::map<std::string, CefRefPtr<IndexUpdate> > IndexUpdateMap;
+
+// Roots being updated, each with the update to run once the current one is
+// done, or NULL. Two updates of one root would each carry over from the same
+// old index and write the same file, so they don't overlap. UI thread only.
+IndexUpdateMap g_updates;
+
+void StartUpdateTask(CefRefPtr<IndexUpdate> update)
+{
+    update->Start();
+}
+
+void PostUpdate(CefRefPtr<IndexUpdate> update)
+{
+    appshell::PostWorkerTask(update->Root() + "\nindex", base::Bind(&StartUpdateTask, update));
+}
+
+// Starts the update queued behind the one for |root| that just finished.
+void UpdateFinished(std::string root)
+{
+    IndexUpdateMap::iterator it = g_updates.find(root);
+    if (it == g_updates.end()) {
+        return;
+    }
+    CefRefPtr<IndexUpdate> next = it->second;
+    if (next.get()) {
+        it->second = NULL;
+        PostUpdate(next);
+    } else {
+        g_updates.erase(it);
+    }
+}
+
+void ReadFilesTask(CefRefPtr<IndexUpdate> update, size_t begin, size_t end)
+{
+    update->ReadFiles(begin, end);
+}
+
+void IndexUpdate::Start()
+{
+    startTime_ = appshell::GetMonotonicMicroseconds();
+    std::string root = (root_.length() > 1) ? root_.substr(0, root_.length() - 1) : root_;
+    struct stat statbuf;
+    if (stat(root.c_str(), &statbuf) == -1) {
+        Finish((errno == ENOENT || errno == ENOTDIR) ? ERR_NOT_FOUND : ERR_CANT_READ);
+        return;
+    }
+    if (!S_ISDIR(statbuf.st_mode)) {
+        Finish(ERR_NOT_DIRECTORY);
+        return;
+    }
+
+    {
+        base::AutoLock lock(g_indexesLock);
+        std::map<std::string, IndexState>::iterator it = g_indexes.find(root_);
+        if (it != g_indexes.end()) {
+            old_ = it->second.index;
+        }
+    }
+    if (!old_.get()) {
+        old_ = MappedIndex::Open(indexPath_, root_);
+    }
+    if (old_.get() && !old_->HasValidEntries()) {
+        // Rebuilt from scratch.
+        old_ = NULL;
+    }
+
+    Scan();
+
+    // Both lists are sorted by path, so unchanged files are found in one pass.
+    uint32_t oldCount = old_.get() ? old_->FileCount() : 0;
+    uint32_t oldNumber = 0;
+    for (size_t i = 0; i < files_.size(); i++) {
+        ScannedFile& file = files_[i];
+        while (oldNumber < oldCount && old_->FilePath(oldNumber) < file.path) {
+            oldNumber++;
+        }
+        if (oldNumber < oldCount) {
+            const IndexFile& oldFile = old_->File(oldNumber);
+            if (oldFile.mtimeSec == file.mtimeSec && oldFile.mtimeNsec == file.mtimeNsec &&
+                oldFile.size == file.size && old_->FilePath(oldNumber) == file.path) {
+                file.oldNumber = oldNumber;
+                continue;
+            }
+        }
+        changed_.push_back(i);
+    }
+
+    if (changed_.empty()) {
+        Build();
+        return;
+    }
+
+    changedTrigrams_.resize(changed_.size());
+    changedRead_.resize(changed_.size(), 0);
+
+    size_t tasks = (changed_.size() + kMinFilesPerTask - 1) / kMinFilesPerTask;
+    tasks = std::max((size_t)1, std::min(tasks, (size_t)appshell::kWorkerPoolSize));
+    size_t perTask = (changed_.size() + tasks - 1) / tasks;
+    remainingTasks_ = (int)tasks;
+
+    for (size_t i = 0; i < tasks; i++) {
+        size_t begin = std::min(i * perTask, changed_.size());
+        size_t end = std::min(begin + perTask, changed_.size());
+
+        // Keyed by the first file, which spreads the slices over the workers.
+        ExtensionString key = (begin < changed_.size()) ? root_ + files_[changed_[begin]].path : root_;
+        appshell::PostWorkerTask(key, base::Bind(&ReadFilesTask, CefRefPtr<IndexUpdate>(this), begin, end));
+    }
+}
+
+// Lists the regular files under the root. Symlinked files are included, but
+// symlinked directories aren't entered, the same as in a search.
+void IndexUpdate::Scan()
+{
+    std::vector<std::string> directories(1, std::string());
+    while (!directories.empty()) {
+        std::string relativePath = directories.back();
+        directories.pop_back();
+
+        std::string directory = root_ + relativePath;
+        int dirfd = open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        DIR* dp = (dirfd == -1) ? NULL : fdopendir(dirfd);
+        if (dp == NULL) {
+            if (dirfd != -1) {
+                close(dirfd);
+            }
+            continue;
+        }
+
+        struct dirent* entry;
+        while ((entry = readdir(dp)) != NULL) {
+            const char* name = entry->d_name;
+            if (!strcmp(name, ".") || !strcmp(name, "..")) {
+                continue;
+            }
+
+            unsigned char type = entry->d_type;
+            if (type != DT_UNKNOWN && type != DT_DIR && type != DT_REG && type != DT_LNK) {
+                continue;
+            }
+
+            std::string entryPath = relativePath + name;
+            if (IsExcludedPath(exclude_, name, entryPath)) {
+                continue;
+            }
+
+            if (type == DT_DIR) {
+                directories.push_back(entryPath + "/");
+                continue;
+            }
+
+            struct stat statbuf;
+            if (fstatat(dirfd, name, &statbuf, 0) == -1) {
+                continue;
+            }
+            if (S_ISDIR(statbuf.st_mode)) {
+                if (type == DT_UNKNOWN) {
+                    directories.push_back(entryPath + "/");
+                }
+                continue;
+            }
+            if (!S_ISREG(statbuf.st_mode) || statbuf.st_size > kMaxIndexedFileSize) {
+                continue;
+            }
+
+            ScannedFile file;
+            file.path = entryPath;
+            file.mtimeSec = statbuf.st_mtim.tv_sec;
+            file.mtimeNsec = (int32_t)statbuf.st_mtim.tv_nsec;
+            file.size = statbuf.st_size;
+            file.oldNumber = -1;
+            files_.push_back(file);
+        }
+
+        // Also closes dirfd.
+        closedir(dp);
+    }
+
+    std::sort(files_.begin(), files_.end());
+}
+
+void IndexUpdate::ReadFiles(size_t begin, size_t end)
+{
+    std::string contents;
+    TrigramSet seen;
+
+    for (size_t i = begin; i < end; i++) {
+        const std::string path = root_ + files_[changed_[i]].path;
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd == -1) {
+            continue;
+        }
+
+        contents.resize((size_t)files_[changed_[i]].size);
+        size_t length = 0;
+        while (length < contents.size()) {
+            ssize_t count = read(fd, &contents[length], contents.size() - length);
+            if (count == -1 && errno == EINTR) {
+                continue;
+            }
+            if (count <= 0) {
+                break;
+            }
+            length += count;
+        }
+        close(fd);
+        changedRead_[i] = 1;
+
+        // Binary files are listed with no trigrams. Searches skip them, so
+        // they never need to be candidates.
+        const unsigned char* text = (const unsigned char*)contents.data();
+        if (memchr(text, '\0', length) != NULL) {
+            continue;
+        }
+
+        // Each trigram is listed once, the first time it's seen.
+        seen.Clear();
+        std::vector<uint32_t>& trigrams = changedTrigrams_[i];
+        if (length >= 3) {
+            uint32_t trigram = (FoldByte(text[0]) << 8) | FoldByte(text[1]);
+            for (size_t j = 2; j < length; j++) {
+                trigram = ((trigram << 8) | FoldByte(text[j])) & (kTrigramCount - 1);
+                if (seen.Insert(trigram)) {
+                    trigrams.push_back(trigram);
+                }
+            }
+        }
+        std::sort(trigrams.begin(), trigrams.end());
+    }
+
+    bool last;
+    {
+        base::AutoLock lock(lock_);
+        last = (--remainingTasks_ == 0);
+    }
+    if (last) {
+        Build();
+    }
+}
+
+// Builds the new posting lists from the old index and the files just read,
+// and writes them out.
+void IndexUpdate::Build()
+{
+    // Files that couldn't be read are left out, and will be tried again next
+    // time.
+    std::vector<ScannedFile> files;
+    std::vector<const std::vector<uint32_t>*> newTrigrams;
+    size_t next = 0;
+    for (size_t i = 0; i < files_.size(); i++) {
+        const std::vector<uint32_t>* trigrams = NULL;
+        if (next < changed_.size() && changed_[next] == i) {
+            if (!changedRead_[next]) {
+                next++;
+                continue;
+            }
+            trigrams = &changedTrigrams_[next++];
+        }
+        files.push_back(files_[i]);
+        newTrigrams.push_back(trigrams);
+    }
+    files_.swap(files);
+
+    // Counting first, so every list goes straight to its place. Trigrams
+    // are noted when first seen, so only the ones that occur are gone over.
+    TrigramCounts counts;
+    std::vector<uint32_t> trigrams;
+    std::vector<int64_t> oldToNew(old_.get() ? old_->FileCount() : 0, -1);
+    for (size_t i = 0; i < files_.size(); i++) {
+        if (files_[i].oldNumber >= 0) {
+            oldToNew[files_[i].oldNumber] = i;
+        } else {
+            const std::vector<uint32_t>& fileTrigrams = *newTrigrams[i];
+            for (size_t j = 0; j < fileTrigrams.size(); j++) {
+                if (counts[fileTrigrams[j]]++ == 0) {
+                    trigrams.push_back(fileTrigrams[j]);
+                }
+            }
+        }
+    }
+    if (old_.get()) {
+        for (uint32_t i = 0; i < old_->TrigramCount(); i++) {
+            const IndexTrigram& trigram = old_->Trigram(i);
+            const uint32_t* postings = old_->Postings(trigram);
+            for (uint32_t j = 0; j < trigram.count; j++) {
+                if (oldToNew[postings[j]] >= 0 && counts[trigram.trigram]++ == 0) {
+                    trigrams.push_back(trigram.trigram);
+                }
+            }
+        }
+    }
+    std::sort(trigrams.begin(), trigrams.end());
+
+    // counts becomes the position each list is filled from.
+    std::vector<uint32_t> offsets(trigrams.size());
+    uint32_t total = 0;
+    for (size_t i = 0; i < trigrams.size(); i++) {
+        offsets[i] = total;
+        total += counts[trigrams[i]];
+        counts[trigrams[i]] = offsets[i];
+    }
+
+    // Carried-over files keep their order, and new files are added in order,
+    // so each list is two sorted runs, merged below.
+    std::vector<uint32_t> postings(total);
+    if (old_.get()) {
+        for (uint32_t i = 0; i < old_->TrigramCount(); i++) {
+            const IndexTrigram& trigram = old_->Trigram(i);
+            const uint32_t* oldPostings = old_->Postings(trigram);
+            for (uint32_t j = 0; j < trigram.count; j++) {
+                int64_t number = oldToNew[oldPostings[j]];
+                if (number >= 0) {
+                    postings[counts[trigram.trigram]++] = (uint32_t)number;
+                }
+            }
+        }
+    }
+    std::vector<uint32_t> firstNew(trigrams.size());
+    for (size_t i = 0; i < trigrams.size(); i++) {
+        firstNew[i] = counts[trigrams[i]];
+    }
+    for (size_t i = 0; i < files_.size(); i++) {
+        if (newTrigrams[i]) {
+            const std::vector<uint32_t>& fileTrigrams = *newTrigrams[i];
+            for (size_t j = 0; j < fileTrigrams.size(); j++) {
+                postings[counts[fileTrigrams[j]]++] = (uint32_t)i;
+            }
+        }
+    }
+    for (size_t i = 0; i < trigrams.size(); i++) {
+        uint32_t end = counts[trigrams[i]];
+        if (firstNew[i] != offsets[i] && firstNew[i] != end) {
+            std::inplace_merge(postings.begin() + offsets[i], postings.begin() + firstNew[i],
+                               postings.begin() + end);
+        }
+    }
+
+    // Nothing refers to the old index any more, except maybe a search.
+    old_ = NULL;
+    changedTrigrams_.clear();
+
+    Finish(Write(offsets, trigrams, postings));
+}
+
+int32 IndexUpdate::Write(const std::vector<uint32_t>& offsets, const std::vector<uint32_t>& trigrams,
+                         const std::vector<uint32_t>& postings)
+{
+    IndexHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, kIndexMagic, sizeof(kIndexMagic));
+    header.version = kIndexVersion;
+    header.fileCount = (uint32_t)files_.size();
+    header.trigramCount = (uint32_t)trigrams.size();
+    header.postingCount = postings.size();
+    header.filesOffset = sizeof(IndexHeader);
+    header.trigramsOffset = header.filesOffset + files_.size() * sizeof(IndexFile);
+    header.postingsOffset = header.trigramsOffset + trigrams.size() * sizeof(IndexTrigram);
+    header.stringsOffset = header.postingsOffset + postings.size() * sizeof(uint32_t);
+    header.rootLength = (uint32_t)root_.length();
+
+    std::vector<IndexFile> fileEntries(files_.size());
+    uint64_t stringsLength = root_.length();
+    for (size_t i = 0; i < files_.size(); i++) {
+        IndexFile& entry = fileEntries[i];
+        memset(&entry, 0, sizeof(entry));
+        entry.pathOffset = stringsLength;
+        entry.pathLength = (uint32_t)files_[i].path.length();
+        entry.mtimeSec = files_[i].mtimeSec;
+        entry.mtimeNsec = files_[i].mtimeNsec;
+        entry.size = files_[i].size;
+        stringsLength += entry.pathLength;
+    }
+    header.stringsLength = stringsLength;
+
+    std::vector<IndexTrigram> trigramEntries(trigrams.size());
+    for (size_t i = 0; i < trigrams.size(); i++) {
+        IndexTrigram& entry = trigramEntries[i];
+        memset(&entry, 0, sizeof(entry));
+        entry.trigram = trigrams[i];
+        entry.offset = offsets[i];
+        entry.count = ((i + 1 < offsets.size()) ? offsets[i + 1] : (uint32_t)postings.size()) - offsets[i];
+    }
+
+    mkdir(indexDirectory_.c_str(), 0755);
+
+    // Written next to the old index and renamed over it, so searches that
+    // still have the old one mapped are unaffected and a crash never leaves
+    // half an index behind. The name is unique, in case another instance of
+    // the app is writing an index for the same root.
+    std::string tempPath = indexPath_ + ".XXXXXX";
+    int fd = mkostemp(&tempPath[0], O_CLOEXEC);
+    if (fd == -1) {
+        return (errno == ENOSPC) ? ERR_OUT_OF_SPACE : ERR_CANT_WRITE;
+    }
+    FILE* file = fdopen(fd, "wb");
+    if (file == NULL) {
+        close(fd);
+        unlink(tempPath.c_str());
+        return ERR_CANT_WRITE;
+    }
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = ok && (fileEntries.empty() ||
+                fwrite(&fileEntries[0], sizeof(IndexFile), fileEntries.size(), file) == fileEntries.size());
+    ok = ok && (trigramEntries.empty() ||
+                fwrite(&trigramEntries[0], sizeof(IndexTrigram), trigramEntries.size(), file) == trigramEntries.size());
+    ok = ok && (postings.empty() ||
+                fwrite(&postings[0], sizeof(uint32_t), postings.size(), file) == postings.size());
+    ok = ok && fwrite(root_.data(), 1, root_.length(), file) == root_.length();
+    for (size_t i = 0; ok && i < files_.size(); i++) {
+        ok = fwrite(files_[i].path.data(), 1, files_[i].path.length(), file) == files_[i].path.length();
+    }
+    // On disk before the rename, or a crash could leave the new name
+    // pointing at an empty file.
+    ok = ok && fflush(file) == 0 && fsync(fd) == 0;
+    ok = (fclose(file) == 0) && ok;
+
+    if (!ok || rename(tempPath.c_str(), indexPath_.c_str()) == -1) {
+        int32 error = (errno == ENOSPC) ? ERR_OUT_OF_SPACE : ERR_CANT_WRITE;
+        unlink(tempPath.c_str());
+        return error;
+    }
+    return NO_ERROR;
+}
+
+void IndexUpdate::Finish(int32 error)
+{
+    CefRefPtr<MappedIndex> index;
+    IndexState state;
+    if (error == NO_ERROR) {
+        index = MappedIndex::Open(indexPath_, root_);
+        if (!index.get()) {
+            error = ERR_CANT_READ;
+        }
+    }
+
+    if (error == NO_ERROR) {
+        base::AutoLock lock(g_indexesLock);
+        state = g_indexes[root_];
+        state.index = index;
+        state.buildTimeMs = (appshell::GetMonotonicMicroseconds() - startTime_) / 1000.0;
+        state.filesRead = (int32)changed_.size();
+        g_indexes[root_] = state;
+    }
+
+    for (size_t i = 0; i < requests_.size(); i++) {
+        CefRefPtr<CefListValue> responseArgs = requests_[i].second->GetArgumentList();
+        responseArgs->SetInt(1, error);
+        SetStatsArgs(responseArgs, state);
+        SendResponse(requests_[i].first, requests_[i].second);
+    }
+
+    CefPostTask(TID_UI, base::Bind(&UpdateFinished, root_));
+}
+
+}  // namespace
+
+void UpdateSearchIndex(CefRefPtr<CefBrowser> browser,
+                       CefRefPtr<CefProcessMessage> response,
+                       const ExtensionString& root,
+                       const std::vector<std::string>& exclude)
+{
+    std::string indexDirectory = std::string(appshell::AppGetSupportDirectory()) + "/search-index/";
+    std::string normalizedRoot = NormalizeRoot(root);
+
+    IndexUpdateMap::iterator it = g_updates.find(normalizedRoot);
+    if (it == g_updates.end()) {
+        CefRefPtr<IndexUpdate> update = new IndexUpdate(browser, response, normalizedRoot, indexDirectory, exclude);
+        g_updates[normalizedRoot] = NULL;
+        PostUpdate(update);
+    } else if (it->second.get()) {
+        // One rerun covers every call made during the current update.
+        it->second->AddRequest(browser, response, exclude);
+    } else {
+        it->second = new IndexUpdate(browser, response, normalizedRoot, indexDirectory, exclude);
+    }
+}
+
+int32 GetSearchIndexStats(const ExtensionString& root, CefRefPtr<CefListValue> responseArgs)
+{
+    IndexState state;
+    {
+        base::AutoLock lock(g_indexesLock);
+        std::map<std::string, IndexState>::iterator it = g_indexes.find(NormalizeRoot(root));
+        if (it != g_indexes.end()) {
+            state = it->second;
+        }
+    }
+
+    SetStatsArgs(responseArgs, state);
+    return state.index.get() ? NO_ERROR : ERR_NOT_FOUND;
+}
+
+bool FindSearchIndexCandidates(const ExtensionString& root,
+                               const std::string& literal,
+                               const std::vector<std::string>& exclude,
+                               std::vector<ExtensionString>& files)
+{
+    std::string normalizedRoot = NormalizeRoot(root);
+    CefRefPtr<MappedIndex> index;
+    {
+        base::AutoLock lock(g_indexesLock);
+        std::map<std::string, IndexState>::iterator it = g_indexes.find(normalizedRoot);
+        if (it != g_indexes.end()) {
+            index = it->second.index;
+        }
+    }
+    if (!index.get()) {
+        return false;
+    }
+
+    // The posting lists of the literal's trigrams, shortest first.
+    std::vector<std::pair<uint32_t, const IndexTrigram*> > lists;
+    for (size_t i = 0; i + 3 <= literal.length(); i++) {
+        uint32_t trigram = (FoldByte(literal[i]) << 16) | (FoldByte(literal[i + 1]) << 8) | FoldByte(literal[i + 2]);
+        const IndexTrigram* entry = index->FindTrigram(trigram);
+        if (entry == NULL) {
+            // No file has this part of the literal.
+            files.clear();
+            return true;
+        }
+        lists.push_back(std::make_pair(entry->count, entry));
+    }
+    std::sort(lists.begin(), lists.end());
+
+    std::vector<uint32_t> candidates;
+    if (lists.empty()) {
+        // Too short to narrow anything down.
+        for (uint32_t i = 0; i < index->FileCount(); i++) {
+            candidates.push_back(i);
+        }
+    } else {
+        const uint32_t* first = index->Postings(*lists[0].second);
+        if (first == NULL) {
+            // Damaged; the search walks the tree instead.
+            return false;
+        }
+        candidates.assign(first, first + lists[0].first);
+        for (size_t i = 1; i < lists.size() && !candidates.empty(); i++) {
+            if (lists[i].second == lists[i - 1].second) {
+                continue;
+            }
+            const uint32_t* postings = index->Postings(*lists[i].second);
+            if (postings == NULL) {
+                return false;
+            }
+            std::vector<uint32_t> narrowed;
+            std::set_intersection(candidates.begin(), candidates.end(), postings, postings + lists[i].first,
+                                  std::back_inserter(narrowed));
+            candidates.swap(narrowed);
+        }
+    }
+
+    files.clear();
+    for (size_t i = 0; i < candidates.size(); i++) {
+        std::string path = index->FilePath(candidates[i]);
+        if (!path.empty() && !IsExcludedFile(exclude, path)) {
+            files.push_back(normalizedRoot + path);
+        }
+    }
+    return true;
+}
+
+void RecordSearchIndexQuery(const ExtensionString& root, double milliseconds)
+{
+    base::AutoLock lock(g_indexesLock);
+    std::map<std::string, IndexState>::iterator it = g_indexes.find(NormalizeRoot(root));
+    if (it != g_indexes.end()) {
+        it->second.queryCount++;
+        it->second.lastQueryMs = milliseconds;
+        it->second.totalQueryMs += milliseconds;
+    }
+}
+
+#else
+
+void UpdateSearchIndex(CefRefPtr<CefBrowser> browser,
+                       CefRefPtr<CefProcessMessage> response,
+                       const ExtensionString& root,
+                       const std::vector<std::string>& exclude)
+{
+    response->GetArgumentList()->SetInt(1, ERR_NOT_SUPPORTED);
+    SendResponse(browser, response);
+}
+
+int32 GetSearchIndexStats(const ExtensionString& root, CefRefPtr<CefListValue> responseArgs)
+{
+    return ERR_NOT_SUPPORTED;
+}
+
+bool FindSearchIndexCandidates(const ExtensionString& root,
+                               const std::string& literal,
+                               const std::vector<std::string>& exclude,
+                               std::vector<ExtensionString>& files)
+{
+    return false;
+}
+
+void RecordSearchIndexQuery(const ExtensionString& root, double milliseconds)
+{
+}
+
+#endif
+
+}  // namespace appshell_extensions
@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2016 - present Adobe Systems Incorporated. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "include/cef_browser.h"
+#include "include/cef_process_message.h"
+
+#include "appshell_extensions_platform.h"
+
+#include <string>
+#include <vector>
+
+namespace appshell_extensions {
+
+// Trigram indexes that let appshell.fs.search() skip files that can't match.
+//
+// An index lists every searchable file under a project root along with its
+// mtime and size, and for each run of three bytes (ASCII folded to lower case)
+// the files it occurs in. A search looks up the trigrams of the literal every
+// match must contain and only reads the files on all of their lists.
+//
+// Indexes are stored under the app support directory, one file per root, and
+// memory-mapped once loaded. Updating one re-reads only the files whose mtime
+// or size changed since the last update; the rest are carried over from the
+// old index. Files changed after the last update are searched as they were
+// then, so callers should update again when they learn of changes.
+//
+// Only implemented on Linux; other platforms respond with ERR_NOT_SUPPORTED,
+// and searches walk the tree as usual.
+
+// Loads the index for |root|, updates it on the worker pool and sends
+// |response| with the error code and the figures from GetSearchIndexStats().
+// Files and directories that match |exclude| (see WalkOptions::exclude) are
+// left out of the index. Calls made while the root is being updated wait for
+// that update and are then answered by one more, with the last |exclude|.
+// Must be called on the UI thread.
+void UpdateSearchIndex(CefRefPtr<CefBrowser> browser,
+                       CefRefPtr<CefProcessMessage> response,
+                       const ExtensionString& root,
+                       const std::vector<std::string>& exclude);
+
+// Sets |responseArgs| from index 2 on to, for the loaded index of |root|:
+// the number of files, the number of distinct trigrams, the size in bytes,
+// the duration of the last update and the number of files it read, the
+// number of searches that used the index, the duration of the last one and
+// their total duration. Durations are in milliseconds. Returns ERR_NOT_FOUND
+// if no index is loaded.
+int32 GetSearchIndexStats(const ExtensionString& root, CefRefPtr<CefListValue> responseArgs);
+
+// Used by searches, on any thread. If an index is loaded for |root|, sets
+// |files| to the full paths of the files that could contain |literal| and
+// aren't excluded by |exclude|, and returns true.
+bool FindSearchIndexCandidates(const ExtensionString& root,
+                               const std::string& literal,
+                               const std::vector<std::string>& exclude,
+                               std::vector<ExtensionString>& files);
+
+// Records how long a search that used the index of |root| took, on any thread.
+void RecordSearchIndexQuery(const ExtensionString& root, double milliseconds);
+
+}  // namespace appshell_extensions
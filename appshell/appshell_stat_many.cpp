@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2016 - present Adobe Systems Incorporated. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "appshell_stat_many.h"
+
+#include "appshell_extensions.h"
+#include "appshell_worker_pool.h"
+
+#include "include/base/cef_bind.h"
+#include "include/base/cef_lock.h"
+
+#include <algorithm>
+
+namespace appshell_extensions {
+
+namespace {
+
+// Fewer paths than this aren't worth another worker.
+const size_t kMinPathsPerTask = 128;
+
+class StatManyJob : public CefBase {
+public:
+    StatManyJob(CefRefPtr<CefBrowser> browser,
+                CefRefPtr<CefProcessMessage> response,
+                const std::vector<ExtensionString>& paths,
+                int tasks)
+        : browser_(browser)
+        , response_(response)
+        , paths_(paths)
+        , stats_(paths.size())
+        , errors_(paths.size(), NO_ERROR)
+        , remainingTasks_(tasks) {
+    }
+
+    // Called on a worker thread for each slice of the paths.
+    void Run(size_t begin, size_t end);
+
+private:
+    void Respond();
+
+    CefRefPtr<CefBrowser> browser_;
+    CefRefPtr<CefProcessMessage> response_;
+    std::vector<ExtensionString> paths_;
+
+    // Each task writes its own slice, so only the counter needs the lock.
+    std::vector<FileStats> stats_;
+    std::vector<int32> errors_;
+
+    base::Lock lock_;
+    int remainingTasks_;
+
+    IMPLEMENT_REFCOUNTING(StatManyJob);
+};
+
+void StatTask(CefRefPtr<StatManyJob> job, size_t begin, size_t end)
+{
+    job->Run(begin, end);
+}
+
+void StatManyJob::Run(size_t begin, size_t end)
+{
+    for (size_t i = begin; i < end; i++) {
+        errors_[i] = GetFileStats(paths_[i], stats_[i]);
+    }
+
+    bool last;
+    {
+        base::AutoLock lock(lock_);
+        last = (--remainingTasks_ == 0);
+    }
+    if (last) {
+        Respond();
+    }
+}
+
+void StatManyJob::Respond()
+{
+    size_t count = paths_.size();
+    CefRefPtr<CefListValue> mtimeSec = CefListValue::Create();
+    CefRefPtr<CefListValue> mtimeNsec = CefListValue::Create();
+    CefRefPtr<CefListValue> sizes = CefListValue::Create();
+    CefRefPtr<CefListValue> types = CefListValue::Create();
+    CefRefPtr<CefListValue> errors = CefListValue::Create();
+    mtimeSec->SetSize(count);
+    mtimeNsec->SetSize(count);
+    sizes->SetSize(count);
+    types->SetSize(count);
+    errors->SetSize(count);
+
+    for (size_t i = 0; i < count; i++) {
+        // Seconds go as a double: exact well past 2038, unlike an int.
+        mtimeSec->SetDouble(i, (double)stats_[i].mtimeSec);
+        mtimeNsec->SetInt(i, stats_[i].mtimeNsec);
+        sizes->SetDouble(i, stats_[i].size);
+        types->SetInt(i, stats_[i].type);
+        errors->SetInt(i, errors_[i]);
+    }
+
+    CefRefPtr<CefListValue> responseArgs = response_->GetArgumentList();
+    responseArgs->SetInt(1, NO_ERROR);
+    responseArgs->SetList(2, mtimeSec);
+    responseArgs->SetList(3, mtimeNsec);
+    responseArgs->SetList(4, sizes);
+    responseArgs->SetList(5, types);
+    responseArgs->SetList(6, errors);
+    SendResponse(browser_, response_);
+}
+
+}  // namespace
+
+void StatMany(CefRefPtr<CefBrowser> browser,
+              CefRefPtr<CefProcessMessage> response,
+              const std::vector<ExtensionString>& paths)
+{
+    size_t tasks = (paths.size() + kMinPathsPerTask - 1) / kMinPathsPerTask;
+    tasks = std::max((size_t)1, std::min(tasks, (size_t)appshell::kWorkerPoolSize));
+    size_t perTask = (paths.size() + tasks - 1) / tasks;
+
+    CefRefPtr<StatManyJob> job = new StatManyJob(browser, response, paths, (int)tasks);
+    for (size_t i = 0; i < tasks; i++) {
+        size_t begin = std::min(i * perTask, paths.size());
+        size_t end = std::min(begin + perTask, paths.size());
+
+        // Keyed by the first path, which spreads the slices over the workers.
+        ExtensionString key = (begin < paths.size()) ? paths[begin] : ExtensionString();
+        appshell::PostWorkerTask(key, base::Bind(&StatTask, job, begin, end));
+    }
+}
+
+}  // namespace appshell_extensions
@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2016 - present Adobe Systems Incorporated. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "appshell_text.h"
+
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define APPSHELL_USE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// Checks the multibyte UTF-8 sequence that starts at |data[i]| and returns its
+// length, or 0 if it is invalid. Overlong forms, surrogates and code points
+// above U+10FFFF are rejected, like ICU and MultiByteToWideChar do.
+static size_t GetUTF8SequenceLength(const unsigned char* data, size_t i, size_t length)
+{
+    unsigned char lead = data[i];
+    size_t remaining = length - i;
+
+    if (lead >= 0xC2 && lead <= 0xDF) {
+        if (remaining < 2 || (data[i + 1] & 0xC0) != 0x80)
+            return 0;
+        return 2;
+    }
+
+    if (lead >= 0xE0 && lead <= 0xEF) {
+        if (remaining < 3)
+            return 0;
+        unsigned char second = data[i + 1];
+        if ((lead == 0xE0 && second < 0xA0) ||      // overlong
+            (lead == 0xED && second > 0x9F) ||      // surrogate
+            (second & 0xC0) != 0x80 ||
+            (data[i + 2] & 0xC0) != 0x80)
+            return 0;
+        return 3;
+    }
+
+    if (lead >= 0xF0 && lead <= 0xF4) {
+        if (remaining < 4)
+            return 0;
+        unsigned char second = data[i + 1];
+        if ((lead == 0xF0 && second < 0x90) ||      // overlong
+            (lead == 0xF4 && second > 0x8F) ||      // above U+10FFFF
+            (second & 0xC0) != 0x80 ||
+            (data[i + 2] & 0xC0) != 0x80 ||
+            (data[i + 3] & 0xC0) != 0x80)
+            return 0;
+        return 4;
+    }
+
+    return 0;
+}
+
+// Returns the number of bytes from |i| on that are plain ASCII and not NUL.
+static size_t SkipPlainASCII(const unsigned char* data, size_t i, size_t length)
+{
+    size_t start = i;
+
+#ifdef APPSHELL_USE_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    while (length - i >= 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        // High bits flag non-ASCII bytes, the compare flags NULs.
+        int mask = _mm_movemask_epi8(chunk) | _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, zero));
+        if (mask != 0) {
+            while ((mask & 1) == 0) {
+                mask >>= 1;
+                i++;
+            }
+            return i - start;
+        }
+        i += 16;
+    }
+#endif
+
+    while (i < length && data[i] != 0 && data[i] < 0x80) {
+        i++;
+    }
+    return i - start;
+}
+
+TextClass ClassifyText(const char* bufferData, size_t bufferLength)
+{
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(bufferData);
+    size_t i = 0;
+    bool hasMultibyte = false;
+
+    for (;;) {
+        i += SkipPlainASCII(data, i, bufferLength);
+        if (i == bufferLength) {
+            return hasMultibyte ? TEXT_UTF8 : TEXT_ASCII;
+        }
+
+        if (data[i] == 0) {
+            return TEXT_BINARY;
+        }
+
+        size_t sequenceLength = GetUTF8SequenceLength(data, i, bufferLength);
+        if (sequenceLength == 0) {
+            // Not UTF-8. A NUL further on still makes it binary.
+            return memchr(data + i, 0, bufferLength - i) ? TEXT_BINARY : TEXT_AMBIGUOUS;
+        }
+        hasMultibyte = true;
+        i += sequenceLength;
+    }
+}
+
+bool IsValidUTF8(const char* bufferData, size_t bufferLength)
+{
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(bufferData);
+    size_t i = 0;
+
+    for (;;) {
+        i += SkipPlainASCII(data, i, bufferLength);
+        if (i == bufferLength) {
+            return true;
+        }
+
+        // NUL is a valid UTF-8 character, only ClassifyText() cares about it.
+        if (data[i] == 0) {
+            i++;
+            continue;
+        }
+
+        size_t sequenceLength = GetUTF8SequenceLength(data, i, bufferLength);
+        if (sequenceLength == 0) {
+            return false;
+        }
+        i += sequenceLength;
+    }
+}
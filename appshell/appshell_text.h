@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) 2016 - present Adobe Systems Incorporated. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+// Encoding checks for file contents. These don't use CEF or ICU, so they can
+// be tested and benchmarked on their own (see test/native).
+
+// What ClassifyText() found in a buffer.
+enum TextClass {
+    TEXT_ASCII,         // 7-bit ASCII, no NUL bytes
+    TEXT_UTF8,          // valid UTF-8 with at least one multibyte character
+    TEXT_BINARY,        // contains NUL bytes
+    TEXT_AMBIGUOUS      // some other 8-bit encoding, ICU has to work it out
+};
+
+// Sorts a buffer into one of the classes above in a single pass. Runs of
+// ASCII are checked 16 bytes at a time where SSE2 is available.
+TextClass ClassifyText(const char* bufferData, size_t bufferLength);
+
+// Returns true if the buffer is valid UTF-8. NUL bytes count as valid.
+bool IsValidUTF8(const char* bufferData, size_t bufferLength);
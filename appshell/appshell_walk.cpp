@@ -0,0 +1,496 @@
+/*
+ * Copyright (c) 2016 - present Adobe Systems Incorporated. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "appshell_walk.h"
+
+#include "appshell_extensions.h"
+#include "appshell_worker_pool.h"
+
+#include "include/base/cef_bind.h"
+#include "include/base/cef_lock.h"
+#include "include/cef_task.h"
+#include "include/wrapper/cef_closure_task.h"
+
+#include <algorithm>
+#include <map>
+
+#ifdef OS_LINUX
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <deque>
+#include <set>
+#endif
+
+namespace appshell_extensions {
+
+#ifdef OS_LINUX
+
+namespace {
+
+const int32 kMinBatchSize = 64;
+const int32 kMaxBatchSize = 64 * 1024;
+
+// Directories read concurrently by one walk.
+const int kMaxRunners = appshell::kWorkerPoolSize;
+
+// Directories a runner reads before it goes to the back of its worker's
+// queue, so other commands aren't held up by a big walk.
+const int kDirectoriesPerTask = 32;
+
+// How often the cancel flag is checked while reading a large directory.
+const size_t kCancelCheckInterval = 1024;
+
+struct DirectoryJob {
+    DirectoryJob(const std::string& relativePath, int32 depth)
+        : relativePath(relativePath), depth(depth) {}
+
+    // Empty for the root, otherwise ends with a slash.
+    std::string relativePath;
+    int32 depth;
+};
+
+typedef std::pair<dev_t, ino_t> FileId;
+
+class Walk : public CefBase {
+public:
+    Walk(CefRefPtr<CefBrowser> browser,
+         CefRefPtr<CefProcessMessage> response,
+         int32 walkId,
+         const ExtensionString& root,
+         const WalkOptions& options)
+        : browser_(browser)
+        , response_(response)
+        , walkId_(walkId)
+        , root_(root)
+        , options_(options)
+        , runners_(0)
+        , nextRunner_(0)
+        , busy_(0)
+        , entryCount_(0)
+        , skippedCount_(0)
+        , cancelled_(false)
+        , finished_(false) {
+        if (root_.empty() || root_[root_.length() - 1] != '/') {
+            root_ += '/';
+        }
+    }
+
+    // Looks at the root and starts the first runner.
+    void Start();
+
+    // Called on the UI thread.
+    void Cancel();
+
+    // Called on the worker threads. Reads queued directories until there are
+    // none left or the walk is cancelled. |batch| holds entries that haven't
+    // been sent yet.
+    void Run(int runner, CefRefPtr<CefListValue> batch);
+
+private:
+    void PostRunner(int runner, CefRefPtr<CefListValue> batch);
+    void ReadDirectory(const DirectoryJob& job, CefRefPtr<CefListValue>& batch, size_t& batchIndex);
+    bool IsCancelled();
+    void SendBatch(CefRefPtr<CefListValue>& batch, size_t& batchIndex);
+    void Finish(int32 error);
+
+    CefRefPtr<CefBrowser> browser_;
+    CefRefPtr<CefProcessMessage> response_;
+    int32 walkId_;
+    ExtensionString root_;
+    WalkOptions options_;
+
+    // Shared between the UI thread and the runners.
+    base::Lock lock_;
+    std::deque<DirectoryJob> queue_;
+    std::set<FileId> visited_;
+    int runners_;
+    int nextRunner_;
+    int busy_;
+    int32 entryCount_;
+    int32 skippedCount_;
+    bool cancelled_;
+    bool finished_;
+
+    IMPLEMENT_REFCOUNTING(Walk);
+};
+
+typedef std::pair<int, int32> WalkKey;
+typedef std::map<WalkKey, CefRefPtr<Walk> > WalkMap;
+
+// Walks that haven't finished yet. UI thread only.
+WalkMap g_walks;
+
+void StartTask(CefRefPtr<Walk> walk)
+{
+    walk->Start();
+}
+
+void RunTask(CefRefPtr<Walk> walk, int runner, CefRefPtr<CefListValue> batch)
+{
+    walk->Run(runner, batch);
+}
+
+void RemoveWalk(WalkKey key, CefRefPtr<Walk> walk)
+{
+    WalkMap::iterator it = g_walks.find(key);
+    if (it != g_walks.end() && it->second.get() == walk.get()) {
+        g_walks.erase(it);
+    }
+}
+
+void Walk::Start()
+{
+    // Without the trailing slash, so a file given as root is reported as
+    // such rather than as missing.
+    std::string root = (root_.length() > 1) ? root_.substr(0, root_.length() - 1) : root_;
+
+    struct stat statbuf;
+    if (stat(root.c_str(), &statbuf) == -1) {
+        Finish((errno == ENOENT || errno == ENOTDIR) ? ERR_NOT_FOUND : ERR_CANT_READ);
+        return;
+    }
+    if (!S_ISDIR(statbuf.st_mode)) {
+        Finish(ERR_NOT_DIRECTORY);
+        return;
+    }
+
+    {
+        base::AutoLock lock(lock_);
+        visited_.insert(FileId(statbuf.st_dev, statbuf.st_ino));
+        queue_.push_back(DirectoryJob("", 0));
+        runners_ = 1;
+        nextRunner_ = 1;
+    }
+    Run(0, CefListValue::Create());
+}
+
+void Walk::Cancel()
+{
+    base::AutoLock lock(lock_);
+    cancelled_ = true;
+}
+
+bool Walk::IsCancelled()
+{
+    base::AutoLock lock(lock_);
+    return cancelled_;
+}
+
+// Each runner keeps to one worker, so a walk never takes more than
+// kMaxRunners threads.
+void Walk::PostRunner(int runner, CefRefPtr<CefListValue> batch)
+{
+    char key[32];
+    snprintf(key, sizeof(key), "\n%d", runner);
+    appshell::PostWorkerTask(root_ + key, base::Bind(&RunTask, CefRefPtr<Walk>(this), runner, batch));
+}
+
+void Walk::Run(int runner, CefRefPtr<CefListValue> batch)
+{
+    size_t batchIndex = batch->GetSize();
+
+    for (int directories = 0; directories < kDirectoriesPerTask; directories++) {
+        DirectoryJob job("", 0);
+        {
+            base::AutoLock lock(lock_);
+            if (cancelled_ || queue_.empty()) {
+                break;
+            }
+            job = queue_.front();
+            queue_.pop_front();
+            busy_++;
+        }
+
+        ReadDirectory(job, batch, batchIndex);
+
+        base::AutoLock lock(lock_);
+        busy_--;
+    }
+
+    bool more;
+    {
+        base::AutoLock lock(lock_);
+        more = !cancelled_ && !queue_.empty();
+    }
+
+    // Entries go out before the runner can be counted as done, so they always
+    // reach the renderer ahead of the final response.
+    if (!more) {
+        SendBatch(batch, batchIndex);
+    }
+
+    bool done = false;
+    int32 error = NO_ERROR;
+    {
+        base::AutoLock lock(lock_);
+        if (!cancelled_ && !queue_.empty()) {
+            more = true;
+        } else {
+            runners_--;
+            done = !finished_ && runners_ == 0 && busy_ == 0;
+            if (done) {
+                finished_ = true;
+                error = cancelled_ ? ERR_CANCELLED : NO_ERROR;
+            }
+        }
+    }
+
+    if (more) {
+        // Let whatever else is queued on this worker run first. Unsent
+        // entries go along, so batches stay full.
+        PostRunner(runner, batch);
+    } else if (done) {
+        Finish(error);
+    }
+}
+
+void Walk::ReadDirectory(const DirectoryJob& job, CefRefPtr<CefListValue>& batch, size_t& batchIndex)
+{
+    std::string directory = root_ + job.relativePath;
+
+    int dirfd = open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    DIR* dp = (dirfd == -1) ? NULL : fdopendir(dirfd);
+    if (dp == NULL) {
+        if (dirfd != -1) {
+            close(dirfd);
+        }
+        base::AutoLock lock(lock_);
+        skippedCount_++;
+        return;
+    }
+
+    bool descend = (options_.maxDepth < 0 || job.depth < options_.maxDepth);
+    std::vector<DirectoryJob> subdirectories;
+    std::vector<FileId> subdirectoryIds;
+    size_t entries = 0;
+    int32 listed = 0;
+    struct dirent* entry;
+
+    while ((entry = readdir(dp)) != NULL) {
+        const char* name = entry->d_name;
+        if (!strcmp(name, ".") || !strcmp(name, "..")) {
+            continue;
+        }
+
+        unsigned char type = entry->d_type;
+        if (type != DT_UNKNOWN && type != DT_DIR && type != DT_REG && type != DT_LNK) {
+            continue;
+        }
+
+        if (++entries % kCancelCheckInterval == 0 && IsCancelled()) {
+            break;
+        }
+
+        std::string relativePath = job.relativePath + name;
+        if (IsExcludedPath(options_.exclude, name, relativePath)) {
+            continue;
+        }
+
+        struct stat statbuf;
+        if (fstatat(dirfd, name, &statbuf, AT_SYMLINK_NOFOLLOW) == -1) {
+            continue;
+        }
+
+        bool isLink = S_ISLNK(statbuf.st_mode);
+        if (isLink && fstatat(dirfd, name, &statbuf, 0) == -1) {
+            // Dangling link
+            continue;
+        }
+
+        bool isDir = S_ISDIR(statbuf.st_mode);
+        if (!isDir && !S_ISREG(statbuf.st_mode)) {
+            continue;
+        }
+
+        batch->SetString(batchIndex++, relativePath);
+        batch->SetInt(batchIndex++, (int)statbuf.st_mtime);
+        batch->SetBool(batchIndex++, isDir);
+        batch->SetDouble(batchIndex++, (double)statbuf.st_size);
+        batch->SetString(batchIndex++, isLink ? ResolveRealPath(directory + name) : ExtensionString());
+        listed++;
+        if (batchIndex >= (size_t)options_.batchSize * READDIR_STATS_STRIDE) {
+            SendBatch(batch, batchIndex);
+        }
+
+        if (isDir && descend && (!isLink || options_.followSymlinks)) {
+            subdirectories.push_back(DirectoryJob(relativePath + "/", job.depth + 1));
+            subdirectoryIds.push_back(FileId(statbuf.st_dev, statbuf.st_ino));
+        }
+    }
+
+    // Also closes dirfd.
+    closedir(dp);
+
+    std::vector<int> newRunners;
+    {
+        base::AutoLock lock(lock_);
+        entryCount_ += listed;
+        for (size_t i = 0; i < subdirectories.size(); i++) {
+            if (visited_.insert(subdirectoryIds[i]).second) {
+                queue_.push_back(subdirectories[i]);
+            }
+        }
+        while (runners_ < kMaxRunners && queue_.size() > (size_t)runners_) {
+            runners_++;
+            newRunners.push_back(nextRunner_++);
+        }
+    }
+
+    for (size_t i = 0; i < newRunners.size(); i++) {
+        PostRunner(newRunners[i], CefListValue::Create());
+    }
+}
+
+void Walk::SendBatch(CefRefPtr<CefListValue>& batch, size_t& batchIndex)
+{
+    if (batchIndex == 0) {
+        return;
+    }
+
+    // Progress callbacks get null in place of the error code, which tells the
+    // JS side apart from the final callback.
+    CefRefPtr<CefProcessMessage> message = CefProcessMessage::Create("invokeProgressCallback");
+    CefRefPtr<CefListValue> messageArgs = message->GetArgumentList();
+    messageArgs->SetInt(0, response_->GetArgumentList()->GetInt(0));
+    messageArgs->SetNull(1);
+    messageArgs->SetList(2, batch);
+    SendResponse(browser_, message);
+
+    batch = CefListValue::Create();
+    batchIndex = 0;
+}
+
+void Walk::Finish(int32 error)
+{
+    int32 entryCount;
+    int32 skippedCount;
+    {
+        base::AutoLock lock(lock_);
+        finished_ = true;
+        queue_.clear();
+        visited_.clear();
+        entryCount = entryCount_;
+        skippedCount = skippedCount_;
+    }
+
+    CefRefPtr<CefListValue> responseArgs = response_->GetArgumentList();
+    responseArgs->SetInt(1, error);
+    responseArgs->SetInt(2, entryCount);
+    responseArgs->SetInt(3, skippedCount);
+    SendResponse(browser_, response_);
+
+    CefPostTask(TID_UI, base::Bind(&RemoveWalk, WalkKey(browser_->GetIdentifier(), walkId_),
+                                   CefRefPtr<Walk>(this)));
+}
+
+}  // namespace
+
+bool IsExcludedPath(const std::vector<std::string>& globs, const char* name, const std::string& relativePath)
+{
+    for (size_t i = 0; i < globs.size(); i++) {
+        const std::string& pattern = globs[i];
+        if (pattern.find('/') == std::string::npos) {
+            if (fnmatch(pattern.c_str(), name, 0) == 0) {
+                return true;
+            }
+        } else if (fnmatch(pattern.c_str(), relativePath.c_str(), FNM_PATHNAME) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void StartWalk(CefRefPtr<CefBrowser> browser,
+               CefRefPtr<CefProcessMessage> response,
+               int32 walkId,
+               const ExtensionString& root,
+               const WalkOptions& options)
+{
+    WalkKey key(browser->GetIdentifier(), walkId);
+
+    // Ids are handed out by the renderer, which starts over after a reload.
+    WalkMap::iterator existing = g_walks.find(key);
+    if (existing != g_walks.end()) {
+        existing->second->Cancel();
+    }
+
+    WalkOptions walkOptions = options;
+    walkOptions.batchSize = std::max(kMinBatchSize, std::min(walkOptions.batchSize, kMaxBatchSize));
+
+    CefRefPtr<Walk> walk = new Walk(browser, response, walkId, root, walkOptions);
+    g_walks[key] = walk;
+    appshell::PostWorkerTask(root, base::Bind(&StartTask, walk));
+}
+
+void CancelWalk(CefRefPtr<CefBrowser> browser, int32 walkId)
+{
+    WalkMap::iterator it = g_walks.find(WalkKey(browser->GetIdentifier(), walkId));
+    if (it != g_walks.end()) {
+        it->second->Cancel();
+    }
+}
+
+void CancelBrowserWalks(CefRefPtr<CefBrowser> browser)
+{
+    WalkMap::iterator it = g_walks.begin();
+    while (it != g_walks.end()) {
+        if (it->first.first == browser->GetIdentifier()) {
+            it->second->Cancel();
+            g_walks.erase(it++);
+        } else {
+            ++it;
+        }
+    }
+}
+
+#else
+
+void StartWalk(CefRefPtr<CefBrowser> browser,
+               CefRefPtr<CefProcessMessage> response,
+               int32 walkId,
+               const ExtensionString& root,
+               const WalkOptions& options)
+{
+    CefRefPtr<CefListValue> responseArgs = response->GetArgumentList();
+    responseArgs->SetInt(1, ERR_NOT_SUPPORTED);
+    responseArgs->SetInt(2, 0);
+    responseArgs->SetInt(3, 0);
+    SendResponse(browser, response);
+}
+
+void CancelWalk(CefRefPtr<CefBrowser> browser, int32 walkId)
+{
+}
+
+void CancelBrowserWalks(CefRefPtr<CefBrowser> browser)
+{
+}
+
+#endif
+
+}  // namespace appshell_extensions
@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2016 - present Adobe Systems Incorporated. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "include/cef_browser.h"
+#include "include/cef_process_message.h"
+
+#include "appshell_extensions_platform.h"
+
+#include <string>
+#include <vector>
+
+namespace appshell_extensions {
+
+// Recursive directory walks for appshell.fs.walk().
+//
+// The tree is read on the worker pool, several directories at a time. Entries
+// go to the renderer in batches as "invokeProgressCallback" messages, packed
+// like ReadDirWithStats() results but with the path relative to the root in
+// place of the name. The walk's callback gets the final "invokeCallback" once
+// the whole tree has been read, the root couldn't be read or the walk was
+// cancelled.
+//
+// Directories are only entered once per (device, inode), so symlink loops and
+// bind mounts that contain themselves don't make a walk run forever.
+//
+// Only implemented on Linux; other platforms respond with ERR_NOT_SUPPORTED.
+//
+// All of these functions must be called on the UI thread.
+
+struct WalkOptions {
+    WalkOptions() : maxDepth(-1), followSymlinks(false), batchSize(2000) {}
+
+    // Glob patterns of entries to leave out, along with everything under
+    // them. Patterns without a slash are matched against the entry name,
+    // the rest against its path relative to the root.
+    std::vector<std::string> exclude;
+
+    // How many levels of subdirectories to enter; 0 only lists the root.
+    // Negative means no limit.
+    int32 maxDepth;
+
+    // Whether to enter symlinks to directories. Symlinks are listed either way.
+    bool followSymlinks;
+
+    // Number of entries sent to the renderer at a time.
+    int32 batchSize;
+};
+
+// Starts walking |root|. |response| is the final response message and
+// already holds the callback id. The response gets the error code, the
+// number of entries listed and the number of directories that couldn't be
+// read and were skipped.
+void StartWalk(CefRefPtr<CefBrowser> browser,
+               CefRefPtr<CefProcessMessage> response,
+               int32 walkId,
+               const ExtensionString& root,
+               const WalkOptions& options);
+
+// Stops walk |walkId|. Its callback gets ERR_CANCELLED.
+void CancelWalk(CefRefPtr<CefBrowser> browser, int32 walkId);
+
+// Stops every walk of |browser|. Called when the browser closes.
+void CancelBrowserWalks(CefRefPtr<CefBrowser> browser);
+
+#ifdef OS_LINUX
+// Whether an entry matches one of |globs|, as described for
+// WalkOptions::exclude. |relativePath| is the entry's path from the root.
+bool IsExcludedPath(const std::vector<std::string>& globs, const char* name, const std::string& relativePath);
+#endif
+
+}  // namespace appshell_extensions
@@ -0,0 +1,720 @@
+/*
+ * Copyright (c) 2016 - present Adobe Systems Incorporated. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "appshell_watch.h"
+
+#include "appshell_extensions.h"
+#include "appshell_helpers.h"
+
+#include "include/base/cef_bind.h"
+#include "include/base/cef_lock.h"
+#include "include/cef_task.h"
+#include "include/wrapper/cef_closure_task.h"
+
+#include <map>
+#include <set>
+
+#ifdef OS_LINUX
+#include "appshell_walk.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <algorithm>
+#endif
+
+namespace appshell_extensions {
+
+#ifdef OS_LINUX
+
+namespace {
+
+// IN_ISDIR comes along with these, so directories can be told apart from
+// files without a stat. Symlinks are never followed.
+const uint32_t kWatchMask = IN_CREATE | IN_DELETE | IN_MODIFY | IN_ATTRIB |
+                            IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF |
+                            IN_ONLYDIR | IN_DONT_FOLLOW | IN_EXCL_UNLINK;
+
+const int32 kMinDebounceMs = 1;
+const int32 kMaxDebounceMs = 10 * 1000;
+
+// Longest a change is held back while the tree keeps changing.
+const int64 kMaxBatchDelayMs = 1000;
+
+// A change set is sent early once it gets this big.
+const size_t kMaxPendingChanges = 10000;
+
+const size_t kEventBufferSize = 64 * 1024;
+
+enum ChangeKind {
+    CHANGE_CREATED,
+    CHANGE_MODIFIED,
+    CHANGE_DELETED
+};
+
+const char* const kChangeNames[] = { "created", "modified", "deleted" };
+
+// Half of a rename, waiting for its MOVED_TO.
+struct PendingMove {
+    PendingMove() : isDir(false) {}
+    PendingMove(const std::string& path, bool isDir) : path(path), isDir(isDir) {}
+
+    std::string path;
+    bool isDir;
+};
+
+typedef std::pair<std::string, std::string> Rename;
+
+int64 NowMs()
+{
+    return appshell::GetMonotonicMicroseconds() / 1000;
+}
+
+std::string JoinPath(const std::string& directory, const char* name)
+{
+    return directory.empty() ? std::string(name) : directory + "/" + name;
+}
+
+// Whether |path| is |directory| or lies under it.
+bool IsInDirectory(const std::string& path, const std::string& directory)
+{
+    return path.compare(0, directory.length(), directory) == 0 &&
+           (path.length() == directory.length() || path[directory.length()] == '/');
+}
+
+class Watch : public CefBase {
+public:
+    Watch(CefRefPtr<CefBrowser> browser,
+          CefRefPtr<CefProcessMessage> response,
+          int32 watchId,
+          const ExtensionString& root,
+          const WatchOptions& options)
+        : browser_(browser)
+        , response_(response)
+        , watchId_(watchId)
+        , root_(root)
+        , options_(options)
+        , inotifyFd_(-1)
+        , wakeFd_(-1)
+        , finished_(false)
+        , rootGone_(false)
+        , overflow_(false)
+        , firstChangeTime_(0)
+        , lastChangeTime_(0) {
+        if (root_.empty() || root_[root_.length() - 1] != '/') {
+            root_ += '/';
+        }
+    }
+
+    // Called on the UI thread.
+    void Start();
+    void Close();
+
+private:
+    static void* ThreadMain(void* watch);
+    void Run();
+
+    int32 AddWatches(const std::string& relativePath, bool reportContents);
+    void RemoveWatches(const std::string& relativePath);
+    void RenameWatches(const std::string& from, const std::string& to);
+
+    void ReadEvents();
+    void HandleEvent(const struct inotify_event* event);
+    void RecordChange(const std::string& path, ChangeKind kind);
+    void RecordRename(const std::string& from, const std::string& to, bool replaced);
+    void Touch();
+    bool HasPendingChanges() const;
+    int64 FlushDeadline() const;
+    void Flush();
+    void Finish(int32 error);
+
+    CefRefPtr<CefBrowser> browser_;
+    CefRefPtr<CefProcessMessage> response_;
+    int32 watchId_;
+    ExtensionString root_;
+    WatchOptions options_;
+
+    int inotifyFd_;
+
+    // Written to by Close() to wake the watch thread up.
+    int wakeFd_;
+
+    // Shared between the UI thread and the watch thread.
+    base::Lock lock_;
+    bool finished_;
+
+    // Only used on the watch thread. Paths are relative to the root, which
+    // is "".
+    std::map<int, std::string> watchPaths_;
+    // The entries of each watched directory, so that a file renamed over
+    // an existing one can be reported as modified rather than created.
+    std::map<int, std::set<std::string> > names_;
+    std::map<std::string, ChangeKind> changes_;
+    std::vector<Rename> renames_;
+    std::map<uint32_t, PendingMove> moves_;
+    std::vector<char> buffer_;
+    bool rootGone_;
+    bool overflow_;
+    int64 firstChangeTime_;
+    int64 lastChangeTime_;
+
+    IMPLEMENT_REFCOUNTING(Watch);
+};
+
+typedef std::pair<int, int32> WatchKey;
+typedef std::map<WatchKey, CefRefPtr<Watch> > WatchMap;
+
+// Watches that haven't finished yet. UI thread only.
+WatchMap g_watches;
+
+void RemoveWatch(WatchKey key, CefRefPtr<Watch> watch)
+{
+    WatchMap::iterator it = g_watches.find(key);
+    if (it != g_watches.end() && it->second.get() == watch.get()) {
+        g_watches.erase(it);
+    }
+}
+
+void Watch::Start()
+{
+    inotifyFd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    wakeFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (inotifyFd_ == -1 || wakeFd_ == -1) {
+        Finish(ERR_UNKNOWN);
+        return;
+    }
+
+    // The thread holds a reference until it's done.
+    AddRef();
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, &Watch::ThreadMain, this) != 0) {
+        fprintf(stderr, "failed to create file watcher thread\n");
+        Release();
+        Finish(ERR_UNKNOWN);
+        return;
+    }
+    pthread_detach(thread);
+}
+
+void Watch::Close()
+{
+    base::AutoLock lock(lock_);
+    if (!finished_ && wakeFd_ != -1) {
+        // Only fails if the counter is already set, which wakes the thread as well.
+        uint64_t one = 1;
+        ssize_t written = write(wakeFd_, &one, sizeof(one));
+        (void)written;
+    }
+}
+
+void* Watch::ThreadMain(void* watch)
+{
+    Watch* self = static_cast<Watch*>(watch);
+    self->Run();
+    self->Release();
+    return NULL;
+}
+
+void Watch::Run()
+{
+    buffer_.resize(kEventBufferSize);
+
+    int32 error = AddWatches("", false);
+    if (error != NO_ERROR) {
+        Finish(error);
+        return;
+    }
+
+    for (;;) {
+        int timeout = -1;
+        if (HasPendingChanges()) {
+            timeout = (int)std::max((int64)0, FlushDeadline() - NowMs());
+        }
+
+        struct pollfd fds[2];
+        fds[0].fd = inotifyFd_;
+        fds[0].events = POLLIN;
+        fds[0].revents = 0;
+        fds[1].fd = wakeFd_;
+        fds[1].events = POLLIN;
+        fds[1].revents = 0;
+
+        if (poll(fds, 2, timeout) == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            error = ERR_UNKNOWN;
+            break;
+        }
+
+        if (fds[1].revents) {
+            // Closed
+            break;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            ReadEvents();
+            if (rootGone_) {
+                // Report what happened up to the root going away.
+                Flush();
+                error = ERR_NOT_FOUND;
+                break;
+            }
+        }
+
+        if (HasPendingChanges() &&
+            (NowMs() >= FlushDeadline() || changes_.size() + renames_.size() >= kMaxPendingChanges)) {
+            Flush();
+        }
+    }
+
+    Finish(error);
+}
+
+// Watches |relativePath| and every directory under it. With
+// |reportContents|, everything found is reported as created: it appeared
+// before the watch was in place, so there were no events for it.
+int32 Watch::AddWatches(const std::string& relativePath, bool reportContents)
+{
+    std::vector<std::string> pending(1, relativePath);
+
+    while (!pending.empty()) {
+        std::string directory = pending.back();
+        pending.pop_back();
+
+        std::string fullPath = root_ + directory;
+        int wd = inotify_add_watch(inotifyFd_, fullPath.c_str(), kWatchMask);
+        if (wd == -1) {
+            int error = errno;
+            if (directory.empty()) {
+                return (error == ENOENT) ? ERR_NOT_FOUND : (error == ENOTDIR) ? ERR_NOT_DIRECTORY : ERR_CANT_READ;
+            }
+            if (error == ENOSPC) {
+                // Out of watches (fs.inotify.max_user_watches); changes in
+                // here will be missed.
+                overflow_ = true;
+                Touch();
+            }
+            continue;
+        }
+        watchPaths_[wd] = directory;
+        std::set<std::string>& names = names_[wd];
+
+        DIR* dp = opendir(fullPath.c_str());
+        if (dp == NULL) {
+            continue;
+        }
+
+        struct dirent* entry;
+        while ((entry = readdir(dp)) != NULL) {
+            const char* name = entry->d_name;
+            if (!strcmp(name, ".") || !strcmp(name, "..")) {
+                continue;
+            }
+
+            std::string path = JoinPath(directory, name);
+            if (IsExcludedPath(options_.exclude, name, path)) {
+                continue;
+            }
+
+            bool isDir = (entry->d_type == DT_DIR);
+            if (entry->d_type == DT_UNKNOWN) {
+                struct stat statbuf;
+                isDir = (fstatat(dirfd(dp), name, &statbuf, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(statbuf.st_mode));
+            }
+
+            names.insert(name);
+            if (reportContents) {
+                RecordChange(path, CHANGE_CREATED);
+            }
+            if (isDir) {
+                pending.push_back(path);
+            }
+        }
+        closedir(dp);
+    }
+
+    return NO_ERROR;
+}
+
+// Drops the watches of a directory that was moved out of the tree.
+void Watch::RemoveWatches(const std::string& relativePath)
+{
+    std::map<int, std::string>::iterator it = watchPaths_.begin();
+    while (it != watchPaths_.end()) {
+        if (IsInDirectory(it->second, relativePath)) {
+            inotify_rm_watch(inotifyFd_, it->first);
+            names_.erase(it->first);
+            watchPaths_.erase(it++);
+        } else {
+            ++it;
+        }
+    }
+}
+
+// Keeps the paths of a moved directory's watches, and of the changes still
+// pending under it, up to date. Renames go out before changes, so the changes
+// have to be under the new paths.
+void Watch::RenameWatches(const std::string& from, const std::string& to)
+{
+    std::map<int, std::string>::iterator it;
+    for (it = watchPaths_.begin(); it != watchPaths_.end(); ++it) {
+        if (IsInDirectory(it->second, from)) {
+            it->second = to + it->second.substr(from.length());
+        }
+    }
+
+    // Everything under |from| sorts together, right after "from/".
+    std::string prefix = from + "/";
+    std::vector<std::pair<std::string, ChangeKind> > moved;
+    std::map<std::string, ChangeKind>::iterator change = changes_.lower_bound(prefix);
+    while (change != changes_.end() && change->first.compare(0, prefix.length(), prefix) == 0) {
+        moved.push_back(std::make_pair(to + change->first.substr(from.length()), change->second));
+        changes_.erase(change++);
+    }
+    for (size_t i = 0; i < moved.size(); i++) {
+        RecordChange(moved[i].first, moved[i].second);
+    }
+
+    std::map<uint32_t, PendingMove>::iterator move;
+    for (move = moves_.begin(); move != moves_.end(); ++move) {
+        if (IsInDirectory(move->second.path, from)) {
+            move->second.path = to + move->second.path.substr(from.length());
+        }
+    }
+}
+
+void Watch::ReadEvents()
+{
+    // The fd is non-blocking, so this drains whatever has queued up.
+    for (;;) {
+        ssize_t length = read(inotifyFd_, &buffer_[0], buffer_.size());
+        if (length <= 0) {
+            return;
+        }
+
+        const char* data = &buffer_[0];
+        const char* end = data + length;
+        while (data < end) {
+            const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(data);
+            HandleEvent(event);
+            data += sizeof(struct inotify_event) + event->len;
+        }
+    }
+}
+
+void Watch::HandleEvent(const struct inotify_event* event)
+{
+    if (event->mask & IN_Q_OVERFLOW) {
+        // Events were lost; the renderer has to look at the tree again.
+        overflow_ = true;
+        Touch();
+        return;
+    }
+
+    std::map<int, std::string>::iterator it = watchPaths_.find(event->wd);
+    if (it == watchPaths_.end()) {
+        return;
+    }
+    std::string directory = it->second;
+
+    if (event->mask & IN_IGNORED) {
+        // The directory is gone; the parent reports that.
+        watchPaths_.erase(it);
+        names_.erase(event->wd);
+        if (directory.empty()) {
+            rootGone_ = true;
+        }
+        return;
+    }
+
+    if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) {
+        if (directory.empty()) {
+            rootGone_ = true;
+        }
+        return;
+    }
+
+    if (event->len == 0) {
+        // Changes to the directory itself show up in the parent as well.
+        return;
+    }
+
+    const char* name = event->name;
+    std::string path = JoinPath(directory, name);
+    if (IsExcludedPath(options_.exclude, name, path)) {
+        return;
+    }
+
+    bool isDir = (event->mask & IN_ISDIR) != 0;
+    std::set<std::string>& names = names_[event->wd];
+
+    if (event->mask & IN_MOVED_FROM) {
+        names.erase(name);
+        moves_[event->cookie] = PendingMove(path, isDir);
+        Touch();
+    } else if (event->mask & IN_MOVED_TO) {
+        // A save that writes a temp file and renames it over the original
+        // replaces an entry that is already there.
+        bool replaced = !names.insert(name).second;
+        std::map<uint32_t, PendingMove>::iterator move = moves_.find(event->cookie);
+        if (move != moves_.end()) {
+            RecordRename(move->second.path, path, replaced);
+            if (isDir) {
+                RenameWatches(move->second.path, path);
+            }
+            moves_.erase(move);
+        } else {
+            // Moved in from outside the tree
+            RecordChange(path, replaced ? CHANGE_MODIFIED : CHANGE_CREATED);
+            if (isDir) {
+                AddWatches(path, true);
+            }
+        }
+    } else if (event->mask & IN_CREATE) {
+        names.insert(name);
+        RecordChange(path, CHANGE_CREATED);
+        if (isDir) {
+            AddWatches(path, true);
+        }
+    } else if (event->mask & IN_DELETE) {
+        names.erase(name);
+        RecordChange(path, CHANGE_DELETED);
+    } else if ((event->mask & (IN_MODIFY | IN_ATTRIB)) && !isDir) {
+        RecordChange(path, CHANGE_MODIFIED);
+    }
+}
+
+void Watch::RecordChange(const std::string& path, ChangeKind kind)
+{
+    Touch();
+
+    std::map<std::string, ChangeKind>::iterator it = changes_.find(path);
+    if (it == changes_.end()) {
+        changes_[path] = kind;
+        return;
+    }
+
+    ChangeKind previous = it->second;
+    if (previous == CHANGE_CREATED && kind == CHANGE_DELETED) {
+        // Never existed as far as the renderer is concerned
+        changes_.erase(it);
+    } else if (previous == CHANGE_CREATED) {
+        // Still new, however often it was written to
+    } else if (previous == CHANGE_DELETED && kind == CHANGE_CREATED) {
+        // Replaced, e.g. by a save that deletes and rewrites the file
+        it->second = CHANGE_MODIFIED;
+    } else {
+        it->second = kind;
+    }
+}
+
+void Watch::RecordRename(const std::string& from, const std::string& to, bool replaced)
+{
+    Touch();
+
+    std::map<std::string, ChangeKind>::iterator it = changes_.find(from);
+    if (it != changes_.end()) {
+        ChangeKind previous = it->second;
+        changes_.erase(it);
+        if (previous == CHANGE_CREATED) {
+            // The renderer never heard of |from|, only of what it replaced.
+            RecordChange(to, replaced ? CHANGE_MODIFIED : CHANGE_CREATED);
+            return;
+        }
+        if (previous == CHANGE_MODIFIED) {
+            RecordChange(to, CHANGE_MODIFIED);
+        }
+    }
+
+    renames_.push_back(Rename(from, to));
+}
+
+void Watch::Touch()
+{
+    int64 now = NowMs();
+    if (!HasPendingChanges()) {
+        firstChangeTime_ = now;
+    }
+    lastChangeTime_ = now;
+}
+
+bool Watch::HasPendingChanges() const
+{
+    return !changes_.empty() || !renames_.empty() || !moves_.empty() || overflow_;
+}
+
+// When the pending changes go out: once the tree has been quiet for the
+// debounce window, or when the oldest change has waited long enough.
+int64 Watch::FlushDeadline() const
+{
+    int64 maxDelay = std::max((int64)options_.debounceMs, kMaxBatchDelayMs);
+    return std::min(lastChangeTime_ + options_.debounceMs, firstChangeTime_ + maxDelay);
+}
+
+void Watch::Flush()
+{
+    // A MOVED_FROM without a MOVED_TO by now was a move out of the tree.
+    std::map<uint32_t, PendingMove>::iterator move;
+    for (move = moves_.begin(); move != moves_.end(); ++move) {
+        RecordChange(move->second.path, CHANGE_DELETED);
+        if (move->second.isDir) {
+            RemoveWatches(move->second.path);
+        }
+    }
+    moves_.clear();
+
+    // Flat list of [type, path, oldPath, type, path, oldPath, ...]
+    CefRefPtr<CefListValue> changes = CefListValue::Create();
+    size_t index = 0;
+    changes->SetSize((renames_.size() + changes_.size()) * 3);
+
+    for (size_t i = 0; i < renames_.size(); i++) {
+        changes->SetString(index++, "renamed");
+        changes->SetString(index++, renames_[i].second);
+        changes->SetString(index++, renames_[i].first);
+    }
+
+    std::map<std::string, ChangeKind>::iterator it;
+    for (it = changes_.begin(); it != changes_.end(); ++it) {
+        changes->SetString(index++, kChangeNames[it->second]);
+        changes->SetString(index++, it->first);
+        changes->SetString(index++, "");
+    }
+
+    // Progress callbacks get null in place of the error code, which tells the
+    // JS side apart from the final callback.
+    CefRefPtr<CefProcessMessage> message = CefProcessMessage::Create("invokeProgressCallback");
+    CefRefPtr<CefListValue> messageArgs = message->GetArgumentList();
+    messageArgs->SetInt(0, response_->GetArgumentList()->GetInt(0));
+    messageArgs->SetNull(1);
+    messageArgs->SetList(2, changes);
+    messageArgs->SetBool(3, overflow_);
+    SendResponse(browser_, message);
+
+    changes_.clear();
+    renames_.clear();
+    overflow_ = false;
+}
+
+void Watch::Finish(int32 error)
+{
+    {
+        base::AutoLock lock(lock_);
+        finished_ = true;
+        if (wakeFd_ != -1) {
+            close(wakeFd_);
+            wakeFd_ = -1;
+        }
+    }
+
+    // Closing the inotify instance drops all of its watches.
+    if (inotifyFd_ != -1) {
+        close(inotifyFd_);
+        inotifyFd_ = -1;
+    }
+    watchPaths_.clear();
+    names_.clear();
+
+    response_->GetArgumentList()->SetInt(1, error);
+    SendResponse(browser_, response_);
+
+    CefPostTask(TID_UI, base::Bind(&RemoveWatch, WatchKey(browser_->GetIdentifier(), watchId_),
+                                   CefRefPtr<Watch>(this)));
+}
+
+}  // namespace
+
+void StartWatch(CefRefPtr<CefBrowser> browser,
+                CefRefPtr<CefProcessMessage> response,
+                int32 watchId,
+                const ExtensionString& root,
+                const WatchOptions& options)
+{
+    WatchKey key(browser->GetIdentifier(), watchId);
+
+    // Ids are handed out by the renderer, which starts over after a reload.
+    WatchMap::iterator existing = g_watches.find(key);
+    if (existing != g_watches.end()) {
+        existing->second->Close();
+    }
+
+    WatchOptions watchOptions = options;
+    watchOptions.debounceMs = std::max(kMinDebounceMs, std::min(watchOptions.debounceMs, kMaxDebounceMs));
+
+    CefRefPtr<Watch> watch = new Watch(browser, response, watchId, root, watchOptions);
+    g_watches[key] = watch;
+    watch->Start();
+}
+
+void CloseWatch(CefRefPtr<CefBrowser> browser, int32 watchId)
+{
+    WatchMap::iterator it = g_watches.find(WatchKey(browser->GetIdentifier(), watchId));
+    if (it != g_watches.end()) {
+        it->second->Close();
+    }
+}
+
+void CloseBrowserWatches(CefRefPtr<CefBrowser> browser)
+{
+    WatchMap::iterator it = g_watches.begin();
+    while (it != g_watches.end()) {
+        if (it->first.first == browser->GetIdentifier()) {
+            it->second->Close();
+            g_watches.erase(it++);
+        } else {
+            ++it;
+        }
+    }
+}
+
+#else
+
+void StartWatch(CefRefPtr<CefBrowser> browser,
+                CefRefPtr<CefProcessMessage> response,
+                int32 watchId,
+                const ExtensionString& root,
+                const WatchOptions& options)
+{
+    response->GetArgumentList()->SetInt(1, ERR_NOT_SUPPORTED);
+    SendResponse(browser, response);
+}
+
+void CloseWatch(CefRefPtr<CefBrowser> browser, int32 watchId)
+{
+}
+
+void CloseBrowserWatches(CefRefPtr<CefBrowser> browser)
+{
+}
+
+#endif
+
+}  // namespace appshell_extensions
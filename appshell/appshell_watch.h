@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2016 - present Adobe Systems Incorporated. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "include/cef_browser.h"
+#include "include/cef_process_message.h"
+
+#include "appshell_extensions_platform.h"
+
+#include <string>
+#include <vector>
+
+namespace appshell_extensions {
+
+// Native change notification for appshell.fs.watch().
+//
+// Each watch runs on its own thread, since it spends its life blocked waiting
+// for events and would tie up a worker for good. On Linux every directory
+// under the root gets an inotify watch, and directories that appear later are
+// added as they show up.
+//
+// Events are coalesced over a debounce window and pushed to the renderer as
+// one "invokeProgressCallback" message per change set. A file that is
+// created and modified in the same window is only reported as created, one
+// that is created and deleted is not reported at all, and so on. A
+// MOVED_FROM/MOVED_TO pair with the same cookie is reported as one rename.
+//
+// The watch's callback gets the final "invokeCallback" when the watch is
+// closed, or when its root goes away (ERR_NOT_FOUND).
+//
+// Only implemented on Linux; other platforms respond with ERR_NOT_SUPPORTED.
+//
+// All functions must be called on the UI thread.
+
+struct WatchOptions {
+    WatchOptions() : debounceMs(100) {}
+
+    // Glob patterns of entries to leave out, matched like WalkOptions::exclude.
+    std::vector<std::string> exclude;
+
+    // How long the tree has to be quiet before a change set is sent. Changes
+    // are never held back longer than a second, however busy the tree is.
+    int32 debounceMs;
+};
+
+// Starts watching |root|. |response| is the final response message and
+// already holds the callback id.
+void StartWatch(CefRefPtr<CefBrowser> browser,
+                CefRefPtr<CefProcessMessage> response,
+                int32 watchId,
+                const ExtensionString& root,
+                const WatchOptions& options);
+
+// Stops watch |watchId|. Its callback gets NO_ERROR.
+void CloseWatch(CefRefPtr<CefBrowser> browser, int32 watchId);
+
+// Stops every watch of |browser|. Called when the browser closes.
+void CloseBrowserWatches(CefRefPtr<CefBrowser> browser);
+
+}  // namespace appshell_extensions
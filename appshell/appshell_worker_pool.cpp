@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2016 - present Adobe Systems Incorporated. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "appshell_worker_pool.h"
+
+#include "include/cef_task.h"
+#include "include/wrapper/cef_closure_task.h"
+
+#ifdef OS_LINUX
+#include <pthread.h>
+#include <stdio.h>
+#include <deque>
+#endif
+
+namespace appshell {
+
+#ifdef OS_LINUX
+
+namespace {
+
+// A single worker thread with its own FIFO queue. Keyed tasks always land on
+// the same Worker, which is what keeps them in order.
+class Worker {
+public:
+    Worker() {
+        pthread_mutex_init(&mutex_, NULL);
+        pthread_cond_init(&cond_, NULL);
+    }
+
+    bool Start() {
+        pthread_t thread_id;
+        if (pthread_create(&thread_id, NULL, &Worker::ThreadMain, this) != 0) {
+            fprintf(stderr, "failed to create worker thread\n");
+            return false;
+        }
+        pthread_detach(thread_id);
+        return true;
+    }
+
+    void Post(const base::Closure& task) {
+        pthread_mutex_lock(&mutex_);
+        queue_.push_back(task);
+        pthread_cond_signal(&cond_);
+        pthread_mutex_unlock(&mutex_);
+    }
+
+private:
+    static void* ThreadMain(void* worker) {
+        static_cast<Worker*>(worker)->Run();
+        return NULL;
+    }
+
+    void Run() {
+        for (;;) {
+            pthread_mutex_lock(&mutex_);
+            while (queue_.empty()) {
+                pthread_cond_wait(&cond_, &mutex_);
+            }
+            base::Closure task = queue_.front();
+            queue_.pop_front();
+            pthread_mutex_unlock(&mutex_);
+
+            task.Run();
+        }
+    }
+
+    pthread_mutex_t mutex_;
+    pthread_cond_t cond_;
+    std::deque<base::Closure> queue_;
+};
+
+Worker* g_workers = NULL;
+bool g_workersStarted = false;
+pthread_once_t g_workersOnce = PTHREAD_ONCE_INIT;
+
+void StartWorkers() {
+    g_workers = new Worker[kWorkerPoolSize];
+    g_workersStarted = true;
+    for (int i = 0; i < kWorkerPoolSize; i++) {
+        if (!g_workers[i].Start()) {
+            g_workersStarted = false;
+        }
+    }
+}
+
+// FNV-1a; only used to spread keys over the workers.
+size_t HashKey(const ExtensionString& key) {
+    size_t hash = 2166136261u;
+    for (size_t i = 0; i < key.size(); i++) {
+        hash = (hash ^ (unsigned char)key[i]) * 16777619u;
+    }
+    return hash;
+}
+
+}  // namespace
+
+void PostWorkerTask(const ExtensionString& key, const base::Closure& task) {
+    pthread_once(&g_workersOnce, &StartWorkers);
+
+    if (!g_workersStarted) {
+        // Couldn't spin up the pool; keep things working on the file thread.
+        CefPostTask(TID_FILE, task);
+        return;
+    }
+
+    g_workers[HashKey(key) % kWorkerPoolSize].Post(task);
+}
+
+#else
+
+void PostWorkerTask(const ExtensionString& key, const base::Closure& task) {
+    CefPostTask(TID_FILE, task);
+}
+
+#endif
+
+}  // namespace appshell
@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2016 - present Adobe Systems Incorporated. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "include/base/cef_callback.h"
+
+#include "appshell_extensions_platform.h"
+
+namespace appshell {
+
+// Number of threads used to run blocking native commands on Linux.
+static const int kWorkerPoolSize = 4;
+
+// Posts |task| to the pool of worker threads that run blocking native
+// commands (file system access, mostly) off the browser UI thread.
+//
+// Tasks posted with the same |key| -- usually the path the command operates
+// on -- run one at a time, in the order they were posted. Tasks with
+// different keys may run concurrently.
+//
+// On Linux this is a fixed pool of kWorkerPoolSize threads. Other platforms
+// use the CEF file thread, which runs all tasks in order.
+void PostWorkerTask(const ExtensionString& key, const base::Closure& task);
+
+}  // namespace appshell
@@ -121,15 +121,23 @@ bool ClientApp::OnProcessMessageReceived(
     }
 
     if (!handled) {
-        if (message->GetName() == "invokeCallback") {
+        if (message->GetName() == "invokeCallback" || message->GetName() == "invokeProgressCallback") {
             // This is called by the appshell extension handler to invoke the asynchronous 
-            // callback function
+            // callback function. Streaming functions send their intermediate results
+            // with "invokeProgressCallback", which leaves the callback registered for
+            // the final "invokeCallback".
             
             CefRefPtr<CefListValue> messageArgs = message->GetArgumentList();
             int32 callbackId = messageArgs->GetInt(0);
+
+            CallbackMap::iterator found = callback_map_.find(callbackId);
+            if (found == callback_map_.end()) {
+                // The context was released while the call was in flight.
+                return true;
+            }
                     
-            CefRefPtr<CefV8Context> context = callback_map_[callbackId].first;
-            CefRefPtr<CefV8Value> callbackFunction = callback_map_[callbackId].second;
+            CefRefPtr<CefV8Context> context = found->second.first;
+            CefRefPtr<CefV8Value> callbackFunction = found->second.second;
             CefV8ValueList arguments;
             context->Enter();
             
@@ -147,7 +155,9 @@ bool ClientApp::OnProcessMessageReceived(
             
             context->Exit();
             
-            callback_map_.erase(callbackId);
+            if (message->GetName() == "invokeCallback") {
+                callback_map_.erase(callbackId);
+            }
         } else if (message->GetName() == "executeCommand") {
             // This is called by the browser process to execute a command via JavaScript
             // 
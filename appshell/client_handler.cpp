@@ -167,6 +167,9 @@ void ClientHandler::OnAfterCreated(CefRefPtr<CefBrowser> browser) {
 void ClientHandler::OnBeforeClose(CefRefPtr<CefBrowser> browser) {
   CEF_REQUIRE_UI_THREAD();
 
+  // Nobody is left to hear about file changes, Node or running jobs.
+  appshell_extensions::CancelBrowserJobs(browser);
+
   if (CanCloseBrowser(browser)) {
     if (m_BrowserId == browser->GetIdentifier()) {
       // Free the browser pointer so that the browser can be destroyed
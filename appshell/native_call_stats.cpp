@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2016 - present Adobe Systems Incorporated. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "native_call_stats.h"
+
+#include <string.h>
+
+NativeCallStats::NativeCallStats()
+    : calls_(0),
+      errors_(0)
+{
+    memset(latencyBuckets_, 0, sizeof(latencyBuckets_));
+}
+
+void NativeCallStats::Record(int64 latencyUs, bool failed)
+{
+    calls_++;
+    if (failed) {
+        errors_++;
+    }
+    latencyBuckets_[GetBucket(latencyUs)]++;
+}
+
+double NativeCallStats::GetLatencyPercentile(double percentile) const
+{
+    if (calls_ == 0) {
+        return 0;
+    }
+
+    // Rank of the sample we're after, counting from 1.
+    uint32 rank = (uint32)(percentile / 100 * calls_ + 0.5);
+    if (rank < 1) {
+        rank = 1;
+    } else if (rank > calls_) {
+        rank = calls_;
+    }
+
+    uint32 seen = 0;
+    for (int i = 0; i < kLatencyBucketCount; i++) {
+        seen += latencyBuckets_[i];
+        if (seen >= rank) {
+            return GetBucketMidpoint(i) / 1000.0;
+        }
+    }
+    return GetBucketMidpoint(kLatencyBucketCount - 1) / 1000.0;
+}
+
+// Buckets 0 - 3 hold 0 - 3us exactly. Above that, every power of two is split
+// into four buckets using the two bits below the most significant one.
+int NativeCallStats::GetBucket(int64 latencyUs)
+{
+    if (latencyUs < 4) {
+        return latencyUs < 0 ? 0 : (int)latencyUs;
+    }
+
+    int msb = 0;
+    for (int64 v = latencyUs; v > 1; v >>= 1) {
+        msb++;
+    }
+
+    int bucket = 4 + (msb - 2) * 4 + (int)((latencyUs >> (msb - 2)) & 3);
+    return bucket < kLatencyBucketCount ? bucket : kLatencyBucketCount - 1;
+}
+
+double NativeCallStats::GetBucketMidpoint(int bucket)
+{
+    if (bucket < 4) {
+        return bucket;
+    }
+
+    int shift = (bucket - 4) / 4;
+    int64 mantissa = 4 + (bucket - 4) % 4;
+    int64 lower = mantissa << shift;
+    int64 upper = ((mantissa + 1) << shift) - 1;
+    return (lower + upper) / 2.0;
+}
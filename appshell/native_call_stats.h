@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2016 - present Adobe Systems Incorporated. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include "include/cef_base.h"
+
+// Call count, error count and a latency histogram for one native command
+// (see the command table in appshell_extensions.cpp). Not thread-safe: all
+// recording and reading happens on the browser UI thread.
+//
+// Latencies are kept in log-linear buckets (four per power of two) and
+// percentiles report the middle of a bucket, so they are accurate to within
+// about 12% while the memory use stays fixed for the whole session.
+class NativeCallStats
+{
+public:
+    NativeCallStats();
+
+    // Records one call that took |latencyUs| microseconds from the time the
+    // message was received to the time the response was sent.
+    void Record(int64 latencyUs, bool failed);
+
+    uint32 GetCallCount() const { return calls_; }
+    uint32 GetErrorCount() const { return errors_; }
+
+    // Returns the |percentile| (0 - 100) latency in milliseconds, or 0 when
+    // nothing has been recorded yet.
+    double GetLatencyPercentile(double percentile) const;
+
+private:
+    static const int kLatencyBucketCount = 4 + 34 * 4;
+
+    static int GetBucket(int64 latencyUs);
+    static double GetBucketMidpoint(int bucket);
+
+    uint32 calls_;
+    uint32 errors_;
+    uint32 latencyBuckets_[kLatencyBucketCount];
+};
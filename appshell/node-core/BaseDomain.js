@@ -24,7 +24,8 @@
 "use strict";
 
 var Launcher = require("./Launcher"),
-    Logger   = require("./Logger");
+    Logger   = require("./Logger"),
+    Server   = require("./Server");
 
 /**
  * @private
@@ -72,6 +73,35 @@ function cmdLoadDomainModulesFromPaths(paths) {
     }
 }
 
+/**
+ * @private
+ * Implementation of base.loadDomainManifestsFromPaths
+ * @param {Array.<string>} paths Paths of the manifests to load
+ * @return {boolean} Whether the load succeeded
+ */
+function cmdLoadDomainManifestsFromPaths(paths) {
+    if (_domainManager) {
+        var success = _domainManager.loadDomainManifestsFromPaths(paths);
+        if (success) {
+            _domainManager.emitEvent("base", "newDomains");
+        }
+        return success;
+    } else {
+        return false;
+    }
+}
+
+/**
+ * @private
+ * Implementation of base.benchmarkCommandChannel command.
+ * @param {number} count Number of commands to send to the shell
+ * @param {number} payloadSize Bytes of padding in each command
+ * @param {function(?string, Object)} callback Called with the results
+ */
+function cmdBenchmarkCommandChannel(count, payloadSize, callback) {
+    Server.benchmarkCommandChannel(count, payloadSize, callback);
+}
+
 /**
  *
  * Registers commands with the DomainManager
@@ -99,6 +129,33 @@ function init(domainManager) {
         [], // no parameters
         []  // no return type
     );
+    _domainManager.registerCommand(
+        "base",
+        "benchmarkCommandChannel",
+        cmdBenchmarkCommandChannel,
+        true,
+        "Measure the throughput of the stdout command channel to the shell " +
+            "by sending it a burst of commands",
+        [{name: "count", type: "number"},
+            {name: "payloadSize", type: "number"}],
+        [{name: "result", type: "{framed: boolean, commands: number, bytes: number, ms: number, " +
+            "commandsPerSecond: number, megabytesPerSecond: number}"}]
+    );
+    // CPU-bound, so keep it off the main thread
+    _domainManager.registerOffloadedCommand(
+        "base",
+        "benchmarkEncodings",
+        require.resolve("./EncodingBenchmark"),
+        "benchmarkEncodings",
+        false,
+        "Measure how fast messages are encoded and decoded as JSON and as " +
+            "MessagePack",
+        [{name: "count", type: "number"},
+            {name: "itemCount", type: "number"}],
+        [{name: "result", type: "{json: {bytes: number, ms: number, messagesPerSecond: number, " +
+            "megabytesPerSecond: number}, msgpack: {bytes: number, ms: number, " +
+            "messagesPerSecond: number, megabytesPerSecond: number}}"}]
+    );
     _domainManager.registerCommand(
         "base",
         "loadDomainModulesFromPaths",
@@ -109,6 +166,17 @@ function init(domainManager) {
         [{name: "paths", type: "array<string>"}],
         [{name: "success", type: "boolean"}]
     );
+    _domainManager.registerCommand(
+        "base",
+        "loadDomainManifestsFromPaths",
+        cmdLoadDomainManifestsFromPaths,
+        false,
+        "Register the domains described by manifest files. Each domain's " +
+            "module is loaded the first time one of its commands is run. " +
+            "The paths should be absolute.",
+        [{name: "paths", type: "array<string>"}],
+        [{name: "success", type: "boolean"}]
+    );
 
     _domainManager.registerEvent(
         "base",
@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2017 - present Adobe Systems Incorporated. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+"use strict";
+
+/*
+ * Runs offloaded domain commands inside a worker process started by
+ * WorkerPool. Each message from the main process is one job; the worker
+ * answers with any number of progress messages followed by a single done
+ * message.
+ */
+
+var WorkerPool = require("./WorkerPool");
+
+/**
+ * @private
+ * Runs a single job and reports back to the main process.
+ * @param {{modulePath: string, exportName: string, isAsync: boolean,
+ *     parameters: Array}} job
+ */
+function _runJob(job) {
+    var finished = false;
+    var done = function (err, result) {
+        if (finished) {
+            return;
+        }
+        finished = true;
+        if (err) {
+            process.send({
+                type: "done",
+                error: WorkerPool.errorMessage(err)
+            });
+        } else {
+            process.send({
+                type: "done",
+                error: null,
+                result: WorkerPool.pack(result)
+            });
+        }
+    };
+    var progressCallback = function (msg) {
+        process.send({type: "progress", message: msg});
+    };
+
+    try {
+        var commandFunction = require(job.modulePath)[job.exportName];
+        if (typeof commandFunction !== "function") {
+            throw new Error(job.modulePath + " does not export " + job.exportName);
+        }
+        var parameters = job.parameters.map(WorkerPool.unpack);
+        if (job.isAsync) {
+            commandFunction.apply(null, parameters.concat([done, progressCallback]));
+        } else {
+            done(null, commandFunction.apply(null, parameters));
+        }
+    } catch (e) {
+        done(e);
+    }
+}
+
+process.on("message", _runJob);
+
+// The main process is gone, or has retired this worker
+process.on("disconnect", function () {
+    process.exit(0);
+});
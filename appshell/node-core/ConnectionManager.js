@@ -23,7 +23,55 @@
 
 "use strict";
 
-var DomainManager = require("./DomainManager");
+var DomainManager = require("./DomainManager"),
+    MessagePack   = require("./MessagePack");
+
+/**
+ * @const
+ * @type {string}
+ * WebSocket sub-protocol of clients that want MessagePack instead of JSON.
+ * Messages in both directions are then binary frames holding one
+ * MessagePack-encoded message, with the same fields the JSON ones have, and
+ * binary command responses are sent as a bin field of a normal
+ * commandResponse. Text frames are still parsed as JSON.
+ */
+var PROTOCOL_MSGPACK = "brackets-msgpack";
+
+/**
+ * @const
+ * @type {number}
+ * Milliseconds that events are collected before they are sent. A burst of
+ * events is then encoded once for all connections, and written to each
+ * socket in one go.
+ */
+var EVENT_FLUSH_DELAY = 10;
+
+/**
+ * @const
+ * @type {number}
+ * Bytes a socket may have waiting to be written before its connection
+ * counts as slow. Messages for a slow connection wait in its backlog until
+ * the socket drains, so it can't hold up the others.
+ */
+var SLOW_SOCKET_BYTES = 1024 * 1024;
+
+/**
+ * @const
+ * @type {number}
+ * Most events kept in the backlog of a connection that has stalled, i.e.
+ * whose socket hasn't drained for STALLED_SOCKET_DELAY. Beyond it, the
+ * oldest events are dropped. Other messages are never dropped, and a
+ * connection that is still draining keeps everything.
+ */
+var MAX_BACKLOG_EVENTS = 1000;
+
+/**
+ * @const
+ * @type {number}
+ * Milliseconds without the socket draining after which a connection with a
+ * backlog counts as stalled.
+ */
+var STALLED_SOCKET_DELAY = 1000;
 
 /**
  * @private
@@ -32,6 +80,122 @@ var DomainManager = require("./DomainManager");
  */
 var _connections = [];
 
+/**
+ * @private
+ * @type {Array.<Event>}
+ * Events waiting for the next flush, and the timer for it.
+ */
+var _pendingEvents = [];
+var _flushTimer = null;
+
+/**
+ * @private
+ * Encodes a message for the wire.
+ * @param {string} type Message type
+ * @param {object} message Message body
+ * @param {boolean} msgpack Whether to use MessagePack rather than JSON
+ * @return {?Buffer} The frame's payload, or null if the message can't be
+ *    encoded
+ */
+function _encodeMessage(type, message, msgpack) {
+    try {
+        if (msgpack) {
+            return MessagePack.encode({type: type, message: message});
+        }
+        return Buffer.from(JSON.stringify({type: type, message: message}));
+    } catch (e) {
+        console.error("[Connection] Unable to stringify message: " + e.message);
+        return null;
+    }
+}
+
+/**
+ * @private
+ * @constructor
+ * An event on its way to one or more connections. It is encoded at most
+ * once per encoding, and the frames are shared by every connection.
+ * @param {number} id unique ID for the event.
+ * @param {string} domain Domain of the event.
+ * @param {string} event Name of the event
+ * @param {object} parameters Event parameters.
+ */
+function Event(id, domain, event, parameters) {
+    this.id = id;
+    this.domain = domain;
+    this.event = event;
+    this.parameters = parameters;
+    this._frames = {};
+}
+
+/**
+ * Returns the event's frame payload in one encoding.
+ * @param {boolean} msgpack Whether to use MessagePack rather than JSON
+ * @return {?Buffer} The payload, or null if the event can't be encoded
+ */
+Event.prototype.getFrame = function (msgpack) {
+    var encoding = msgpack ? "msgpack" : "json";
+    if (!this._frames.hasOwnProperty(encoding)) {
+        this._frames[encoding] = _encodeMessage("event", {
+            id: this.id,
+            domain: this.domain,
+            event: this.event,
+            parameters: this.parameters
+        }, msgpack);
+    }
+    return this._frames[encoding];
+};
+
+/**
+ * Returns what the event says, without its id. Two events with the same
+ * key only need to be sent once to a connection that hasn't been sent
+ * either yet.
+ * @return {string}
+ */
+Event.prototype.getMergeKey = function () {
+    if (this._mergeKey === undefined) {
+        try {
+            this._mergeKey = this.domain + "." + this.event + ":" + JSON.stringify(this.parameters);
+        } catch (e) {
+            this._mergeKey = null;
+        }
+    }
+    return this._mergeKey;
+};
+
+/**
+ * @private
+ * Sends the pending events to every connection. Each event is encoded once
+ * per encoding in use, and each socket gets all of them in one write.
+ */
+function _flushEvents() {
+    if (_flushTimer) {
+        clearTimeout(_flushTimer);
+        _flushTimer = null;
+    }
+    if (_pendingEvents.length === 0) {
+        return;
+    }
+
+    var events = _pendingEvents;
+    _pendingEvents = [];
+    _connections.forEach(function (c) {
+        var socket = c._ws && c._ws._socket,
+            corked = socket && typeof socket.cork === "function";
+        if (corked) {
+            socket.cork();
+        }
+        events.forEach(function (e) {
+            var frame = e.getFrame(c._msgpack);
+            if (frame) {
+                c._write(frame, e);
+            }
+        });
+        if (corked) {
+            socket.uncork();
+        }
+    });
+}
+
 /**
  * @private
  * @constructor
@@ -43,8 +207,14 @@ var _connections = [];
 function Connection(ws) {
     this._ws = ws;
     this._connected = true;
+    this._msgpack = (ws.protocol === PROTOCOL_MSGPACK);
+    this._backlog = [];
+    this._backlogKeys = {};
     this._ws.on("message", this._receive.bind(this));
     this._ws.on("close", this.close.bind(this));
+    if (this._ws._socket) {
+        this._ws._socket.on("drain", this._sendBacklog.bind(this));
+    }
 }
 
 /**
@@ -61,6 +231,148 @@ Connection.prototype._connected = false;
  */
 Connection.prototype._ws = null;
 
+/**
+ * @private
+ * @type {boolean}
+ * Whether the client negotiated the MessagePack sub-protocol.
+ */
+Connection.prototype._msgpack = false;
+
+/**
+ * @private
+ * @type {Array.<{frame: Buffer, event: ?Event}>}
+ * Messages waiting for the socket to drain, oldest first. event is set for
+ * events, which may be merged or dropped.
+ */
+Connection.prototype._backlog = null;
+
+/**
+ * @private
+ * @type {Object.<string, boolean>}
+ * Merge keys of the events in the backlog.
+ */
+Connection.prototype._backlogKeys = null;
+
+/**
+ * @private
+ * @type {number}
+ * Number of events in the backlog.
+ */
+Connection.prototype._backlogEvents = 0;
+
+/**
+ * @private
+ * @type {number}
+ * When the backlog last started filling or the socket last drained.
+ */
+Connection.prototype._backlogProgressTime = 0;
+
+/**
+ * @private
+ * @type {number}
+ * Events dropped since the backlog was last empty.
+ */
+Connection.prototype._eventsDropped = 0;
+
+/**
+ * @private
+ * Returns how many bytes are waiting to be written to the socket.
+ * @return {number}
+ */
+Connection.prototype._bufferedAmount = function () {
+    var socket = this._ws && this._ws._socket;
+    if (!socket) {
+        return 0;
+    }
+    return socket.writableLength !== undefined ? socket.writableLength : socket.bufferSize;
+};
+
+/**
+ * @private
+ * Sends a frame right away, or adds it to the backlog if the socket already
+ * has SLOW_SOCKET_BYTES waiting. A backlogged event is left out if the
+ * backlog already has one saying the same thing, and once the connection
+ * has stalled, the oldest events are dropped to keep MAX_BACKLOG_EVENTS.
+ * @param {Buffer} frame Frame payload from _encodeMessage
+ * @param {?Event} event The event, if this is one
+ * @param {boolean=} binary Whether to send a binary frame on a JSON
+ *    connection, as for binary command responses
+ */
+Connection.prototype._write = function (frame, event, binary) {
+    if (!this._ws || !this._connected) {
+        return;
+    }
+    binary = this._msgpack || !!binary;
+    if (this._backlog.length === 0) {
+        if (this._bufferedAmount() < SLOW_SOCKET_BYTES) {
+            this._ws.send(frame, {binary: binary, mask: false});
+            return;
+        }
+        this._backlogProgressTime = Date.now();
+    }
+
+    var key = null,
+        i;
+    if (event) {
+        key = event.getMergeKey();
+        if (key !== null && this._backlogKeys.hasOwnProperty(key)) {
+            return;
+        }
+        if (this._backlogEvents >= MAX_BACKLOG_EVENTS &&
+                Date.now() - this._backlogProgressTime > STALLED_SOCKET_DELAY) {
+            for (i = 0; i < this._backlog.length; i++) {
+                if (this._backlog[i].event) {
+                    this._removeFromBacklog(i);
+                    break;
+                }
+            }
+            if (this._eventsDropped++ === 0) {
+                console.warn("[Connection] Client is not keeping up, dropping events");
+            }
+        }
+        if (key !== null) {
+            this._backlogKeys[key] = true;
+        }
+        this._backlogEvents++;
+    }
+    this._backlog.push({frame: frame, event: event, key: key, binary: binary});
+};
+
+/**
+ * @private
+ * Takes entry |index| out of the backlog.
+ * @param {number} index
+ * @return {{frame: Buffer, event: ?Event, key: ?string, binary: boolean}}
+ *    The entry
+ */
+Connection.prototype._removeFromBacklog = function (index) {
+    var entry = this._backlog.splice(index, 1)[0];
+    if (entry.event) {
+        this._backlogEvents--;
+        if (entry.key !== null) {
+            delete this._backlogKeys[entry.key];
+        }
+    }
+    return entry;
+};
+
+/**
+ * @private
+ * Sends backlogged messages until the socket is slow again. Called when the
+ * socket drains.
+ */
+Connection.prototype._sendBacklog = function () {
+    this._backlogProgressTime = Date.now();
+    while (this._backlog.length > 0 && this._connected &&
+            this._bufferedAmount() < SLOW_SOCKET_BYTES) {
+        var entry = this._removeFromBacklog(0);
+        this._ws.send(entry.frame, {binary: entry.binary, mask: false});
+    }
+    if (this._backlog.length === 0) {
+        this._eventsDropped = 0;
+    }
+};
+
 /**
  * @private
  * Sends a message over the WebSocket. Called by public sendX commands.
@@ -70,10 +382,12 @@ Connection.prototype._ws = null;
  */
 Connection.prototype._send = function (type, message) {
     if (this._ws && this._connected) {
-        try {
-            this._ws.send(JSON.stringify({type: type, message: message}));
-        } catch (e) {
-            console.error("[Connection] Unable to stringify message: " + e.message);
+        // Events emitted before this message go out before it
+        _flushEvents();
+
+        var frame = _encodeMessage(type, message, this._msgpack);
+        if (frame) {
+            this._write(frame, null);
         }
     }
 };
@@ -86,7 +400,8 @@ Connection.prototype._send = function (type, message) {
  */
 Connection.prototype._sendBinary = function (message) {
     if (this._ws && this._connected) {
-        this._ws.send(message, {binary: true, mask: false});
+        _flushEvents();
+        this._write(message, null, true);
     }
 };
 
@@ -94,12 +409,18 @@ Connection.prototype._sendBinary = function (message) {
  * @private
  * Receive event handler for the WebSocket. Responsible for parsing
  * message and handing it off to the appropriate handler.
- * @param {string} message Message received by WebSocket
+ * @param {string|Buffer} message Message received by WebSocket
+ * @param {{binary: boolean}} flags Whether it came in a binary frame, which
+ *    holds MessagePack
  */
-Connection.prototype._receive = function (message) {
+Connection.prototype._receive = function (message, flags) {
     var m;
     try {
-        m = JSON.parse(message);
+        if (flags && flags.binary) {
+            m = MessagePack.decode(message);
+        } else {
+            m = JSON.parse(message);
+        }
     } catch (parseError) {
         this.sendError("Unable to parse message: " + message);
         return;
@@ -132,6 +453,9 @@ Connection.prototype.close = function () {
         }
     }
     this._connected = false;
+    this._backlog = [];
+    this._backlogKeys = {};
+    this._backlogEvents = 0;
     _connections.splice(_connections.indexOf(this), 1);
 };
 
@@ -152,7 +476,7 @@ Connection.prototype.sendError = function (message) {
  *    the result will be sent as a binary response.
  */
 Connection.prototype.sendCommandResponse = function (id, response) {
-    if (Buffer.isBuffer(response)) {
+    if (Buffer.isBuffer(response) && !this._msgpack) {
         // Assume the id is an unsigned 32-bit integer, which is encoded
         // as a four-byte header
         var header = new Buffer(4);
@@ -200,13 +524,37 @@ Connection.prototype.sendCommandError = function (id, message, stack) {
  */
 Connection.prototype.sendEventMessage =
     function (id, domain, event, parameters) {
-        this._send("event", {id: id,
-                             domain: domain,
-                             event: event,
-                             parameters: parameters
-                            });
+        if (this._ws && this._connected) {
+            _flushEvents();
+
+            var e = new Event(id, domain, event, parameters),
+                frame = e.getFrame(this._msgpack);
+            if (frame) {
+                this._write(frame, e);
+            }
+        }
     };
 
+/**
+ * Picks the sub-protocol for a new WebSocket connection.
+ * @param {string=} offered The client's Sec-WebSocket-Protocol header, a
+ *    comma-separated list
+ * @return {?string} PROTOCOL_MSGPACK if the client offered it, otherwise
+ *    null for plain JSON
+ */
+function chooseProtocol(offered) {
+    if (offered) {
+        var protocols = offered.split(","),
+            i;
+        for (i = 0; i < protocols.length; i++) {
+            if (protocols[i].trim() === PROTOCOL_MSGPACK) {
+                return PROTOCOL_MSGPACK;
+            }
+        }
+    }
+    return null;
+}
+
 /**
  * Factory function for creating a new Connection
  * @param {WebSocket} ws The WebSocket connected to the client.
@@ -231,18 +579,22 @@ function closeAllConnections() {
 }
 
 /**
- * Sends all open connections the specified event
+ * Sends all open connections the specified event. Events are sent together
+ * after EVENT_FLUSH_DELAY, or sooner if another message goes out first.
  * @param {number} id unique ID for the event.
  * @param {string} domain Domain of the event.
  * @param {string} event Name of the event
  * @param {object} parameters Event parameters. Must be JSON.stringify-able.
  */
 function sendEventToAllConnections(id, domain, event, parameters) {
-    _connections.forEach(function (c) {
-        c.sendEventMessage(id, domain, event, parameters);
-    });
+    _pendingEvents.push(new Event(id, domain, event, parameters));
+    if (!_flushTimer) {
+        _flushTimer = setTimeout(_flushEvents, EVENT_FLUSH_DELAY);
+    }
 }
 
+exports.PROTOCOL_MSGPACK          = PROTOCOL_MSGPACK;
+exports.chooseProtocol            = chooseProtocol;
 exports.createConnection          = createConnection;
 exports.closeAllConnections       = closeAllConnections;
 exports.sendEventToAllConnections = sendEventToAllConnections;
@@ -26,8 +26,10 @@
 // TODO: verify if this has any side effects, and if not remove it.
 require("./Server");
 
-var util              = require("util"),
-    ConnectionManager = require("./ConnectionManager");
+var path              = require("path"),
+    util              = require("util"),
+    ConnectionManager = require("./ConnectionManager"),
+    WorkerPool        = require("./WorkerPool");
 
 /**
  * @constructor
@@ -51,6 +53,13 @@ var _domains = {};
  */
 var _initializedDomainModules = [];
 
+/**
+ * @private
+ * @type {Object.<string, boolean>}
+ * Paths of the manifest-declared modules that have been loaded
+ */
+var _loadedDeclaredModules = {};
+
 /**
  * @private
  * @type {number}
@@ -67,6 +76,78 @@ var _eventCount = 1;
  */
 var _cachedDomainDescriptions = null;
 
+/**
+ * @constructor
+ * Running totals for the commands of one domain. Reported live in the API
+ * description, so a slow or backed-up domain is easy to spot.
+ */
+function DomainStats() {
+    this.commands = 0;   // commands received
+    this.completed = 0;  // commands that have responded
+    this.queued = 0;     // offloaded commands waiting for a worker
+    this.running = 0;    // commands started but not yet responded
+    this.totalMs = 0;
+    this.maxMs = 0;
+    this.loadMs = null;  // time to load a manifest-declared domain's module
+}
+
+/**
+ * Records a command that has just been received.
+ * @param {boolean} queued Whether it waits for a worker before running
+ */
+DomainStats.prototype.begin = function (queued) {
+    this.commands++;
+    if (queued) {
+        this.queued++;
+    } else {
+        this.running++;
+    }
+};
+
+/**
+ * Records that a queued command has been picked up by a worker.
+ */
+DomainStats.prototype.dequeue = function () {
+    this.queued--;
+    this.running++;
+};
+
+/**
+ * Records a command that has responded.
+ * @param {number} ms Time since the command was received, including any
+ *    time spent queued
+ */
+DomainStats.prototype.end = function (ms) {
+    this.running--;
+    this.completed++;
+    this.totalMs += ms;
+    this.maxMs = Math.max(this.maxMs, ms);
+};
+
+/**
+ * Called by JSON.stringify
+ */
+DomainStats.prototype.toJSON = function () {
+    return {
+        commands: this.commands,
+        queued: this.queued,
+        running: this.running,
+        meanMs: this.completed ? Math.round(this.totalMs / this.completed * 100) / 100 : 0,
+        maxMs: Math.round(this.maxMs * 100) / 100,
+        loadMs: this.loadMs === null ? null : Math.round(this.loadMs * 100) / 100
+    };
+};
+
+/**
+ * @private
+ * Returns a high-resolution timestamp in milliseconds.
+ * @return {number}
+ */
+function _now() {
+    var t = process.hrtime();
+    return t[0] * 1e3 + t[1] / 1e6;
+}
+
 /**
  * Returns whether a domain with the specified name exists or not.
  * @param {string} domainName The domain name.
@@ -89,7 +170,19 @@ function registerDomain(domainName, version) {
         // invalidate the cache
         _cachedDomainDescriptions = null;
 
-        _domains[domainName] = {version: version, commands: {}, events: {}};
+        _domains[domainName] = {
+            version: version,
+            commands: {},
+            events: {},
+            stats: new DomainStats(),
+            modulePath: null,   // set for domains declared by a manifest
+            declaredOnly: false
+        };
+    } else if (_domains[domainName].declaredOnly) {
+        // The module of a manifest-declared domain is registering it for real
+        _cachedDomainDescriptions = null;
+        _domains[domainName].version = version;
+        _domains[domainName].declaredOnly = false;
     } else {
         console.error("[DomainManager] Domain " + domainName + " already registered");
     }
@@ -122,7 +215,8 @@ function registerCommand(domainName, commandName, commandFunction, isAsync,
         registerDomain(domainName, null);
     }
 
-    if (!_domains[domainName].commands[commandName]) {
+    var existing = _domains[domainName].commands[commandName];
+    if (!existing || existing.modulePath) {
         _domains[domainName].commands[commandName] = {
             commandFunction: commandFunction,
             isAsync: isAsync,
@@ -136,6 +230,96 @@ function registerCommand(domainName, commandName, commandFunction, isAsync,
     }
 }
 
+/**
+ * Registers a command that runs in a worker process instead of on the main
+ * event loop, so that CPU-heavy work doesn't hold up other domains or the
+ * pings to the shell. Since functions can't be passed between processes, the
+ * command is named by the module that exports it; the worker loads that
+ * module itself. The module must not need its init() to have been called,
+ * and the command function is called with no connection as "this".
+ * Parameters and results must survive being sent as JSON, though Buffers
+ * among the parameters or as the result arrive as Buffers (see
+ * WorkerPool.run).
+ * @param {string} domainName The domain name.
+ * @param {string} commandName The command name.
+ * @param {string} modulePath Absolute path of the module exporting the command.
+ * @param {string} exportName Name of the exported command function.
+ * @param {boolean} isAsync See registerCommand
+ * @param {?string} description Used in the API documentation
+ * @param {?Array.<{name: string, type: string, description:string}>} parameters
+ *    Used in the API documentation.
+ * @param {?Array.<{name: string, type: string, description:string}>} returns
+ *    Used in the API documentation.
+ */
+function registerOffloadedCommand(domainName, commandName, modulePath, exportName,
+    isAsync, description, parameters, returns) {
+    registerCommand(domainName, commandName, null, isAsync, description,
+        parameters, returns);
+    _domains[domainName].commands[commandName].offload = {
+        modulePath: modulePath,
+        exportName: exportName
+    };
+}
+
+/**
+ * @private
+ * Runs an offloaded command on the worker pool.
+ * @param {Connection} connection The requesting connection object.
+ * @param {number} id The unique command ID.
+ * @param {Object} command The registered command.
+ * @param {DomainStats} stats The stats of the command's domain.
+ * @param {Array} parameters The parameters to pass to the command function.
+ */
+function _executeOffloadedCommand(connection, id, command, stats, parameters) {
+    var startTime = _now();
+    stats.begin(true);
+    WorkerPool.run({
+        modulePath: command.offload.modulePath,
+        exportName: command.offload.exportName,
+        isAsync: command.isAsync,
+        parameters: parameters || [],
+        onStart: function () {
+            stats.dequeue();
+        },
+        onProgress: function (msg) {
+            connection.sendCommandProgress(id, msg);
+        },
+        onDone: function (err, result) {
+            stats.end(_now() - startTime);
+            if (err) {
+                connection.sendCommandError(id, err);
+            } else {
+                connection.sendCommandResponse(id, result);
+            }
+        }
+    });
+}
+
+/**
+ * @private
+ * Loads the module of a manifest-declared domain, unless that was already
+ * done, and records how long it took for each domain the manifest declared.
+ * @param {string} modulePath Absolute path of the module
+ */
+function _loadDeclaredModule(modulePath) {
+    if (_loadedDeclaredModules[modulePath]) {
+        return;
+    }
+    var startTime = _now();
+    loadDomainModulesFromPaths([modulePath]);
+    var loadMs = _now() - startTime;
+    _loadedDeclaredModules[modulePath] = true;
+
+    Object.keys(_domains).forEach(function (domainName) {
+        var domain = _domains[domainName];
+        if (domain.modulePath === modulePath && domain.stats.loadMs === null) {
+            domain.stats.loadMs = loadMs;
+        }
+    });
+    console.log("[DomainManager] Loaded " + modulePath + " in " +
+        Math.round(loadMs) + "ms");
+}
+
 /**
  * Executes a command by domain name and command name. Called by a connection's
  * message parser. Sends response or error (possibly asynchronously) to the
@@ -153,9 +337,35 @@ function executeCommand(connection, id, domainName,
     commandName, parameters) {
     if (_domains[domainName] &&
             _domains[domainName].commands[commandName]) {
-        var command = _domains[domainName].commands[commandName];
-        if (command.isAsync) {
+        var command = _domains[domainName].commands[commandName],
+            stats = _domains[domainName].stats,
+            startTime;
+        if (command.modulePath) {
+            // Declared by a manifest; load the module on first use
+            var modulePath = command.modulePath;
+            try {
+                _loadDeclaredModule(modulePath);
+            } catch (loadError) {
+                connection.sendCommandError(id, "unable to load " +
+                    modulePath + ": " + loadError.message);
+                return;
+            }
+            command = _domains[domainName].commands[commandName];
+            if (command.modulePath) {
+                connection.sendCommandError(id, modulePath +
+                    " did not register " + domainName + "." + commandName);
+                return;
+            }
+        }
+        if (command.offload) {
+            _executeOffloadedCommand(connection, id, command, stats, parameters);
+        } else if (command.isAsync) {
+            var responded = false;
             var callback = function (err, result) {
+                if (!responded) {
+                    responded = true;
+                    stats.end(_now() - startTime);
+                }
                 if (err) {
                     connection.sendCommandError(id, err);
                 } else {
@@ -166,8 +376,12 @@ function executeCommand(connection, id, domainName,
                 connection.sendCommandProgress(id, msg);
             };
             parameters.push(callback, progressCallback);
+            startTime = _now();
+            stats.begin(false);
             command.commandFunction.apply(connection, parameters);
         } else { // synchronous command
+            startTime = _now();
+            stats.begin(false);
             try {
                 connection.sendCommandResponse(
                     id,
@@ -176,6 +390,7 @@ function executeCommand(connection, id, domainName,
             } catch (e) {
                 connection.sendCommandError(id, e.message);
             }
+            stats.end(_now() - startTime);
         }
     } else {
         connection.sendCommandError(id, "no such command: " +
@@ -198,7 +413,8 @@ function registerEvent(domainName, eventName, parameters) {
         registerDomain(domainName, null);
     }
 
-    if (!_domains[domainName].events[eventName]) {
+    var existing = _domains[domainName].events[eventName];
+    if (!existing || existing.declared) {
         _domains[domainName].events[eventName] = {
             parameters: parameters
         };
@@ -259,9 +475,80 @@ function loadDomainModulesFromPaths(paths) {
     return true; // if we fail, an exception will be thrown
 }
 
+/**
+ * Registers the domains described by manifest files without loading their
+ * modules. Each module is loaded, as by loadDomainModulesFromPaths, the first
+ * time one of its commands is executed, and must then register everything
+ * its manifest declares. Until then the domains appear in the API
+ * description and their events can be emitted. A manifest is a JSON file
+ * like this, where "module" is resolved relative to the manifest:
+ *
+ *   {
+ *       "module": "./FooDomain",
+ *       "domains": [{
+ *           "domain": "foo",
+ *           "version": {"major": 0, "minor": 1},
+ *           "commands": [{"name": "bar", "description": "...",
+ *                         "parameters": [...], "returns": [...]}],
+ *           "events": [{"name": "changed", "parameters": [...]}]
+ *       }]
+ *   }
+ *
+ * Commands and events that are already registered are left alone, so a
+ * manifest can be loaded after its module without harm.
+ *
+ * @param {Array.<string>} paths The manifest paths, resolved like the paths
+ *    of loadDomainModulesFromPaths.
+ * @return {boolean} Whether loading succeded. (Failure will throw an exception).
+ */
+function loadDomainManifestsFromPaths(paths) {
+    var pathArray = paths;
+    if (!util.isArray(paths)) {
+        pathArray = [paths];
+    }
+    pathArray.forEach(function (manifestPath) {
+        var manifest = require(manifestPath),
+            modulePath = path.resolve(path.dirname(require.resolve(manifestPath)),
+                manifest.module);
+
+        (manifest.domains || []).forEach(function (d) {
+            if (!hasDomain(d.domain)) {
+                registerDomain(d.domain, d.version || null);
+                _domains[d.domain].modulePath = modulePath;
+                _domains[d.domain].declaredOnly = true;
+            }
+            var domain = _domains[d.domain];
+
+            (d.commands || []).forEach(function (c) {
+                if (!domain.commands[c.name]) {
+                    domain.commands[c.name] = {
+                        commandFunction: null,
+                        isAsync: false,
+                        description: c.description,
+                        parameters: c.parameters,
+                        returns: c.returns,
+                        modulePath: modulePath
+                    };
+                }
+            });
+            (d.events || []).forEach(function (e) {
+                if (!domain.events[e.name]) {
+                    domain.events[e.name] = {
+                        parameters: e.parameters,
+                        declared: true
+                    };
+                }
+            });
+        });
+    });
+    _cachedDomainDescriptions = null;
+    return true; // if we fail, an exception will be thrown
+}
+
 /**
  * Returns a description of all registered domains in the format of WebKit's
- * Inspector.json. Used for sending API documentation to clients.
+ * Inspector.json. Used for sending API documentation to clients. Each domain
+ * also carries its current queue depth and command latency under "stats".
  *
  * @return {Array} Array describing all domains.
  */
@@ -275,7 +562,9 @@ function getDomainDescriptions() {
                 domain: domainName,
                 version: _domains[domainName].version,
                 commands: [],
-                events: []
+                events: [],
+                // live object, serialized fresh on every request
+                stats: _domains[domainName].stats
             };
             var commandNames = Object.keys(_domains[domainName].commands);
             commandNames.forEach(function (commandName) {
@@ -300,11 +589,13 @@ function getDomainDescriptions() {
     return _cachedDomainDescriptions;
 }
 
-exports.hasDomain                  = hasDomain;
-exports.registerDomain             = registerDomain;
-exports.registerCommand            = registerCommand;
-exports.executeCommand             = executeCommand;
-exports.registerEvent              = registerEvent;
-exports.emitEvent                  = emitEvent;
-exports.loadDomainModulesFromPaths = loadDomainModulesFromPaths;
-exports.getDomainDescriptions      = getDomainDescriptions;
+exports.hasDomain                    = hasDomain;
+exports.registerDomain               = registerDomain;
+exports.registerCommand              = registerCommand;
+exports.registerOffloadedCommand     = registerOffloadedCommand;
+exports.executeCommand               = executeCommand;
+exports.registerEvent                = registerEvent;
+exports.emitEvent                    = emitEvent;
+exports.loadDomainModulesFromPaths   = loadDomainModulesFromPaths;
+exports.loadDomainManifestsFromPaths = loadDomainManifestsFromPaths;
+exports.getDomainDescriptions        = getDomainDescriptions;
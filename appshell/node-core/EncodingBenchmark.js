@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2017 - present Adobe Systems Incorporated. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+"use strict";
+
+/*
+ * Benchmarks for the encodings the WebSocket connections can use. Kept apart
+ * from ConnectionManager, which loads the whole server, so that a worker
+ * process can run them with nothing but the encoder loaded.
+ */
+
+var MessagePack = require("./MessagePack");
+
+/**
+ * @private
+ * Measures encoding and decoding one message |count| times.
+ * @param {function(*): (string|Buffer)} encode
+ * @param {function((string|Buffer)): *} decode
+ * @param {object} message
+ * @param {number} count
+ * @return {{bytes: number, ms: number, messagesPerSecond: number, megabytesPerSecond: number}}
+ */
+function _benchmarkEncoding(encode, decode, message, count) {
+    var bytes = 0,
+        start,
+        encoded,
+        elapsed,
+        ms,
+        i;
+
+    // Warm up, so both encodings are measured optimized
+    for (i = 0; i < Math.min(count, 10); i++) {
+        decode(encode(message));
+    }
+
+    start = process.hrtime();
+    for (i = 0; i < count; i++) {
+        encoded = encode(message);
+        decode(encoded);
+        bytes += encoded.length;
+    }
+    elapsed = process.hrtime(start);
+    ms = elapsed[0] * 1000 + elapsed[1] / 1e6;
+    return {
+        bytes: bytes / count,
+        ms: ms,
+        messagesPerSecond: Math.round(count * 1000 / ms),
+        megabytesPerSecond: Math.round(bytes / 1024 / 1024 * 1000 / ms * 10) / 10
+    };
+}
+
+/**
+ * Measures how fast command responses are encoded and decoded as JSON and
+ * as MessagePack. Each response holds |itemCount| lint results, a typical
+ * large payload. Sizes for JSON are in UTF-16 code units, which is what the
+ * string costs to build.
+ * @param {number} count Number of messages to encode and decode
+ * @param {number} itemCount Number of lint results in each message
+ * @return {{json: object, msgpack: object}} The bytes per message, ms,
+ *    messagesPerSecond and megabytesPerSecond of each encoding
+ */
+function benchmarkEncodings(count, itemCount) {
+    var results = [],
+        i;
+    for (i = 0; i < itemCount; i++) {
+        results.push({
+            fullPath: "/Users/someone/projects/brackets/src/extensions/default/module" + i + "/main.js",
+            line: i,
+            ch: i % 80,
+            type: "warning",
+            message: "Expected '===' and instead saw '=='.",
+            fixable: (i % 2 === 0)
+        });
+    }
+    var message = {type: "commandResponse", message: {id: 1, response: results}};
+
+    return {
+        json: _benchmarkEncoding(JSON.stringify, JSON.parse, message, count),
+        msgpack: _benchmarkEncoding(MessagePack.encode, MessagePack.decode, message, count)
+    };
+}
+
+exports.benchmarkEncodings = benchmarkEncodings;
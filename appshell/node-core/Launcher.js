@@ -102,8 +102,33 @@ function launch() {
     Server.start();
 }
 
+/**
+ * Calls launch once the parent process writes to stdin. The parent starts
+ * spare processes this way, so that everything is loaded by the time it
+ * needs one. Exits if the parent closes stdin first.
+ */
+function launchWhenActivated() {
+    function exitWithoutLaunch() {
+        process.exit(0);
+    }
+
+    // Node processes started by domains shouldn't wait too
+    delete process.env.BRACKETS_NODE_STANDBY;
+
+    process.stdin.once("end", exitWithoutLaunch);
+    process.stdin.once("data", function () {
+        process.stdin.removeListener("end", exitWithoutLaunch);
+        process.stdin.pause();
+        launch();
+    });
+}
+
 if (!DEBUG_ON_LAUNCH) {
-    launch();
+    if (process.env.BRACKETS_NODE_STANDBY === "1") {
+        launchWhenActivated();
+    } else {
+        launch();
+    }
 } else {
     var noopTimer = setInterval(function () {
         // no-op so that we don't exit the process
@@ -35,6 +35,24 @@ var fs           = require("fs"),
  */
 var Logger = module.exports = new EventEmitter();
 
+/** @define{number} Number of ms log lines may wait before being written */
+var LOG_FLUSH_DELAY = 250;
+
+/** @define{number} Number of buffered bytes that get written right away */
+var LOG_FLUSH_BYTES = 64 * 1024;
+
+/** @define{number} Most bytes written at once, so rotation stays timely */
+var MAX_LOG_WRITE_BYTES = 256 * 1024;
+
+/** @define{number} Size at which the log file is rotated */
+var MAX_LOG_FILE_BYTES = 5 * 1024 * 1024;
+
+/** @define{number} Number of rotated files kept, as filename.1 and so on */
+var MAX_OLD_LOG_FILES = 2;
+
+/** @define{number} Number of messages kept for getLogHistory */
+var LOG_HISTORY_SIZE = 1000;
+
 /**
  * @private
  * @type{?string}
@@ -45,10 +63,240 @@ var _logFilename = null;
 /**
  * @private
  * @type{Array.<{level: string, timestamp: Date, message: string}>}
- * Complete log history
+ * Recent log history. A ring buffer holding the last LOG_HISTORY_SIZE
+ * messages, starting at _logHistoryStart.
  */
 var _logHistory = [];
 
+/**
+ * @private
+ * @type{number}
+ * Index of the oldest message in _logHistory, once it is full
+ */
+var _logHistoryStart = 0;
+
+/**
+ * @private
+ * @type{Array.<{filename: string, lines: Array.<string>}>}
+ * Lines waiting to be written, grouped by the file that was set when they
+ * were logged, oldest first. Only the last group gets new lines.
+ */
+var _pendingLines = [];
+
+/**
+ * @private
+ * @type{number}
+ * Total length of the lines in _pendingLines
+ */
+var _pendingBytes = 0;
+
+/**
+ * @private
+ * @type{?number}
+ * Timer for the next write of _pendingLines
+ */
+var _flushTimer = null;
+
+/**
+ * @private
+ * @type{?{filename: string, chunk: string}}
+ * Lines taken from _pendingLines for the write, rotation or open of the log
+ * file that is in progress. Kept until the write completes, so they can
+ * still be written if the process exits first.
+ */
+var _writing = null;
+
+/**
+ * @private
+ * @type{?{fd: number, filename: string, size: number}}
+ * The open log file
+ */
+var _logFile = null;
+
+/**
+ * @private
+ * Closes the open log file, if any. Errors are ignored, as there is
+ * nowhere to report them.
+ * @param {function()} callback
+ */
+function _closeLogFile(callback) {
+    if (!_logFile) {
+        callback();
+        return;
+    }
+    var fd = _logFile.fd;
+    _logFile = null;
+    fs.close(fd, function () {
+        callback();
+    });
+}
+
+/**
+ * @private
+ * Renames filename to filename.1, filename.1 to filename.2 and so on,
+ * dropping the oldest.
+ * @param {string} filename
+ * @param {function()} callback
+ */
+function _rotateLogFiles(filename, callback) {
+    var i = MAX_OLD_LOG_FILES;
+    function next() {
+        if (i === 0) {
+            callback();
+            return;
+        }
+        var from = i > 1 ? filename + "." + (i - 1) : filename;
+        fs.rename(from, filename + "." + i, function () {
+            i--;
+            next();
+        });
+    }
+    next();
+}
+
+/**
+ * @private
+ * Opens filename for appending, rotating it first if it is already too
+ * big. Closes the previous file if it is another one.
+ * @param {string} filename
+ * @param {function(?Error)} callback
+ */
+function _openLogFile(filename, callback) {
+    if (_logFile && _logFile.filename === filename) {
+        callback(null);
+        return;
+    }
+    _closeLogFile(function () {
+        fs.stat(filename, function (err, stats) {
+            var size = err ? 0 : stats.size;
+            function open() {
+                fs.open(filename, "a", function (err, fd) {
+                    if (err) {
+                        callback(err);
+                        return;
+                    }
+                    _logFile = {fd: fd, filename: filename, size: size};
+                    callback(null);
+                });
+            }
+            if (size >= MAX_LOG_FILE_BYTES) {
+                size = 0;
+                _rotateLogFiles(filename, open);
+            } else {
+                open();
+            }
+        });
+    });
+}
+
+/**
+ * @private
+ * Writes the pending lines to their log files without blocking. Only one
+ * write is in progress at a time; lines logged meanwhile go out with the
+ * next, so they stay in order even when the filename changes in between.
+ * A file is rotated once it reaches MAX_LOG_FILE_BYTES.
+ */
+function _flush() {
+    if (_flushTimer) {
+        clearTimeout(_flushTimer);
+        _flushTimer = null;
+    }
+    if (_writing || _pendingLines.length === 0) {
+        return;
+    }
+
+    var group = _pendingLines[0],
+        count = 0,
+        chunkLength = 0;
+    while (count < group.lines.length && chunkLength < MAX_LOG_WRITE_BYTES) {
+        chunkLength += group.lines[count++].length;
+    }
+    var chunk = group.lines.splice(0, count).join("");
+    if (group.lines.length === 0) {
+        _pendingLines.shift();
+    }
+    _pendingBytes -= chunkLength;
+    _writing = {filename: group.filename, chunk: chunk};
+
+    function done() {
+        _writing = null;
+        if (_pendingBytes >= LOG_FLUSH_BYTES) {
+            _flush();
+        } else if (_pendingLines.length > 0) {
+            _scheduleFlush();
+        } else if (!_logFilename) {
+            _closeLogFile(function () {});
+        }
+    }
+
+    _openLogFile(group.filename, function (err) {
+        if (err) {
+            done();  // the lines are lost, as when appendFileSync failed
+            return;
+        }
+        var buffer = Buffer.from(chunk),
+            file = _logFile;
+        fs.write(file.fd, buffer, 0, buffer.length, null, function (err) {
+            // Written, or lost; either way not to be written again on exit
+            _writing.chunk = "";
+            if (!err) {
+                file.size += buffer.length;
+            }
+            if (file === _logFile && file.size >= MAX_LOG_FILE_BYTES) {
+                _closeLogFile(function () {
+                    _rotateLogFiles(file.filename, done);
+                });
+            } else {
+                done();
+            }
+        });
+    });
+}
+
+/**
+ * @private
+ * Makes sure the pending lines are written within LOG_FLUSH_DELAY ms
+ */
+function _scheduleFlush() {
+    if (!_flushTimer && !_writing) {
+        _flushTimer = setTimeout(_flush, LOG_FLUSH_DELAY);
+        // Logging alone shouldn't keep the process alive
+        if (_flushTimer.unref) {
+            _flushTimer.unref();
+        }
+    }
+}
+
+/**
+ * @private
+ * Writes the lines of the write in progress and the pending lines
+ * synchronously. Used when the process exits, so that buffered lines are not
+ * lost. The write in progress may have reached the file already without
+ * having reported it, in which case its lines appear twice.
+ */
+function _flushSync() {
+    if (_flushTimer) {
+        clearTimeout(_flushTimer);
+        _flushTimer = null;
+    }
+    var groups = _pendingLines;
+    if (_writing && _writing.chunk) {
+        groups.unshift({filename: _writing.filename, lines: [_writing.chunk]});
+        _writing = null;
+    }
+    groups.forEach(function (group) {
+        try {
+            fs.appendFileSync(group.filename, group.lines.join(""));
+        } catch (e) {
+            // Do nothing
+        }
+    });
+    _pendingLines = [];
+    _pendingBytes = 0;
+}
+
+process.on("exit", _flushSync);
+
 /**
  * @private
  * Helper function for logging functions. Handles string formatting.
@@ -61,22 +309,36 @@ function logReplacement(level, args) {
     var message = util.format.apply(null, args);
     var timestamp = new Date();
     if (_logFilename) {
-        try {
-            var timestampString =
-                "[" + level + ": " +
-                timestamp.toLocaleTimeString() + "] ";
+        var line =
+            "[" + level + ": " +
+            timestamp.toLocaleTimeString() + "] " +
+            message + "\n";
 
-            fs.appendFileSync(_logFilename,
-                              timestampString + message + "\n");
-        } catch (e) {
-            // Do nothing
+        var group = _pendingLines[_pendingLines.length - 1];
+        if (!group || group.filename !== _logFilename) {
+            group = {filename: _logFilename, lines: []};
+            _pendingLines.push(group);
+        }
+        group.lines.push(line);
+        _pendingBytes += line.length;
+        if (_pendingBytes >= LOG_FLUSH_BYTES) {
+            _flush();
+        } else {
+            _scheduleFlush();
         }
     }
-    _logHistory.push({
+
+    var entry = {
         level: level,
         timestamp: timestamp,
         message: message
-    });
+    };
+    if (_logHistory.length < LOG_HISTORY_SIZE) {
+        _logHistory.push(entry);
+    } else {
+        _logHistory[_logHistoryStart] = entry;
+        _logHistoryStart = (_logHistoryStart + 1) % LOG_HISTORY_SIZE;
+    }
     Logger.emit("log", level, timestamp, message);
 }
 
@@ -139,23 +401,37 @@ function remapConsole() {
 }
 
 /**
- * Retrieves the entire log history
+ * Retrieves the recent log history, oldest first. Only the last
+ * LOG_HISTORY_SIZE messages are kept.
+ * @param {?number} count Number of messages to return; all if omitted or 0
  * @return {Array.<{level: string, timestamp: Date, message: string}>}
  */
 function getLogHistory(count) {
-    if (count === null) {
-        count = 0;
+    var length = _logHistory.length;
+    if (!count || count > length) {
+        count = length;
     }
-    return _logHistory.slice(-count);
+    var result = new Array(count),
+        i;
+    for (i = 0; i < count; i++) {
+        result[i] = _logHistory[(_logHistoryStart + length - count + i) % length];
+    }
+    return result;
 }
 
 /**
  * Sets the filename to which the log messages are appended.
  * Specifying a null filename will turn off logging to a file.
+ * Messages logged before still go to the file that was set then.
  * @param {?string} filename The filename.
  */
 function setLogFilename(filename) {
-    _logFilename = filename;
+    if (filename !== _logFilename) {
+        _logFilename = filename;
+        if (!filename && !_writing && _pendingLines.length === 0) {
+            _closeLogFile(function () {});
+        }
+    }
 }
 
 // Public interface
@@ -0,0 +1,532 @@
+/*
+ * Copyright (c) 2017 - present Adobe Systems Incorporated. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+"use strict";
+
+/**
+ * A MessagePack (https://msgpack.org) encoder and decoder for the
+ * "brackets-msgpack" WebSocket sub-protocol. Values are encoded the way
+ * JSON.stringify would see them (toJSON is called, undefined and functions
+ * become nil in arrays and are left out of objects), except that Buffers are
+ * sent as bin rather than as an array of numbers. The ext types aren't used.
+ */
+
+/**
+ * @private
+ * @type {Buffer}
+ * Buffer that values are encoded into. It is reused, and grows as needed.
+ */
+var _buffer = Buffer.allocUnsafe(64 * 1024);
+
+/**
+ * @private
+ * @type {number}
+ * Where the next byte goes in _buffer.
+ */
+var _offset = 0;
+
+/**
+ * @private
+ * Makes room for |bytes| more bytes in _buffer.
+ * @param {number} bytes
+ */
+function _reserve(bytes) {
+    if (_offset + bytes > _buffer.length) {
+        var grown = Buffer.allocUnsafe(Math.max(_buffer.length * 2, _offset + bytes));
+        _buffer.copy(grown, 0, 0, _offset);
+        _buffer = grown;
+    }
+}
+
+/**
+ * @private
+ * Writes the header of a str, bin, array or map, picking the smallest
+ * format that holds |length|. |fixType| is the fix format's type bits, or -1
+ * if the type has none (bin), and |fixLimit| the longest length it holds.
+ * |type8| is the 8-bit length format, or -1 if the type has none (array and
+ * map); the 16- and 32-bit formats follow it.
+ */
+function _writeHeader(length, fixType, fixLimit, type8, type16) {
+    _reserve(5);
+    if (fixType !== -1 && length <= fixLimit) {
+        _buffer[_offset++] = fixType | length;
+    } else if (type8 !== -1 && length <= 0xff) {
+        _buffer[_offset++] = type8;
+        _buffer[_offset++] = length;
+    } else if (length <= 0xffff) {
+        _buffer[_offset++] = type16;
+        _buffer.writeUInt16BE(length, _offset);
+        _offset += 2;
+    } else {
+        _buffer[_offset++] = type16 + 1;
+        _buffer.writeUInt32BE(length, _offset);
+        _offset += 4;
+    }
+}
+
+/**
+ * @private
+ * Encodes a string. The UTF-8 length isn't known up front, so the header is
+ * sized for the longest it could be (3 bytes per UTF-16 unit), which is
+ * valid MessagePack even where a shorter header would have done.
+ * @param {string} value
+ */
+function _encodeString(value) {
+    var length = value.length,
+        maxBytes = length * 3,
+        headerSize = maxBytes <= 31 ? 1 : (maxBytes <= 0xff ? 2 : (maxBytes <= 0xffff ? 3 : 5)),
+        start = _offset,
+        i,
+        c;
+
+    _reserve(headerSize + maxBytes);
+    _offset += headerSize;
+
+    // Short ASCII strings are cheaper to copy here than through Buffer.write
+    if (length <= 32) {
+        for (i = 0; i < length; i++) {
+            c = value.charCodeAt(i);
+            if (c >= 0x80) {
+                break;
+            }
+            _buffer[_offset + i] = c;
+        }
+    }
+    if (i === length) {
+        _offset += length;
+    } else {
+        _offset += _buffer.write(value, _offset, "utf8");
+    }
+
+    var bytes = _offset - start - headerSize;
+    switch (headerSize) {
+    case 1:
+        _buffer[start] = 0xa0 | bytes;
+        break;
+    case 2:
+        _buffer[start] = 0xd9;
+        _buffer[start + 1] = bytes;
+        break;
+    case 3:
+        _buffer[start] = 0xda;
+        _buffer.writeUInt16BE(bytes, start + 1);
+        break;
+    default:
+        _buffer[start] = 0xdb;
+        _buffer.writeUInt32BE(bytes, start + 1);
+    }
+}
+
+/**
+ * @private
+ * Encodes a number as the smallest int that holds it, or as a float 64.
+ * @param {number} value
+ */
+function _encodeNumber(value) {
+    _reserve(9);
+    if (Math.floor(value) !== value || value > 0xffffffff || value < -0x80000000) {
+        _buffer[_offset++] = 0xcb;
+        _buffer.writeDoubleBE(value, _offset);
+        _offset += 8;
+    } else if (value >= 0) {
+        if (value < 0x80) {
+            _buffer[_offset++] = value;
+        } else if (value <= 0xff) {
+            _buffer[_offset++] = 0xcc;
+            _buffer[_offset++] = value;
+        } else if (value <= 0xffff) {
+            _buffer[_offset++] = 0xcd;
+            _buffer.writeUInt16BE(value, _offset);
+            _offset += 2;
+        } else {
+            _buffer[_offset++] = 0xce;
+            _buffer.writeUInt32BE(value, _offset);
+            _offset += 4;
+        }
+    } else {
+        if (value >= -32) {
+            _buffer[_offset++] = value & 0xff;
+        } else if (value >= -0x80) {
+            _buffer[_offset++] = 0xd0;
+            _buffer.writeInt8(value, _offset);
+            _offset += 1;
+        } else if (value >= -0x8000) {
+            _buffer[_offset++] = 0xd1;
+            _buffer.writeInt16BE(value, _offset);
+            _offset += 2;
+        } else {
+            _buffer[_offset++] = 0xd2;
+            _buffer.writeInt32BE(value, _offset);
+            _offset += 4;
+        }
+    }
+}
+
+/**
+ * @private
+ * Whether JSON.stringify would leave |value| out of an object.
+ */
+function _isSkipped(value) {
+    return value === undefined || typeof value === "function";
+}
+
+/**
+ * @private
+ * Encodes any value into _buffer.
+ * @param {*} value
+ */
+function _encodeValue(value) {
+    var i, keys, length, count, start, key, item;
+
+    switch (typeof value) {
+    case "string":
+        _encodeString(value);
+        return;
+    case "number":
+        _encodeNumber(value);
+        return;
+    case "boolean":
+        _reserve(1);
+        _buffer[_offset++] = value ? 0xc3 : 0xc2;
+        return;
+    case "object":
+        if (value === null) {
+            break;
+        }
+        if (Array.isArray(value)) {
+            length = value.length;
+            _writeHeader(length, 0x90, 15, -1, 0xdc);
+            for (i = 0; i < length; i++) {
+                _encodeValue(value[i]);
+            }
+            return;
+        }
+        if (Buffer.isBuffer(value)) {
+            _writeHeader(value.length, -1, 0, 0xc4, 0xc5);
+            _reserve(value.length);
+            value.copy(_buffer, _offset);
+            _offset += value.length;
+            return;
+        }
+        if (typeof value.toJSON === "function") {
+            _encodeValue(value.toJSON());
+            return;
+        }
+
+        // The header is written for all the keys and the count patched
+        // afterwards, since skipped values can only make it smaller
+        keys = Object.keys(value);
+        length = keys.length;
+        start = _offset;
+        _writeHeader(length, 0x80, 15, -1, 0xde);
+        count = 0;
+        for (i = 0; i < length; i++) {
+            key = keys[i];
+            item = value[key];
+            if (!_isSkipped(item)) {
+                _encodeString(key);
+                _encodeValue(item);
+                count++;
+            }
+        }
+        if (count !== length) {
+            if (length <= 15) {
+                _buffer[start] = 0x80 | count;
+            } else if (length <= 0xffff) {
+                _buffer.writeUInt16BE(count, start + 1);
+            } else {
+                _buffer.writeUInt32BE(count, start + 1);
+            }
+        }
+        return;
+    }
+
+    // null, undefined and functions
+    _reserve(1);
+    _buffer[_offset++] = 0xc0;
+}
+
+/**
+ * Encodes a value as MessagePack.
+ * @param {*} value
+ * @return {Buffer} A new buffer holding the encoded value
+ */
+function encode(value) {
+    _offset = 0;
+    _encodeValue(value);
+    var result = Buffer.allocUnsafe(_offset);
+    _buffer.copy(result, 0, 0, _offset);
+    return result;
+}
+
+/**
+ * @private
+ * @type {Buffer}
+ * Buffer being decoded, and where the next value starts in it.
+ */
+var _data = null;
+var _position = 0;
+
+/**
+ * @private
+ * Returns |length| bytes of _data from _position, as a Buffer that doesn't
+ * share memory with _data.
+ */
+function _readBytes(length) {
+    if (_position + length > _data.length) {
+        throw new Error("MessagePack data ends inside a bin");
+    }
+    var bytes = Buffer.allocUnsafe(length);
+    _data.copy(bytes, 0, _position, _position + length);
+    _position += length;
+    return bytes;
+}
+
+/**
+ * @private
+ * @type {Array.<{bytes: Buffer, value: string}>}
+ * Recently decoded short strings, by a hash of their bytes. Object keys and
+ * enum-like values repeat a lot, and looking them up is much cheaper than
+ * making a new string each time.
+ */
+var _stringCache = new Array(4096);
+
+/**
+ * @private
+ * Reads a string of |length| bytes.
+ */
+function _readString(length) {
+    var start = _position,
+        end = start + length,
+        hash = length,
+        cached,
+        value,
+        i;
+
+    if (end > _data.length) {
+        throw new Error("MessagePack data ends inside a string");
+    }
+    _position = end;
+
+    if (length > 16) {
+        return _data.toString("utf8", start, end);
+    }
+
+    for (i = start; i < end; i++) {
+        hash = (hash * 31 + _data[i]) & 0xfff;
+    }
+    cached = _stringCache[hash];
+    if (cached && cached.bytes.length === length) {
+        for (i = 0; i < length; i++) {
+            if (cached.bytes[i] !== _data[start + i]) {
+                break;
+            }
+        }
+        if (i === length) {
+            return cached.value;
+        }
+    }
+
+    // The bytes are copied, outside the shared pool, so the cache doesn't
+    // keep whole messages or pool slabs alive
+    value = _data.toString("utf8", start, end);
+    cached = {bytes: Buffer.allocUnsafeSlow(length), value: value};
+    _data.copy(cached.bytes, 0, start, end);
+    _stringCache[hash] = cached;
+    return value;
+}
+
+var _decodeValue;
+
+/**
+ * @private
+ * Reads an array with |length| elements.
+ */
+function _readArray(length) {
+    var value = new Array(length),
+        i;
+    for (i = 0; i < length; i++) {
+        value[i] = _decodeValue();
+    }
+    return value;
+}
+
+/**
+ * @private
+ * Reads a map with |length| entries into an object. Like JSON.parse, a
+ * "__proto__" key becomes a plain property.
+ */
+function _readMap(length) {
+    var value = {},
+        i,
+        key;
+    for (i = 0; i < length; i++) {
+        key = String(_decodeValue());
+        if (key === "__proto__") {
+            Object.defineProperty(value, key, {value: _decodeValue(), enumerable: true,
+                                               writable: true, configurable: true});
+        } else {
+            value[key] = _decodeValue();
+        }
+    }
+    return value;
+}
+
+/**
+ * @private
+ * Decodes the value at _position.
+ * @return {*}
+ */
+_decodeValue = function () {
+    if (_position >= _data.length) {
+        throw new Error("MessagePack data ends early");
+    }
+    var type = _data[_position++],
+        value;
+
+    if (type < 0x80) {
+        return type;
+    }
+    if (type >= 0xe0) {
+        return type - 0x100;
+    }
+    if (type >= 0xa0 && type <= 0xbf) {
+        return _readString(type & 0x1f);
+    }
+    if (type >= 0x90 && type <= 0x9f) {
+        return _readArray(type & 0x0f);
+    }
+    if (type <= 0x8f) {
+        return _readMap(type & 0x0f);
+    }
+
+    // The fixed-size values below read past the end of _data as a RangeError
+    switch (type) {
+    case 0xc0:
+        return null;
+    case 0xc2:
+        return false;
+    case 0xc3:
+        return true;
+    case 0xc4:
+        value = _data.readUInt8(_position);
+        _position += 1;
+        return _readBytes(value);
+    case 0xc5:
+        value = _data.readUInt16BE(_position);
+        _position += 2;
+        return _readBytes(value);
+    case 0xc6:
+        value = _data.readUInt32BE(_position);
+        _position += 4;
+        return _readBytes(value);
+    case 0xca:
+        value = _data.readFloatBE(_position);
+        _position += 4;
+        return value;
+    case 0xcb:
+        value = _data.readDoubleBE(_position);
+        _position += 8;
+        return value;
+    case 0xcc:
+        return _data.readUInt8(_position++);
+    case 0xcd:
+        value = _data.readUInt16BE(_position);
+        _position += 2;
+        return value;
+    case 0xce:
+        value = _data.readUInt32BE(_position);
+        _position += 4;
+        return value;
+    case 0xcf:
+        value = _data.readUInt32BE(_position) * 0x100000000 + _data.readUInt32BE(_position + 4);
+        _position += 8;
+        return value;
+    case 0xd0:
+        return _data.readInt8(_position++);
+    case 0xd1:
+        value = _data.readInt16BE(_position);
+        _position += 2;
+        return value;
+    case 0xd2:
+        value = _data.readInt32BE(_position);
+        _position += 4;
+        return value;
+    case 0xd3:
+        value = _data.readInt32BE(_position) * 0x100000000 + _data.readUInt32BE(_position + 4);
+        _position += 8;
+        return value;
+    case 0xd9:
+        value = _data.readUInt8(_position);
+        _position += 1;
+        return _readString(value);
+    case 0xda:
+        value = _data.readUInt16BE(_position);
+        _position += 2;
+        return _readString(value);
+    case 0xdb:
+        value = _data.readUInt32BE(_position);
+        _position += 4;
+        return _readString(value);
+    case 0xdc:
+        value = _data.readUInt16BE(_position);
+        _position += 2;
+        return _readArray(value);
+    case 0xdd:
+        value = _data.readUInt32BE(_position);
+        _position += 4;
+        return _readArray(value);
+    case 0xde:
+        value = _data.readUInt16BE(_position);
+        _position += 2;
+        return _readMap(value);
+    case 0xdf:
+        value = _data.readUInt32BE(_position);
+        _position += 4;
+        return _readMap(value);
+    }
+    throw new Error("Unsupported MessagePack type 0x" + type.toString(16));
+};
+
+/**
+ * Decodes one MessagePack value.
+ * @param {Buffer} data Encoded value, with nothing after it
+ * @return {*} The value
+ */
+function decode(data) {
+    _data = data;
+    _position = 0;
+    try {
+        var value = _decodeValue();
+        if (_position !== data.length) {
+            throw new Error("Extra data after MessagePack value");
+        }
+        return value;
+    } finally {
+        _data = null;
+    }
+}
+
+exports.encode = encode;
+exports.decode = decode;
@@ -26,8 +26,13 @@
 /** @define{number} Number of ms to wait for the server to start */
 var SETUP_TIMEOUT = 5000; // wait up to 5 seconds for server to start
 
-/** @define{number} Number of ms between pings to parent process */
-var PING_DELAY = 1000; // send ping to parent process every 1 second
+/** @define{number} Number of ms between pings to parent process. The pipes
+ * closing is what normally tells us the parent is gone, so this is only a
+ * fallback, and rare so that an idle editor doesn't keep waking up. */
+var PING_DELAY = 60000; // send ping to parent process every minute
+
+/** @define{number} Number of ms to wait for the parent process to answer a benchmark */
+var BENCHMARK_TIMEOUT = 30000;
 
 var http              = require("http"),
     WebSocket         = require("./thirdparty/ws"),
@@ -53,6 +58,35 @@ var Server = module.exports = new EventEmitter();
  */
 var _commandCount = 1;
 
+/**
+ * @private
+ * @type{boolean} Whether messages to the parent process are prefixed with
+ * their length instead of being separated by blank lines. The parent offers
+ * this through the BRACKETS_NODE_FRAMING environment variable; older shells
+ * don't, and only understand the blank lines.
+ */
+var _framedStdout = false;
+
+/**
+ * @private
+ * @type{string} Data from the parent process that doesn't make up a whole
+ * message yet
+ */
+var _stdinBuffer = "";
+
+/**
+ * @private
+ * @type{Object.<string, function(number, number)>} Callbacks of command
+ * channel benchmarks waiting for the parent process, by benchmark id
+ */
+var _pendingBenchmarks = {};
+
+/**
+ * @private
+ * @type{number} id of the next command channel benchmark
+ */
+var _nextBenchmarkId = 1;
+
 /**
  * @private
  * @type{http.Server} the HTTP server
@@ -65,6 +99,86 @@ var _httpServer = null;
  */
 var _wsServer = null;
 
+/**
+ * @private
+ * Sends a command to the parent process over stdout. The arguments are the
+ * command name and its parameters.
+ */
+function _sendCommandToParentProcess() {
+    var cmd = (_commandCount++) + "|" + Array.prototype.join.call(arguments, "|");
+    if (_framedStdout) {
+        var length = Buffer.byteLength(cmd, "utf8"),
+            frame = Buffer.allocUnsafe(length + 4);
+
+        frame.writeUInt32BE(length, 0);
+        frame.write(cmd, 4, length, "utf8");
+        process.stdout.write(frame);
+    } else {
+        process.stdout.write("\n\n" + cmd + "\n\n");
+    }
+}
+
+/**
+ * @private
+ * Handles a message from the parent process. Messages are "|"-separated: an
+ * id, the command name and its parameters. Only the answer to a benchmark
+ * needs handling; "pong" is ignored.
+ * @param {string} message The message, without separators
+ */
+function _processParentCommand(message) {
+    var args = message.split("|"),
+        callback;
+
+    if (args[1] === "benchmarkEnd" && _pendingBenchmarks.hasOwnProperty(args[2])) {
+        callback = _pendingBenchmarks[args[2]];
+        delete _pendingBenchmarks[args[2]];
+        callback(parseInt(args[3], 10), parseInt(args[4], 10));
+    }
+}
+
+/**
+ * Measures how fast commands get to the parent process: sends a burst of
+ * commands and waits for the parent to report how many arrived.
+ * @param {number} count Number of commands to send
+ * @param {number} payloadSize Number of bytes of padding in each command
+ * @param {function(?string, Object)} callback Called with an error string or
+ *     the results: framed, commands, bytes, ms, commandsPerSecond and
+ *     megabytesPerSecond
+ */
+function benchmarkCommandChannel(count, payloadSize, callback) {
+    var id = String(_nextBenchmarkId++),
+        payload = new Array(payloadSize + 1).join("x"),
+        start = process.hrtime(),
+        timeoutTimer,
+        i;
+
+    timeoutTimer = setTimeout(function () {
+        delete _pendingBenchmarks[id];
+        callback("ERR_TIMEOUT", null);
+    }, BENCHMARK_TIMEOUT);
+
+    _pendingBenchmarks[id] = function (commands, bytes) {
+        var elapsed = process.hrtime(start),
+            ms = elapsed[0] * 1000 + elapsed[1] / 1e6;
+
+        clearTimeout(timeoutTimer);
+        callback(null, {
+            framed: _framedStdout,
+            commands: commands,
+            bytes: bytes,
+            ms: ms,
+            commandsPerSecond: ms > 0 ? commands * 1000 / ms : 0,
+            megabytesPerSecond: ms > 0 ? bytes * 1000 / ms / (1024 * 1024) : 0
+        });
+    };
+
+    _sendCommandToParentProcess("benchmarkStart", id);
+    for (i = 0; i < count; i++) {
+        _sendCommandToParentProcess("noop", payload);
+    }
+    _sendCommandToParentProcess("benchmarkEnd", id);
+}
+
 /**
  * Stops the server and does appropriate cleanup.
  * Emits an "end" event when shutdown is complete.
@@ -95,12 +209,6 @@ function stop() {
  * Starts the server.
  */
 function start() {
-    function sendCommandToParentProcess() {
-        var cmd = "\n\n" + (_commandCount++) + "|"
-            + Array.prototype.join.call(arguments, "|") + "\n\n";
-        process.stdout.write(cmd);
-    }
-
     function httpRequestHandler(req, res) {
         if (req.method === "GET") {
             if (req.url === "/api" || req.url.indexOf("/api/") === 0) {
@@ -133,8 +241,15 @@ function start() {
 
         // set up event handlers for stdin
         process.stdin.on("data", function (data) {
-            // no-op, but make sure we read the data so the buffer
-            // doesn't fill up
+            // Messages are separated by blank lines, so half the time
+            // there's an empty message between two separators
+            var messages = (_stdinBuffer + data).split("\n\n");
+            _stdinBuffer = messages.pop();
+            messages.forEach(function (message) {
+                if (message) {
+                    _processParentCommand(message);
+                }
+            });
         });
 
         process.stdin.on("end", function receiveStdInClose() {
@@ -144,13 +259,32 @@ function start() {
     }
 
     function setupStdout() {
-        // Routinely check if stdout is closed. Stdout will close when our
-        // parent process closes (either expectedly or unexpectedly) so this
-        // is our signal to shutdown to prevent process abandonment.
-        //
-        // We need to continually ping because that's the only way to actually
-        // check if the pipe is closed in a robust way (writable may only get
-        // set to false after trying to write a ping to a closed pipe).
+        // Switch to length-prefixed messages if the parent offered them.
+        // The switch is announced in the old format, so the parent knows
+        // where it happens.
+        if (process.env.BRACKETS_NODE_FRAMING === "1") {
+            _sendCommandToParentProcess("framing", 1);
+            _framedStdout = true;
+        }
+
+
+        // When our parent process exits (either expectedly or unexpectedly)
+        // the pipes close. Stdin ends (see setupStdin), and writes to stdout
+        // fail with EPIPE. Either is our signal to shutdown to prevent process
+        // abandonment. On Linux the parent also has the kernel send us
+        // SIGTERM, which works even if we're too busy to notice the pipes.
+        process.stdout.on("error", function (err) {
+            Logger.info("[Server] stopping because stdout failed:", err.code || err.message);
+            stop();
+        });
+        process.stdout.on("close", function () {
+            Logger.info("[Server] stopping because stdout closed");
+            stop();
+        });
+
+        // As a fallback, occasionally check if stdout is closed. A write is
+        // the only robust way to find out (writable may only get set to false
+        // after trying to write a ping to a closed pipe).
         setInterval(function () {
             if (!process.stdout.writable) {
                 // If stdout closes, our parent process has terminated or
@@ -159,7 +293,7 @@ function start() {
                 stop();
             } else {
                 try {
-                    sendCommandToParentProcess("ping");
+                    _sendCommandToParentProcess("ping");
                 } catch (e) {
                     Logger.info("[Server] stopping because stdout was not writable");
                     stop();
@@ -203,6 +337,16 @@ function start() {
                         // Accept connections originated from local system only
                         // Also do a loose check on user-agent to accept connection only from Brackets CEF shell
                         if (info.origin === "file://" && info.req.headers["user-agent"].indexOf(" Brackets") !== -1) {
+                            // ws answers with the sub-protocols the client offered,
+                            // so narrow them down to the one we speak, if any.
+                            // Clients that don't get it fall back to JSON.
+                            var headers = info.req.headers,
+                                protocol = ConnectionManager.chooseProtocol(headers["sec-websocket-protocol"]);
+                            if (protocol) {
+                                headers["sec-websocket-protocol"] = protocol;
+                            } else {
+                                delete headers["sec-websocket-protocol"];
+                            }
                             callback(true);
                         } else {
                             // Reject the connection
@@ -260,7 +404,7 @@ function start() {
             _httpServer = servers.httpServer;
             _wsServer = servers.wsServer;
             // tell the parent process what port we're on
-            sendCommandToParentProcess("port", servers.port);
+            _sendCommandToParentProcess("port", servers.port);
         }
     }, SETUP_TIMEOUT);
     DomainManager.loadDomainModulesFromPaths(["./BaseDomain"]);
@@ -270,3 +414,4 @@ function start() {
 // Public interface
 Server.start                    = start;
 Server.stop                     = stop;
+Server.benchmarkCommandChannel  = benchmarkCommandChannel;
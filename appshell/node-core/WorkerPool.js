@@ -0,0 +1,265 @@
+/*
+ * Copyright (c) 2017 - present Adobe Systems Incorporated. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+"use strict";
+
+var childProcess = require("child_process"),
+    os           = require("os"),
+    path         = require("path");
+
+/**
+ * @const
+ * @type {number}
+ * Maximum number of worker processes. One core is left for the main process,
+ * which still has to service the sockets and the shell.
+ */
+var MAX_WORKERS = Math.max(1, Math.min(os.cpus().length - 1, 4));
+
+/**
+ * @const
+ * @type {string}
+ * Script that runs inside each worker process
+ */
+var WORKER_SCRIPT = path.join(__dirname, "CommandWorker.js");
+
+/**
+ * @private
+ * @type {Array.<{child: ChildProcess, job: ?Object}>}
+ * Worker processes that have been started. A worker runs one job at a time.
+ */
+var _workers = [];
+
+/**
+ * @private
+ * @type {Array.<Object>}
+ * Jobs waiting for a free worker, oldest first
+ */
+var _queue = [];
+
+/**
+ * Prepares a command parameter or result to be sent to another process.
+ * Messages between processes are serialized as JSON, which would turn a
+ * Buffer into an array of numbers, so Buffers are sent as base64 instead.
+ * @param {*} value
+ * @return {*}
+ */
+function pack(value) {
+    if (Buffer.isBuffer(value)) {
+        return {type: "Buffer", base64: value.toString("base64")};
+    }
+    return value;
+}
+
+/**
+ * Reverses pack() on a value received from another process.
+ * @param {*} value
+ * @return {*}
+ */
+function unpack(value) {
+    if (value && value.type === "Buffer" && typeof value.base64 === "string") {
+        return Buffer.from(value.base64, "base64");
+    }
+    return value;
+}
+
+/**
+ * Returns the message to report for a failed command. Commands may fail with
+ * an Error or with a string; the connection is always sent a string.
+ * @param {*} err
+ * @return {string}
+ */
+function errorMessage(err) {
+    return (err && err.message) || String(err);
+}
+
+/**
+ * @private
+ * Lets the process exit while the worker is idle, and keeps it alive while
+ * the worker has a job. The IPC channel holds the process open on its own.
+ * @param {{child: ChildProcess, job: ?Object}} entry
+ * @param {boolean} busy
+ */
+function _setBusy(entry, busy) {
+    var child   = entry.child,
+        channel = child.channel || child._channel;  // "_channel" before Node 7
+
+    if (busy) {
+        child.ref();
+        if (channel && channel.ref) {
+            channel.ref();
+        }
+    } else {
+        child.unref();
+        if (channel && channel.unref) {
+            channel.unref();
+        }
+    }
+}
+
+/**
+ * @private
+ * Hands the job to the given idle worker.
+ * @param {{child: ChildProcess, job: ?Object}} entry
+ * @param {Object} job
+ */
+function _startJob(entry, job) {
+    entry.job = job;
+    _setBusy(entry, true);
+    job.onStart();
+    entry.child.send({
+        modulePath: job.modulePath,
+        exportName: job.exportName,
+        isAsync: job.isAsync,
+        parameters: job.parameters.map(pack)
+    });
+}
+
+/**
+ * @private
+ * Starts queued jobs on idle workers, starting new workers up to MAX_WORKERS.
+ */
+function _dispatch() {
+    while (_queue.length > 0) {
+        var entry = null, i;
+        for (i = 0; i < _workers.length; i++) {
+            if (!_workers[i].job) {
+                entry = _workers[i];
+                break;
+            }
+        }
+        if (!entry) {
+            if (_workers.length >= MAX_WORKERS) {
+                return;
+            }
+            entry = _createWorker();
+        }
+        _startJob(entry, _queue.shift());
+    }
+}
+
+/**
+ * @private
+ * Fails the worker's current job, if any, and forgets the worker. The next
+ * job that needs it gets a fresh one.
+ * @param {{child: ChildProcess, job: ?Object}} entry
+ * @param {string} reason
+ */
+function _retireWorker(entry, reason) {
+    var index = _workers.indexOf(entry);
+    if (index < 0) {
+        return;
+    }
+    _workers.splice(index, 1);
+    if (entry.child.connected) {
+        entry.child.kill();
+    }
+    if (entry.job) {
+        var job = entry.job;
+        entry.job = null;
+        job.onDone(reason);
+    }
+    _dispatch();
+}
+
+/**
+ * @private
+ * Copies what a worker writes to stdout or stderr to the log. The workers
+ * mustn't write to the main process's stdout, which carries the commands to
+ * the shell.
+ * @param {Readable} stream
+ * @param {function(string)} log
+ */
+function _forwardOutput(stream, log) {
+    stream.setEncoding("utf8");
+    stream.on("data", function (data) {
+        log("[WorkerPool] " + data.replace(/\n$/, ""));
+    });
+    // Like the worker itself, its output shouldn't keep the process alive
+    if (stream.unref) {
+        stream.unref();
+    }
+}
+
+/**
+ * @private
+ * Starts a new worker process and adds it to the pool.
+ * @return {{child: ChildProcess, job: ?Object}}
+ */
+function _createWorker() {
+    var entry = {
+        child: childProcess.fork(WORKER_SCRIPT, [], {silent: true}),
+        job: null
+    };
+
+    _forwardOutput(entry.child.stdout, console.log);
+    _forwardOutput(entry.child.stderr, console.error);
+
+    entry.child.on("message", function (message) {
+        var job = entry.job;
+        if (!job) {
+            return;
+        }
+        if (message.type === "progress") {
+            job.onProgress(message.message);
+        } else if (message.type === "done") {
+            entry.job = null;
+            _setBusy(entry, false);
+            job.onDone(message.error, unpack(message.result));
+            _dispatch();
+        }
+    });
+    entry.child.on("error", function (err) {
+        _retireWorker(entry, "worker failed: " + errorMessage(err));
+    });
+    entry.child.on("exit", function (code, signal) {
+        _retireWorker(entry, "worker exited with " + (signal || "code " + code));
+    });
+
+    _workers.push(entry);
+    return entry;
+}
+
+/**
+ * Runs a function exported by a module in a worker process. The module is
+ * loaded in the worker with require(), so it must not depend on state set up
+ * in the main process, and the parameters and result must survive being
+ * sent as JSON. Buffers given as parameters or returned as the result are
+ * sent as base64.
+ *
+ * @param {{modulePath: string, exportName: string, isAsync: boolean,
+ *     parameters: Array, onStart: function(), onProgress: function(*),
+ *     onDone: function(?string, *)}} job
+ *     onStart is called when a worker picks up the job. Async functions get
+ *     a callback and a progressCallback appended to their parameters, like
+ *     ordinary async commands do. onDone gets an error message or null.
+ */
+function run(job) {
+    _queue.push(job);
+    _dispatch();
+}
+
+exports.MAX_WORKERS  = MAX_WORKERS;
+exports.run          = run;
+exports.pack         = pack;
+exports.unpack       = unpack;
+exports.errorMessage = errorMessage;
@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2013 - present Adobe Systems Incorporated. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+"use strict";
+
+module.exports = function (grunt) {
+    var child_process   = require("child_process"),
+        fs              = require("fs"),
+        path            = require("path"),
+        common          = require("./common")(grunt),
+        resolve         = common.resolve,
+        platform        = common.platform();
+
+    /**
+     * Runs the executables one after another, logging their output.
+     * @param {!Array.<Array.<string>>} commands Each an executable and its arguments
+     * @param {function(boolean)} callback Called with whether they all succeeded
+     */
+    function run(commands, callback) {
+        if (commands.length === 0) {
+            callback(true);
+            return;
+        }
+        var command = commands[0];
+        grunt.log.writeln("Running " + path.basename(command[command.length - 1]));
+        child_process.execFile(command[0], command.slice(1), function (err, stdout, stderr) {
+            grunt.log.write(stdout);
+            if (err) {
+                grunt.log.error(stderr || err.message);
+                callback(false);
+                return;
+            }
+            run(commands.slice(1), callback);
+        });
+    }
+
+    // task: test
+    grunt.registerTask("test", ["test-node-core", "test-native"]);
+
+    // task: test-node-core
+    grunt.registerTask("test-node-core", "Run the node-core specs in test/node-core", function () {
+        var dir = resolve("test/node-core"),
+            specs = fs.readdirSync(dir).filter(function (name) {
+                return (/Spec\.js$/).test(name);
+            });
+
+        // Each spec runs in its own process, since the modules keep state
+        run(specs.map(function (name) {
+            return [process.execPath, path.join(dir, name)];
+        }), this.async());
+    });
+
+    // task: test-native
+    grunt.registerTask("test-native", "Run the native unit tests built by 'grunt build'", function () {
+        var executable = resolve("out/Release/appshell_unittests");
+
+        if (platform !== "linux") {
+            grunt.log.writeln("The native unit tests are only built on Linux.");
+            return;
+        }
+        if (!grunt.file.exists(executable)) {
+            grunt.log.error(executable + " does not exist. Run 'grunt build' first.");
+            return false;
+        }
+
+        run([[executable]], this.async());
+    });
+};
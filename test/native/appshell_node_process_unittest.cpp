@@ -0,0 +1,200 @@
+/*
+ * Copyright (c) 2016 - present Adobe Systems Incorporated. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "appshell/appshell_helpers.h"
+#include "appshell/appshell_node_process.h"
+#include "appshell/appshell_node_process_internal.h"
+#include "unittest.h"
+
+#include <string>
+#include <vector>
+
+// These stand in for the platform code that appshell_node_process.cpp calls,
+// and record what it was asked to do.
+
+static std::vector<std::string> sentData;
+static std::vector<int> nodeStates;
+static int64 fakeNow = 0;
+
+void sendData(const std::string &data) {
+    sentData.push_back(data);
+}
+
+void setNodeState(int state) {
+    nodeStates.push_back(state);
+}
+
+bool getProcessWakeups(long long& shellWakeups, long long& nodeWakeups) {
+    return false;
+}
+
+namespace appshell {
+
+int64 GetMonotonicMicroseconds() {
+    return fakeNow;
+}
+
+}  // namespace appshell
+
+namespace {
+
+void Reset() {
+    resetIncomingData();
+    sentData.clear();
+    nodeStates.clear();
+}
+
+// Feeds |data| to the parser |chunkSize| bytes at a time.
+void Feed(const std::string& data, size_t chunkSize) {
+    for (size_t offset = 0; offset < data.size(); offset += chunkSize) {
+        processIncomingData(data.substr(offset, chunkSize));
+    }
+}
+
+std::string Frame(const std::string& command) {
+    size_t length = command.size();
+    std::string frame;
+    frame += (char)((length >> 24) & 0xff);
+    frame += (char)((length >> 16) & 0xff);
+    frame += (char)((length >> 8) & 0xff);
+    frame += (char)(length & 0xff);
+    return frame + command;
+}
+
+// The pong for a ping is "\n\n<count>|pong|<id>\n\n".
+bool IsPong(const std::string& data, const std::string& id) {
+    std::string suffix = "|pong|" + id + "\n\n";
+    return data.size() > suffix.size() &&
+        data.compare(data.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+}  // namespace
+
+TEST(NodeTextCommandsAreParsed) {
+    Reset();
+    processIncomingData("\n\n1|port|1234\n\n\n\n2|ping\n\n");
+    EXPECT_EQ(1u, nodeStates.size());
+    EXPECT_TRUE(nodeStates.size() == 1 && nodeStates[0] == 1234);
+    EXPECT_EQ(1u, sentData.size());
+    EXPECT_TRUE(sentData.size() == 1 && IsPong(sentData[0], "2"));
+}
+
+TEST(NodeTextCommandsSurviveAnyChunking) {
+    std::string data = "\n\n1|port|80\n\n\n\n2|ping\n\n\n\n3|port|81\n\n";
+    for (size_t chunkSize = 1; chunkSize <= data.size(); chunkSize++) {
+        Reset();
+        Feed(data, chunkSize);
+        EXPECT_EQ(2u, nodeStates.size());
+        EXPECT_TRUE(nodeStates.size() == 2 && nodeStates[0] == 80 && nodeStates[1] == 81);
+        EXPECT_EQ(1u, sentData.size());
+    }
+}
+
+TEST(NodeUnknownCommandsAreIgnored) {
+    Reset();
+    processIncomingData("\n\n1|nonsense|x\n\nno separator yet");
+    EXPECT_EQ(0u, nodeStates.size());
+    EXPECT_EQ(0u, sentData.size());
+    processIncomingData("\n\n2|port|5\n\n");
+    EXPECT_EQ(1u, nodeStates.size());
+}
+
+TEST(NodeFramedCommandsAreParsed) {
+    Reset();
+    processIncomingData("\n\n1|framing|1\n\n");
+    // Separators mean nothing inside a frame.
+    processIncomingData(Frame("a\n\nb|ping") + Frame("2|port|99"));
+    EXPECT_EQ(1u, sentData.size());
+    EXPECT_TRUE(sentData.size() == 1 && IsPong(sentData[0], "a\n\nb"));
+    EXPECT_TRUE(nodeStates.size() == 1 && nodeStates[0] == 99);
+}
+
+TEST(NodeFramedCommandsSurviveAnyChunking) {
+    std::string data = "\n\n1|framing|1\n\n" + Frame("2|port|7") + Frame("3|ping") + Frame("4|port|8");
+    for (size_t chunkSize = 1; chunkSize <= data.size(); chunkSize++) {
+        Reset();
+        Feed(data, chunkSize);
+        EXPECT_TRUE(nodeStates.size() == 2 && nodeStates[0] == 7 && nodeStates[1] == 8);
+        EXPECT_EQ(1u, sentData.size());
+    }
+}
+
+TEST(NodeOversizedFramesAreSkipped) {
+    Reset();
+    processIncomingData("\n\n1|framing|1\n\n");
+    std::string huge = "2|port|1|" + std::string(100 * 1024, 'x');
+    Feed(Frame(huge) + Frame("3|port|2"), 4096);
+    EXPECT_TRUE(nodeStates.size() == 1 && nodeStates[0] == 2);
+}
+
+TEST(NodeResetGoesBackToText) {
+    Reset();
+    processIncomingData("\n\n1|framing|1\n\n" + Frame("2|port|3"));
+    Reset();
+    processIncomingData("\n\n3|port|4\n\n");
+    EXPECT_TRUE(nodeStates.size() == 1 && nodeStates[0] == 4);
+}
+
+// More data than the 64KB buffer holds, with commands straddling the point
+// where it wraps around.
+TEST(NodeCommandsStraddlingTheBufferEndAreKept) {
+    const int count = 5000;
+    std::string text, framed;
+    for (int i = 0; i < count; i++) {
+        text += "\n\nid|benchmarkData|0123456789\n\n";
+        framed += Frame("id|benchmarkData|0123456789");
+    }
+
+    Reset();
+    Feed("\n\n0|benchmarkStart\n\n" + text + "\n\n1|benchmarkEnd|b\n\n", 1000);
+    EXPECT_EQ(1u, sentData.size());
+    EXPECT_TRUE(sentData.size() == 1 && sentData[0].find("|benchmarkEnd|b|5000|135000\n\n") != std::string::npos);
+
+    Reset();
+    Feed("\n\n1|framing|1\n\n" + Frame("0|benchmarkStart") + framed + Frame("1|benchmarkEnd|b"), 999);
+    EXPECT_EQ(1u, sentData.size());
+    EXPECT_TRUE(sentData.size() == 1 && sentData[0].find("|benchmarkEnd|b|5000|135000\n\n") != std::string::npos);
+}
+
+TEST(NodeStartupAndFailoverAreTimed) {
+    Reset();
+    fakeNow = 1000000;
+    recordNodeStarting();
+    fakeNow += 250000;
+    processIncomingData("\n\n1|port|10\n\n");
+
+    NodeProcessStats stats = getNodeProcessStats();
+    EXPECT_TRUE(stats.startupMilliseconds == 250);
+    EXPECT_TRUE(stats.lastFailoverMilliseconds < 0);
+    EXPECT_TRUE(stats.shellWakeups == -1 && stats.nodeWakeups == -1);
+
+    int restarts = stats.restartCount;
+    recordNodeRestarting();
+    fakeNow += 40000;
+    processIncomingData("\n\n2|port|11\n\n");
+
+    stats = getNodeProcessStats();
+    EXPECT_EQ(restarts + 1, stats.restartCount);
+    EXPECT_TRUE(stats.lastFailoverMilliseconds == 40);
+    // Only the first process's startup is measured until recordNodeStarting.
+    EXPECT_TRUE(stats.startupMilliseconds == 250);
+}
@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2016 - present Adobe Systems Incorporated. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "appshell/appshell_regex.h"
+#include "unittest.h"
+
+#include <string>
+
+using appshell::Regex;
+
+namespace {
+
+// Returns the first match of |pattern| in |line| from |from| on, "<none>" if
+// there isn't one, or "<error>" if the pattern doesn't compile.
+std::string Find(const char* pattern, const std::string& line, bool ignoreCase = false, size_t from = 0) {
+    Regex regex;
+    std::string error;
+    if (!regex.Compile(pattern, ignoreCase, error)) {
+        return "<error>";
+    }
+    Regex::Threads threads;
+    size_t matchStart, matchEnd;
+    if (!regex.Search(line.data(), line.size(), from, matchStart, matchEnd, threads)) {
+        return "<none>";
+    }
+    return line.substr(matchStart, matchEnd - matchStart);
+}
+
+std::string CompileError(const char* pattern) {
+    Regex regex;
+    std::string error;
+    regex.Compile(pattern, false, error);
+    return error;
+}
+
+}  // namespace
+
+TEST(RegexMatchesLiterals) {
+    EXPECT_EQ("abc", Find("abc", "xxabcxx"));
+    EXPECT_EQ("<none>", Find("abd", "xxabcxx"));
+    EXPECT_EQ(".", Find("\\.", "a.b"));
+    EXPECT_EQ("A", Find("\\x41", "zA"));
+    EXPECT_EQ("\xC3\xA9", Find("\\u00e9", "x\xC3\xA9"));
+}
+
+TEST(RegexMatchesClasses) {
+    EXPECT_EQ("bca", Find("[a-c]+", "zzbcaz"));
+    EXPECT_EQ("b", Find("[^a]", "aab"));
+    EXPECT_EQ("123", Find("\\d+", "ab123c"));
+    EXPECT_EQ("x", Find("\\D", "12x"));
+    EXPECT_EQ("foo_1", Find("\\w+", "  foo_1 "));
+    EXPECT_EQ("-", Find("\\W", "ab-"));
+    EXPECT_EQ(" ", Find("\\s", "a b"));
+    EXPECT_EQ("1.2.3", Find("[\\d.]+", "v1.2.3"));
+}
+
+TEST(RegexDotMatchesOneCodePoint) {
+    EXPECT_EQ("a\xC3\xA9" "c", Find("a.c", "a\xC3\xA9" "c"));
+    EXPECT_EQ("\xF0\x9F\x98\x80", Find(".", "\xF0\x9F\x98\x80"));
+}
+
+TEST(RegexMatchesAnchorsAndBoundaries) {
+    EXPECT_EQ("foo", Find("^foo", "foo foo"));
+    EXPECT_EQ("<none>", Find("^foo", "foo foo", false, 1));
+    EXPECT_EQ("foo", Find("foo$", "foo foo"));
+    EXPECT_EQ("<none>", Find("\\bfoo\\b", "xfoo foox"));
+    EXPECT_EQ("foo", Find("\\bfoo\\b", "xfoo foo"));
+    EXPECT_EQ("oo", Find("\\Boo", "foo"));
+}
+
+// Like JavaScript, the leftmost match wins, then the first alternative.
+TEST(RegexPrefersLeftmostThenFirstAlternative) {
+    EXPECT_EQ("cat", Find("cat|category", "category"));
+    EXPECT_EQ("category", Find("category|cat", "category"));
+    EXPECT_EQ("dog", Find("cat|dog", "dog cat"));
+}
+
+TEST(RegexRepeatsGreedilyOrLazily) {
+    EXPECT_EQ("aaa", Find("a+", "aaa"));
+    EXPECT_EQ("a", Find("a+?", "aaa"));
+    EXPECT_EQ("<a><b>", Find("<.*>", "<a><b>"));
+    EXPECT_EQ("<a>", Find("<.*?>", "<a><b>"));
+    EXPECT_EQ("aaa", Find("a{2,3}", "aaaa"));
+    EXPECT_EQ("aa", Find("a{2,3}?", "aaaa"));
+    EXPECT_EQ("<none>", Find("a{2}", "a"));
+    EXPECT_EQ("ababc", Find("(ab)*c", "ababc"));
+    EXPECT_EQ("abab", Find("(?:ab)+", "abab"));
+}
+
+TEST(RegexAllowsEmptyMatches) {
+    EXPECT_EQ("", Find("x*", "abc"));
+    EXPECT_EQ("", Find("$", "abc"));
+}
+
+TEST(RegexSearchesFromAnOffset) {
+    EXPECT_EQ("foo", Find("f.o", "foo fxo", false, 0));
+    EXPECT_EQ("fxo", Find("f.o", "foo fxo", false, 1));
+    EXPECT_EQ("<none>", Find("f.o", "foo fxo", false, 5));
+}
+
+TEST(RegexIgnoresCase) {
+    EXPECT_EQ("foo", Find("FOO", "xfoo", true));
+    EXPECT_EQ("abc", Find("[A-Z]+", "abc", true));
+    EXPECT_EQ("<none>", Find("[A-Z]+", "abc", false));
+    EXPECT_EQ("\xC3\xA9T\xC3\x89", Find("\xC3\x89t\xC3\xA9", "\xC3\xA9T\xC3\x89", true));
+}
+
+TEST(RegexRejectsUnsupportedSyntax) {
+    EXPECT_EQ("Backreferences are not supported", CompileError("(a)\\1"));
+    EXPECT_EQ("Lookaround and named groups are not supported", CompileError("(?=a)"));
+    EXPECT_EQ("Lookaround and named groups are not supported", CompileError("(?!a)"));
+    EXPECT_EQ("Unterminated group", CompileError("a("));
+    EXPECT_EQ("Range out of order in character class", CompileError("[b-a]"));
+    EXPECT_EQ("Nothing to repeat", CompileError("*a"));
+    EXPECT_EQ("Numbers out of order in {} quantifier", CompileError("a{3,1}"));
+}
+
+TEST(RegexFindsRequiredLiterals) {
+    Regex regex;
+    std::string error;
+
+    EXPECT_TRUE(regex.Compile("abc", false, error));
+    EXPECT_EQ("abc", regex.RequiredLiteral());
+    EXPECT_TRUE(regex.IsLiteral());
+
+    EXPECT_TRUE(regex.Compile("^foo", false, error));
+    EXPECT_EQ("foo", regex.RequiredLiteral());
+    EXPECT_FALSE(regex.IsLiteral());
+
+    EXPECT_TRUE(regex.Compile("FOO", true, error));
+    EXPECT_EQ("foo", regex.RequiredLiteral());
+
+    EXPECT_TRUE(regex.Compile("cat|dog", false, error));
+    EXPECT_EQ("", regex.RequiredLiteral());
+}
+
+// Patterns that take exponential time with backtracking still finish.
+TEST(RegexRunsInLinearTime) {
+    std::string line(20000, 'a');
+    EXPECT_EQ("<none>", Find("(a*)*b", line));
+    EXPECT_EQ("<none>", Find("(a|aa)+$", line + "!"));
+    EXPECT_EQ("<none>", Find("(x+x+)+y", std::string(20000, 'x')));
+}
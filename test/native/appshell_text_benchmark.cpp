@@ -0,0 +1,200 @@
+/*
+ * Copyright (c) 2016 - present Adobe Systems Incorporated. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+// Compares ClassifyText() and IsValidUTF8() with the ICU charset detection
+// that every file read used to go through. Run it on a tree of real source
+// files, e.g.
+//
+//     appshell_text_benchmark ../brackets/src
+//
+// It reads every file under the given paths into memory, then times several
+// passes over the text files with each method. Binary files are counted but
+// not timed, since ClassifyText() gives up on them at the first NUL.
+
+#include "appshell/appshell_text.h"
+
+#include <unicode/ucsdet.h>
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include <string>
+#include <vector>
+
+namespace {
+
+const int PASSES = 5;
+
+// Files bigger than this are left out, as the editor won't open them.
+const off_t MAX_FILE_SIZE = 16 * 1024 * 1024;
+
+double GetSeconds() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+void ReadFiles(const std::string& path, std::vector<std::string>& files) {
+    struct stat info;
+    if (lstat(path.c_str(), &info) != 0) {
+        return;
+    }
+
+    if (S_ISDIR(info.st_mode)) {
+        DIR* dir = opendir(path.c_str());
+        if (dir == NULL) {
+            return;
+        }
+        struct dirent* entry;
+        while ((entry = readdir(dir)) != NULL) {
+            if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0) {
+                ReadFiles(path + "/" + entry->d_name, files);
+            }
+        }
+        closedir(dir);
+    } else if (S_ISREG(info.st_mode) && info.st_size <= MAX_FILE_SIZE) {
+        FILE* file = fopen(path.c_str(), "rb");
+        if (file == NULL) {
+            return;
+        }
+        std::string contents(info.st_size, '\0');
+        size_t length = contents.empty() ? 0 : fread(&contents[0], 1, contents.size(), file);
+        contents.resize(length);
+        fclose(file);
+        files.push_back(contents);
+    }
+}
+
+// What ReadFile did before ClassifyText: open a detector for each file and
+// have ICU work out the charset.
+std::string DetectWithNewDetector(const std::string& contents) {
+    UErrorCode error = U_ZERO_ERROR;
+    UCharsetDetector* detector = ucsdet_open(&error);
+    ucsdet_setText(detector, contents.data(), (int32_t)contents.size(), &error);
+    const UCharsetMatch* match = ucsdet_detect(detector, &error);
+    std::string name = (U_SUCCESS(error) && match) ? ucsdet_getName(match, &error) : "";
+    ucsdet_close(detector);
+    return name;
+}
+
+// The same, reusing one detector.
+std::string DetectWithDetector(UCharsetDetector* detector, const std::string& contents) {
+    UErrorCode error = U_ZERO_ERROR;
+    ucsdet_setText(detector, contents.data(), (int32_t)contents.size(), &error);
+    const UCharsetMatch* match = ucsdet_detect(detector, &error);
+    return (U_SUCCESS(error) && match) ? ucsdet_getName(match, &error) : "";
+}
+
+void Report(const char* name, double seconds, size_t fileCount, size_t totalBytes) {
+    double perPass = seconds / PASSES;
+    printf("%-28s %10.2f ms/pass %10.2f us/file %10.1f MB/s\n", name,
+           perPass * 1e3, perPass * 1e6 / fileCount, totalBytes / perPass / (1024 * 1024));
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <file or directory>...\n", argv[0]);
+        return 2;
+    }
+
+    std::vector<std::string> allFiles;
+    for (int i = 1; i < argc; i++) {
+        ReadFiles(argv[i], allFiles);
+    }
+
+    std::vector<std::string> files;
+    size_t totalBytes = 0;
+    int classCounts[4] = { 0, 0, 0, 0 };
+    int icuDisagreements = 0;
+    UErrorCode error = U_ZERO_ERROR;
+    UCharsetDetector* detector = ucsdet_open(&error);
+
+    for (size_t i = 0; i < allFiles.size(); i++) {
+        TextClass textClass = ClassifyText(allFiles[i].data(), allFiles[i].size());
+        classCounts[textClass]++;
+        if (textClass == TEXT_BINARY) {
+            continue;
+        }
+        files.push_back(allFiles[i]);
+        totalBytes += files.back().size();
+        // ICU calls plain ASCII ISO-8859-1, which reads the same.
+        std::string charSet = DetectWithDetector(detector, allFiles[i]);
+        if (textClass == TEXT_UTF8 && charSet != "UTF-8") {
+            icuDisagreements++;
+        }
+    }
+
+    if (files.empty()) {
+        fprintf(stderr, "no text files found\n");
+        return 1;
+    }
+
+    printf("%d ASCII, %d UTF-8 and %d other text files, %.1f MB; %d binary files left out\n",
+           classCounts[TEXT_ASCII], classCounts[TEXT_UTF8], classCounts[TEXT_AMBIGUOUS],
+           totalBytes / (1024.0 * 1024.0), classCounts[TEXT_BINARY]);
+    printf("ICU named something other than UTF-8 for %d UTF-8 files\n\n", icuDisagreements);
+
+    // Keeps the compiler from dropping the work.
+    size_t checksum = 0;
+    double start;
+
+    start = GetSeconds();
+    for (int pass = 0; pass < PASSES; pass++) {
+        for (size_t i = 0; i < files.size(); i++) {
+            checksum += DetectWithNewDetector(files[i]).size();
+        }
+    }
+    Report("ICU, detector per file", GetSeconds() - start, files.size(), totalBytes);
+
+    start = GetSeconds();
+    for (int pass = 0; pass < PASSES; pass++) {
+        for (size_t i = 0; i < files.size(); i++) {
+            checksum += DetectWithDetector(detector, files[i]).size();
+        }
+    }
+    Report("ICU, shared detector", GetSeconds() - start, files.size(), totalBytes);
+
+    start = GetSeconds();
+    for (int pass = 0; pass < PASSES; pass++) {
+        for (size_t i = 0; i < files.size(); i++) {
+            checksum += ClassifyText(files[i].data(), files[i].size());
+        }
+    }
+    Report("ClassifyText", GetSeconds() - start, files.size(), totalBytes);
+
+    start = GetSeconds();
+    for (int pass = 0; pass < PASSES; pass++) {
+        for (size_t i = 0; i < files.size(); i++) {
+            checksum += IsValidUTF8(files[i].data(), files[i].size());
+        }
+    }
+    Report("IsValidUTF8", GetSeconds() - start, files.size(), totalBytes);
+
+    ucsdet_close(detector);
+    return checksum == 0 ? 1 : 0;
+}
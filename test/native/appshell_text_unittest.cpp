@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2016 - present Adobe Systems Incorporated. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "appshell/appshell_text.h"
+#include "unittest.h"
+
+#include <string>
+
+namespace {
+
+TextClass Classify(const std::string& text) {
+    return ClassifyText(text.data(), text.size());
+}
+
+bool IsValid(const std::string& text) {
+    return IsValidUTF8(text.data(), text.size());
+}
+
+}  // namespace
+
+TEST(ClassifyTextFindsASCII) {
+    EXPECT_EQ(TEXT_ASCII, Classify(""));
+    EXPECT_EQ(TEXT_ASCII, Classify("function () {\n\treturn 1;\n}\n"));
+}
+
+TEST(ClassifyTextFindsUTF8) {
+    EXPECT_EQ(TEXT_UTF8, Classify("caf\xC3\xA9"));
+    EXPECT_EQ(TEXT_UTF8, Classify("\xE2\x82\xAC 5"));
+    EXPECT_EQ(TEXT_UTF8, Classify("\xF0\x9F\x98\x80"));
+}
+
+TEST(ClassifyTextFindsBinary) {
+    EXPECT_EQ(TEXT_BINARY, Classify(std::string("ab\0cd", 5)));
+    EXPECT_EQ(TEXT_BINARY, Classify(std::string("caf\xC3\xA9\0", 6)));
+    // Invalid UTF-8 followed by a NUL is still binary.
+    EXPECT_EQ(TEXT_BINARY, Classify(std::string("\xE9t\xE9\0", 4)));
+}
+
+TEST(ClassifyTextFindsOtherEncodings) {
+    EXPECT_EQ(TEXT_AMBIGUOUS, Classify("\xE9t\xE9"));
+    EXPECT_EQ(TEXT_AMBIGUOUS, Classify("caf\xC3\xA9 \xFF"));
+}
+
+TEST(IsValidUTF8AcceptsNUL) {
+    EXPECT_TRUE(IsValid(std::string("a\0b", 3)));
+    EXPECT_EQ(TEXT_BINARY, Classify(std::string("a\0b", 3)));
+}
+
+TEST(IsValidUTF8RejectsOverlongForms) {
+    EXPECT_FALSE(IsValid("\xC0\x80"));
+    EXPECT_FALSE(IsValid("\xC1\xBF"));
+    EXPECT_FALSE(IsValid("\xE0\x80\x80"));
+    EXPECT_FALSE(IsValid("\xE0\x9F\xBF"));
+    EXPECT_FALSE(IsValid("\xF0\x80\x80\x80"));
+    EXPECT_FALSE(IsValid("\xF0\x8F\xBF\xBF"));
+    EXPECT_TRUE(IsValid("\xE0\xA0\x80"));
+    EXPECT_TRUE(IsValid("\xF0\x90\x80\x80"));
+}
+
+TEST(IsValidUTF8RejectsSurrogatesAndLargeCodePoints) {
+    EXPECT_FALSE(IsValid("\xED\xA0\x80"));
+    EXPECT_FALSE(IsValid("\xED\xBF\xBF"));
+    EXPECT_TRUE(IsValid("\xED\x9F\xBF"));
+    EXPECT_TRUE(IsValid("\xF4\x8F\xBF\xBF"));
+    EXPECT_FALSE(IsValid("\xF4\x90\x80\x80"));
+    EXPECT_FALSE(IsValid("\xF5\x80\x80\x80"));
+}
+
+TEST(IsValidUTF8RejectsBadContinuations) {
+    EXPECT_FALSE(IsValid("\x80"));
+    EXPECT_FALSE(IsValid("a\xBF"));
+    EXPECT_FALSE(IsValid("\xC3\x28"));
+    EXPECT_FALSE(IsValid("\xE2\x82\x28"));
+    EXPECT_FALSE(IsValid("\xF0\x9F\x98\x28"));
+}
+
+TEST(IsValidUTF8RejectsTruncatedSequences) {
+    EXPECT_FALSE(IsValid("\xC3"));
+    EXPECT_FALSE(IsValid("abc\xE2\x82"));
+    EXPECT_FALSE(IsValid("abc\xF0\x9F\x98"));
+}
+
+// The ASCII runs are skipped 16 bytes at a time, so put the interesting byte
+// at every offset around those blocks.
+TEST(ClassifyTextChecksEveryOffset) {
+    for (size_t offset = 0; offset < 48; offset++) {
+        std::string text(48, 'x');
+
+        std::string utf8 = text;
+        utf8.insert(offset, "\xC3\xA9");
+        EXPECT_EQ(TEXT_UTF8, Classify(utf8));
+        EXPECT_TRUE(IsValid(utf8));
+
+        std::string binary = text;
+        binary[offset] = '\0';
+        EXPECT_EQ(TEXT_BINARY, Classify(binary));
+        EXPECT_TRUE(IsValid(binary));
+
+        std::string latin1 = text;
+        latin1[offset] = '\xE9';
+        EXPECT_EQ(TEXT_AMBIGUOUS, Classify(latin1));
+        EXPECT_FALSE(IsValid(latin1));
+
+        // A sequence cut off by the end of the buffer.
+        std::string truncated = text.substr(0, offset) + "\xE2\x82";
+        EXPECT_FALSE(IsValid(truncated));
+    }
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2016 - present Adobe Systems Incorporated. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "unittest.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+namespace {
+
+struct UnitTest {
+    const char* name;
+    UnitTestFunction function;
+};
+
+std::vector<UnitTest>& GetUnitTests() {
+    static std::vector<UnitTest> tests;
+    return tests;
+}
+
+int failureCount = 0;
+
+}  // namespace
+
+UnitTestRegistration::UnitTestRegistration(const char* name, UnitTestFunction function) {
+    UnitTest test = { name, function };
+    GetUnitTests().push_back(test);
+}
+
+void ReportUnitTestFailure(const char* file, int line, const std::string& message) {
+    fprintf(stderr, "%s:%d: %s\n", file, line, message.c_str());
+    failureCount++;
+}
+
+// Runs every test, or those whose names contain the first argument.
+int main(int argc, char* argv[]) {
+    const char* filter = argc > 1 ? argv[1] : "";
+    std::vector<UnitTest>& tests = GetUnitTests();
+    int run = 0;
+    int failed = 0;
+
+    for (size_t i = 0; i < tests.size(); i++) {
+        if (strstr(tests[i].name, filter) == NULL) {
+            continue;
+        }
+        int failuresBefore = failureCount;
+        tests[i].function();
+        run++;
+        if (failureCount != failuresBefore) {
+            fprintf(stderr, "FAILED %s\n", tests[i].name);
+            failed++;
+        }
+    }
+
+    printf("%d of %d tests passed\n", run - failed, run);
+    return failed == 0 ? 0 : 1;
+}
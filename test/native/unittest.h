@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2016 - present Adobe Systems Incorporated. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#pragma once
+
+#include <string>
+
+// A small harness for the native unit tests, so that they build with nothing
+// but the sources under test. Tests are registered with TEST() and run by
+// run_all_unittests.cpp; a failed check is reported and the test carries on.
+
+typedef void (*UnitTestFunction)();
+
+struct UnitTestRegistration {
+    UnitTestRegistration(const char* name, UnitTestFunction function);
+};
+
+void ReportUnitTestFailure(const char* file, int line, const std::string& message);
+
+#define TEST(name) \
+    static void name(); \
+    static UnitTestRegistration name##_registration(#name, name); \
+    static void name()
+
+#define EXPECT_TRUE(condition) \
+    do { \
+        if (!(condition)) \
+            ReportUnitTestFailure(__FILE__, __LINE__, "expected " #condition); \
+    } while (0)
+
+#define EXPECT_FALSE(condition) EXPECT_TRUE(!(condition))
+
+#define EXPECT_EQ(expected, actual) \
+    do { \
+        if (!((expected) == (actual))) \
+            ReportUnitTestFailure(__FILE__, __LINE__, "expected " #actual " == " #expected); \
+    } while (0)
@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2016 - present Adobe Systems Incorporated. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+"use strict";
+
+var assert        = require("assert"),
+    child_process = require("child_process"),
+    fs            = require("fs"),
+    os            = require("os"),
+    path          = require("path"),
+    Logger        = require("../../appshell/node-core/Logger"),
+    SpecHelper    = require("./SpecHelper");
+
+var LOGGER_PATH = require.resolve("../../appshell/node-core/Logger");
+
+var tempDir = fs.mkdtempSync(path.join(os.tmpdir(), "brackets-logger-"));
+
+function readFile(filename) {
+    try {
+        return fs.readFileSync(filename, "utf8");
+    } catch (e) {
+        return "";
+    }
+}
+
+/**
+ * Calls callback once condition() is true, checking every 20ms.
+ */
+function waitFor(condition, callback) {
+    if (condition()) {
+        callback();
+    } else {
+        setTimeout(waitFor, 20, condition, callback);
+    }
+}
+
+/**
+ * Returns the numbers in the messages "<prefix><number>" in the given text.
+ */
+function sequence(text, prefix) {
+    var pattern = new RegExp(prefix + "(\\d+)", "g"),
+        numbers = [],
+        match;
+    while ((match = pattern.exec(text)) !== null) {
+        numbers.push(Number(match[1]));
+    }
+    return numbers;
+}
+
+/**
+ * Checks that numbers holds 0 to count - 1, in order.
+ */
+function assertSequence(numbers, count) {
+    assert.strictEqual(numbers.length, count);
+    numbers.forEach(function (number, i) {
+        assert.strictEqual(number, i);
+    });
+}
+
+process.on("exit", function () {
+    fs.readdirSync(tempDir).forEach(function (name) {
+        fs.unlinkSync(path.join(tempDir, name));
+    });
+    fs.rmdirSync(tempDir);
+});
+
+SpecHelper.run({
+    "keeps the last 1000 messages, oldest first": function () {
+        var i,
+            history;
+        for (i = 0; i < 1005; i++) {
+            Logger.info("message %d", i);
+        }
+
+        history = Logger.getLogHistory();
+        assert.strictEqual(history.length, 1000);
+        assert.strictEqual(history[0].message, "message 5");
+        assert.strictEqual(history[0].level, "info");
+        assert.ok(history[0].timestamp instanceof Date);
+        assert.strictEqual(history[999].message, "message 1004");
+
+        history = Logger.getLogHistory(3);
+        assert.deepEqual(history.map(function (entry) { return entry.message; }),
+                         ["message 1002", "message 1003", "message 1004"]);
+        assert.strictEqual(Logger.getLogHistory(0).length, 1000);
+        assert.strictEqual(Logger.getLogHistory(5000).length, 1000);
+    },
+
+    "emits each message": function () {
+        var seen = null;
+        function listener(level, timestamp, message) {
+            seen = [level, message];
+        }
+        Logger.on("log", listener);
+        Logger.warn("careful");
+        Logger.dir("%s and %d");
+        Logger.removeListener("log", listener);
+        assert.deepEqual(seen, ["dir", "%s and %d"]);
+    },
+
+    "appends messages to the log file": function (done) {
+        var filename = path.join(tempDir, "append.log");
+        Logger.setLogFilename(filename);
+        Logger.log("first");
+        Logger.error("second");
+        waitFor(function () {
+            return /second/.test(readFile(filename));
+        }, function () {
+            var lines = readFile(filename).split("\n");
+            assert.ok(/^\[log: .*\] first$/.test(lines[0]));
+            assert.ok(/^\[error: .*\] second$/.test(lines[1]));
+            Logger.setLogFilename(null);
+            done();
+        });
+    },
+
+    "rotates the log file at 5MB and keeps two old ones": function (done) {
+        var filename = path.join(tempDir, "rotate.log"),
+            line = new Array(1024).join("x"),
+            count = 16 * 1024,
+            i;
+        Logger.setLogFilename(filename);
+        for (i = 0; i < count; i++) {
+            Logger.log("r" + i + " " + line);
+        }
+        waitFor(function () {
+            return new RegExp("r" + (count - 1) + " ").test(readFile(filename));
+        }, function () {
+            var limit = 5 * 1024 * 1024 + 256 * 1024 + 1024,
+                kept = readFile(filename + ".2") + readFile(filename + ".1") + readFile(filename),
+                numbers = sequence(kept, "r");
+
+            assert.ok(!fs.existsSync(filename + ".3"));
+            assert.ok(fs.statSync(filename + ".1").size >= 5 * 1024 * 1024);
+            [filename, filename + ".1", filename + ".2"].forEach(function (name) {
+                assert.ok(fs.statSync(name).size < limit);
+            });
+            // The oldest messages were dropped with the oldest file, and the
+            // rest are all there in order
+            numbers.forEach(function (number, i) {
+                assert.strictEqual(number, count - numbers.length + i);
+            });
+            assert.ok(numbers.length < count);
+            Logger.setLogFilename(null);
+            done();
+        });
+    },
+
+    "puts messages in the file that was set when they were logged": function (done) {
+        var first = path.join(tempDir, "first.log"),
+            second = path.join(tempDir, "second.log"),
+            i;
+        Logger.setLogFilename(first);
+        for (i = 0; i < 5000; i++) {
+            Logger.log("a" + i);
+        }
+        Logger.setLogFilename(second);
+        for (i = 0; i < 5000; i++) {
+            Logger.log("b" + i);
+        }
+        Logger.setLogFilename(null);
+        for (i = 0; i < 10; i++) {
+            Logger.log("c" + i);
+        }
+        waitFor(function () {
+            return /b4999/.test(readFile(second));
+        }, function () {
+            assertSequence(sequence(readFile(first), "a"), 5000);
+            assertSequence(sequence(readFile(second), "b"), 5000);
+            assert.ok(!/[abc]/.test(readFile(first).replace(/a\d+/g, "").replace(/\[log: [^\]]*\]/g, "")));
+            assert.strictEqual(sequence(readFile(first) + readFile(second), "c").length, 0);
+            done();
+        });
+    },
+
+    "writes buffered messages when the process exits": function () {
+        var filename = path.join(tempDir, "exit.log"),
+            script = "var Logger = require(" + JSON.stringify(LOGGER_PATH) + ");" +
+                "Logger.setLogFilename(" + JSON.stringify(filename) + ");" +
+                "for (var i = 0; i < 100000; i++) { Logger.log('e' + i); }" +
+                "process.exit(0);";
+        child_process.execFileSync(process.execPath, ["-e", script]);
+        assertSequence(sequence(readFile(filename), "e"), 100000);
+    }
+});
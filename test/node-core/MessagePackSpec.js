@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2016 - present Adobe Systems Incorporated. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+"use strict";
+
+var assert      = require("assert"),
+    MessagePack = require("../../appshell/node-core/MessagePack"),
+    SpecHelper  = require("./SpecHelper");
+
+function bytes(value) {
+    return Array.prototype.slice.call(MessagePack.encode(value));
+}
+
+function roundTrip(value) {
+    return MessagePack.decode(MessagePack.encode(value));
+}
+
+function repeat(text, count) {
+    return new Array(count + 1).join(text);
+}
+
+SpecHelper.run({
+    "encodes numbers in the smallest format": function () {
+        assert.deepEqual(bytes(0), [0x00]);
+        assert.deepEqual(bytes(127), [0x7f]);
+        assert.deepEqual(bytes(128), [0xcc, 0x80]);
+        assert.deepEqual(bytes(300), [0xcd, 0x01, 0x2c]);
+        assert.deepEqual(bytes(65536), [0xce, 0x00, 0x01, 0x00, 0x00]);
+        assert.deepEqual(bytes(-1), [0xff]);
+        assert.deepEqual(bytes(-32), [0xe0]);
+        assert.deepEqual(bytes(-33), [0xd0, 0xdf]);
+        assert.deepEqual(bytes(-129), [0xd1, 0xff, 0x7f]);
+        assert.deepEqual(bytes(0.5), [0xcb, 0x3f, 0xe0, 0, 0, 0, 0, 0, 0]);
+    },
+
+    "round trips numbers at every boundary": function () {
+        [0, 1, 127, 128, 255, 256, 65535, 65536, 4294967295, 4294967296,
+         -1, -32, -33, -128, -129, -32768, -32769, -2147483648, -2147483649,
+         0.1, -2.5, 1e300, Number.MAX_SAFE_INTEGER, Number.MIN_SAFE_INTEGER].forEach(function (value) {
+            assert.strictEqual(roundTrip(value), value);
+        });
+    },
+
+    "round trips strings of every header size": function () {
+        assert.deepEqual(bytes("a"), [0xa1, 0x61]);
+        [0, 10, 11, 31, 32, 85, 86, 255, 256, 21845, 21846, 65536].forEach(function (length) {
+            var ascii = repeat("x", length),
+                multibyte = repeat("é", length),
+                astral = repeat("😀", length);
+            assert.strictEqual(roundTrip(ascii), ascii);
+            assert.strictEqual(roundTrip(multibyte), multibyte);
+            assert.strictEqual(roundTrip(astral), astral);
+        });
+    },
+
+    "round trips arrays, maps and buffers of every header size": function () {
+        [0, 15, 16, 255, 256, 65535, 65536].forEach(function (length) {
+            var array = [],
+                map = {},
+                buffer = Buffer.alloc(length),
+                i;
+            for (i = 0; i < length; i++) {
+                array.push(i);
+                map["k" + i] = i;
+                buffer[i] = i % 256;
+            }
+            assert.deepEqual(roundTrip(array), array);
+            assert.deepEqual(roundTrip(map), map);
+            assert.ok(roundTrip(buffer).equals(buffer));
+        });
+        assert.deepEqual(bytes(Buffer.from([1, 2])), [0xc4, 0x02, 0x01, 0x02]);
+    },
+
+    "encodes values the way JSON.stringify sees them": function () {
+        var date = new Date(0);
+        assert.deepEqual(roundTrip({a: 1, b: undefined, c: function () {}, d: null}), {a: 1, d: null});
+        assert.deepEqual(roundTrip([undefined, function () {}, null]), [null, null, null]);
+        assert.strictEqual(roundTrip(date), date.toJSON());
+        assert.deepEqual(roundTrip({toJSON: function () { return [1]; }}), [1]);
+        assert.deepEqual(bytes({a: 1, b: undefined}), [0x81, 0xa1, 0x61, 0x01]);
+    },
+
+    "patches the count of large maps with skipped values": function () {
+        var map = {},
+            expected = {},
+            i;
+        for (i = 0; i < 20; i++) {
+            map["k" + i] = i % 2 ? i : undefined;
+            if (i % 2) {
+                expected["k" + i] = i;
+            }
+        }
+        assert.deepEqual(roundTrip(map), expected);
+    },
+
+    "round trips nested values": function () {
+        var value = {
+            id: 7,
+            domain: "fileSystem",
+            command: "readFile",
+            parameters: ["/tmp/é", {encoding: "utf8", flags: [true, false]}],
+            data: Buffer.from("abc")
+        };
+        var decoded = roundTrip(value);
+        assert.ok(decoded.data.equals(value.data));
+        decoded.data = value.data;
+        assert.deepEqual(decoded, value);
+    },
+
+    "decodes formats the encoder doesn't write": function () {
+        var decode = MessagePack.decode;
+        assert.strictEqual(decode(Buffer.from([0xca, 0x3f, 0xc0, 0x00, 0x00])), 1.5);
+        assert.strictEqual(decode(Buffer.from([0xcf, 0, 0, 0, 1, 0, 0, 0, 2])), 4294967298);
+        assert.strictEqual(decode(Buffer.from([0xd3, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xfe])), -2);
+        assert.strictEqual(decode(Buffer.from([0xd9, 0x01, 0x61])), "a");
+        assert.deepEqual(decode(Buffer.from([0xdd, 0, 0, 0, 1, 0xc3])), [true]);
+        assert.deepEqual(decode(Buffer.from([0xdf, 0, 0, 0, 1, 0xa1, 0x61, 0xc2])), {a: false});
+        assert.ok(decode(Buffer.from([0xc6, 0, 0, 0, 1, 0x09])).equals(Buffer.from([9])));
+    },
+
+    "keeps __proto__ keys as plain properties": function () {
+        var decoded = MessagePack.decode(Buffer.from([0x81, 0xa9, 0x5f, 0x5f, 0x70, 0x72, 0x6f, 0x74, 0x6f,
+                                                     0x5f, 0x5f, 0x81, 0xa1, 0x78, 0x01]));
+        assert.ok(Object.prototype.hasOwnProperty.call(decoded, "__proto__"));
+        assert.strictEqual(Object.getPrototypeOf(decoded), Object.prototype);
+        assert.strictEqual(decoded.x, undefined);
+    },
+
+    "returns the right strings when cached ones collide": function () {
+        var i,
+            value;
+        for (i = 0; i < 20000; i++) {
+            value = "s" + i;
+            assert.strictEqual(roundTrip(value), value);
+        }
+    },
+
+    "rejects malformed data": function () {
+        var decode = MessagePack.decode;
+        assert.throws(function () { decode(Buffer.alloc(0)); }, /ends early/);
+        assert.throws(function () { decode(Buffer.from([0x92, 0x01])); }, /ends early/);
+        assert.throws(function () { decode(Buffer.from([0xa3, 0x61])); }, /inside a string/);
+        assert.throws(function () { decode(Buffer.from([0xc4, 0x05, 0x01])); }, /inside a bin/);
+        assert.throws(function () { decode(Buffer.from([0xcd, 0x01])); }, RangeError);
+        assert.throws(function () { decode(Buffer.from([0x01, 0x02])); }, /Extra data/);
+        assert.throws(function () { decode(Buffer.from([0xc1])); }, /Unsupported MessagePack type 0xc1/);
+        // A failed decode doesn't affect the next one
+        assert.strictEqual(decode(Buffer.from([0x05])), 5);
+    }
+});
@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2016 - present Adobe Systems Incorporated. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+"use strict";
+
+/**
+ * A small runner for the node-core specs, so that they need nothing but
+ * Node. Each spec file is run in its own process ("node LoggerSpec.js"), as
+ * the modules under test keep state, and passes its tests to run(). Tests
+ * that take a callback are asynchronous.
+ */
+
+/** @define{number} Number of ms an asynchronous test may take */
+var TEST_TIMEOUT = 10000;
+
+/**
+ * Runs the tests one after another and sets the exit code if any fails.
+ * @param {Object.<string, function(function()=)>} tests Test functions by name
+ */
+function run(tests) {
+    var names = Object.keys(tests),
+        index = 0,
+        failures = 0,
+        current = null;
+
+    function next() {
+        if (index === names.length) {
+            console.log((names.length - failures) + " of " + names.length + " tests passed");
+            process.exitCode = failures === 0 ? 0 : 1;
+            return;
+        }
+
+        var name = names[index++],
+            test = tests[name],
+            finished = false,
+            timer = null;
+
+        function finish(err) {
+            if (finished) {
+                return;
+            }
+            finished = true;
+            current = null;
+            if (timer) {
+                clearTimeout(timer);
+            }
+            if (err) {
+                failures++;
+                console.error("FAILED " + name + "\n" + (err.stack || err));
+            }
+            setImmediate(next);
+        }
+
+        current = finish;
+        try {
+            if (test.length > 0) {
+                timer = setTimeout(function () {
+                    finish(new Error("Timed out after " + TEST_TIMEOUT + "ms"));
+                }, TEST_TIMEOUT);
+                test(function () { finish(null); });
+            } else {
+                test();
+                finish(null);
+            }
+        } catch (e) {
+            finish(e);
+        }
+    }
+
+    // A failed assertion in a callback fails the test that is running
+    process.on("uncaughtException", function (err) {
+        if (current) {
+            current(err);
+        } else {
+            console.error(err.stack || err);
+            process.exitCode = 1;
+        }
+    });
+
+    next();
+}
+
+exports.run = run;
@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2016 - present Adobe Systems Incorporated. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+"use strict";
+
+var assert     = require("assert"),
+    WorkerPool = require("../../appshell/node-core/WorkerPool"),
+    SpecHelper = require("./SpecHelper");
+
+var COMMANDS_PATH = require.resolve("./fixtures/WorkerCommands");
+
+/**
+ * Runs a command from fixtures/WorkerCommands and calls back with the error,
+ * the result and the progress messages.
+ */
+function runCommand(exportName, isAsync, parameters, callback) {
+    var progress = [],
+        started = false;
+    WorkerPool.run({
+        modulePath: COMMANDS_PATH,
+        exportName: exportName,
+        isAsync: isAsync,
+        parameters: parameters,
+        onStart: function () {
+            started = true;
+        },
+        onProgress: function (msg) {
+            progress.push(msg);
+        },
+        onDone: function (err, result) {
+            assert.ok(started, "onDone without onStart");
+            callback(err, result, progress);
+        }
+    });
+}
+
+SpecHelper.run({
+    "runs commands in another process": function (done) {
+        runCommand("pid", false, [], function (err, result) {
+            assert.strictEqual(err, null);
+            assert.strictEqual(typeof result, "number");
+            assert.notStrictEqual(result, process.pid);
+            done();
+        });
+    },
+
+    "returns the results of synchronous commands": function (done) {
+        runCommand("echo", false, [{a: [1, "two", null]}], function (err, result) {
+            assert.strictEqual(err, null);
+            assert.deepEqual(result, {a: [1, "two", null]});
+            done();
+        });
+    },
+
+    "passes progress and results of asynchronous commands": function (done) {
+        runCommand("add", true, [2, 3], function (err, result, progress) {
+            assert.strictEqual(err, null);
+            assert.strictEqual(result, 5);
+            assert.deepEqual(progress, ["adding"]);
+            done();
+        });
+    },
+
+    "reports every failure as a string": function (done) {
+        runCommand("throwError", false, ["thrown"], function (err1) {
+            runCommand("failWithError", true, ["error object"], function (err2) {
+                runCommand("failWithString", true, ["plain string"], function (err3) {
+                    runCommand("missing", false, [], function (err4) {
+                        assert.strictEqual(err1, "thrown");
+                        assert.strictEqual(err2, "error object");
+                        assert.strictEqual(err3, "plain string");
+                        assert.strictEqual(typeof err4, "string");
+                        done();
+                    });
+                });
+            });
+        });
+    },
+
+    "sends Buffers both ways": function (done) {
+        runCommand("reverseBuffer", false, [Buffer.from([1, 2, 3, 250])], function (err, result) {
+            assert.strictEqual(err, null);
+            assert.ok(Buffer.isBuffer(result));
+            assert.deepEqual(Array.prototype.slice.call(result), [250, 3, 2, 1]);
+            done();
+        });
+    },
+
+    "runs jobs side by side up to MAX_WORKERS": function (done) {
+        var pids = {},
+            remaining = WorkerPool.MAX_WORKERS * 2,
+            i;
+        function onDone(err, result) {
+            assert.strictEqual(err, null);
+            pids[result] = true;
+            if (--remaining === 0) {
+                assert.ok(Object.keys(pids).length <= WorkerPool.MAX_WORKERS);
+                done();
+            }
+        }
+        for (i = 0; i < WorkerPool.MAX_WORKERS * 2; i++) {
+            runCommand("pid", false, [], onDone);
+        }
+    },
+
+    "replaces a worker that exits": function (done) {
+        runCommand("crash", false, [], function (err) {
+            assert.strictEqual(typeof err, "string");
+            runCommand("echo", false, ["still working"], function (err, result) {
+                assert.strictEqual(err, null);
+                assert.strictEqual(result, "still working");
+                done();
+            });
+        });
+    },
+
+    "runs the encoding benchmark": function (done) {
+        WorkerPool.run({
+            modulePath: require.resolve("../../appshell/node-core/EncodingBenchmark"),
+            exportName: "benchmarkEncodings",
+            isAsync: false,
+            parameters: [5, 10],
+            onStart: function () {},
+            onProgress: function () {},
+            onDone: function (err, result) {
+                assert.strictEqual(err, null);
+                assert.ok(result.json.bytes > 0);
+                assert.ok(result.msgpack.bytes > 0);
+                done();
+            }
+        });
+    }
+});
@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2016 - present Adobe Systems Incorporated. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+"use strict";
+
+/*
+ * Commands run by WorkerPoolSpec in the worker processes.
+ */
+
+function echo(value) {
+    return value;
+}
+
+function add(a, b, callback, progressCallback) {
+    progressCallback("adding");
+    setTimeout(function () {
+        callback(null, a + b);
+    }, 10);
+}
+
+function throwError(text) {
+    throw new Error(text);
+}
+
+function failWithError(text, callback) {
+    callback(new Error(text));
+}
+
+function failWithString(text, callback) {
+    callback(text);
+}
+
+function reverseBuffer(buffer) {
+    var result = Buffer.alloc(buffer.length),
+        i;
+    for (i = 0; i < buffer.length; i++) {
+        result[i] = buffer[buffer.length - 1 - i];
+    }
+    return result;
+}
+
+function pid() {
+    return process.pid;
+}
+
+function crash() {
+    process.exit(3);
+}
+
+exports.echo           = echo;
+exports.add            = add;
+exports.throwError     = throwError;
+exports.failWithError  = failWithError;
+exports.failWithString = failWithString;
+exports.reverseBuffer  = reverseBuffer;
+exports.pid            = pid;
+exports.crash          = crash;